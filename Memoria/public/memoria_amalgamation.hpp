@@ -2,7 +2,9 @@
 
 #include "memoria_common.hpp"
 
+#include "memoria_core_arena.hpp"
 #include "memoria_core_check.hpp"
+#include "memoria_core_codearena.hpp"
 #include "memoria_core_debug.hpp"
 #include "memoria_core_errors.hpp"
 #include "memoria_core_hash.hpp"
@@ -12,6 +14,7 @@
 #include "memoria_core_rtti.hpp"
 #include "memoria_core_search.hpp"
 #include "memoria_core_signature.hpp"
+#include "memoria_core_source.hpp"
 #include "memoria_core_windows.hpp"
 #include "memoria_core_write.hpp"
 #include "memoria_core_hook.hpp"
@@ -23,8 +26,14 @@
 #include "memoria_utils_string.hpp"
 #include "memoria_utils_vector.hpp"
 #include "memoria_utils_format.hpp"
+#include "memoria_utils_hashmap.hpp"
 
+#include "memoria_ext_elf.hpp"
+#include "memoria_ext_import.hpp"
+#include "memoria_ext_integrity.hpp"
 #include "memoria_ext_logger.hpp"
+#include "memoria_ext_manifest.hpp"
 #include "memoria_ext_module.hpp"
 #include "memoria_ext_patch.hpp"
-#include "memoria_ext_sig.hpp"
\ No newline at end of file
+#include "memoria_ext_sig.hpp"
+#include "memoria_ext_snapshot.hpp"
\ No newline at end of file
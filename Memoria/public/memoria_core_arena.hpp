@@ -0,0 +1,188 @@
+//
+// memoria_core_arena.hpp
+//
+// Size-class arena allocator.
+//
+// Memory is taken from the system in 64 KiB slabs, which is the allocation granularity of
+// `VirtualAlloc`, so the slab header of any pointer handed out by an arena is found by masking
+// the pointer. Small objects are carved from slabs dedicated to one size class and recycled
+// through per-thread caches, so the hot path takes no lock; a cache is returned to the arena
+// when its thread exits. Medium sizes are served as runs of whole pages, which are split and
+// coalesced within their slab, and a medium slab whose pages are all free is returned to the
+// system. Anything larger gets its own reservation.
+//
+// All memory of an arena is released at once by `Reset`, which makes arenas suitable for
+// short-lived bulk data. Memory is zeroed only when requested.
+//
+
+#pragma once
+
+#include "memoria_common.hpp"
+
+#include <stdint.h>
+#include <Windows.h>
+
+#define MEMORIA_ARENA_SLAB_SIZE 0x10000
+#define MEMORIA_ARENA_PAGE_SIZE 0x1000
+
+// Small objects: 16, 32, ..., 2048 bytes.
+#define MEMORIA_ARENA_SMALL_CLASSES 8
+#define MEMORIA_ARENA_SMALL_MAX     2048
+
+// Medium objects: runs of up to 15 pages; the first page of a slab holds its header.
+#define MEMORIA_ARENA_MEDIUM_PAGES  (MEMORIA_ARENA_SLAB_SIZE / MEMORIA_ARENA_PAGE_SIZE - 1)
+#define MEMORIA_ARENA_MEDIUM_MAX    (MEMORIA_ARENA_MEDIUM_PAGES * MEMORIA_ARENA_PAGE_SIZE)
+
+MEMORIA_BEGIN
+
+class CArena;
+
+struct ArenaSlab_t;
+struct ArenaCache_t;
+struct ArenaFreeRun_t;
+
+struct ArenaFreeBlock_t
+{
+	ArenaFreeBlock_t *Next;
+};
+
+struct ArenaClassStats_t
+{
+	size_t Blocks;
+	size_t Bytes;
+};
+
+struct ArenaStats_t
+{
+	// Number of slabs and bytes reserved from the system.
+	size_t Slabs;
+	size_t Reserved;
+
+	// Blocks in use, per small size class.
+	ArenaClassStats_t Small[MEMORIA_ARENA_SMALL_CLASSES];
+
+	// Medium and large blocks in use.
+	ArenaClassStats_t Pages;
+
+	// Number of `Reset` calls.
+	uint32_t Epoch;
+};
+
+class CArena
+{
+	CArena(const CArena &) = delete;
+	CArena &operator=(const CArena &) = delete;
+
+private:
+	SRWLOCK _lock = SRWLOCK_INIT;
+
+	// FLS slot of the per-thread caches, allocated on first use. Unlike a TLS slot, it calls
+	// `ReleaseCache` when a thread exits.
+	DWORD _fls = FLS_OUT_OF_INDEXES;
+
+	// Incremented by `Reset`; caches of an older epoch are dropped on their next use.
+	volatile uint32_t _epoch = 0;
+
+	ArenaSlab_t *_slabs = nullptr;
+	ArenaCache_t *_caches = nullptr;
+
+	// Shared free lists of small objects.
+	ArenaFreeBlock_t *_free[MEMORIA_ARENA_SMALL_CLASSES] = {};
+	size_t _free_count[MEMORIA_ARENA_SMALL_CLASSES] = {};
+
+	// Number of small objects carved from slabs.
+	size_t _carved[MEMORIA_ARENA_SMALL_CLASSES] = {};
+
+	// Unused tail of the current slab of each small class.
+	uint8_t *_bump[MEMORIA_ARENA_SMALL_CLASSES] = {};
+	uint8_t *_bump_end[MEMORIA_ARENA_SMALL_CLASSES] = {};
+
+	// Free page runs, indexed by length in pages. Adjacent free runs are always coalesced.
+	ArenaFreeRun_t *_runs[MEMORIA_ARENA_MEDIUM_PAGES + 1] = {};
+
+	// A medium slab with no pages in use, kept so a single run freed and allocated in turn
+	// does not reserve and release a slab each time.
+	ArenaSlab_t *_run_spare = nullptr;
+
+	size_t _slab_count = 0;
+	size_t _reserved = 0;
+
+	// Medium and large blocks in use.
+	ArenaClassStats_t _pages = {};
+
+	ArenaSlab_t *CreateSlab(size_t size, uint8_t kind);
+	void DestroySlab(ArenaSlab_t *slab);
+
+	ArenaCache_t *GetCache();
+	static VOID NTAPI ReleaseCache(PVOID data);
+
+	void *AllocateSmall(size_t index);
+	void *RefillSmall(ArenaCache_t *cache, size_t index);
+	void FreeSmall(void *addr, size_t index);
+
+	void InsertRun(ArenaSlab_t *slab, size_t page, size_t pages);
+	void RemoveRun(ArenaSlab_t *slab, size_t page);
+
+	void *AllocateMedium(size_t pages);
+	void FreeMedium(ArenaSlab_t *slab, void *addr);
+
+	void *AllocateLarge(size_t size);
+
+public:
+	constexpr CArena() = default;
+	~CArena();
+
+	/**
+	 * @brief Allocates `size` bytes aligned to at least 16 bytes.
+	 *
+	 * @param size Number of bytes.
+	 * @param zero If `true`, the memory is zero-filled.
+	 *
+	 * @return Pointer to the memory, or `nullptr` on failure.
+	 */
+	void *Allocate(size_t size, bool zero = false);
+
+	/**
+	 * @brief Returns memory obtained from `Allocate` of this arena.
+	 *
+	 * @return `true` if `addr` belongs to this arena.
+	 */
+	bool Free(void *addr);
+
+	/**
+	 * @brief Returns the usable size of a block, which may exceed the requested size.
+	 */
+	size_t GetSize(const void *addr) const;
+
+	/**
+	 * @brief Releases all memory of the arena at once. Pointers obtained before
+	 *        the call become invalid.
+	 *
+	 * NOTE: The arena must not be used by other threads during the call.
+	 */
+	void Reset();
+
+	/**
+	 * @brief Returns the blocks cached by all threads to the arena and releases the FLS slot.
+	 *        Called by the destructor, and by `Cleanup` for the default arena.
+	 *
+	 * NOTE: The arena must not be used by other threads during the call.
+	 */
+	void ReleaseThreadCaches();
+
+	ArenaStats_t GetStats();
+
+	/**
+	 * @brief Returns the arena that owns `addr`, or `nullptr` if `addr` was not
+	 *        allocated from an arena.
+	 */
+	static CArena *FromPointer(const void *addr);
+};
+
+/**
+ * @brief Returns the arena used by `Memoria::New` and `Memoria::Alloc` for
+ *        readable and writable memory.
+ */
+extern CArena *GetDefaultArena();
+
+MEMORIA_END
\ No newline at end of file
@@ -0,0 +1,80 @@
+//
+// memoria_core_codearena.hpp
+//
+// Executable memory for generated code (trampolines, stubs) with W^X semantics.
+//
+// The arena is a pagefile-backed section mapped twice: a read-write view that code is
+// emitted through, and a read-execute view at an address reachable from the hooked code.
+// No page is ever writable and executable through the same view, and emitting code needs no
+// protection changes. Only the ranges that were written are flushed from the instruction cache.
+//
+// If the section cannot be created or mapped near the requested address, the arena falls
+// back to a single read-write-execute allocation and both views are the same.
+//
+
+#pragma once
+
+#include "memoria_common.hpp"
+
+#include <stdint.h>
+#include <Windows.h>
+
+MEMORIA_BEGIN
+
+class CCodeArena
+{
+	CCodeArena(const CCodeArena &) = delete;
+	CCodeArena &operator=(const CCodeArena &) = delete;
+
+private:
+	HANDLE _section = nullptr;
+
+	uint8_t *_writable = nullptr;
+	uint8_t *_executable = nullptr;
+
+	size_t _size = 0;
+
+public:
+	constexpr CCodeArena() = default;
+	~CCodeArena();
+
+	/**
+	 * @brief Creates both views of the arena.
+	 *
+	 * @param addr_nearest The executable view is placed within a 32-bit displacement of this address.
+	 * @param size Size of the arena; rounded up to the allocation granularity.
+	 *
+	 * @return `true` if the arena is usable, possibly in the single-view fallback mode.
+	 */
+	bool Create(const void *addr_nearest, size_t size);
+
+	void Release();
+
+	bool IsValid() const { return _writable != nullptr; }
+
+	// `true` if the arena has separate writable and executable views.
+	bool IsDualMapped() const { return _writable != _executable; }
+
+	size_t GetSize() const { return _size; }
+
+	void *GetWritable() const { return _writable; }
+	void *GetExecutable() const { return _executable; }
+
+	void *ToExecutable(const void *writable) const
+	{
+		return _executable + (reinterpret_cast<const uint8_t *>(writable) - _writable);
+	}
+
+	void *ToWritable(const void *executable) const
+	{
+		return _writable + (reinterpret_cast<const uint8_t *>(executable) - _executable);
+	}
+
+	/**
+	 * @brief Flushes the instruction cache for code written to the executable range
+	 *        starting at `executable`.
+	 */
+	void Flush(const void *executable, size_t size) const;
+};
+
+MEMORIA_END
\ No newline at end of file
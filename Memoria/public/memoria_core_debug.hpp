@@ -39,6 +39,34 @@ extern bool GetSymbolName(const void *address, char *out, size_t max_size);
  */
 extern bool GetBeautyFunctionAddress(const void *address, char *out, size_t max_size, bool concat_module_name = true, bool memory_beautify_on_error = true);
 
+struct FunctionTable_t
+{
+	HMODULE Module;
+
+	// The `IMAGE_DIRECTORY_ENTRY_EXCEPTION` entries of the module, sorted by start address.
+	const IMAGE_RUNTIME_FUNCTION_ENTRY *Entries;
+	size_t Count;
+};
+
+/**
+ * @brief Retrieves the function table of the specified module, in place.
+ *
+ * @param handle Module handle, or `nullptr` for the main executable.
+ *
+ * @return The table; `Entries` is `nullptr` if the module has none (e.g. x86 binaries).
+ */
+extern FunctionTable_t GetFunctionTable(HMODULE handle);
+
+/**
+ * @brief Finds the function table entry covering `address` by binary search.
+ *
+ * @param primary If `true`, entries of function fragments are followed to the entry of the function
+ *                they belong to.
+ *
+ * @return The entry, or `nullptr` if `address` is not covered by the table.
+ */
+extern const IMAGE_RUNTIME_FUNCTION_ENTRY *FindFunctionEntry(const FunctionTable_t &table, const void *address, bool primary = true);
+
 /**
  * @brief Retrieves a list of absolute function ranges for the specified module.
  *
@@ -58,6 +86,8 @@ extern Memoria::Vector<std::tuple<void */*addr_start*/, void */*addr_end*/>> Get
  *
  * @param address Pointer to an arbitrary code location within the function.
  *
+ * @note The lookup is a binary search in the function table and does not allocate.
+ *
  * @warning The function extracts information from the `IMAGE_DIRECTORY_ENTRY_EXCEPTION` section,
  *       which is usually missing in x86 binaries, so the collection for such files will be empty.
  *
@@ -65,6 +95,111 @@ extern Memoria::Vector<std::tuple<void */*addr_start*/, void */*addr_end*/>> Get
  */
 extern void *GetFunctionBaseAddressFromItsCode(const void *address);
 
+//
+// Symbolization of many addresses.
+//
+// Names are resolved through dbghelp, which is single-threaded; all calls into it are serialized,
+// and the results (including misses) are kept in an address-keyed LRU cache of
+// `MEMORIA_SYMBOL_CACHE_SIZE` entries. Names longer than `MEMORIA_SYMBOL_NAME_SIZE` are truncated.
+//
+#ifndef MEMORIA_SYMBOL_CACHE_SIZE
+#define MEMORIA_SYMBOL_CACHE_SIZE 1024
+#endif
+
+#ifndef MEMORIA_SYMBOL_NAME_SIZE
+#define MEMORIA_SYMBOL_NAME_SIZE 256
+#endif
+
+struct SymbolInfo_t
+{
+	const void *Address;
+
+	// Module containing `Address`, or `nullptr`.
+	HMODULE Module;
+
+	// Start of the function containing `Address`, or `nullptr` if it is not in the function table.
+	const void *Function;
+
+	// File name of the module and name of the function; empty if unknown.
+	char ModuleName[64];
+	char Name[MEMORIA_SYMBOL_NAME_SIZE];
+};
+
+/**
+ * @brief Symbolizes `count` addresses, e.g. the frames of a backtrace.
+ *
+ * The addresses are processed in address order, so every module is looked up once per call,
+ * and dbghelp is entered once for the whole set.
+ *
+ * @param out Receives one entry per address, in the order of `addresses`.
+ *
+ * @return The number of addresses whose function name was found.
+ */
+extern size_t SymbolizeAddresses(const void *const *addresses, size_t count, SymbolInfo_t *out);
+
+/**
+ * @brief Formats an entry returned by `SymbolizeAddresses` the same way as `GetBeautyFunctionAddress`.
+ */
+extern bool FormatSymbolInfo(const SymbolInfo_t &info, char *out, size_t max_size, bool concat_module_name = true, bool memory_beautify_on_error = true);
+
+//
+// Stack traces.
+//
+// Frame pointers are followed if `MEMORIA_USE_FRAME_POINTERS` is defined. This is the default on x86,
+// where `RtlCaptureStackBackTrace` walks the same chain anyway, and not supported on x64, where the
+// stack is unwound through the function tables. Traces can be interned in a global store, which keeps every
+// distinct trace once and refers to it by a 4-byte id, e.g. for recording the origin of patches
+// or allocations.
+//
+#define MEMORIA_MAX_STACK_FRAMES 128
+
+#if !defined(MEMORIA_USE_FRAME_POINTERS) && !defined(MEMORIA_NO_FRAME_POINTERS) && !defined(MEMORIA_64BIT)
+#define MEMORIA_USE_FRAME_POINTERS
+#endif
+
+// x64 code keeps no frame pointer chain, not even with /Oy-.
+#if defined(MEMORIA_USE_FRAME_POINTERS) && defined(MEMORIA_64BIT)
+#error MEMORIA_USE_FRAME_POINTERS is only supported on x86.
+#endif
+
+/**
+ * @brief Captures the return addresses of the calling code.
+ *
+ * @param frames Receives up to `max_frames` return addresses; the first one is in the caller.
+ * @param skip Number of frames to skip.
+ *
+ * @return The number of captured frames.
+ */
+extern __declspec(noinline) size_t CaptureStackTrace(void **frames, size_t max_frames, size_t skip = 0);
+
+/**
+ * @brief Stores a trace in the global trace store, unless it is already there.
+ *
+ * @return The id of the trace, or 0 on failure.
+ */
+extern uint32_t InternStackTrace(void *const *frames, size_t count);
+
+/**
+ * @brief Captures the call stack of the calling code and interns it.
+ *
+ * @param skip Number of frames to skip; the first frame is in the caller.
+ *
+ * @return The id of the trace, or 0 on failure.
+ */
+extern __declspec(noinline) uint32_t CaptureStackTraceId(size_t skip = 0);
+
+/**
+ * @brief Returns the frames of an interned trace; they stay valid for the lifetime of the process.
+ *
+ * @return Pointer to the frames, or `nullptr` if `id` is unknown.
+ */
+extern void *const *GetStackTrace(uint32_t id, size_t *count);
+
+/**
+ * @brief Returns the number of distinct traces in the store.
+ */
+extern size_t GetStackTraceCount();
+
 /**
  * @brief Retrieves the call stack for the calling code.
  *
@@ -36,4 +36,8 @@ MEMORIA_END
 
 // Any error related to failure in finding certain data, e.g., 
 // FindReference failed to find anything.
-#define ME_NOT_FOUND            5
\ No newline at end of file
+#define ME_NOT_FOUND            5
+
+// Error specific to writes that suspend other threads. Indicates that a thread
+// kept executing inside the memory being written.
+#define ME_THREAD_BUSY          6
\ No newline at end of file
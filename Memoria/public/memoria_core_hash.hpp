@@ -107,6 +107,15 @@ struct FNV1a32_t
 		: Hash{ N > 1 ? FNV1a32(in) : 0 } {}
 };
 
+/**
+ * @brief Computes the CRC32C (Castagnoli) checksum of `size` bytes at `data`.
+ *
+ * Uses the SSE4.2 `crc32` instruction when the CPU supports it and a table otherwise.
+ *
+ * @param crc Checksum of the preceding data, to continue a previous calculation.
+ */
+extern uint32_t CRC32C(const void *data, size_t size, uint32_t crc = 0);
+
 MEMORIA_END
 
 #define FNV32(s) Memoria::FNV1a32(s)
@@ -2,9 +2,15 @@
 
 #include "memoria_common.hpp"
 #include "memoria_utils_assert.hpp"
+#include "memoria_utils_vector.hpp"
+#include "memoria_utils_string.hpp"
+#include "memoria_core_codearena.hpp"
 
 #include <stdint.h>
+#include <intrin.h>
 #include <memory> // std::unique_ptr
+#include <utility>
+#include <type_traits>
 
 MEMORIA_BEGIN
 
@@ -86,8 +92,9 @@ public:
 	bool Hook();
 	bool Unhook();
 
-	void *GetJmpHook() { return reinterpret_cast<void *>(&_backup[0]); }
-	void *GetOriginal() { return reinterpret_cast<void *>(&_backup[5]); }
+	// Executable addresses of the code stored in the trampoline.
+	void *GetJmpHook();
+	void *GetOriginal();
 
 	__forceinline void operator()()
 	{
@@ -103,8 +110,8 @@ template <typename ret_t = void, typename... args_t>
 class CTrampolineEx : public CTrampoline
 {
 public:
-	CTrampolineEx(CHookMgr *manager, void *code, uint8_t size, eInvokeMethod method)
-		: CTrampoline(manager, code, size, method)
+	CTrampolineEx(CHookMgr *manager, void *target, const void *hook, bool is_x64, uint8_t size, eInvokeMethod method)
+		: CTrampoline(manager, target, hook, is_x64, size, method)
 	{
 	}
 
@@ -118,6 +125,213 @@ public:
 
 #pragma pack(pop)
 
+//
+// Number of counter shards per instrumented hook. Must be a power of two, because
+// the generated entry stub selects the shard with a single `and` instruction.
+//
+#ifndef MEMORIA_HOOK_STATS_SHARDS
+#define MEMORIA_HOOK_STATS_SHARDS 16
+#endif
+
+static_assert((MEMORIA_HOOK_STATS_SHARDS & (MEMORIA_HOOK_STATS_SHARDS - 1)) == 0, "MEMORIA_HOOK_STATS_SHARDS must be a power of two.");
+static_assert(MEMORIA_HOOK_STATS_SHARDS <= 128, "MEMORIA_HOOK_STATS_SHARDS must fit into imm8.");
+
+//
+// One cache line of hook counters. Each thread updates the shard selected by its thread ID,
+// so concurrent callers of the same hook rarely contend for the same cache line.
+//
+struct alignas(64) CHookCounterShard
+{
+	volatile int64_t Calls;
+	volatile int64_t Cycles;
+};
+
+static_assert(sizeof(CHookCounterShard) == 64);
+
+//
+// Profiling counters of a single instrumented hook.
+//
+// The call counter is incremented by the entry stub generated by `CHookMgr::AllocateInstrumented`
+// before control reaches the hook. Cycles are accumulated by `CHookTimer`, which should wrap
+// the call of the original function inside the hook.
+//
+class CHookCounters
+{
+	friend class CHookMgr;
+
+	CHookCounters(const CHookCounters &) = delete;
+	CHookCounters &operator=(const CHookCounters &) = delete;
+
+private:
+	CHookCounterShard _shards[MEMORIA_HOOK_STATS_SHARDS];
+
+	const void *_target;
+	const void *_hook;
+
+	// Unaligned pointer returned by the allocator.
+	void *_allocation;
+
+public:
+	CHookCounters(const void *target, const void *hook, void *allocation);
+
+	// Must match the shard selection of the generated entry stub.
+	static __forceinline size_t GetShardIndex()
+	{
+#ifdef MEMORIA_64BIT
+		uint32_t tid = static_cast<uint32_t>(__readgsqword(0x48)); // TEB->ClientId.UniqueThread
+#else
+		uint32_t tid = __readfsdword(0x24); // TEB->ClientId.UniqueThread
+#endif
+
+		return (tid >> 2) & (MEMORIA_HOOK_STATS_SHARDS - 1);
+	}
+
+	__forceinline void AddCycles(uint64_t cycles)
+	{
+		_InterlockedExchangeAdd64(&_shards[GetShardIndex()].Cycles, static_cast<int64_t>(cycles));
+	}
+
+	const void *GetTarget() const { return _target; }
+	const void *GetHook() const { return _hook; }
+
+	uint64_t GetCalls() const;
+	uint64_t GetCycles() const;
+
+	void Reset();
+};
+
+//
+// Accumulates the cycles spent between construction and destruction into `counters`.
+// Intended usage inside an instrumented hook:
+//
+// {
+//     Memoria::CHookTimer timer(counters);
+//     result = original(args...);
+// }
+//
+class CHookTimer
+{
+	CHookTimer(const CHookTimer &) = delete;
+	CHookTimer &operator=(const CHookTimer &) = delete;
+
+private:
+	CHookCounters *_counters;
+	uint64_t _start;
+
+public:
+	__forceinline CHookTimer(CHookCounters *counters) : _counters(counters), _start(counters ? __rdtsc() : 0) {}
+
+	__forceinline ~CHookTimer()
+	{
+		if (_counters)
+			_counters->AddCycles(__rdtsc() - _start);
+	}
+};
+
+struct HookStats_t
+{
+	const void *Target;
+	const void *Hook;
+
+	uint64_t Calls;
+	uint64_t Cycles;
+};
+
+//
+// Registers which are captured into `MidHookContext_t` by a mid-function hook. Registers that
+// are volatile under the native calling convention (and the flags) are saved and restored
+// regardless of the mask, because the callback is free to clobber them; the mask only
+// selects which non-volatile registers are exposed to the callback.
+//
+enum eMidHookRegister : uint32_t
+{
+	MHR_AX = 1 << 0,
+	MHR_CX = 1 << 1,
+	MHR_DX = 1 << 2,
+	MHR_BX = 1 << 3,
+	MHR_SP = 1 << 4,
+	MHR_BP = 1 << 5,
+	MHR_SI = 1 << 6,
+	MHR_DI = 1 << 7,
+#ifdef MEMORIA_64BIT
+	MHR_R8 = 1 << 8,
+	MHR_R9 = 1 << 9,
+	MHR_R10 = 1 << 10,
+	MHR_R11 = 1 << 11,
+	MHR_R12 = 1 << 12,
+	MHR_R13 = 1 << 13,
+	MHR_R14 = 1 << 14,
+	MHR_R15 = 1 << 15,
+
+	MHR_ALL = 0xFFFF,
+#else
+	MHR_ALL = 0xFF,
+#endif
+};
+
+//
+// Register state at the hooked instruction. Fields follow the hardware register numbering,
+// so the generated stub can address them directly. Only registers selected by the mask
+// (plus the volatile ones) are valid; changes to them are written back after the callback
+// returns, except for the stack pointer, which is read-only.
+//
+struct MidHookContext_t
+{
+#ifdef MEMORIA_64BIT
+	uintptr_t Rax, Rcx, Rdx, Rbx, Rsp, Rbp, Rsi, Rdi;
+	uintptr_t R8, R9, R10, R11, R12, R13, R14, R15;
+#else
+	uintptr_t Eax, Ecx, Edx, Ebx, Esp, Ebp, Esi, Edi;
+#endif
+
+	uintptr_t Flags;
+};
+
+using MidHookCallback_t = void(*)(MidHookContext_t *context);
+
+#pragma pack(push, 1)
+class CMidHook
+{
+	friend class CHookMgr;
+
+	CMidHook(const CMidHook &) = delete;
+	CMidHook &operator=(const CMidHook &) = delete;
+
+private:
+	CHookMgr *_manager;
+
+	// Address of the hooked instruction.
+	void *_target;
+
+	MidHookCallback_t _callback;
+
+	uint32_t _mask;
+
+	// Size of the displaced instructions.
+	uint8_t _size;
+
+	uint8_t _original[32];
+
+#ifdef MEMORIA_64BIT
+	// Unwind data of the stub, registered with `RtlAddFunctionTable`.
+	RUNTIME_FUNCTION *_function_table;
+#endif
+
+	// The generated stub directly follows the object.
+
+public:
+	CMidHook() = delete;
+	CMidHook(CHookMgr *manager, void *target, MidHookCallback_t callback, uint32_t mask, uint8_t size);
+
+	bool IsActive();
+
+	bool Hook();
+	bool Unhook();
+
+	void *GetStub() { return reinterpret_cast<uint8_t *>(this) + sizeof(CMidHook); }
+};
+#pragma pack(pop)
+
 class CHookMgr
 {
 private:
@@ -125,11 +339,26 @@ private:
 	CHookMgr &operator=(const CHookMgr &) = delete;
 
 private:
-	void *_data = nullptr;
+	CCodeArena _code;
 
 	size_t _hooks = 0;
 	size_t _max_hooks = 0;
 
+	Memoria::Vector<CHookCounters *> _counters;
+
+	struct CodeRun_t
+	{
+		size_t First;
+		size_t Slots;
+	};
+
+	// Slots given back by `FreeCode` below the end of the slab, reused for allocations of
+	// the same size.
+	Memoria::Vector<CodeRun_t> _free_code;
+
+	void *AllocateCode(size_t size);
+	void FreeCode(void *code, size_t size);
+
 public:
 	CHookMgr() = default;
 	CHookMgr(const void *addr_nearest, size_t max_hooks = 64);
@@ -137,6 +366,23 @@ public:
 
 	CTrampoline *Allocate(void *target, const void *hook, bool is_x64, eInvokeMethod method);
 
+	// Same as `Allocate`, but the target is redirected to a generated stub that increments
+	// the call counter of `counters` before jumping to the hook.
+	CTrampoline *AllocateInstrumented(void *target, const void *hook, bool is_x64, eInvokeMethod method, CHookCounters **counters);
+
+	// Allocates a mid-function hook at `target`. The displaced instructions are relocated
+	// behind the generated context stub.
+	CMidHook *AllocateMidHook(void *target, MidHookCallback_t callback, uint32_t mask);
+
+	// Releases a mid-function hook that was never installed.
+	void FreeMidHook(CMidHook *hook);
+
+	const Memoria::Vector<CHookCounters *> &GetCounters() const { return _counters; }
+
+	// Objects returned by the manager live in the writable view of its code arena;
+	// this returns the address at which the code inside them is executed.
+	void *ToExecutable(const void *addr) const { return _code.ToExecutable(addr); }
+
 	bool IsNear(const void *addr) const;
 };
 
@@ -157,6 +403,227 @@ extern bool Hook64(void *target, const void *hook, void *trampoline, eInvokeMeth
 
 extern bool Hook(void *target, const void *hook, void *trampoline = nullptr);
 
+//
+// Signature traits of hook targets.
+//
+// `fn_t` is the type of the original function as a plain function pointer. For member
+// functions the object pointer becomes the first argument, and on x86 the calling convention
+// is `__thiscall`.
+//
+// `detour_t` is the type of a detour. It equals `fn_t`, except for member functions on x86:
+// a free function cannot be declared `__thiscall`, so the detour is `__fastcall`, which also
+// receives the object pointer in ecx, and takes an unused second argument for edx. Declare
+// member detours with `MEMORIA_MEMBER_DETOUR_CC` and `MEMORIA_MEMBER_DETOUR_THIS` to match
+// both architectures.
+//
+template <typename T>
+struct HookTraits;
+
+#define MEMORIA_HOOK_TRAITS(cc) \
+	template <typename R, typename... A> \
+	struct HookTraits<R(cc *)(A...)> { using ret_t = R; using fn_t = R(cc *)(A...); using detour_t = fn_t; }; \
+	template <typename R, typename... A> \
+	struct HookTraits<R(cc *)(A...) noexcept> { using ret_t = R; using fn_t = R(cc *)(A...); using detour_t = fn_t; };
+
+MEMORIA_HOOK_TRAITS(__cdecl)
+
+#ifdef MEMORIA_32BIT
+MEMORIA_HOOK_TRAITS(__stdcall)
+MEMORIA_HOOK_TRAITS(__fastcall)
+MEMORIA_HOOK_TRAITS(__thiscall)
+#endif
+
+#undef MEMORIA_HOOK_TRAITS
+
+#ifdef MEMORIA_32BIT
+#define MEMORIA_MEMBER_DETOUR_CC __fastcall
+#define MEMORIA_MEMBER_DETOUR_THIS(object_t, name) object_t name, void *
+#else
+#define MEMORIA_MEMBER_DETOUR_CC
+#define MEMORIA_MEMBER_DETOUR_THIS(object_t, name) object_t name
+#endif
+
+#ifdef MEMORIA_32BIT
+#define MEMORIA_HOOK_MEMBER_TRAITS(qualifiers, object_t) \
+	template <typename R, typename C, typename... A> \
+	struct HookTraits<R(C:: *)(A...) qualifiers> \
+	{ \
+		using ret_t = R; \
+		using fn_t = R(__thiscall *)(object_t *, A...); \
+		using detour_t = R(__fastcall *)(object_t *, void *, A...); \
+	};
+#else
+#define MEMORIA_HOOK_MEMBER_TRAITS(qualifiers, object_t) \
+	template <typename R, typename C, typename... A> \
+	struct HookTraits<R(C:: *)(A...) qualifiers> { using ret_t = R; using fn_t = R(*)(object_t *, A...); using detour_t = fn_t; };
+#endif
+
+MEMORIA_HOOK_MEMBER_TRAITS(, C)
+MEMORIA_HOOK_MEMBER_TRAITS(const, const C)
+MEMORIA_HOOK_MEMBER_TRAITS(noexcept, C)
+MEMORIA_HOOK_MEMBER_TRAITS(const noexcept, const C)
+
+#undef MEMORIA_HOOK_MEMBER_TRAITS
+
+//
+// Typed hook of the function `Target`, which may be a free function or a non-virtual member function.
+//
+// The original function pointer lives in a static variable of the specialization, so
+// `CallOriginal` compiles to a single indirect call with the arguments forwarded as is.
+//
+// Usage:
+//
+// static int Detour(int a, int b)
+// {
+//     return Memoria::CTypedHook<&Target>::CallOriginal(a, b) + 1;
+// }
+//
+// Memoria::TypedHook<&Target>(Detour);
+//
+// For a member function `int CFoo::Get(int a)`:
+//
+// static int MEMORIA_MEMBER_DETOUR_CC Detour(MEMORIA_MEMBER_DETOUR_THIS(CFoo *, self), int a)
+// {
+//     return Memoria::CTypedHook<&CFoo::Get>::CallOriginal(self, a) + 1;
+// }
+//
+template <auto Target>
+class CTypedHook
+{
+	using traits_t = HookTraits<decltype(Target)>;
+
+public:
+	using fn_t = typename traits_t::fn_t;
+	using detour_t = typename traits_t::detour_t;
+	using ret_t = typename traits_t::ret_t;
+
+private:
+	static inline fn_t _original = nullptr;
+
+public:
+	static void *GetTarget()
+	{
+		if constexpr (std::is_member_function_pointer_v<decltype(Target)>)
+		{
+			static_assert(sizeof(Target) == sizeof(void *), "Member functions of classes with multiple or virtual inheritance are not supported.");
+
+			auto target = Target;
+			void *result;
+
+			MemCopy(&result, &target, sizeof(result));
+			return result;
+		}
+		else
+		{
+			return reinterpret_cast<void *>(Target);
+		}
+	}
+
+	static bool Install(detour_t detour)
+	{
+		if (_original != nullptr)
+			return false;
+
+		return Hook(GetTarget(), reinterpret_cast<const void *>(detour), &_original);
+	}
+
+	static bool IsInstalled() { return _original != nullptr; }
+
+	static fn_t GetOriginal() { return _original; }
+
+	template <typename... args_t>
+	static __forceinline ret_t CallOriginal(args_t &&... args)
+	{
+		return _original(std::forward<args_t>(args)...);
+	}
+};
+
+/**
+ * @brief Hooks `Target` with `detour`, deducing the signature and calling convention from `Target`.
+ *        The original function is available via `CTypedHook<Target>::CallOriginal`.
+ *
+ * @param detour Hook with the signature of `Target`; for member functions the object pointer
+ *               is passed as the first argument, see `HookTraits`.
+ *
+ * @return `true` if the hook is installed.
+ */
+template <auto Target>
+__forceinline bool TypedHook(typename CTypedHook<Target>::detour_t detour)
+{
+	return CTypedHook<Target>::Install(detour);
+}
+
+/**
+ * @brief Installs a hook with call-count and cycle profiling.
+ *
+ * @param target Address of the function to hook.
+ * @param hook Address of the hook.
+ * @param trampoline Receives the address of the original function; can be `nullptr`.
+ * @param counters Receives the counters of the hook, which should be passed to `CHookTimer`
+ *                 around the call of the original function; can be `nullptr`.
+ *
+ * @return `true` if the hook is installed.
+ */
+extern bool HookInstrumented(void *target, const void *hook, void *trampoline = nullptr, CHookCounters **counters = nullptr);
+
+/**
+ * @brief Installs a hook at an arbitrary instruction. When the instruction is reached, `callback`
+ *        receives the register state, which it can inspect and modify. Afterwards the displaced
+ *        instructions are executed and control returns to the hooked code.
+ *
+ * @param target Address of the instruction to hook. At least 5 bytes of complete instructions
+ *               must follow it within the same basic block.
+ * @param callback Function to call.
+ * @param mask Combination of `eMidHookRegister` values to capture.
+ * @param handle Receives the hook object, which can be used to unhook; can be `nullptr`.
+ *
+ * @return `true` if the hook is installed.
+ */
+extern bool MidHook(void *target, MidHookCallback_t callback, uint32_t mask = MHR_ALL, CMidHook **handle = nullptr);
+
+/**
+ * @brief Same as `MidHook`, with the register mask specified at compile time.
+ */
+template <uint32_t mask>
+__forceinline bool MidHook(void *target, MidHookCallback_t callback, CMidHook **handle = nullptr)
+{
+	static_assert((mask & ~MHR_ALL) == 0, "Invalid register mask.");
+	return MidHook(target, callback, mask, handle);
+}
+
+/**
+ * @brief Takes a snapshot of the counters of all instrumented hooks.
+ *
+ * @return One entry per instrumented hook.
+ */
+extern Memoria::Vector<HookStats_t> GetHookStats();
+
+/**
+ * @brief Resets the counters of all instrumented hooks.
+ */
+extern void ResetHookStats();
+
+/**
+ * @brief Writes the counters of all instrumented hooks to the log.
+ */
+extern void DumpHookStats();
+
+/**
+ * @brief Starts a background thread which calls `DumpHookStats` every `interval_ms` milliseconds.
+ *        If the thread is already running, only the interval is updated.
+ *
+ * @param interval_ms Dump interval in milliseconds.
+ *
+ * @return `true` if the thread is running.
+ */
+extern bool StartHookStatsDump(uint32_t interval_ms);
+
+/**
+ * @brief Stops the thread started by `StartHookStatsDump` and waits until it has exited,
+ *        unless called from the thread itself. Called by `Cleanup`.
+ */
+extern void StopHookStatsDump();
+
 MEMORIA_END
 
 MEMORIA_BEGIN
@@ -195,6 +662,72 @@ auto CVTable::InvokeFn(size_t index, Args... args)
 	return ((Fn)_vtable[index])(args...);
 }
 
+//
+// Registry of shadow virtual tables shared between all instances of the same class.
+//
+// A shadow is created once per original vtable and reference-counted by its users, so
+// swapping the vtable of an object is a single pointer store and the memory usage grows
+// with the number of hooked classes rather than the number of hooked objects.
+//
+// The number of methods is derived from the image layout: entries are counted while they
+// are stored inside the section holding the vtable and point into executable sections of
+// the same module. The scan stops at the RTTI locator of the next vtable, which is a data
+// pointer, and never reads past the section, unlike counting until a null entry.
+//
+// Shadows also copy the entry preceding the vtable (the RTTI complete object locator on MSVC),
+// so `typeid` and `dynamic_cast` keep working on objects with a swapped vtable.
+//
+class CShadowVTableRegistry
+{
+public:
+	/**
+	 * @brief Returns the shadow of `vtable`, creating it on first use, and increments its reference count.
+	 *
+	 * @param vtable Original virtual table. A shadow created by the registry is also accepted,
+	 *               in which case its reference count is incremented.
+	 * @param method_count Number of methods, or `0` to determine it automatically.
+	 *
+	 * @return Pointer to the shadow, or `nullptr` on failure.
+	 */
+	static void **Acquire(void **vtable, size_t method_count = 0);
+
+	/**
+	 * @brief Decrements the reference count of the shadow of `vtable` and destroys the shadow when it drops to zero.
+	 *
+	 * @param vtable Original virtual table.
+	 *
+	 * @return `true` if the shadow existed.
+	 */
+	static bool Release(void **vtable);
+
+	/**
+	 * @brief Returns the shadow of `vtable`, or `nullptr` if there is none.
+	 */
+	static void **FindShadow(void **vtable);
+
+	/**
+	 * @brief Returns the original virtual table of `shadow`, or `nullptr` if `shadow` is not a registered shadow.
+	 */
+	static void **FindOriginal(void **shadow);
+
+	/**
+	 * @brief Returns the number of methods of the shadow of `vtable`, or `0` if there is none.
+	 */
+	static size_t GetMethodCount(void **vtable);
+
+	/**
+	 * @brief Determines the number of methods of `vtable` from the section bounds of its module.
+	 */
+	static size_t CountMethods(void **vtable);
+};
+
+//
+// Replaces the vtable of an instance with the shared shadow of its class.
+//
+// Since shadows are shared, a method hooked through one `CShadowVTable` is hooked for every
+// instance of the class which currently uses the shadow. An instance may be shadowed by several
+// `CShadowVTable` objects; its original vtable is restored when the last of them is destroyed.
+//
 class CShadowVTable
 {
 	struct Class
@@ -212,7 +745,7 @@ private:
 	CVTable _vmt_original = {};
 
 	Class *_instance = {};
-	std::unique_ptr<void *[]> _vmt_shadow = {};
+	void **_vmt_shadow = {};
 
 public:
 	CShadowVTable(void *instance);
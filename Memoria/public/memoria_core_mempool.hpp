@@ -2,8 +2,33 @@
 
 #include "memoria_common.hpp"
 
+//
+// Number of size classes tracked by the pool: heap chunks are grouped by powers of two
+// from 16 bytes up to 2048 bytes, then everything below 4096 bytes, and the last class
+// holds all chunks allocated with `VirtualAlloc`. Blocks of the default arena, which serves
+// `New`, are counted in the class of their size, and page runs in the last class.
+//
+#define MEMORIA_MEMPOOL_CLASSES 10
+
 MEMORIA_BEGIN
 
+class CArena;
+
+struct MemPoolClassStats_t
+{
+	size_t Chunks;
+	size_t Bytes;
+};
+
+struct MemPoolStats_t
+{
+	// Totals over all classes.
+	size_t Chunks;
+	size_t Bytes;
+
+	MemPoolClassStats_t Classes[MEMORIA_MEMPOOL_CLASSES];
+};
+
 /**
  * @brief
  *
@@ -15,6 +40,29 @@ extern bool Free(void *addr);
 
 extern bool FreeAll();
 
+//
+// Slabs of `CArena` are registered in the pool, so `Free` can route a block to its arena
+// and `CArena::FromPointer` works for any arena.
+//
+extern bool RegisterArenaSlab(void *base, size_t size, CArena *arena);
+extern void UnregisterArenaSlab(void *base);
+
+/**
+ * @brief Returns the arena that owns the slab at `base`, or `nullptr`.
+ */
+extern CArena *FindArenaSlab(const void *base);
+
+/**
+ * @brief Returns the number of live chunks and bytes, in total and per size class.
+ */
+extern MemPoolStats_t GetMemPoolStats();
+
+/**
+ * @brief Returns the largest chunk size that falls into the size class `index`,
+ *        or `SIZE_MAX` for the class of virtual allocations.
+ */
+extern size_t GetMemPoolClassSize(size_t index);
+
 /**
  * @brief
  *
@@ -52,4 +100,24 @@ extern void *AllocNear(const void *addr_source, size_t size, bool is_executable
 extern void *AllocFar(const void *addr_source, size_t size, bool is_executable = false, bool is_readable = true, bool is_writable = true);
 
 
+//
+// Places a block of `size` bytes at a free address reachable from `addr_source` with a 32-bit
+// displacement. `allocator` is called with the chosen address and must reserve memory exactly
+// there, e.g. by mapping a view, or return `nullptr`.
+//
+using RegionAllocator_t = void *(*)(void *addr, size_t size, void *context);
+
+/**
+ * @brief Reserves memory near `addr_source` through a custom allocator.
+ *
+ * @param addr_source Address the block must be reachable from.
+ * @param size Size of the block.
+ * @param near If `true`, the closest free address is used, otherwise the farthest one above `addr_source`.
+ * @param allocator Callback that reserves memory at the chosen address.
+ * @param context Value passed to `allocator`.
+ *
+ * @return Value returned by `allocator`, or `nullptr` if no address fits.
+ */
+extern void *AllocInRegion(const void *addr_source, size_t size, bool near, RegionAllocator_t allocator, void *context);
+
 MEMORIA_END
\ No newline at end of file
@@ -199,6 +199,46 @@ static __forceinline bool IsIn32BitRange(const void *addr1, const void *addr2, p
  */
 extern bool IsMemoryValid(const void *addr, ptrdiff_t offset = 0);
 
+//
+// Guarded memory access.
+//
+// Instead of asking the kernel whether memory is accessible before touching it, the access is
+// attempted under a structured exception handler, and an access violation is reported as failure.
+// A guard page hit is reported the same way, and the guard is restored.
+// The successful path costs about as much as the unguarded access: on x64 the handler is
+// table-based and adds no instructions at all.
+//
+// NOTE: Code running under the guard is abandoned on a fault; destructors of its locals do not run,
+//       and locks taken inside it are not released.
+//
+
+/**
+ * @brief Copies `size` bytes from `source` to `dest`.
+ *
+ * @return `false` if reading `source` or writing `dest` faulted; `dest` may be partially written then.
+ */
+extern bool GuardedCopy(void *dest, const void *source, size_t size);
+
+/**
+ * @brief Compares `size` bytes at `addr1` and `addr2`.
+ *
+ * @return `false` if reading either block faulted; otherwise `*equal` receives the result.
+ */
+extern bool GuardedCompare(const void *addr1, const void *addr2, size_t size, bool *equal);
+
+/**
+ * @brief Calls `fn(context)`.
+ *
+ * @return `false` if the call raised an access violation.
+ */
+extern bool GuardedCall(void (*fn)(void *context), void *context);
+
+template <typename fn_t>
+__forceinline bool GuardedInvoke(fn_t &&fn)
+{
+	return GuardedCall([](void *context) { (*static_cast<std::remove_reference_t<fn_t> *>(context))(); }, &fn);
+}
+
 /**
  * @brief
  *
@@ -307,6 +347,14 @@ bool GetModuleNameForAddress(const void *address, char *out, size_t max_size);
  */
 bool BeautifyPointer(const void *addr, char *out, size_t max_size);
 
+/**
+ * @brief Same as `BeautifyPointer`, for an address whose module is already known.
+ *
+ * @param module Base address of the module containing `addr`, or `nullptr`.
+ * @param module_name File name of the module, or `nullptr`.
+ */
+bool BeautifyPointer(const void *addr, const void *module, const char *module_name, char *out, size_t max_size);
+
 /**
  * @brief
  *
@@ -335,25 +383,39 @@ extern void *Align(const void *value, int alignment = 16);
 extern DWORD BeginThread(void (*fnFunction)(LPVOID), LPVOID param);
 
 /**
- * @brief
+ * @brief Same as `BeginThread`, but keeps the thread handle, so the thread can be waited for.
  *
- * @param
+ * @return The handle, to be closed by the caller, or `nullptr` on failure.
+ */
+extern HANDLE BeginThreadHandle(void (*fnFunction)(LPVOID), LPVOID param);
+
+/**
+ * @brief Finds a loaded module by the hash of its file name, e.g. `FNV1a64("kernel32.dll")`.
  *
- * @return
+ * NOTE: Modules and their exports are indexed on first use; the index follows module loads
+ *       and unloads until `FreeExportIndex` is called.
  */
 extern HMODULE GetModuleHandleDirect(fnv1a_t module_name_hash);
 
 extern void *GetProcAddressDirect(fnv1a_t function_name_hash);
 
 /**
- * @brief
+ * @brief Finds an export by the hash of its name, resolving forwarded exports.
  *
- * @param
+ * @param module_name_hash Hash of the module file name, or `0` to search all modules in load order.
+ * @param function_name_hash Hash of the export name.
  *
- * @return
+ * @return Address of the export, or `nullptr` if it is not found.
  */
 extern void *GetProcAddressDirect(fnv1a_t module_name_hash, fnv1a_t function_name_hash);
 
+/**
+ * @brief Releases the export index and stops following module loads.
+ *
+ * Called by `Cleanup`; must be called before the module containing Memoria is unloaded.
+ */
+extern void FreeExportIndex();
+
 /**
  * @brief Retrieves a pointer to the `module_name` interface from the library specified by `handle`.
  *        Used for Valve Software-style modules that expose a `CreateInterface` function.
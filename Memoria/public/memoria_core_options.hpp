@@ -7,4 +7,7 @@ MEMORIA_BEGIN
 extern void SetSafeModeState(bool value);
 extern bool IsSafeModeActive();
 
+extern void SetHotPatchModeState(bool value);
+extern bool IsHotPatchModeActive();
+
 MEMORIA_END
\ No newline at end of file
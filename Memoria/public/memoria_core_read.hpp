@@ -8,6 +8,7 @@
 
 #include <optional>
 #include <span>
+#include <type_traits>
 
 MEMORIA_BEGIN
 
@@ -29,6 +30,71 @@ extern std::optional<double> ReadDouble(const void *addr, ptrdiff_t offset = 0);
 extern bool ReadAStr(const void *addr, char *out, size_t max_size, ptrdiff_t offset = 0);
 extern bool ReadWStr(const void *addr, wchar_t *out, size_t max_size, ptrdiff_t offset = 0);
 
+//
+// Bulk reads.
+//
+// In safe mode all reads are guarded copies (see `GuardedCopy`), so a read of an invalid address
+// fails instead of crashing, and a successful one costs no system call. The functions below
+// read many values per call; small values are copied with single unaligned loads.
+//
+
+/**
+ * @brief Copies `size` bytes at `addr` to `out`.
+ *
+ * @return `false` if any byte of the range is not readable; `out` may be partially written then.
+ */
+extern bool ReadRaw(const void *addr, void *out, size_t size, ptrdiff_t offset = 0);
+
+template <typename T>
+std::optional<T> ReadStruct(const void *addr, ptrdiff_t offset = 0)
+{
+	static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable.");
+
+	T value;
+
+	if (!ReadRaw(addr, &value, sizeof(T), offset))
+		return std::nullopt;
+
+	return value;
+}
+
+/**
+ * @brief Reads `count` elements of `element_size` bytes from the addresses `addrs` into the
+ *        consecutive elements of `out`. Unreadable elements are zero-filled.
+ *
+ * @param valid Optional; receives per element whether it was read.
+ *
+ * @return Number of elements read.
+ */
+extern size_t ReadGather(const void *const *addrs, size_t count, void *out, size_t element_size, bool *valid = nullptr);
+
+template <typename T>
+size_t ReadMany(std::span<const void *const> addrs, std::span<T> out, std::span<bool> valid = {})
+{
+	static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable.");
+
+	size_t count = (addrs.size() < out.size()) ? addrs.size() : out.size();
+	return ReadGather(addrs.data(), count, out.data(), sizeof(T), (valid.size() >= count) ? valid.data() : nullptr);
+}
+
+// One field of a declarative read: `Size` bytes at `base + Offset` are copied to `Out`.
+struct ReadField_t
+{
+	ptrdiff_t Offset;
+	size_t Size;
+	void *Out;
+};
+
+// Describes a field read into the variable `out`, e.g. `MEMORIA_READ_FIELD(0x40, health)`.
+#define MEMORIA_READ_FIELD(offset, out) Memoria::ReadField_t{ (offset), sizeof(out), &(out) }
+
+/**
+ * @brief Reads all fields relative to `base`. Unreadable fields are zero-filled.
+ *
+ * @return Number of fields read.
+ */
+extern size_t ReadFields(const void *base, std::span<const ReadField_t> fields);
+
 extern bool GetMemoryBlock(const void *source, size_t size, void *dest);
 extern Memoria::Vector<uint8_t> GetMemoryData(const void *source, size_t size);
 
@@ -2,13 +2,148 @@
 
 #include "memoria_common.hpp"
 
+#include "memoria_core_hash.hpp"
+#include "memoria_utils_hashmap.hpp"
+#include "memoria_utils_vector.hpp"
+
+#include <Windows.h>
+#include <memory>
+
 // TODO: Export only GetVTableForClass?
 
 MEMORIA_BEGIN
 
+//
+// The functions below scan the given range on every call. To resolve more than a few classes
+// of a module, build a `CRttiCatalog` for it once instead.
+//
+
 extern void *GetRTTIDescriptor(const void *addr_start, const void *addr_min, const void *addr_max, const char *rtti_name);
 extern void **GetVTableForDescriptor(const void *addr_start, const void *addr_min, const void *addr_max, const void *rtti_descriptor);
 
 extern void **GetVTableForClass(const void *addr_start, const void *addr_min, const void *addr_max, const char *rtti_name);
 
+//
+// RTTI catalog of an MSVC module.
+//
+// The data sections of the module are scanned once for vtables, recognized by the complete object
+// locator in the slot preceding them. The locators lead to the type descriptors and the class
+// hierarchies, and everything found is indexed by class name, type descriptor and vtable, so
+// each lookup afterwards is a hash probe. On x64 the RTTI structures refer to each other by RVA,
+// and a locator refers to itself, which rules out false positives.
+//
+// The catalog points into the module and must not be used after the module is unloaded.
+//
+
+struct RttiClass_t
+{
+	// Decorated name, e.g. `.?AVCFoo@@`.
+	const char *Name;
+
+	const void *TypeDescriptor;
+
+	// Vtable of the complete object, or `nullptr` if the class has none in the module.
+	void **VTable;
+
+	// Bit 0 - multiple inheritance; Bit 1 - virtual inheritance
+	uint32_t Attributes;
+
+	// Direct and indirect bases, in hierarchy order, at `GetBase(cls, 0 .. BaseCount - 1)`.
+	uint32_t FirstBase;
+	uint32_t BaseCount;
+};
+
+struct RttiVTable_t
+{
+	void **VTable;
+	const void *Locator;
+
+	// Index of the class of the complete object in `GetClasses()`.
+	uint32_t Class;
+
+	// Offset of the vtable pointer in the complete object; 0 for the primary vtable.
+	uint32_t Offset;
+};
+
+class CRttiCatalog
+{
+private:
+	CRttiCatalog(const CRttiCatalog &) = delete;
+	CRttiCatalog &operator=(const CRttiCatalog &) = delete;
+
+	HMODULE _module = nullptr;
+	uintptr_t _image_begin = 0;
+	uintptr_t _image_end = 0;
+
+	Memoria::Vector<RttiClass_t> _classes;
+	Memoria::Vector<RttiVTable_t> _vtables;
+	Memoria::Vector<uint32_t> _bases;
+
+	// Class name hash -> class index.
+	Memoria::HashMap<fnv1a_t, uint32_t> _by_name;
+
+	// Type descriptor -> class index.
+	Memoria::HashMap<const void *, uint32_t> _by_descriptor;
+
+	// Vtable -> index in `_vtables`.
+	Memoria::HashMap<const void *, uint32_t> _by_vtable;
+
+	// Classes whose hierarchy was read.
+	Memoria::Vector<bool> _hierarchy_read;
+
+	bool IsInImage(uintptr_t addr, size_t size) const;
+	const char *GetTypeName(const void *type_descriptor) const;
+	const void *GetLocator(uintptr_t addr) const;
+
+	uint32_t AddClass(const void *type_descriptor);
+	void AddVTable(void **vtable, const void *locator);
+	void ReadHierarchy(uint32_t index, const void *hierarchy);
+
+	const RttiClass_t *FindDecoratedClass(const char *name) const;
+
+public:
+	CRttiCatalog() = default;
+
+	/**
+	 * @brief Scans the module and fills the catalog.
+	 *
+	 * @param module Module handle, or `nullptr` for the main executable.
+	 */
+	bool Build(HMODULE module);
+
+	HMODULE GetModule() const { return _module; }
+
+	const Memoria::Vector<RttiClass_t> &GetClasses() const { return _classes; }
+	const Memoria::Vector<RttiVTable_t> &GetVTables() const { return _vtables; }
+
+	/**
+	 * @brief Finds a class by name.
+	 *
+	 * @param name Decorated name (`.?AVCFoo@@`), or a plain one (`CFoo`, `ns::CFoo`) which
+	 *             is tried as a class and then as a struct. Templates need the decorated name.
+	 */
+	const RttiClass_t *FindClass(const char *name) const;
+	const RttiClass_t *FindClassByDescriptor(const void *type_descriptor) const;
+
+	/**
+	 * @brief Finds the class of objects whose vtable pointer (at any offset) is `vtable`.
+	 */
+	const RttiClass_t *FindClassByVTable(const void *vtable) const;
+	const RttiVTable_t *FindVTable(const void *vtable) const;
+
+	/**
+	 * @brief Returns the vtable of the complete object of the class `name`, same as `GetVTableForClass`.
+	 */
+	void **GetVTable(const char *name) const;
+
+	const RttiClass_t *GetBase(const RttiClass_t &cls, size_t index) const;
+	bool IsDerivedFrom(const RttiClass_t &cls, const RttiClass_t &base) const;
+
+	//
+	// Static builders
+	//
+
+	static std::unique_ptr<CRttiCatalog> Create(HMODULE module);
+};
+
 MEMORIA_END
\ No newline at end of file
@@ -0,0 +1,239 @@
+//
+// memoria_core_source.hpp
+//
+// Memory sources: access to the memory of the current or of another process.
+//
+// The rest of Memoria works on local pointers. To analyze or patch another process, its memory
+// is accessed through an `IMemorySource`. Remote reads are system calls, so they are meant to go
+// through `CCachedMemorySource`, which keeps whole pages and fetches runs of missing pages in one
+// transfer. `CMemoryView` copies a remote range into local memory once; the local scanners,
+// readers and `CSigHandle` then run on the copy, and results are translated back with `ToRemote`.
+//
+
+#pragma once
+
+#include "memoria_common.hpp"
+#include "memoria_utils_vector.hpp"
+#include "memoria_utils_hashmap.hpp"
+
+#include <stdint.h>
+#include <optional>
+#include <type_traits>
+#include <Windows.h>
+
+#define MEMORIA_SOURCE_PAGE_SIZE 0x1000
+
+MEMORIA_BEGIN
+
+class IMemorySource
+{
+public:
+	virtual ~IMemorySource() = default;
+
+	/**
+	 * @brief Copies `size` bytes at `addr` of the target to `out`.
+	 *
+	 * @return `true` if all bytes were read.
+	 */
+	virtual bool Read(const void *addr, void *out, size_t size) = 0;
+
+	/**
+	 * @brief Writes `size` bytes to `addr` of the target, changing the protection if necessary.
+	 */
+	virtual bool Write(void *addr, const void *data, size_t size) = 0;
+
+	virtual bool Query(const void *addr, MEMORY_BASIC_INFORMATION *mbi) = 0;
+
+	// `true` if addresses of the target are valid local pointers.
+	virtual bool IsLocal() const { return false; }
+
+	template <typename T>
+	std::optional<T> ReadValue(const void *addr, ptrdiff_t offset = 0)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable.");
+
+		T value;
+
+		if (!Read(reinterpret_cast<const void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(T)))
+			return std::nullopt;
+
+		return value;
+	}
+
+	template <typename T>
+	bool WriteValue(void *addr, const T &value, ptrdiff_t offset = 0)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable.");
+		return Write(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(T));
+	}
+};
+
+//
+// The current process. Reads are guarded copies, writes go through `WriteMemory`.
+//
+class CLocalMemorySource : public IMemorySource
+{
+public:
+	bool Read(const void *addr, void *out, size_t size) override;
+	bool Write(void *addr, const void *data, size_t size) override;
+	bool Query(const void *addr, MEMORY_BASIC_INFORMATION *mbi) override;
+
+	bool IsLocal() const override { return true; }
+};
+
+//
+// Another process, accessed with `ReadProcessMemory` and `WriteProcessMemory`.
+//
+class CRemoteMemorySource : public IMemorySource
+{
+	CRemoteMemorySource(const CRemoteMemorySource &) = delete;
+	CRemoteMemorySource &operator=(const CRemoteMemorySource &) = delete;
+
+private:
+	HANDLE _process = nullptr;
+	bool _owned = false;
+
+public:
+	CRemoteMemorySource() = default;
+	~CRemoteMemorySource();
+
+	/**
+	 * @brief Opens the process `pid` with read, write and query access.
+	 */
+	bool Open(DWORD pid);
+
+	/**
+	 * @brief Uses an existing process handle; it is not closed by `Close`.
+	 */
+	void Attach(HANDLE process);
+
+	void Close();
+
+	HANDLE GetProcess() const { return _process; }
+
+	bool Read(const void *addr, void *out, size_t size) override;
+	bool Write(void *addr, const void *data, size_t size) override;
+	bool Query(const void *addr, MEMORY_BASIC_INFORMATION *mbi) override;
+};
+
+//
+// Read-through page cache in front of another source.
+//
+// Pages are fetched on first access; a miss fetches the run of consecutive missing pages up to
+// `MEMORIA_SOURCE_BATCH_PAGES` in one read. Unreadable pages are remembered as well. Writes go
+// through to the underlying source and update the cached copies. Data that the target changes
+// itself is seen only after `Invalidate`.
+//
+#ifndef MEMORIA_SOURCE_BATCH_PAGES
+#define MEMORIA_SOURCE_BATCH_PAGES 16
+#endif
+
+class CCachedMemorySource : public IMemorySource
+{
+	CCachedMemorySource(const CCachedMemorySource &) = delete;
+	CCachedMemorySource &operator=(const CCachedMemorySource &) = delete;
+
+private:
+	struct Slot_t
+	{
+		uintptr_t Page;
+		bool Readable;
+	};
+
+	IMemorySource *_source = nullptr;
+
+	// `_capacity` pages of data, one slot per page; replaced round-robin.
+	uint8_t *_data = nullptr;
+	uint8_t *_staging = nullptr;
+	Slot_t *_slots = nullptr;
+	size_t _capacity = 0;
+	size_t _used = 0;
+	size_t _next = 0;
+
+	// Page address -> slot index.
+	Memoria::HashMap<uintptr_t, uint32_t> _index;
+
+	uint64_t _hits = 0;
+	uint64_t _misses = 0;
+
+	const Slot_t *GetPage(uintptr_t page);
+	uint32_t AllocateSlot(uintptr_t page);
+	void Fetch(uintptr_t page);
+
+public:
+	CCachedMemorySource() = default;
+	~CCachedMemorySource();
+
+	/**
+	 * @brief Sets the underlying source and allocates room for `max_pages` pages.
+	 */
+	bool Create(IMemorySource *source, size_t max_pages = 1024);
+	void Release();
+
+	// Drops all cached pages.
+	void Invalidate();
+
+	uint64_t GetHits() const { return _hits; }
+	uint64_t GetMisses() const { return _misses; }
+
+	bool Read(const void *addr, void *out, size_t size) override;
+	bool Write(void *addr, const void *data, size_t size) override;
+	bool Query(const void *addr, MEMORY_BASIC_INFORMATION *mbi) override;
+
+	bool IsLocal() const override { return _source && _source->IsLocal(); }
+};
+
+//
+// Local copy of a range of the target.
+//
+// For local sources no copy is made and the view points at the range itself.
+//
+class CMemoryView
+{
+	CMemoryView(const CMemoryView &) = delete;
+	CMemoryView &operator=(const CMemoryView &) = delete;
+
+private:
+	Memoria::Vector<uint8_t> _copy;
+
+	const uint8_t *_local = nullptr;
+	uintptr_t _remote = 0;
+	size_t _size = 0;
+
+public:
+	CMemoryView() = default;
+
+	/**
+	 * @brief Maps `size` bytes at `addr` of the target; unreadable pages are zero-filled.
+	 *
+	 * @return `false` if no byte of the range could be read.
+	 */
+	bool Map(IMemorySource *source, const void *addr, size_t size);
+
+	const void *GetBegin() const { return _local; }
+	const void *GetLastByte() const { return _size ? _local + _size - 1 : _local; }
+	size_t GetSize() const { return _size; }
+
+	bool Contains(const void *local) const
+	{
+		return local >= _local && local < _local + _size;
+	}
+
+	// Translates between addresses of the copy and of the target.
+	void *ToRemote(const void *local) const
+	{
+		return local ? reinterpret_cast<void *>(_remote + (static_cast<const uint8_t *>(local) - _local)) : nullptr;
+	}
+
+	const void *ToLocal(const void *remote) const
+	{
+		return _local + (reinterpret_cast<uintptr_t>(remote) - _remote);
+	}
+};
+
+/**
+ * @brief Returns the source for the current process.
+ */
+extern IMemorySource *GetLocalMemorySource();
+
+MEMORIA_END
\ No newline at end of file
@@ -132,4 +132,36 @@ extern Memoria::Vector<ExportFunc_t> ParseExportDirectory(HMODULE handle);
 
 extern DWORD GetMainThreadId();
 
+/**
+ * @brief Suspends all threads of the current process except the calling one.
+ *
+ * NOTE: The caller must not allocate from the heap until the threads are resumed.
+ *
+ * @return Handles of the suspended threads, to be passed to `ResumeThreads`.
+ */
+extern Memoria::Vector<HANDLE> SuspendOtherThreads();
+
+// Returns `true` if a thread stopped at `ip` must not stay suspended there.
+using ThreadIpFilterFn = bool(*)(const void *ip, void *param);
+
+/**
+ * @brief Suspends all threads of the current process except the calling one, and waits
+ *        until each of them has actually stopped.
+ *
+ * A thread stopped at an address rejected by `is_unsafe` is resumed for a moment and
+ * suspended again, until it has left.
+ *
+ * NOTE: The caller must not allocate from the heap until the threads are resumed.
+ *
+ * @param threads Receives the handles of the suspended threads, to be passed to `ResumeThreads`.
+ *
+ * @return `false` if a thread did not leave the rejected addresses; no thread is suspended then.
+ */
+extern bool SuspendOtherThreads(Memoria::Vector<HANDLE> &threads, ThreadIpFilterFn is_unsafe, void *param);
+
+/**
+ * @brief Resumes and closes threads suspended by `SuspendOtherThreads`.
+ */
+extern void ResumeThreads(Memoria::Vector<HANDLE> &threads);
+
 MEMORIA_END
\ No newline at end of file
@@ -1,8 +1,10 @@
 #pragma once
 
 #include "memoria_common.hpp"
+#include "memoria_utils_vector.hpp"
 
 #include <stdint.h>
+#include <Windows.h>
 
 MEMORIA_BEGIN
 
@@ -27,10 +29,158 @@ extern bool WriteDouble(void *addr, double value, ptrdiff_t offset = 0);
 extern bool WritePointer(void *addr, const void *value, ptrdiff_t offset = 0);
 extern bool WriteRelative(void *addr, const void *value, ptrdiff_t offset = 0);
 
+// Replaces the pointer at `addr` with a single interlocked exchange, so concurrent readers
+// observe either the old or the new value. `addr` must be pointer-aligned.
+extern bool WritePointerAtomic(void *addr, const void *value, void **previous = nullptr);
+
+// Replaces code which may be executed by other threads at the same time.
+//
+// If the bytes fit into one aligned 8-byte (or 16-byte on x64) window, they are published
+// with a single `cmpxchg`. Otherwise the first instruction is replaced with a `jmp $`
+// (or `int3` handled by a vectored exception handler, when the first instruction is a single
+// byte or two bytes cannot be written atomically), the tail is written, and then the head is
+// published atomically.
+// Threads reaching the code in between wait on the guard instead of executing a mix
+// of old and new bytes. The instruction cache is flushed after every step.
+extern bool WriteCodeAtomic(void *addr, const void *data, size_t size);
+
 extern bool WriteAStr(void *addr, const char *value, ptrdiff_t offset = 0);
 extern bool WriteWStr(void *addr, const wchar_t *value, ptrdiff_t offset = 0);
 
 extern bool FillChar(void *addr, int value, size_t size);
 extern bool FillNops(void *addr, size_t size);
 
+//
+// Batches writes to protected memory.
+//
+// Writes are staged in the session and applied by `Commit`, which sorts them by address,
+// groups them into page ranges of equal protection and unprotects every range once, instead
+// of issuing a validity query and two `VirtualProtect` calls per write. Original protections
+// are restored afterwards and the instruction cache is flushed for executable ranges.
+//
+// The original bytes are saved on commit, so a committed session can be reverted with
+// `Rollback`. All ranges are unprotected before the first byte is written, so a commit
+// that fails to unprotect any of them leaves the memory unchanged.
+//
+// Usage:
+//
+// Memoria::CWriteSession session;
+//
+// session.Write(addr_1, data_1, size_1);
+// session.WriteValue<uint8_t>(addr_2, 0xEB);
+// session.Fill(addr_3, 0x90, 6);
+//
+// if (!session.Commit())
+//     ...
+//
+class CWriteSession
+{
+	CWriteSession(const CWriteSession &) = delete;
+	CWriteSession &operator=(const CWriteSession &) = delete;
+
+private:
+	struct Write_t
+	{
+		uint8_t *Address;
+
+		// Offset of the data in `_data` and `_backup`.
+		size_t Offset;
+		size_t Size;
+	};
+
+	struct Region_t
+	{
+		uint8_t *Base;
+		size_t Size;
+
+		DWORD Protection;
+		bool Executable;
+	};
+
+	struct Range_t
+	{
+		uint8_t *Begin;
+		uint8_t *End;
+	};
+
+	Memoria::Vector<Write_t> _writes;
+	Memoria::Vector<uint8_t> _data;
+
+	// Page ranges touched by the writes, sorted and merged.
+	Memoria::Vector<Range_t> _ranges;
+
+	// Bytes overwritten by the last commit, parallel to `_data`.
+	Memoria::Vector<uint8_t> _backup;
+
+	// Ranges unprotected during the current commit.
+	Memoria::Vector<Region_t> _regions;
+
+	bool _committed = false;
+
+	uint8_t *Stage(void *addr, size_t size);
+
+	// Computes `_ranges` and reserves all memory needed by `Apply`, so no allocation happens
+	// while other threads are suspended (one of them may own the heap lock).
+	void Prepare();
+
+	bool Unprotect();
+	bool Protect();
+
+	// Thread filter for `SuspendOtherThreads`: a thread stopped inside a staged range,
+	// past its first byte, would resume into a mix of old and new instructions.
+	static bool IsInsideWrite(const void *ip, void *param);
+
+	// Copies the staged data over the targets, or the saved bytes back if `restore` is set.
+	// `written` is set once the bytes have been copied, even if restoring protections fails.
+	bool Apply(bool restore, bool suspend_threads, bool *written);
+
+public:
+	CWriteSession() = default;
+
+	/**
+	 * @brief Stages `size` bytes of `data` to be written at `addr`.
+	 *
+	 * @return `false` if the session has already been committed or the arguments are invalid.
+	 */
+	bool Write(void *addr, const void *data, size_t size);
+
+	/**
+	 * @brief Stages `size` bytes of `value` to be written at `addr`.
+	 */
+	bool Fill(void *addr, uint8_t value, size_t size);
+
+	template <typename T>
+	bool WriteValue(void *addr, const T &value)
+	{
+		return Write(addr, &value, sizeof(T));
+	}
+
+	/**
+	 * @brief Applies all staged writes.
+	 *
+	 * @param suspend_threads If `true`, other threads are suspended while the memory is modified.
+	 *                        A thread stopped inside a staged range is let run until it has left;
+	 *                        if it does not, nothing is written (`ME_THREAD_BUSY`).
+	 *
+	 * @return `true` if every write has been applied and all protections have been restored.
+	 *         If the bytes were written but a protection could not be restored, the session
+	 *         is still committed and can be rolled back.
+	 */
+	bool Commit(bool suspend_threads = false);
+
+	/**
+	 * @brief Restores the bytes overwritten by `Commit`.
+	 */
+	bool Rollback(bool suspend_threads = false);
+
+	/**
+	 * @brief Drops all staged writes and the saved original bytes.
+	 */
+	void Clear();
+
+	bool IsCommitted() const { return _committed; }
+
+	size_t GetWriteCount() const { return _writes.size(); }
+};
+
 MEMORIA_END
\ No newline at end of file
@@ -0,0 +1,208 @@
+//
+// memoria_ext_elf.hpp
+//
+// ELF images: segments, sections and dynamic symbol lookup.
+//
+// `CElfModule` is the ELF counterpart of `CMemoryModule`. It works on an image in memory, either
+// as the loader mapped it (`eElfLayout::Loaded`) or as a raw copy of the file (`eElfLayout::File`),
+// and does not depend on the host platform. Dynamic symbols are found through the `DT_GNU_HASH`
+// table (bloom filter first) or the `DT_HASH` table, so a lookup compares one or two names
+// instead of walking the symbol table.
+//
+// Named sections need the section headers, which the loader usually does not map. For loaded
+// images `.text`, `.rodata`, `.data.rel.ro` and `.got` fall back to the segment containing them.
+//
+// All tables are read through the mapped segments and every index into them is checked against
+// the segment holding the table, so a corrupted or truncated image fails the lookup instead of
+// reading past the mapping.
+//
+
+#pragma once
+
+#include "memoria_common.hpp"
+
+#include "memoria_ext_module.hpp"
+#include "memoria_utils_vector.hpp"
+
+#include <memory>
+#include <stdint.h>
+
+// Segment flags, as in `Elf_Phdr::p_flags`.
+#define MEMORIA_ELF_PF_X 0x1
+#define MEMORIA_ELF_PF_W 0x2
+#define MEMORIA_ELF_PF_R 0x4
+
+MEMORIA_BEGIN
+
+enum class eElfLayout : uint8_t
+{
+	Loaded,  // Segments at their virtual addresses, relative to the load bias
+	File,    // Segments at their file offsets
+};
+
+struct ElfSegment_t
+{
+	void *Address;
+
+	// Address the segment was linked at (`p_vaddr`).
+	uint64_t VirtualAddress;
+
+	// Size in memory; for file images only the part present in the file.
+	size_t Size;
+
+	uint32_t Flags;
+};
+
+class CElfModule : public CMemoryBlock
+{
+private:
+	CElfModule(const CElfModule &) = delete;
+	CElfModule &operator=(const CElfModule &) = delete;
+
+	const uint8_t *_image = nullptr;
+	size_t _image_size = 0;
+
+	// Bytes of the file present at `_image`; for loaded images those of the segment mapping the header.
+	size_t _file_size = 0;
+
+	eElfLayout _layout = eElfLayout::Loaded;
+	bool _is64 = false;
+
+	// Difference between the load address and the linked address.
+	uintptr_t _bias = 0;
+
+	Memoria::Vector<ElfSegment_t> _segments;
+
+	// `PT_GNU_RELRO`, which holds `.data.rel.ro` and `.got`.
+	void *_relro = nullptr;
+	size_t _relro_size = 0;
+
+	// Dynamic symbol table.
+	const void *_symtab = nullptr;
+	const char *_strtab = nullptr;
+	size_t _strsz = 0;
+	const uint32_t *_hash = nullptr;
+	const uint32_t *_gnu_hash = nullptr;
+
+	// Section headers, if they are present in the image.
+	const void *_sections = nullptr;
+	uint16_t _section_count = 0;
+	const char *_section_names = nullptr;
+	size_t _section_names_size = 0;
+
+	template <typename traits>
+	bool ParseImage();
+
+	template <typename traits>
+	bool MatchSymbol(const void *symbol, const char *name) const;
+
+	template <typename traits>
+	void *FindSymbolGnu(const char *name) const;
+
+	template <typename traits>
+	void *FindSymbolSysV(const char *name) const;
+
+	template <typename traits>
+	std::pair<void *, size_t> FindSectionHeader(const char *name) const;
+
+	// Translates a linked address to an address in the image; `nullptr` if it is not mapped.
+	void *Translate(uint64_t vaddr, size_t size = 1) const;
+
+	// Same, for `d_ptr` values of the dynamic section, which the loader may have relocated.
+	void *TranslateDynamic(uint64_t value) const;
+
+	// Translates a file offset; `nullptr` if that part of the file is not in the image.
+	const void *TranslateOffset(uint64_t offset, uint64_t size) const;
+
+	// Bytes from `ptr` to the end of the segment containing it; 0 if it is not mapped.
+	size_t GetMappedSize(const void *ptr) const;
+
+	std::pair<void *, size_t> GetSectionInfo(const char *name) const;
+
+public:
+	CElfModule() = default;
+
+	/**
+	 * @brief Parses the image at `image`.
+	 *
+	 * @param image Address of the ELF header.
+	 * @param size Size of the image; only needed for `eElfLayout::File`.
+	 */
+	bool Parse(const void *image, size_t size, eElfLayout layout);
+
+	bool Is64Bit() const { return _is64; }
+	uintptr_t GetLoadBias() const { return _bias; }
+
+	const Memoria::Vector<ElfSegment_t> &GetSegments() const { return _segments; }
+
+	/**
+	 * @brief Returns the first loadable segment that has all of `flags`, e.g. `MEMORIA_ELF_PF_X`.
+	 */
+	std::unique_ptr<CMemoryBlock> GetSegment(uint32_t flags) const;
+
+	/**
+	 * @brief Returns the section `name`, e.g. `.text`.
+	 */
+	std::unique_ptr<CMemoryBlock> GetSection(const char *name) const;
+
+	/**
+	 * @brief Finds a defined dynamic symbol.
+	 *
+	 * NOTE: For `STT_GNU_IFUNC` symbols this is the address of the resolver. Of a name with several
+	 *       symbol versions, the first one in the table is returned.
+	 *
+	 * @return Address of the symbol, or `nullptr` if it is not exported.
+	 */
+	void *FindSymbol(const char *name) const;
+
+	//
+	// Signaturing
+	//
+
+	bool SigSec(const char *section, const CSignature &signature, SigCallbackFn cb, void *lpParam);
+	bool SigSec(const char *section, const char *signature, SigCallbackFn cb, void *lpParam);
+	bool SigSec(const char *section, SigCallbackFn cb, void *lpParam);
+
+	//
+	// Static builders
+	//
+
+	static std::unique_ptr<CElfModule> CreateFromImage(const void *image, size_t size, eElfLayout layout);
+};
+
+/**
+ * @brief Computes the `DT_GNU_HASH` hash of a symbol name.
+ */
+inline constexpr uint32_t ElfGnuHash(const char *name)
+{
+	uint32_t hash = 5381;
+
+	for (; *name; ++name)
+		hash = hash * 33 + static_cast<uint8_t>(*name);
+
+	return hash;
+}
+
+/**
+ * @brief Computes the `DT_HASH` hash of a symbol name.
+ */
+inline constexpr uint32_t ElfSysVHash(const char *name)
+{
+	uint32_t hash = 0;
+
+	for (; *name; ++name)
+	{
+		hash = (hash << 4) + static_cast<uint8_t>(*name);
+
+		uint32_t high = hash & 0xF0000000;
+
+		if (high)
+			hash ^= high >> 24;
+
+		hash &= ~high;
+	}
+
+	return hash;
+}
+
+MEMORIA_END
\ No newline at end of file
@@ -0,0 +1,174 @@
+//
+// memoria_ext_import.hpp
+//
+// Import table hooking.
+//
+// Instead of patching the code of an imported function (which affects every caller in the
+// process), the import address table entry of a single module is replaced. Installing or
+// removing such a hook is one atomic pointer store: no trampoline and no instruction decoding
+// is required, and calls through the hooked entry cost exactly as much as before.
+//
+// Both regular (`IMAGE_DIRECTORY_ENTRY_IMPORT`) and delay-loaded (`IMAGE_DIRECTORY_ENTRY_DELAY_IMPORT`)
+// imports are supported. All entries of a module are collected into an index once, so lookups by
+// module and symbol hash do not walk the import descriptors. A symbol may be imported through
+// several entries (e.g. both regularly and delay-loaded); a hook replaces all of them.
+//
+// The index is immutable after it is built. The state of installed hooks is kept apart from it,
+// by entry address, so it survives `InvalidateImportIndex` and the indices built afterwards.
+//
+
+#pragma once
+
+#include "memoria_common.hpp"
+#include "memoria_core_hash.hpp"
+#include "memoria_utils_vector.hpp"
+#include "memoria_utils_hashmap.hpp"
+
+#include <stdint.h>
+#include <Windows.h>
+
+MEMORIA_BEGIN
+
+struct ImportSlot_t
+{
+	// Address of the import address table entry.
+	void **Slot;
+
+	// Hash of the imported module name, e.g. `FNV1a64("kernel32.dll")`.
+	fnv1a_t ModuleHash;
+
+	// Hash of the imported symbol name, or `0` for imports by ordinal.
+	fnv1a_t SymbolHash;
+
+	// Names inside the image; `Name` is `nullptr` for imports by ordinal.
+	const char *ModuleName;
+	const char *Name;
+
+	// Ordinal for imports by ordinal, otherwise the hint.
+	uint16_t Ordinal;
+
+	bool ByOrdinal;
+	bool Delayed;
+
+	// Index in `GetSlots()` of the next entry of the same symbol from the same module, or `SIZE_MAX`.
+	size_t Next;
+
+	// Same, for the next entry of the same symbol from any module.
+	size_t NextSymbol;
+};
+
+class CImportIndex
+{
+	CImportIndex(const CImportIndex &) = delete;
+	CImportIndex &operator=(const CImportIndex &) = delete;
+
+private:
+	HMODULE _module;
+
+	Memoria::Vector<ImportSlot_t> _slots;
+
+	// (module hash, symbol hash) -> index of the first slot of the chain linked by `Next`.
+	Memoria::HashMap<uint64_t, size_t> _index;
+
+	// Symbol hash -> index of the first slot of the chain linked by `NextSymbol`.
+	Memoria::HashMap<fnv1a_t, size_t> _symbols;
+
+	template <typename thunk_t>
+	void AddThunks(const char *module_name, const thunk_t *names, void **slots, bool delayed);
+
+	void AddSlot(const ImportSlot_t &slot);
+
+	// Returns the first slot from `index` on, along the chain for `module_hash`, that imports the symbol.
+	const ImportSlot_t *Scan(size_t index, fnv1a_t module_hash, fnv1a_t symbol_hash, bool by_ordinal, uint16_t ordinal) const;
+
+public:
+	CImportIndex(HMODULE module);
+
+	HMODULE GetModule() const { return _module; }
+
+	/**
+	 * @brief Parses the import and delay-import directories of the module.
+	 *
+	 * @return `true` if the module has a valid PE header.
+	 */
+	bool Build();
+
+	/**
+	 * @brief Finds an entry imported by name.
+	 *
+	 * @param module_hash Hash of the imported module name, or `0` to match any module.
+	 * @param symbol_hash Hash of the imported symbol name.
+	 *
+	 * @return Pointer to the first entry, or `nullptr` if the symbol is not imported.
+	 */
+	const ImportSlot_t *Find(fnv1a_t module_hash, fnv1a_t symbol_hash) const;
+
+	/**
+	 * @brief Finds an entry imported by ordinal.
+	 *
+	 * @param module_hash Hash of the imported module name.
+	 * @param ordinal Ordinal of the symbol.
+	 *
+	 * @return Pointer to the first entry, or `nullptr` if the ordinal is not imported.
+	 */
+	const ImportSlot_t *FindByOrdinal(fnv1a_t module_hash, uint16_t ordinal) const;
+
+	/**
+	 * @brief Returns the next entry of the same symbol, after one returned by `Find`, `FindByOrdinal`
+	 *        or `FindNext` with the same `module_hash`.
+	 */
+	const ImportSlot_t *FindNext(const ImportSlot_t *slot, fnv1a_t module_hash) const;
+
+	const Memoria::Vector<ImportSlot_t> &GetSlots() const { return _slots; }
+};
+
+/**
+ * @brief Returns the import index of `module`, building it on first use.
+ *
+ * @param module Module handle, or `nullptr` for the main executable.
+ *
+ * @return Pointer to the index, or `nullptr` if the module is not a valid PE image.
+ */
+extern CImportIndex *GetImportIndex(HMODULE module);
+
+/**
+ * @brief Drops the cached import index of `module`, e.g. after it has been unloaded.
+ *
+ * Pointers returned by `GetImportIndex` before stay valid. Installed hooks are kept, unless
+ * their entry no longer holds the hook (e.g. because the module was unloaded).
+ *
+ * @param module Module handle, or `nullptr` to drop all indices.
+ */
+extern void InvalidateImportIndex(HMODULE module = nullptr);
+
+/**
+ * @brief Redirects an imported function of `module` to `hook`, in every entry importing it.
+ *
+ * @param module Module whose import table is modified, or `nullptr` for the main executable.
+ * @param module_hash Hash of the imported module name, or `0` to match any module.
+ * @param symbol_hash Hash of the imported symbol name.
+ * @param hook Address of the hook.
+ * @param original Receives the previous value of the first entry; can be `nullptr`.
+ *
+ * @return `true` if every entry was replaced.
+ */
+extern bool HookImport(HMODULE module, fnv1a_t module_hash, fnv1a_t symbol_hash, const void *hook, void *original = nullptr);
+
+/**
+ * @brief Same as `HookImport`, for a symbol imported by ordinal.
+ */
+extern bool HookImportByOrdinal(HMODULE module, fnv1a_t module_hash, uint16_t ordinal, const void *hook, void *original = nullptr);
+
+/**
+ * @brief Restores the entries replaced by `HookImport`.
+ *
+ * @return `true` if an entry was hooked and has been restored.
+ */
+extern bool UnhookImport(HMODULE module, fnv1a_t module_hash, fnv1a_t symbol_hash);
+
+/**
+ * @brief Same as `UnhookImport`, for a symbol imported by ordinal.
+ */
+extern bool UnhookImportByOrdinal(HMODULE module, fnv1a_t module_hash, uint16_t ordinal);
+
+MEMORIA_END
\ No newline at end of file
@@ -0,0 +1,112 @@
+//
+// memoria_ext_integrity.hpp
+//
+// Integrity monitor for patched memory.
+//
+// Watched ranges (patches and code written by hooks) are grouped by page, and the monitor keeps
+// a CRC32C of every such page. A check hashes the page first; only if the hash differs from the
+// last verified one are the ranges on that page compared byte by byte. Unchanged pages therefore
+// cost one hardware-accelerated hash, and a check can be spread over time: each call processes
+// pages round-robin until its time budget is spent.
+//
+// Diverged ranges are reported to a callback, which decides whether the expected bytes are
+// written back. Without a callback, violations are logged and reapplied.
+//
+
+#pragma once
+
+#include "memoria_common.hpp"
+
+#include <stdint.h>
+#include <Windows.h>
+
+MEMORIA_BEGIN
+
+class CPatch;
+
+struct IntegrityViolation_t
+{
+	void *Address;
+	size_t Size;
+
+	// The patch owning the range, or `nullptr` for ranges watched by `WatchCode`.
+	CPatch *Patch;
+};
+
+/**
+ * @brief Called for every diverged range.
+ *
+ * The callback runs after the check has released the watched ranges, so it may watch or
+ * unwatch ranges itself.
+ *
+ * @return `true` to write the expected bytes back.
+ */
+using IntegrityCallback_t = bool(*)(const IntegrityViolation_t &violation);
+
+struct IntegrityStats_t
+{
+	// Number of watched pages and ranges.
+	size_t Pages;
+	size_t Ranges;
+
+	// Totals since the monitor was created.
+	uint64_t PagesChecked;
+	uint64_t PagesChanged;
+	uint64_t Violations;
+};
+
+/**
+ * @brief Watches a patch. The expected bytes follow the state of the patch, so applying or
+ *        restoring it is not reported as a violation.
+ */
+extern bool WatchPatch(CPatch *patch);
+
+/**
+ * @brief Watches all registered patches.
+ */
+extern bool WatchPatches();
+
+/**
+ * @brief Watches `size` bytes at `addr`, expecting them to stay as they are now; e.g. the
+ *        jump written by a hook right after installing it.
+ */
+extern bool WatchCode(const void *addr, size_t size);
+
+/**
+ * @brief Stops watching all ranges.
+ */
+extern void UnwatchAll();
+
+/**
+ * @brief Stops watching all patches; `FreePatches` calls it before releasing them.
+ */
+extern void UnwatchPatches();
+
+extern void SetIntegrityCallback(IntegrityCallback_t callback);
+
+/**
+ * @brief Checks watched pages, continuing where the previous check stopped.
+ *
+ * @param budget_us Time budget in microseconds; `0` checks every page once.
+ *
+ * @return Number of violations found.
+ */
+extern size_t CheckIntegrity(uint32_t budget_us = 0);
+
+/**
+ * @brief Starts a background thread which calls `CheckIntegrity(budget_us)` every `interval_ms`
+ *        milliseconds. If the thread is already running, only the parameters are updated.
+ *
+ * @return `true` if the thread is running.
+ */
+extern bool StartIntegrityMonitor(uint32_t interval_ms, uint32_t budget_us = 500);
+
+/**
+ * @brief Stops the thread started by `StartIntegrityMonitor` and waits until it has exited,
+ *        unless called from the thread itself, e.g. by the violation callback. Called by `Cleanup`.
+ */
+extern void StopIntegrityMonitor();
+
+extern IntegrityStats_t GetIntegrityStats();
+
+MEMORIA_END
\ No newline at end of file
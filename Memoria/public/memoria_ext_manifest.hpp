@@ -0,0 +1,212 @@
+//
+// memoria_ext_manifest.hpp
+//
+// Binary manifests of patches and hooks.
+//
+// A manifest records, per patch or hook, the identity of the module it belongs to, its RVA and
+// the original bytes expected there (plus the new bytes of patches). It is written once, e.g. after
+// the patch set was built from signatures, and loaded on later launches instead of scanning.
+//
+// The file consists of fixed-size records followed by a byte blob, and is used directly through
+// a read-only file mapping: loading parses nothing. An entry is applied at its recorded RVA if
+// the module is the same build and the original bytes match; otherwise the module is rescanned
+// for the entry's signature and the entry is verified again. Entries without a signature are
+// only found again by their original bytes if those are long enough and occur exactly once.
+// All patches are applied in one `CWriteSession` through a patch group.
+//
+
+#pragma once
+
+#include "memoria_common.hpp"
+#include "memoria_core_hash.hpp"
+#include "memoria_utils_vector.hpp"
+
+#include <stdint.h>
+#include <Windows.h>
+
+#define MEMORIA_MANIFEST_MAGIC   0x464E4D4D // 'MMNF'
+#define MEMORIA_MANIFEST_VERSION 1
+
+// Minimum length of the original bytes of an entry without a signature to be rescanned for.
+#ifndef MEMORIA_MANIFEST_MIN_RESCAN
+#define MEMORIA_MANIFEST_MIN_RESCAN 16
+#endif
+
+MEMORIA_BEGIN
+
+class CPatch;
+class CPatchGroup;
+
+enum class eManifestEntry : uint8_t
+{
+	Patch,
+	Hook,
+};
+
+struct ManifestHeader_t
+{
+	uint32_t Magic;
+	uint16_t Version;
+
+	// Size of a pointer of the process that wrote the manifest.
+	uint16_t PointerSize;
+
+	uint32_t ModuleCount;
+	uint32_t EntryCount;
+
+	// File offsets of the module records, entry records and the byte blob.
+	uint32_t ModulesOffset;
+	uint32_t EntriesOffset;
+	uint32_t DataOffset;
+	uint32_t DataSize;
+};
+
+struct ManifestModule_t
+{
+	// `FNV1a64` of the module file name, as used by `GetModuleHandleDirect`.
+	fnv1a_t NameHash;
+
+	// Identity of the build; RVAs are trusted only if both match.
+	uint32_t TimeDateStamp;
+	uint32_t SizeOfImage;
+};
+
+struct ManifestEntry_t
+{
+	uint32_t Module;
+	eManifestEntry Kind;
+	uint8_t Reserved;
+
+	// Length of the signature string, without the terminating zero; 0 if there is none.
+	uint16_t SignatureSize;
+
+	uint32_t Rva;
+	uint32_t Size;
+
+	// Blob offsets of the original bytes, the new bytes (patches only) and the signature.
+	uint32_t OriginalOffset;
+	uint32_t PatchOffset;
+	uint32_t SignatureOffset;
+
+	// Distance from the signature match to the entry address.
+	int32_t SignatureDelta;
+
+	// Name of the hook, resolved through `ManifestHook_t` when loading.
+	fnv1a_t HookName;
+};
+
+static_assert(sizeof(ManifestHeader_t) == 32);
+static_assert(sizeof(ManifestModule_t) == 16);
+static_assert(sizeof(ManifestEntry_t) == 40);
+
+// Detour of a manifest hook entry, supplied by the loader.
+struct ManifestHook_t
+{
+	fnv1a_t Name;
+	const void *Hook;
+
+	// Passed to `Hook` as the trampoline output.
+	void *Trampoline;
+};
+
+struct ManifestResult_t
+{
+	// Entries applied at their recorded RVA.
+	size_t Verified;
+
+	// Entries found again by scanning.
+	size_t Rescanned;
+
+	// Entries that could not be located or applied.
+	size_t Failed;
+};
+
+//
+// Collects patches and hooks and writes them to a manifest file.
+//
+class CManifestWriter
+{
+	CManifestWriter(const CManifestWriter &) = delete;
+	CManifestWriter &operator=(const CManifestWriter &) = delete;
+
+private:
+	Memoria::Vector<ManifestModule_t> _modules;
+	Memoria::Vector<ManifestEntry_t> _entries;
+	Memoria::Vector<uint8_t> _data;
+
+	uint32_t AddData(const void *data, size_t size);
+	bool AddEntry(eManifestEntry kind, const void *addr, size_t size, const void *original, const void *patch,
+		const char *signature, ptrdiff_t signature_delta, fnv1a_t hook_name);
+
+public:
+	CManifestWriter() = default;
+
+	/**
+	 * @brief Records a patch.
+	 *
+	 * @param signature Optional signature used to find the patch again if the module changed.
+	 *                  Without one, the original bytes are searched for if they are at least
+	 *                  `MEMORIA_MANIFEST_MIN_RESCAN` bytes long and occur once in the module.
+	 * @param signature_delta Distance from the signature match to the patch address.
+	 */
+	bool AddPatch(CPatch *patch, const char *signature = nullptr, ptrdiff_t signature_delta = 0);
+
+	/**
+	 * @brief Records all registered patches, without signatures.
+	 */
+	bool AddPatches();
+
+	/**
+	 * @brief Records a hook at `target`, verified by the `size` bytes found there.
+	 *
+	 * NOTE: Must be called before the hook is installed.
+	 */
+	bool AddHook(fnv1a_t name, const void *target, size_t size, const char *signature = nullptr, ptrdiff_t signature_delta = 0);
+
+	size_t GetEntryCount() const { return _entries.size(); }
+
+	bool Save(const char *path) const;
+};
+
+//
+// A manifest mapped into memory.
+//
+class CManifest
+{
+	CManifest(const CManifest &) = delete;
+	CManifest &operator=(const CManifest &) = delete;
+
+private:
+	const uint8_t *_view = nullptr;
+	size_t _size = 0;
+
+	const ManifestHeader_t *GetHeader() const { return reinterpret_cast<const ManifestHeader_t *>(_view); }
+	const uint8_t *GetData(uint32_t offset) const { return _view + GetHeader()->DataOffset + offset; }
+
+	bool Validate() const;
+	uint8_t *Locate(const ManifestEntry_t &entry, uint8_t *base, size_t size, bool same_build, bool *rescanned) const;
+
+public:
+	CManifest() = default;
+	~CManifest();
+
+	bool Open(const char *path);
+	void Close();
+
+	bool IsOpen() const { return _view != nullptr; }
+
+	size_t GetEntryCount() const { return _view ? GetHeader()->EntryCount : 0; }
+
+	const ManifestEntry_t *GetEntries() const;
+	const ManifestModule_t *GetModules() const;
+
+	/**
+	 * @brief Locates, verifies and applies all entries.
+	 *
+	 * Patches are created in the group `group` and applied together with one write session.
+	 * Hooks are installed with the detours from `hooks`; entries without a matching detour fail.
+	 */
+	ManifestResult_t Apply(const char *group, const ManifestHook_t *hooks = nullptr, size_t hook_count = 0) const;
+};
+
+MEMORIA_END
\ No newline at end of file
@@ -1,48 +1,73 @@
 #pragma once
 
 #include "memoria_common.hpp"
+#include "memoria_core_hash.hpp"
 #include "memoria_utils_vector.hpp"
 
 #include <stdint.h>
-#include <memory>
 
 MEMORIA_BEGIN
 
-//
-// Macros to serve as a reminder that the project should be rewritten for C99 compliance in the future.
-//
+class CPatch;
+class CPatchGroup;
+class IMemorySource;
 
-#define MAX_PATCHES_COUNT 128
-#define MAX_PATCH_SIZE 128
+/**
+ * @brief Creates a patch replacing `size` bytes at `dest_address` with the bytes at `source_address`.
+ *
+ * @param instant_deploy If `true`, the patch is applied immediately.
+ *
+ * @return Pointer to the patch, or `nullptr` if the arguments are invalid.
+ */
+extern CPatch *CreatePatch(void *dest_address, const void *source_address, size_t size, bool instant_deploy = true);
 
 //
 // Holder of patch information.
 //
-// The absence of a destructor here is intentional. 
+// Patches are owned by a global registry and never move once created, so `CPatch *` stays
+// valid until `FreePatches`. The original and the new bytes of all patches are kept in one
+// contiguous byte arena, sized exactly per patch; a patch only stores their offset.
+//
+// The absence of a destructor here is intentional.
 // Please do not forget to call `Memoria::Cleanup` or `Memoria::FreePatches`.
 //
 class CPatch
 {
+	friend CPatch *CreatePatch(void *dest_address, const void *source_address, size_t size, bool instant_deploy);
+	friend class CPatchGroup;
+
 private:
 	CPatch(const CPatch &) = delete;
 	CPatch &operator=(const CPatch &) = delete;
 
 private:
 	void *_dest_address = nullptr;
-	bool _active = false;
 
-	Memoria::FixedVector<uint8_t, MAX_PATCH_SIZE> _data_origin{};
-	Memoria::FixedVector<uint8_t, MAX_PATCH_SIZE> _data_patch{};
+	// Offset of the original bytes in the byte arena; the new bytes directly follow them.
+	uint32_t _data_offset = 0;
+	uint32_t _size = 0;
 
-#ifdef _DEBUG
-	// Introduces significant overhead to the object size. 
-	// It is better to avoid using it in release configurations 
-	// to maintain a smaller binary size.
+	// Index of the patch in the registry.
+	uint32_t _id = 0;
+
+	bool _active = false;
 
-	Memoria::FixedVector<void *, 128> _stack_backtrace{};
+#ifdef _DEBUG
+	// Call stack of the creator, as an id in the trace store.
+	uint32_t _trace_id = 0;
 #endif
 
+	// Applies or restores the patches `ids[0..count)`, or all patches if `ids` is `nullptr`,
+	// in one `CWriteSession`. Nothing is left half-written on failure.
+	static bool ToggleSet(const uint32_t *ids, size_t count, bool state, bool suspend_threads);
+
+	// Same as `ToggleSet`; must be called with the patch lock held exclusively.
+	static bool ToggleSetUnlocked(const uint32_t *ids, size_t count, bool state, bool suspend_threads);
+
 public:
+	// Applies or restores all registered patches at once; see `ApplyPatches`.
+	static bool ToggleAll(bool state, bool suspend_threads = false);
+
 	bool IsActive() const;
 	bool IsValid() const;
 
@@ -51,12 +76,124 @@ public:
 	void Toggle(bool state);
 
 	void *GetAddress() const { return _dest_address; }
+	size_t GetSize() const { return _size; }
+	uint32_t GetId() const { return _id; }
 
-	const auto &GetDataOrigin() const { return _data_origin; }
-	const auto &GetDataPatch() const { return _data_patch; }
+	// Pointers into the byte arena; valid until the next patch is created.
+	const uint8_t *GetDataOrigin() const;
+	const uint8_t *GetDataPatch() const;
+
+#ifdef _DEBUG
+	Memoria::Vector<void *> GetBacktrace() const;
+	uint32_t GetTraceId() const { return _trace_id; }
+#endif
 
 	CPatch() = default;
-	CPatch(void *dest_address, const void *source_address, size_t size, bool instant_deploy);
+	CPatch(void *dest_address, uint32_t id, uint32_t data_offset, uint32_t size);
+};
+
+//
+// Named set of patches that are applied and restored as a unit, e.g. all patches of one
+// feature. Toggling a group writes all of its patches in one `CWriteSession`, so the memory
+// is unprotected once per page and other threads are paused at most once. If the session
+// fails after the memory was modified, the already written bytes are rolled back and the
+// patches keep their previous state.
+//
+// Groups are owned by the patch registry and released by `FreePatches`.
+//
+class CPatchGroup
+{
+	CPatchGroup(const CPatchGroup &) = delete;
+	CPatchGroup &operator=(const CPatchGroup &) = delete;
+
+private:
+	fnv1a_t _name_hash = 0;
+
+	// Ids of the member patches in insertion order.
+	Memoria::Vector<uint32_t> _patches;
+
+	bool _active = false;
+
+public:
+	CPatchGroup(fnv1a_t name_hash) : _name_hash(name_hash) {}
+
+	/**
+	 * @brief Adds a patch to the group. Adding the same patch twice has no effect.
+	 *
+	 * NOTE: The state of the patch is left as is until the next `Apply` or `Restore`.
+	 */
+	bool Add(CPatch *patch);
+
+	fnv1a_t GetNameHash() const { return _name_hash; }
+	size_t GetSize() const;
+
+	// `true` if the group was last applied.
+	bool IsActive() const;
+
+	/**
+	 * @brief Applies or restores all patches of the group.
+	 *
+	 * @param suspend_threads If `true`, other threads are suspended while the memory is modified.
+	 *
+	 * @return `true` on success; on failure no patch of the group changes its state.
+	 */
+	bool Toggle(bool state, bool suspend_threads = false);
+
+	bool Apply(bool suspend_threads = false) { return Toggle(true, suspend_threads); }
+	bool Restore(bool suspend_threads = false) { return Toggle(false, suspend_threads); }
+};
+
+//
+// Patch of memory accessed through an `IMemorySource`, e.g. of another process.
+//
+// `CPatch` works on local pointers only. A source patch is owned by the caller instead of the
+// registry, so `ApplyPatches`, groups, `FindPatch` and the integrity monitor do not see it.
+// The original bytes are read from the source when the patch is created, and are written back
+// by `Release` or the destructor if the patch is active. The source must outlive the patch.
+//
+class CSourcePatch
+{
+	CSourcePatch(const CSourcePatch &) = delete;
+	CSourcePatch &operator=(const CSourcePatch &) = delete;
+
+private:
+	IMemorySource *_source = nullptr;
+	void *_dest_address = nullptr;
+	size_t _size = 0;
+
+	// The original bytes directly followed by the new bytes.
+	Memoria::Vector<uint8_t> _data;
+
+	bool _active = false;
+
+public:
+	CSourcePatch() = default;
+	~CSourcePatch();
+
+	/**
+	 * @brief Prepares replacing `size` bytes at `dest_address` of the target with the local bytes at `data`.
+	 *
+	 * @param instant_deploy If `true`, the patch is applied immediately.
+	 *
+	 * @return `false` if the arguments are invalid, the original bytes could not be read or the
+	 *         patch could not be applied.
+	 */
+	bool Create(IMemorySource *source, void *dest_address, const void *data, size_t size, bool instant_deploy = true);
+
+	// Restores the original bytes if the patch is active, and forgets the patch.
+	void Release();
+
+	bool IsActive() const { return _active; }
+
+	// `true` if the target holds the bytes of the current state.
+	bool IsValid() const;
+
+	bool Toggle(bool state);
+	bool Apply() { return Toggle(true); }
+	bool Restore() { return Toggle(false); }
+
+	void *GetAddress() const { return _dest_address; }
+	size_t GetSize() const { return _size; }
 };
 
 extern CPatch *PatchU8(void *addr, uint8_t value, bool instant_deploy = true, ptrdiff_t offset = 0);
@@ -81,7 +218,45 @@ extern CPatch *PatchRelative(void *addr, const void *value, bool instant_deploy
 extern CPatch *PatchAStr(void *addr, const char *value, bool instant_deploy = true, ptrdiff_t offset = 0);
 extern CPatch *PatchWStr(void *addr, const wchar_t *value, bool instant_deploy = true, ptrdiff_t offset = 0);
 
-extern Memoria::FixedVector<CPatch, MAX_PATCHES_COUNT> &GetPatches();
+extern size_t GetPatchCount();
+
+/**
+ * @brief Returns the patch with the id `id`, or `nullptr`.
+ */
+extern CPatch *GetPatch(uint32_t id);
+
+/**
+ * @brief Returns the patch with the lowest address that overlaps `[addr, addr + size)`, or `nullptr`.
+ */
+extern CPatch *FindPatch(const void *addr, size_t size = 1);
+
+/**
+ * @brief Returns all patches overlapping `[addr, addr + size)`, ordered by address.
+ */
+extern Memoria::Vector<CPatch *> FindPatches(const void *addr, size_t size);
+
+/**
+ * @brief Returns the group named `name`, creating an empty one on first use.
+ *
+ * @return Pointer to the group, or `nullptr` if it could not be created.
+ */
+extern CPatchGroup *GetPatchGroup(const char *name);
+extern CPatchGroup *GetPatchGroup(fnv1a_t name_hash);
+
+/**
+ * @brief Returns the group with the name hash `name_hash`, or `nullptr` if it does not exist.
+ */
+extern CPatchGroup *FindPatchGroup(fnv1a_t name_hash);
+
+/**
+ * @brief Applies or restores all registered patches in one `CWriteSession`.
+ */
+extern bool ApplyPatches();
+extern bool RestorePatches();
+
+/**
+ * @brief Restores all patches and releases the registry. Pointers to patches and groups become invalid.
+ */
 extern bool FreePatches();
 
 MEMORIA_END
\ No newline at end of file
@@ -0,0 +1,163 @@
+//
+// memoria_ext_snapshot.hpp
+//
+// Memory snapshots and diffs.
+//
+// A snapshot holds a copy of selected regions, page by page. Pages that are entirely zero take
+// no storage, and every page keeps a CRC32C of its contents. A diff against the live memory only
+// reads pages that may have changed: for regions allocated with `MEM_WRITE_WATCH` the kernel
+// reports the written pages, all other pages are compared. Between two snapshots, a different
+// hash marks a page as changed without comparing it first; pages with equal hashes are still
+// compared, so a collision cannot hide a change. Pages are compared 16 bytes at a time, and the
+// result is a list of changed byte ranges or of typed value deltas.
+//
+
+#pragma once
+
+#include "memoria_common.hpp"
+#include "memoria_core_misc.hpp"
+#include "memoria_utils_vector.hpp"
+#include "memoria_utils_string.hpp"
+
+#include <stdint.h>
+#include <type_traits>
+#include <Windows.h>
+
+MEMORIA_BEGIN
+
+struct SnapshotChange_t
+{
+	uint8_t *Address;
+	size_t Size;
+};
+
+template <typename T>
+struct SnapshotDelta_t
+{
+	T *Address;
+	T Old;
+	T New;
+};
+
+class CSnapshot
+{
+	CSnapshot(const CSnapshot &) = delete;
+	CSnapshot &operator=(const CSnapshot &) = delete;
+
+private:
+	struct Region_t
+	{
+		uint8_t *Base;
+		size_t Size;
+
+		// Index of the first page of the region in `_pages`.
+		size_t FirstPage;
+
+		// The region was allocated with `MEM_WRITE_WATCH`.
+		bool WriteWatch;
+	};
+
+	struct Page_t
+	{
+		uint8_t *Address;
+		uint32_t Hash;
+
+		// Offset of the copy in `_data`; `kZeroPage` for pages that were entirely zero.
+		uint32_t DataOffset;
+
+		bool Readable;
+	};
+
+	static constexpr uint32_t kZeroPage = UINT32_MAX;
+
+	Memoria::Vector<Region_t> _regions;
+	Memoria::Vector<Page_t> _pages;
+	Memoria::Vector<uint8_t> _data;
+
+	bool _captured = false;
+
+	const uint8_t *GetPageData(const Page_t &page) const;
+	size_t FindPage(const uint8_t *addr) const;
+
+	// Marks the pages of write-watched regions that were not written since the capture.
+	void GetCleanPages(Memoria::Vector<bool> &clean) const;
+
+public:
+	CSnapshot() = default;
+
+	/**
+	 * @brief Adds a region to the snapshot; it is extended to whole pages.
+	 *
+	 * NOTE: Regions must not overlap. Adding a region discards the captured contents.
+	 */
+	bool Add(const void *addr, size_t size);
+
+	/**
+	 * @brief Copies all regions and resets their write tracking.
+	 */
+	bool Capture();
+
+	bool IsCaptured() const { return _captured; }
+
+	size_t GetPageCount() const { return _pages.size(); }
+
+	// Bytes used by page copies; zero pages take none.
+	size_t GetStoredSize() const { return _data.size(); }
+
+	/**
+	 * @brief Copies `size` bytes at `addr` as they were at the time of the capture.
+	 */
+	bool Read(const void *addr, void *out, size_t size) const;
+
+	/**
+	 * @brief Returns the byte ranges that differ between the snapshot and the live memory.
+	 */
+	Memoria::Vector<SnapshotChange_t> Diff() const;
+
+	/**
+	 * @brief Returns the byte ranges that differ between two snapshots of the same regions.
+	 */
+	Memoria::Vector<SnapshotChange_t> Diff(const CSnapshot &other) const;
+
+	/**
+	 * @brief Returns the values of type `T` at multiples of `alignment` that changed since the capture.
+	 */
+	template <typename T>
+	Memoria::Vector<SnapshotDelta_t<T>> DiffValues(size_t alignment = sizeof(T)) const
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable.");
+
+		Memoria::Vector<SnapshotDelta_t<T>> result;
+
+		for (auto &change : Diff())
+		{
+			uintptr_t begin = reinterpret_cast<uintptr_t>(change.Address);
+			uintptr_t end = begin + change.Size;
+
+			// Every aligned value overlapping the range.
+			uintptr_t addr = (begin >= sizeof(T) ? begin - sizeof(T) + 1 : 0);
+			addr = (addr + alignment - 1) / alignment * alignment;
+
+			for (; addr < end; addr += alignment)
+			{
+				// Adjacent ranges may share a value; it is reported once.
+				if (!result.empty() && reinterpret_cast<uintptr_t>(result.back().Address) >= addr)
+					continue;
+
+				SnapshotDelta_t<T> delta;
+
+				delta.Address = reinterpret_cast<T *>(addr);
+
+				if (!Read(delta.Address, &delta.Old, sizeof(T)) || !GuardedCopy(&delta.New, delta.Address, sizeof(T)))
+					continue;
+
+				if (!MemEqual(&delta.Old, &delta.New, sizeof(T)))
+					result.push_back(delta);
+			}
+		}
+
+		return result;
+	}
+};
+
+MEMORIA_END
\ No newline at end of file
@@ -27,13 +27,21 @@ protected:
 	size_t _size;
 	size_t _pos;
 
+	// Address at which the data is executed, if it differs from `_data`.
+	uint8_t *_origin;
+
 public:
-	CBuffer(void *data, size_t size) : _data(reinterpret_cast<uint8_t *>(data)), _size(size), _pos(0) {}
+	CBuffer(void *data, size_t size, const void *origin = nullptr)
+		: _data(reinterpret_cast<uint8_t *>(data)), _size(size), _pos(0), _origin(reinterpret_cast<uint8_t *>(const_cast<void *>(origin))) {}
 
 	bool Clone(void *dest, bool is_code = false, ptrdiff_t offset = 0);
 
 	uint8_t *GetData() const { return _data; }
 	uint8_t *GetPointer() const { return _data ? &_data[_pos] : nullptr; }
+
+	// Address at which the current position is executed. Code written through a writable
+	// alias of executable memory must compute relative operands against this address.
+	uint8_t *GetAddress() const { return _origin ? &_origin[_pos] : GetPointer(); }
 	size_t GetCapacity() const { return _size; }
 	size_t GetOffset() const { return _pos; }
 
@@ -43,7 +51,7 @@ public:
 class CWriteBuffer : public CBuffer
 {
 public:
-	CWriteBuffer(void *data, size_t size) : CBuffer(data, size) {}
+	CWriteBuffer(void *data, size_t size, const void *origin = nullptr) : CBuffer(data, size, origin) {}
 
 	size_t GetSize() const { return _pos; }
 
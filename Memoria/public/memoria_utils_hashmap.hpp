@@ -0,0 +1,278 @@
+//
+// memoria_utils_hashmap.hpp
+//
+// An alternative to std::unordered_map<K, V> to eliminate dependency on the CRT.
+//
+// Open addressing with linear probing over a power-of-two table. The container is
+// intended for integer-like keys such as addresses, pointers and precomputed hashes
+// (`fnv1a_t`), which covers all lookups done inside Memoria. Keys are mixed before
+// probing, so page-aligned addresses do not cluster.
+//
+// Same as with `Vector`, the default constructor is trivial, so the container can be
+// placed in the global scope without generating a dynamic initializer.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <memory>
+#include <type_traits>
+
+#include "memoria_common.hpp"
+#include "memoria_utils_string.hpp"
+
+MEMORIA_BEGIN
+
+template<typename K>
+struct HashMapHasher
+{
+	static size_t Hash(const K &key)
+	{
+		uint64_t value;
+
+		if constexpr (std::is_pointer_v<K>)
+			value = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key));
+		else
+			value = static_cast<uint64_t>(key);
+
+		// MurmurHash3 finalizer.
+		value ^= value >> 33;
+		value *= 0xFF51AFD7ED558CCDull;
+		value ^= value >> 33;
+		value *= 0xC4CEB9FE1A85EC53ull;
+		value ^= value >> 33;
+
+		return static_cast<size_t>(value);
+	}
+};
+
+template<typename K, typename V, typename Hasher = HashMapHasher<K>>
+class HashMap
+{
+private:
+	HashMap(const HashMap &) = delete;
+	HashMap &operator=(const HashMap &) = delete;
+
+	enum : uint8_t
+	{
+		SlotEmpty,
+		SlotOccupied,
+		SlotDeleted,
+	};
+
+	struct Slot
+	{
+		K key;
+		V value;
+	};
+
+	Slot *_slots = nullptr;
+	uint8_t *_states = nullptr;
+
+	// Number of occupied slots.
+	size_t _size = 0;
+
+	// Number of occupied and deleted slots; drives rehashing.
+	size_t _used = 0;
+
+	size_t _capacity = 0;
+
+	size_t find_index(const K &key) const
+	{
+		if (_capacity == 0)
+			return SIZE_MAX;
+
+		size_t mask = _capacity - 1;
+		size_t index = Hasher::Hash(key) & mask;
+
+		while (_states[index] != SlotEmpty)
+		{
+			if (_states[index] == SlotOccupied && _slots[index].key == key)
+				return index;
+
+			index = (index + 1) & mask;
+		}
+
+		return SIZE_MAX;
+	}
+
+	void rehash(size_t new_capacity)
+	{
+		Slot *old_slots = _slots;
+		uint8_t *old_states = _states;
+		size_t old_capacity = _capacity;
+
+		_slots = static_cast<Slot *>(::operator new(new_capacity * sizeof(Slot)));
+		_states = static_cast<uint8_t *>(::operator new(new_capacity));
+		_capacity = new_capacity;
+		_size = 0;
+		_used = 0;
+
+		MemFill(_states, SlotEmpty, new_capacity);
+
+		for (size_t i = 0; i < old_capacity; ++i)
+		{
+			if (old_states[i] != SlotOccupied)
+				continue;
+
+			emplace_unique(std::move(old_slots[i].key), std::move(old_slots[i].value));
+			std::destroy_at(&old_slots[i]);
+		}
+
+		::operator delete(old_slots);
+		::operator delete(old_states);
+	}
+
+	void ensure_capacity(size_t used, size_t live)
+	{
+		// Keep the load factor (including tombstones) at or below 3/4. Rehashing drops
+		// the tombstones, so the new table is sized by the live elements only.
+		if (_capacity != 0 && (used * 4) <= (_capacity * 3))
+			return;
+
+		size_t new_capacity = 16;
+
+		while (live * 4 > new_capacity * 3)
+			new_capacity *= 2;
+
+		rehash(new_capacity);
+	}
+
+	template<typename KArg, typename... Args>
+	V *emplace_unique(KArg &&key, Args&&... args)
+	{
+		size_t mask = _capacity - 1;
+		size_t index = Hasher::Hash(key) & mask;
+
+		while (_states[index] == SlotOccupied)
+			index = (index + 1) & mask;
+
+		if (_states[index] == SlotEmpty)
+			++_used;
+
+		std::construct_at(&_slots[index], Slot{ std::forward<KArg>(key), V(std::forward<Args>(args)...) });
+		_states[index] = SlotOccupied;
+		++_size;
+
+		return &_slots[index].value;
+	}
+
+public:
+	constexpr HashMap() = default;
+
+	~HashMap()
+	{
+		clear();
+
+		::operator delete(_slots);
+		::operator delete(_states);
+	}
+
+	size_t size() const { return _size; }
+	bool empty() const { return _size == 0; }
+
+	V *find(const K &key)
+	{
+		size_t index = find_index(key);
+		return index != SIZE_MAX ? &_slots[index].value : nullptr;
+	}
+
+	const V *find(const K &key) const
+	{
+		size_t index = find_index(key);
+		return index != SIZE_MAX ? &_slots[index].value : nullptr;
+	}
+
+	bool contains(const K &key) const
+	{
+		return find_index(key) != SIZE_MAX;
+	}
+
+	//
+	// Inserts `value` under `key`, replacing the existing value if there is one.
+	// Returns a pointer to the stored value, which stays valid until the next insertion.
+	//
+	V *insert(const K &key, const V &value)
+	{
+		if (V *existing = find(key))
+		{
+			*existing = value;
+			return existing;
+		}
+
+		ensure_capacity(_used + 1, _size + 1);
+		return emplace_unique(key, value);
+	}
+
+	template<typename... Args>
+	V *emplace(const K &key, Args&&... args)
+	{
+		if (V *existing = find(key))
+			return existing;
+
+		ensure_capacity(_used + 1, _size + 1);
+		return emplace_unique(key, std::forward<Args>(args)...);
+	}
+
+	bool erase(const K &key)
+	{
+		size_t index = find_index(key);
+
+		if (index == SIZE_MAX)
+			return false;
+
+		std::destroy_at(&_slots[index]);
+		_states[index] = SlotDeleted;
+		--_size;
+
+		return true;
+	}
+
+	void reserve(size_t count)
+	{
+		if (count > _size)
+			ensure_capacity(_used + (count - _size), count);
+	}
+
+	void clear()
+	{
+		for (size_t i = 0; i < _capacity; ++i)
+		{
+			if (_states[i] == SlotOccupied)
+				std::destroy_at(&_slots[i]);
+
+			_states[i] = SlotEmpty;
+		}
+
+		_size = 0;
+		_used = 0;
+	}
+
+	//
+	// Calls `fn(key, value)` for every element. The container must not be modified
+	// from inside the callback.
+	//
+	template<typename Fn>
+	void for_each(Fn fn)
+	{
+		for (size_t i = 0; i < _capacity; ++i)
+		{
+			if (_states[i] == SlotOccupied)
+				fn(_slots[i].key, _slots[i].value);
+		}
+	}
+
+	template<typename Fn>
+	void for_each(Fn fn) const
+	{
+		for (size_t i = 0; i < _capacity; ++i)
+		{
+			if (_states[i] == SlotOccupied)
+				fn(_slots[i].key, _slots[i].value);
+		}
+	}
+};
+
+MEMORIA_END
\ No newline at end of file
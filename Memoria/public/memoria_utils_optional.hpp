@@ -106,6 +106,15 @@ public:
 		return *this;
 	}
 
+	template<typename... Args>
+	T &emplace(Args &&...args)
+	{
+		reset();
+		std::construct_at(ptr(), std::forward<Args>(args)...);
+		_has_value = true;
+		return *ptr();
+	}
+
 	void reset()
 	{
 		if (_has_value)
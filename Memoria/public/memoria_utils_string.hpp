@@ -29,6 +29,9 @@ extern char *FindLastCharA(const char *lpString, int ch);
 // memcmp
 extern int MemCompare(const void *lpBlock1, const void *lpBlock2, size_t dwSize);
 
+// memcmp == 0, compares 16 bytes per step
+extern bool MemEqual(const void *lpBlock1, const void *lpBlock2, size_t dwSize);
+
 // memcpy
 extern void *MemCopy(void *lpDestination, const void *lpSource, size_t dwSize);
 
@@ -0,0 +1,693 @@
+#include "memoria_core_arena.hpp"
+
+#include "memoria_core_mempool.hpp"
+#include "memoria_core_misc.hpp"
+#include "memoria_utils_assert.hpp"
+#include "memoria_utils_optional.hpp"
+#include "memoria_utils_string.hpp"
+
+MEMORIA_BEGIN
+
+enum eArenaSlabKind : uint8_t
+{
+	ASK_SMALL,
+	ASK_MEDIUM,
+	ASK_LARGE,
+};
+
+//
+// Header at the start of every slab. Large blocks get a whole page for the header,
+// so the header of any block is found at `addr & ~(MEMORIA_ARENA_SLAB_SIZE - 1)`.
+//
+struct ArenaSlab_t
+{
+	CArena *Arena;
+
+	ArenaSlab_t *Prev;
+	ArenaSlab_t *Next;
+
+	size_t Size;
+
+	uint8_t Kind;
+
+	// Small slabs: index of the size class.
+	uint8_t Class;
+
+	// Medium slabs: length in pages of the run starting at each page, `0` inside a run.
+	uint8_t Runs[MEMORIA_ARENA_MEDIUM_PAGES + 1];
+
+	// Medium slabs: bit set for each page that starts a free run.
+	uint16_t FreeRuns;
+};
+
+static_assert(sizeof(ArenaSlab_t) <= 64, "The slab header must fit in front of the first small object.");
+
+// Header of a free medium run, linked into the list of its length.
+struct ArenaFreeRun_t
+{
+	ArenaFreeRun_t *Prev;
+	ArenaFreeRun_t *Next;
+};
+
+struct ArenaCache_t
+{
+	CArena *Arena;
+
+	uint32_t Epoch;
+	ArenaCache_t *Prev;
+	ArenaCache_t *Next;
+
+	ArenaFreeBlock_t *Free[MEMORIA_ARENA_SMALL_CLASSES];
+	uint32_t Count[MEMORIA_ARENA_SMALL_CLASSES];
+};
+
+// Objects moved between a thread cache and the shared lists at once.
+static constexpr uint32_t kArenaBatch = 16;
+
+// Number of objects per class a thread cache may hold before returning a batch.
+static constexpr uint32_t kArenaCacheLimit = 64;
+
+static size_t GetClassSize(size_t index)
+{
+	return static_cast<size_t>(16) << index;
+}
+
+static size_t GetClassIndex(size_t size)
+{
+	size_t index = 0;
+
+	while (GetClassSize(index) < size)
+		++index;
+
+	return index;
+}
+
+static ArenaSlab_t *GetSlab(const void *addr)
+{
+	return reinterpret_cast<ArenaSlab_t *>(reinterpret_cast<uintptr_t>(addr) & ~static_cast<uintptr_t>(MEMORIA_ARENA_SLAB_SIZE - 1));
+}
+
+static void *GetPage(ArenaSlab_t *slab, size_t page)
+{
+	return PtrAdvance(slab, page * MEMORIA_ARENA_PAGE_SIZE);
+}
+
+static size_t GetPageIndex(const ArenaSlab_t *slab, const void *addr)
+{
+	return (reinterpret_cast<uintptr_t>(addr) - reinterpret_cast<uintptr_t>(slab)) / MEMORIA_ARENA_PAGE_SIZE;
+}
+
+static void PushBlock(ArenaFreeBlock_t **list, void *addr)
+{
+	auto block = static_cast<ArenaFreeBlock_t *>(addr);
+
+	block->Next = *list;
+	*list = block;
+}
+
+static void *PopBlock(ArenaFreeBlock_t **list)
+{
+	ArenaFreeBlock_t *block = *list;
+
+	if (block)
+		*list = block->Next;
+
+	return block;
+}
+
+CArena::~CArena()
+{
+	ReleaseThreadCaches();
+	Reset();
+}
+
+ArenaSlab_t *CArena::CreateSlab(size_t size, uint8_t kind)
+{
+	auto slab = static_cast<ArenaSlab_t *>(VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+
+	if (!slab)
+		return nullptr;
+
+	if (!RegisterArenaSlab(slab, size, this))
+	{
+		VirtualFree(slab, 0, MEM_RELEASE);
+		return nullptr;
+	}
+
+	// Fresh pages are zero-filled, only the non-zero fields are set.
+	slab->Arena = this;
+	slab->Size = size;
+	slab->Kind = kind;
+	slab->Next = _slabs;
+
+	if (_slabs)
+		_slabs->Prev = slab;
+
+	_slabs = slab;
+
+	++_slab_count;
+	_reserved += size;
+
+	return slab;
+}
+
+void CArena::DestroySlab(ArenaSlab_t *slab)
+{
+	if (slab->Prev)
+		slab->Prev->Next = slab->Next;
+	else
+		_slabs = slab->Next;
+
+	if (slab->Next)
+		slab->Next->Prev = slab->Prev;
+
+	--_slab_count;
+	_reserved -= slab->Size;
+
+	UnregisterArenaSlab(slab);
+
+	bool freed = VirtualFree(slab, 0, MEM_RELEASE) != FALSE;
+	Assert(freed);
+}
+
+ArenaCache_t *CArena::GetCache()
+{
+	if (_fls == FLS_OUT_OF_INDEXES)
+	{
+		AcquireSRWLockExclusive(&_lock);
+
+		if (_fls == FLS_OUT_OF_INDEXES)
+			_fls = FlsAlloc(ReleaseCache);
+
+		ReleaseSRWLockExclusive(&_lock);
+
+		if (_fls == FLS_OUT_OF_INDEXES)
+			return nullptr;
+	}
+
+	auto cache = static_cast<ArenaCache_t *>(FlsGetValue(_fls));
+
+	if (!cache)
+	{
+		cache = static_cast<ArenaCache_t *>(HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(ArenaCache_t)));
+
+		if (!cache)
+			return nullptr;
+
+		cache->Arena = this;
+
+		AcquireSRWLockExclusive(&_lock);
+
+		cache->Epoch = _epoch;
+		cache->Next = _caches;
+
+		if (_caches)
+			_caches->Prev = cache;
+
+		_caches = cache;
+
+		ReleaseSRWLockExclusive(&_lock);
+
+		FlsSetValue(_fls, cache);
+	}
+	else if (cache->Epoch != _epoch)
+	{
+		// The arena has been reset, cached blocks point to released slabs.
+		MemFill(cache->Free, 0, sizeof(cache->Free));
+		MemFill(cache->Count, 0, sizeof(cache->Count));
+
+		cache->Epoch = _epoch;
+	}
+
+	return cache;
+}
+
+VOID NTAPI CArena::ReleaseCache(PVOID data)
+{
+	auto cache = static_cast<ArenaCache_t *>(data);
+
+	if (!cache)
+		return;
+
+	CArena *arena = cache->Arena;
+
+	AcquireSRWLockExclusive(&arena->_lock);
+
+	// Hand the cached blocks to the other threads; blocks of an older epoch belong to released slabs.
+	if (cache->Epoch == arena->_epoch)
+	{
+		for (size_t i = 0; i < MEMORIA_ARENA_SMALL_CLASSES; ++i)
+		{
+			while (cache->Free[i])
+				PushBlock(&arena->_free[i], PopBlock(&cache->Free[i]));
+
+			arena->_free_count[i] += cache->Count[i];
+		}
+	}
+
+	if (cache->Prev)
+		cache->Prev->Next = cache->Next;
+	else
+		arena->_caches = cache->Next;
+
+	if (cache->Next)
+		cache->Next->Prev = cache->Prev;
+
+	ReleaseSRWLockExclusive(&arena->_lock);
+
+	HeapFree(GetProcessHeap(), 0, cache);
+}
+
+void CArena::ReleaseThreadCaches()
+{
+	if (_fls == FLS_OUT_OF_INDEXES)
+		return;
+
+	// Runs `ReleaseCache` for the cache of every thread, so no callback into this module
+	// remains registered once it is unloaded.
+	FlsFree(_fls);
+	_fls = FLS_OUT_OF_INDEXES;
+}
+
+void *CArena::RefillSmall(ArenaCache_t *cache, size_t index)
+{
+	size_t class_size = GetClassSize(index);
+
+	AcquireSRWLockExclusive(&_lock);
+
+	// Take a batch from the shared list first, then carve fresh objects.
+	void *result = PopBlock(&_free[index]);
+
+	if (result)
+		--_free_count[index];
+
+	for (uint32_t i = 1; cache && i < kArenaBatch && _free[index]; ++i)
+	{
+		PushBlock(&cache->Free[index], PopBlock(&_free[index]));
+		--_free_count[index];
+		++cache->Count[index];
+	}
+
+	if (!result)
+	{
+		if (_bump[index] == _bump_end[index])
+		{
+			ArenaSlab_t *slab = CreateSlab(MEMORIA_ARENA_SLAB_SIZE, ASK_SMALL);
+
+			if (!slab)
+			{
+				ReleaseSRWLockExclusive(&_lock);
+				return nullptr;
+			}
+
+			slab->Class = static_cast<uint8_t>(index);
+
+			_bump[index] = reinterpret_cast<uint8_t *>(slab) + (class_size > 64 ? class_size : 64);
+			_bump_end[index] = reinterpret_cast<uint8_t *>(slab) + MEMORIA_ARENA_SLAB_SIZE;
+		}
+
+		result = _bump[index];
+		_bump[index] += class_size;
+		++_carved[index];
+
+		for (uint32_t i = 1; cache && i < kArenaBatch && _bump[index] != _bump_end[index]; ++i)
+		{
+			PushBlock(&cache->Free[index], _bump[index]);
+			++cache->Count[index];
+
+			_bump[index] += class_size;
+			++_carved[index];
+		}
+	}
+
+	ReleaseSRWLockExclusive(&_lock);
+	return result;
+}
+
+void *CArena::AllocateSmall(size_t index)
+{
+	ArenaCache_t *cache = GetCache();
+
+	if (cache && cache->Free[index])
+	{
+		--cache->Count[index];
+		return PopBlock(&cache->Free[index]);
+	}
+
+	return RefillSmall(cache, index);
+}
+
+void CArena::FreeSmall(void *addr, size_t index)
+{
+	ArenaCache_t *cache = GetCache();
+
+	if (cache)
+	{
+		PushBlock(&cache->Free[index], addr);
+
+		if (++cache->Count[index] <= kArenaCacheLimit)
+			return;
+
+		// Return a batch, so a thread that only frees does not hoard memory.
+		AcquireSRWLockExclusive(&_lock);
+
+		for (uint32_t i = 0; i < kArenaBatch * 2; ++i)
+			PushBlock(&_free[index], PopBlock(&cache->Free[index]));
+
+		_free_count[index] += kArenaBatch * 2;
+
+		ReleaseSRWLockExclusive(&_lock);
+
+		cache->Count[index] -= kArenaBatch * 2;
+		return;
+	}
+
+	AcquireSRWLockExclusive(&_lock);
+	PushBlock(&_free[index], addr);
+	++_free_count[index];
+	ReleaseSRWLockExclusive(&_lock);
+}
+
+void CArena::InsertRun(ArenaSlab_t *slab, size_t page, size_t pages)
+{
+	auto run = static_cast<ArenaFreeRun_t *>(GetPage(slab, page));
+
+	run->Prev = nullptr;
+	run->Next = _runs[pages];
+
+	if (_runs[pages])
+		_runs[pages]->Prev = run;
+
+	_runs[pages] = run;
+
+	slab->Runs[page] = static_cast<uint8_t>(pages);
+	slab->FreeRuns |= static_cast<uint16_t>(1u << page);
+}
+
+void CArena::RemoveRun(ArenaSlab_t *slab, size_t page)
+{
+	auto run = static_cast<ArenaFreeRun_t *>(GetPage(slab, page));
+
+	if (run->Prev)
+		run->Prev->Next = run->Next;
+	else
+		_runs[slab->Runs[page]] = run->Next;
+
+	if (run->Next)
+		run->Next->Prev = run->Prev;
+
+	slab->FreeRuns &= static_cast<uint16_t>(~(1u << page));
+}
+
+void *CArena::AllocateMedium(size_t pages)
+{
+	AcquireSRWLockExclusive(&_lock);
+
+	// Best fit: the shortest free run that holds the request.
+	size_t length = pages;
+
+	while (length <= MEMORIA_ARENA_MEDIUM_PAGES && !_runs[length])
+		++length;
+
+	ArenaSlab_t *slab;
+	size_t page;
+
+	if (length <= MEMORIA_ARENA_MEDIUM_PAGES)
+	{
+		slab = GetSlab(_runs[length]);
+		page = GetPageIndex(slab, _runs[length]);
+
+		RemoveRun(slab, page);
+	}
+	else
+	{
+		slab = CreateSlab(MEMORIA_ARENA_SLAB_SIZE, ASK_MEDIUM);
+
+		if (!slab)
+		{
+			ReleaseSRWLockExclusive(&_lock);
+			return nullptr;
+		}
+
+		page = 1;
+		length = MEMORIA_ARENA_MEDIUM_PAGES;
+	}
+
+	if (slab == _run_spare)
+		_run_spare = nullptr;
+
+	// The rest of the run stays free.
+	if (length > pages)
+		InsertRun(slab, page + pages, length - pages);
+
+	slab->Runs[page] = static_cast<uint8_t>(pages);
+
+	++_pages.Blocks;
+	_pages.Bytes += pages * MEMORIA_ARENA_PAGE_SIZE;
+
+	ReleaseSRWLockExclusive(&_lock);
+	return GetPage(slab, page);
+}
+
+void CArena::FreeMedium(ArenaSlab_t *slab, void *addr)
+{
+	size_t page = GetPageIndex(slab, addr);
+
+	AcquireSRWLockExclusive(&_lock);
+
+	size_t pages = slab->Runs[page];
+
+	--_pages.Blocks;
+	_pages.Bytes -= pages * MEMORIA_ARENA_PAGE_SIZE;
+
+	// Merge with the free run that follows.
+	size_t next = page + pages;
+
+	if (next <= MEMORIA_ARENA_MEDIUM_PAGES && (slab->FreeRuns & (1u << next)))
+	{
+		RemoveRun(slab, next);
+
+		pages += slab->Runs[next];
+		slab->Runs[next] = 0;
+	}
+
+	// Merge with the free run that precedes; it starts at the closest page with a length.
+	size_t prev = page - 1;
+
+	while (prev > 0 && slab->Runs[prev] == 0)
+		--prev;
+
+	if (prev > 0 && (slab->FreeRuns & (1u << prev)))
+	{
+		RemoveRun(slab, prev);
+
+		pages += slab->Runs[prev];
+		slab->Runs[page] = 0;
+		page = prev;
+	}
+
+	// Release a slab with no pages in use, unless it is the only spare.
+	if (pages == MEMORIA_ARENA_MEDIUM_PAGES && _run_spare != nullptr)
+	{
+		DestroySlab(slab);
+	}
+	else
+	{
+		if (pages == MEMORIA_ARENA_MEDIUM_PAGES)
+			_run_spare = slab;
+
+		InsertRun(slab, page, pages);
+	}
+
+	ReleaseSRWLockExclusive(&_lock);
+}
+
+void *CArena::AllocateLarge(size_t size)
+{
+	AcquireSRWLockExclusive(&_lock);
+
+	ArenaSlab_t *slab = CreateSlab(size + MEMORIA_ARENA_PAGE_SIZE, ASK_LARGE);
+
+	if (slab)
+	{
+		++_pages.Blocks;
+		_pages.Bytes += size;
+	}
+
+	ReleaseSRWLockExclusive(&_lock);
+
+	return slab ? PtrAdvance(slab, MEMORIA_ARENA_PAGE_SIZE) : nullptr;
+}
+
+void *CArena::Allocate(size_t size, bool zero)
+{
+	Assert(size != 0);
+
+	if (size == 0)
+		return nullptr;
+
+	void *result;
+
+	if (size <= MEMORIA_ARENA_SMALL_MAX)
+	{
+		size_t index = GetClassIndex(size);
+		result = AllocateSmall(index);
+		size = GetClassSize(index);
+	}
+	else if (size <= MEMORIA_ARENA_MEDIUM_MAX)
+	{
+		size = Align(size, MEMORIA_ARENA_PAGE_SIZE);
+		result = AllocateMedium(size / MEMORIA_ARENA_PAGE_SIZE);
+	}
+	else
+	{
+		// Fresh pages are already zero-filled.
+		return AllocateLarge(size);
+	}
+
+	if (result && zero)
+		MemFill(result, 0, size);
+
+	return result;
+}
+
+bool CArena::Free(void *addr)
+{
+	if (addr == nullptr)
+		return false;
+
+	ArenaSlab_t *slab = GetSlab(addr);
+
+	if (slab->Arena != this)
+		return false;
+
+	switch (slab->Kind)
+	{
+	case ASK_SMALL:
+		FreeSmall(addr, slab->Class);
+		break;
+
+	case ASK_MEDIUM:
+		FreeMedium(slab, addr);
+		break;
+
+	case ASK_LARGE:
+		AcquireSRWLockExclusive(&_lock);
+
+		--_pages.Blocks;
+		_pages.Bytes -= slab->Size - MEMORIA_ARENA_PAGE_SIZE;
+
+		DestroySlab(slab);
+		ReleaseSRWLockExclusive(&_lock);
+		break;
+	}
+
+	return true;
+}
+
+size_t CArena::GetSize(const void *addr) const
+{
+	ArenaSlab_t *slab = GetSlab(addr);
+
+	switch (slab->Kind)
+	{
+	case ASK_SMALL:
+		return GetClassSize(slab->Class);
+
+	case ASK_MEDIUM:
+		return slab->Runs[GetPageIndex(slab, addr)] * MEMORIA_ARENA_PAGE_SIZE;
+
+	case ASK_LARGE:
+		return slab->Size - MEMORIA_ARENA_PAGE_SIZE;
+	}
+
+	return 0;
+}
+
+void CArena::Reset()
+{
+	AcquireSRWLockExclusive(&_lock);
+
+	while (_slabs)
+		DestroySlab(_slabs);
+
+	MemFill(_free, 0, sizeof(_free));
+	MemFill(_free_count, 0, sizeof(_free_count));
+	MemFill(_carved, 0, sizeof(_carved));
+	MemFill(_bump, 0, sizeof(_bump));
+	MemFill(_bump_end, 0, sizeof(_bump_end));
+	MemFill(_runs, 0, sizeof(_runs));
+
+	_run_spare = nullptr;
+	_pages = {};
+
+	// Thread caches notice the new epoch on their next use.
+	InterlockedIncrement(reinterpret_cast<volatile LONG *>(&_epoch));
+
+	ReleaseSRWLockExclusive(&_lock);
+}
+
+ArenaStats_t CArena::GetStats()
+{
+	ArenaStats_t result = {};
+
+	AcquireSRWLockShared(&_lock);
+
+	result.Slabs = _slab_count;
+	result.Reserved = _reserved;
+	result.Pages = _pages;
+	result.Epoch = _epoch;
+
+	for (size_t i = 0; i < MEMORIA_ARENA_SMALL_CLASSES; ++i)
+	{
+		// Counts of caches are read while their threads run, so the result is only a snapshot.
+		size_t unused = _free_count[i];
+
+		for (ArenaCache_t *cache = _caches; cache != nullptr; cache = cache->Next)
+		{
+			if (cache->Epoch == _epoch)
+				unused += cache->Count[i];
+		}
+
+		result.Small[i].Blocks = (_carved[i] > unused) ? _carved[i] - unused : 0;
+		result.Small[i].Bytes = result.Small[i].Blocks * GetClassSize(i);
+	}
+
+	ReleaseSRWLockShared(&_lock);
+	return result;
+}
+
+CArena *CArena::FromPointer(const void *addr)
+{
+	return FindArenaSlab(GetSlab(addr));
+}
+
+// Constructed on first use; a static `CArena` would need a destructor run by the CRT.
+static Memoria::Optional<CArena> gDefaultArena;
+static CArena *volatile gDefaultArenaPtr = nullptr;
+static SRWLOCK gDefaultArenaLock = SRWLOCK_INIT;
+
+CArena *GetDefaultArena()
+{
+	CArena *arena = gDefaultArenaPtr;
+
+	if (arena)
+		return arena;
+
+	AcquireSRWLockExclusive(&gDefaultArenaLock);
+
+	if (!gDefaultArena.has_value())
+	{
+		gDefaultArena.emplace();
+		gDefaultArenaPtr = &gDefaultArena.value();
+
+		RegisterOnExitCallback([]() { gDefaultArena.value().ReleaseThreadCaches(); });
+	}
+
+	arena = gDefaultArenaPtr;
+
+	ReleaseSRWLockExclusive(&gDefaultArenaLock);
+	return arena;
+}
+
+MEMORIA_END
\ No newline at end of file
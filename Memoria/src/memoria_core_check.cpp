@@ -12,22 +12,18 @@ MEMORIA_BEGIN
 
 bool CheckMemory(const void *addr, const void *value, size_t size, ptrdiff_t offset)
 {
-	if (IsSafeModeActive())
+	if (!IsSafeModeActive())
+		return MemEqual(PtrOffset(addr, offset), value, size);
+
+	bool equal = false;
+
+	if (!addr || !value || !GuardedCompare(PtrOffset(addr, offset), value, size, &equal))
 	{
-		if (!IsMemoryValid(addr, offset))
-		{
-			SetError(ME_INVALID_MEMORY);
-			return false;
-		}
-
-		if (!IsMemoryValid(value))
-		{
-			SetError(ME_INVALID_MEMORY);
-			return false;
-		}
+		SetError(ME_INVALID_MEMORY);
+		return false;
 	}
 
-	return MemCompare(PtrOffset(addr, offset), value, size) == 0;
+	return equal;
 }
 
 bool CheckU8(const void *addr, uint8_t value, ptrdiff_t offset)
@@ -134,25 +130,27 @@ bool CheckWStr(const void *addr, const wchar_t *value, ptrdiff_t offset)
 
 bool CheckSignature(const void *addr, const CSignature &value, ptrdiff_t offset)
 {
-	if (IsSafeModeActive())
+	if (offset != 0)
+		addr = (reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset));
+
+	if (!IsSafeModeActive())
+		return value.Match(addr);
+
+	if (value.IsEmpty())
 	{
-		if (value.IsEmpty())
-		{
-			SetError(ME_INVALID_ARGUMENT);
-			return false;
-		}
-
-		if (!IsMemoryValid(addr, offset))
-		{
-			SetError(ME_INVALID_MEMORY);
-			return false;
-		}
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
 	}
 
-	if (offset != 0)
-		addr = (reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset));
+	bool matched = false;
+
+	if (!addr || !GuardedInvoke([&]() { matched = value.Match(addr); }))
+	{
+		SetError(ME_INVALID_MEMORY);
+		return false;
+	}
 
-	return value.Match(addr);
+	return matched;
 }
 
 bool CheckSignature(const void *addr, const char *value, ptrdiff_t offset)
@@ -0,0 +1,92 @@
+#include "memoria_core_codearena.hpp"
+
+#include "memoria_core_mempool.hpp"
+#include "memoria_core_misc.hpp"
+
+MEMORIA_BEGIN
+
+static void *MapExecutableView(void *addr, size_t size, void *context)
+{
+	return MapViewOfFileEx(static_cast<HANDLE>(context), FILE_MAP_READ | FILE_MAP_EXECUTE, 0, 0, size, addr);
+}
+
+CCodeArena::~CCodeArena()
+{
+	Release();
+}
+
+bool CCodeArena::Create(const void *addr_nearest, size_t size)
+{
+	if (IsValid())
+		return false;
+
+	size = Align(size, 0x10000);
+
+#ifdef MEMORIA_64BIT
+	DWORD size_high = static_cast<DWORD>(static_cast<uint64_t>(size) >> 32);
+#else
+	DWORD size_high = 0;
+#endif
+
+	_section = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_EXECUTE_READWRITE | SEC_COMMIT, size_high, static_cast<DWORD>(size), nullptr);
+
+	if (_section)
+	{
+		_writable = static_cast<uint8_t *>(MapViewOfFile(_section, FILE_MAP_WRITE, 0, 0, size));
+
+		if (_writable)
+			_executable = static_cast<uint8_t *>(AllocInRegion(addr_nearest, size, false, MapExecutableView, _section));
+
+		if (_executable)
+		{
+			_size = size;
+			return true;
+		}
+
+		if (_writable)
+			UnmapViewOfFile(_writable);
+
+		CloseHandle(_section);
+
+		_section = nullptr;
+		_writable = nullptr;
+	}
+
+	// Sections may be unavailable, e.g. under restrictive process mitigation policies.
+	_writable = _executable = static_cast<uint8_t *>(AllocFar(addr_nearest, size, true, true, true));
+
+	if (!_writable)
+		return false;
+
+	_size = size;
+	return true;
+}
+
+void CCodeArena::Release()
+{
+	if (!IsValid())
+		return;
+
+	if (_section)
+	{
+		UnmapViewOfFile(_executable);
+		UnmapViewOfFile(_writable);
+		CloseHandle(_section);
+	}
+	else
+	{
+		Free(_writable);
+	}
+
+	_section = nullptr;
+	_writable = nullptr;
+	_executable = nullptr;
+	_size = 0;
+}
+
+void CCodeArena::Flush(const void *executable, size_t size) const
+{
+	FlushInstructionCache(GetCurrentProcess(), executable, size);
+}
+
+MEMORIA_END
\ No newline at end of file
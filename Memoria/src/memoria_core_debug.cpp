@@ -1,9 +1,12 @@
 #include "memoria_core_debug.hpp"
 
 #include "memoria_core_misc.hpp"
+#include "memoria_core_errors.hpp"
+#include "memoria_core_windows.hpp"
 #include "memoria_utils_string.hpp"
 #include "memoria_utils_format.hpp"
 #include "memoria_utils_optional.hpp"
+#include "memoria_utils_hashmap.hpp"
 
 #include <Windows.h>
 #include <dbghelp.h>
@@ -140,13 +143,90 @@ void *GetImageDirectoryData(void *base,
 	return nullptr;
 }
 
+//
+// Symbol cache.
+//
+// `gSymbolLock` serializes all calls into dbghelp and guards the cache. Entries are linked in
+// order of use through indices; the least recently used one is replaced when the cache is full.
+//
+
+static constexpr uint32_t kNoSymbolEntry = UINT32_MAX;
+
+struct SymbolCacheEntry_t
+{
+	const void *Address;
+	uint32_t Prev;
+	uint32_t Next;
+	bool Found;
+	char Name[MEMORIA_SYMBOL_NAME_SIZE];
+};
+
+static SRWLOCK gSymbolLock = SRWLOCK_INIT;
+
+static SymbolCacheEntry_t *gSymbolCache = nullptr;
+static uint32_t gSymbolCacheUsed = 0;
+
+// Most and least recently used entries.
+static uint32_t gSymbolCacheHead = kNoSymbolEntry;
+static uint32_t gSymbolCacheTail = kNoSymbolEntry;
+
+static Memoria::HashMap<const void *, uint32_t> gSymbolCacheIndex;
+
+static void UnlinkSymbolEntry(uint32_t index)
+{
+	SymbolCacheEntry_t &entry = gSymbolCache[index];
+
+	if (entry.Prev != kNoSymbolEntry)
+		gSymbolCache[entry.Prev].Next = entry.Next;
+	else
+		gSymbolCacheHead = entry.Next;
+
+	if (entry.Next != kNoSymbolEntry)
+		gSymbolCache[entry.Next].Prev = entry.Prev;
+	else
+		gSymbolCacheTail = entry.Prev;
+}
+
+static void LinkSymbolEntry(uint32_t index)
+{
+	SymbolCacheEntry_t &entry = gSymbolCache[index];
+
+	entry.Prev = kNoSymbolEntry;
+	entry.Next = gSymbolCacheHead;
+
+	if (gSymbolCacheHead != kNoSymbolEntry)
+		gSymbolCache[gSymbolCacheHead].Prev = index;
+	else
+		gSymbolCacheTail = index;
+
+	gSymbolCacheHead = index;
+}
+
+static void ReleaseSymbolCache()
+{
+	if (gSymbolCache)
+		VirtualFree(gSymbolCache, 0, MEM_RELEASE);
+
+	gSymbolCache = nullptr;
+	gSymbolCacheUsed = 0;
+	gSymbolCacheHead = kNoSymbolEntry;
+	gSymbolCacheTail = kNoSymbolEntry;
+	gSymbolCacheIndex.clear();
+}
+
 static void SymShutdown()
 {
+	AcquireSRWLockExclusive(&gSymbolLock);
+
 	if (SymInited.has_value() && SymInited.value())
 	{
 		SymCleanupWrap(GetCurrentProcess());
 		SymInited = std::nullopt;
 	}
+
+	ReleaseSymbolCache();
+
+	ReleaseSRWLockExclusive(&gSymbolLock);
 }
 
 static bool SymInit()
@@ -165,11 +245,9 @@ static bool SymInit()
 // The variable is moved outside the function to eliminate the generation of __chkstk calls.
 static char GetSymbolNameSymBuf[sizeof(SYMBOL_INFO) + MAX_SYM_NAME * sizeof(TCHAR)];
 
-bool GetSymbolName(const void *address, char *out, size_t max_size)
+// Must be called with `gSymbolLock` held.
+static bool ResolveSymbolName(const void *address, char *out, size_t max_size)
 {
-	if (!address || !out || max_size == 0)
-		return false;
-
 	if (!SymInit())
 		return false;
 
@@ -190,80 +268,345 @@ bool GetSymbolName(const void *address, char *out, size_t max_size)
 	return false;
 }
 
+// Must be called with `gSymbolLock` held.
+static bool LookupSymbolName(const void *address, char *out, size_t max_size)
+{
+	if (auto cached = gSymbolCacheIndex.find(address))
+	{
+		uint32_t index = *cached;
+
+		UnlinkSymbolEntry(index);
+		LinkSymbolEntry(index);
+
+		if (!gSymbolCache[index].Found)
+			return false;
+
+		StrNCopySafeA(out, max_size, gSymbolCache[index].Name, _TRUNCATE);
+		return true;
+	}
+
+	if (!gSymbolCache)
+	{
+		gSymbolCache = static_cast<SymbolCacheEntry_t *>(VirtualAlloc(nullptr, MEMORIA_SYMBOL_CACHE_SIZE * sizeof(SymbolCacheEntry_t),
+			MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+
+		if (!gSymbolCache)
+			return ResolveSymbolName(address, out, max_size);
+
+		gSymbolCacheIndex.reserve(MEMORIA_SYMBOL_CACHE_SIZE);
+	}
+
+	uint32_t index;
+
+	if (gSymbolCacheUsed < MEMORIA_SYMBOL_CACHE_SIZE)
+	{
+		index = gSymbolCacheUsed++;
+	}
+	else
+	{
+		index = gSymbolCacheTail;
+
+		UnlinkSymbolEntry(index);
+		gSymbolCacheIndex.erase(gSymbolCache[index].Address);
+	}
+
+	SymbolCacheEntry_t &entry = gSymbolCache[index];
+
+	entry.Address = address;
+	entry.Name[0] = '\0';
+	entry.Found = ResolveSymbolName(address, entry.Name, sizeof(entry.Name));
+
+	LinkSymbolEntry(index);
+	gSymbolCacheIndex.insert(address, index);
+
+	if (!entry.Found)
+		return false;
+
+	StrNCopySafeA(out, max_size, entry.Name, _TRUNCATE);
+	return true;
+}
+
+bool GetSymbolName(const void *address, char *out, size_t max_size)
+{
+	if (!address || !out || max_size == 0)
+		return false;
+
+	AcquireSRWLockExclusive(&gSymbolLock);
+	bool result = LookupSymbolName(address, out, max_size);
+	ReleaseSRWLockExclusive(&gSymbolLock);
+
+	return result;
+}
+
 bool GetBeautyFunctionAddress(const void *address, char *out, size_t max_size,
 	bool concat_module_name, bool memory_beautify_on_error)
 {
 	if (!address || !out || max_size == 0)
 		return false;
 
-	void *pBaseAddress = GetFunctionBaseAddressFromItsCode(address);
-	if (!pBaseAddress)
+	SymbolInfo_t info;
+	SymbolizeAddresses(&address, 1, &info);
+
+	return FormatSymbolInfo(info, out, max_size, concat_module_name, memory_beautify_on_error);
+}
+
+// Sorts `order` by the addresses it refers to; a heap sort, as backtrace sets can be large.
+static void SortByAddress(uint32_t *order, size_t count, const void *const *addresses)
+{
+	auto key = [&](size_t i) { return reinterpret_cast<uintptr_t>(addresses[order[i]]); };
+
+	auto sift = [&](size_t root, size_t end)
 	{
-		if (memory_beautify_on_error)
-			return BeautifyPointer(address, out, max_size);
-		out[0] = '\0';
-		return false;
-	}
+		for (size_t child; (child = root * 2 + 1) < end; root = child)
+		{
+			if (child + 1 < end && key(child + 1) > key(child))
+				++child;
 
-	char name[1024];
-	if (!GetSymbolName(pBaseAddress, name, sizeof(name)))
+			if (key(root) >= key(child))
+				return;
+
+			uint32_t temp = order[root];
+			order[root] = order[child];
+			order[child] = temp;
+		}
+	};
+
+	for (size_t i = count / 2; i-- > 0;)
+		sift(i, count);
+
+	for (size_t end = count; end-- > 1;)
 	{
-		if (memory_beautify_on_error)
-			return BeautifyPointer(address, out, max_size);
-		out[0] = '\0';
-		return false;
+		uint32_t temp = order[0];
+		order[0] = order[end];
+		order[end] = temp;
+
+		sift(0, end);
 	}
+}
 
-	uintptr_t offset = reinterpret_cast<uintptr_t>(address) - reinterpret_cast<uintptr_t>(pBaseAddress);
+size_t SymbolizeAddresses(const void *const *addresses, size_t count, SymbolInfo_t *out)
+{
+	if (!addresses || !out || count == 0 || count > UINT32_MAX)
+		return 0;
 
-	char offset_str[32];
-	FormatBufSafe(offset_str, sizeof(offset_str), "+0x%llX", static_cast<unsigned long long>(offset));
+	Memoria::Vector<uint32_t> order;
+	uint32_t single = 0;
+	uint32_t *indices = &single;
 
-	char module_prefix[512] = "";
-	if (concat_module_name)
+	if (count > 1)
 	{
-		HMODULE hModule = reinterpret_cast<HMODULE>(GetBaseAddress(address));
-		if (hModule)
+		order.resize(count);
+
+		for (size_t i = 0; i < count; ++i)
+			order[i] = static_cast<uint32_t>(i);
+
+		SortByAddress(order.data(), count, addresses);
+		indices = order.data();
+	}
+
+	// Modules and functions are resolved without the lock; consecutive addresses mostly share the module.
+	HMODULE module = nullptr;
+	uintptr_t module_begin = 0;
+	uintptr_t module_end = 0;
+	FunctionTable_t table = {};
+	char module_name[sizeof(SymbolInfo_t::ModuleName)] = "";
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		SymbolInfo_t &info = out[indices[i]];
+		const void *address = addresses[indices[i]];
+		uintptr_t value = reinterpret_cast<uintptr_t>(address);
+
+		info.Address = address;
+		info.Module = nullptr;
+		info.Function = nullptr;
+		info.ModuleName[0] = '\0';
+		info.Name[0] = '\0';
+
+		if (!address)
+			continue;
+
+		if (!module || value < module_begin || value >= module_end)
 		{
-			GetModuleName(hModule, module_prefix, sizeof(module_prefix));
-			StrCatSafeA(module_prefix, sizeof(module_prefix), "!");
+			module = static_cast<HMODULE>(GetBaseAddress(address));
+
+			if (!module)
+				continue;
+
+			module_begin = reinterpret_cast<uintptr_t>(module);
+			module_end = module_begin + GetModuleSize(module);
+			table = GetFunctionTable(module);
+
+			if (!GetModuleName(module, module_name, sizeof(module_name)))
+				module_name[0] = '\0';
 		}
+
+		info.Module = module;
+		StrNCopySafeA(info.ModuleName, sizeof(info.ModuleName), module_name, _TRUNCATE);
+
+		if (auto entry = FindFunctionEntry(table, address))
+			info.Function = PtrOffset(module, entry->BeginAddress);
 	}
 
+	size_t found = 0;
+
+	AcquireSRWLockExclusive(&gSymbolLock);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		SymbolInfo_t &info = out[i];
+
+		if (info.Function && LookupSymbolName(info.Function, info.Name, sizeof(info.Name)))
+			++found;
+	}
+
+	ReleaseSRWLockExclusive(&gSymbolLock);
+
+	return found;
+}
+
+bool FormatSymbolInfo(const SymbolInfo_t &info, char *out, size_t max_size, bool concat_module_name, bool memory_beautify_on_error)
+{
+	if (!out || max_size == 0)
+		return false;
+
 	char pointer_str[128];
-	BeautifyPointer(address, pointer_str, sizeof(pointer_str));
+	BeautifyPointer(info.Address, info.Module, info.ModuleName, pointer_str, sizeof(pointer_str));
+
+	if (!info.Function || !info.Name[0])
+	{
+		if (memory_beautify_on_error)
+		{
+			StrNCopySafeA(out, max_size, pointer_str, _TRUNCATE);
+			return true;
+		}
+
+		out[0] = '\0';
+		return false;
+	}
 
-	int written = FormatBufSafe(out, max_size, "%s%s%s [%s]", module_prefix, name, offset_str, pointer_str);
+	uintptr_t offset = reinterpret_cast<uintptr_t>(info.Address) - reinterpret_cast<uintptr_t>(info.Function);
+
+	char module_prefix[sizeof(info.ModuleName) + 1] = "";
+	if (concat_module_name && info.ModuleName[0])
+	{
+		StrNCopySafeA(module_prefix, sizeof(module_prefix), info.ModuleName, _TRUNCATE);
+		StrCatSafeA(module_prefix, sizeof(module_prefix), "!");
+	}
+
+	int written = FormatBufSafe(out, max_size, "%s%s+0x%llX [%s]", module_prefix, info.Name, static_cast<unsigned long long>(offset), pointer_str);
 	return written > 0 && static_cast<size_t>(written) < max_size;
 }
 
-Memoria::Vector<std::tuple<void *, void *>> GetFunctionEntries(HMODULE handle)
+FunctionTable_t GetFunctionTable(HMODULE handle)
 {
+	FunctionTable_t table = {};
+
 	if (!handle)
 		handle = GetModuleHandleA(0);
 
 	if (!handle)
-		return {};
+		return table;
 
 	uint32_t size;
-	PIMAGE_RUNTIME_FUNCTION_ENTRY pFunc = reinterpret_cast<PIMAGE_RUNTIME_FUNCTION_ENTRY>(
+	auto entries = reinterpret_cast<const IMAGE_RUNTIME_FUNCTION_ENTRY *>(
 		GetImageDirectoryData(handle, TRUE, IMAGE_DIRECTORY_ENTRY_EXCEPTION, &size));
 
-	if (!pFunc)
-		return {};
+	if (!entries)
+		return table;
+
+	table.Module = handle;
+	table.Entries = entries;
+	table.Count = size / sizeof(IMAGE_RUNTIME_FUNCTION_ENTRY);
+
+	return table;
+}
 
-	DWORD count = size / sizeof(IMAGE_RUNTIME_FUNCTION_ENTRY);
+// Entries of function fragments (e.g. split cold code) refer to the entry of the function they belong to.
+static constexpr uint8_t kUnwindFlagChainInfo = 0x4;
+static constexpr DWORD kRuntimeFunctionIndirect = 0x1;
+
+static const IMAGE_RUNTIME_FUNCTION_ENTRY *GetPrimaryFunctionEntry(HMODULE module, const IMAGE_RUNTIME_FUNCTION_ENTRY *entry)
+{
+	// Bounds malformed cycles.
+	for (int depth = 0; entry && depth < 32; ++depth)
+	{
+		if (entry->UnwindData & kRuntimeFunctionIndirect)
+		{
+			entry = reinterpret_cast<const IMAGE_RUNTIME_FUNCTION_ENTRY *>(PtrAdvance(module, entry->UnwindData & ~kRuntimeFunctionIndirect));
+			continue;
+		}
+
+		// UNWIND_INFO: version and flags, prolog size, count of codes, frame register; then the codes,
+		// padded to an even count, followed by the chained entry.
+		auto unwind = reinterpret_cast<const uint8_t *>(PtrAdvance(module, entry->UnwindData));
+
+		if (((unwind[0] >> 3) & kUnwindFlagChainInfo) == 0)
+			return entry;
+
+		size_t codes = (static_cast<size_t>(unwind[2]) + 1) & ~static_cast<size_t>(1);
+		entry = reinterpret_cast<const IMAGE_RUNTIME_FUNCTION_ENTRY *>(&unwind[4 + codes * sizeof(uint16_t)]);
+	}
+
+	return entry;
+}
+
+const IMAGE_RUNTIME_FUNCTION_ENTRY *FindFunctionEntry(const FunctionTable_t &table, const void *address, bool primary)
+{
+	if (!table.Entries || table.Count == 0)
+		return nullptr;
+
+	uintptr_t offset = reinterpret_cast<uintptr_t>(address) - reinterpret_cast<uintptr_t>(table.Module);
+
+	if (reinterpret_cast<uintptr_t>(address) < reinterpret_cast<uintptr_t>(table.Module) || offset > UINT32_MAX)
+		return nullptr;
+
+	DWORD rva = static_cast<DWORD>(offset);
+
+	// The entries are sorted by their start address; find the last one starting at or before `rva`.
+	size_t low = 0;
+	size_t high = table.Count;
+
+	while (low < high)
+	{
+		size_t middle = low + (high - low) / 2;
+
+		if (table.Entries[middle].BeginAddress <= rva)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	if (low == 0)
+		return nullptr;
+
+	const IMAGE_RUNTIME_FUNCTION_ENTRY *entry = &table.Entries[low - 1];
+
+	if (!entry->BeginAddress || rva >= entry->EndAddress)
+		return nullptr;
+
+	return primary ? GetPrimaryFunctionEntry(table.Module, entry) : entry;
+}
+
+Memoria::Vector<std::tuple<void *, void *>> GetFunctionEntries(HMODULE handle)
+{
+	FunctionTable_t table = GetFunctionTable(handle);
+
+	if (!table.Entries)
+		return {};
 
 	Memoria::Vector<std::tuple<void *, void *>> result{};
-	result.reserve(count);
+	result.reserve(table.Count);
 
-	for (size_t i = 0u; i < count; ++i)
+	for (size_t i = 0u; i < table.Count; ++i)
 	{
-		if (!pFunc[i].BeginAddress || !pFunc[i].EndAddress)
+		auto &entry = table.Entries[i];
+
+		if (!entry.BeginAddress || !entry.EndAddress)
 			continue;
 
-		void *addr_begin = PtrOffset(handle, pFunc[i].BeginAddress);
-		void *addr_end = PtrOffset(handle, pFunc[i].EndAddress);
+		void *addr_begin = PtrOffset(table.Module, entry.BeginAddress);
+		void *addr_end = PtrOffset(table.Module, entry.EndAddress);
 
 		result.emplace_back(addr_begin, addr_end);
 	}
@@ -277,45 +620,263 @@ void *GetFunctionBaseAddressFromItsCode(const void *address)
 	if (!hModule)
 		return nullptr;
 
-	uint32_t size;
-	PIMAGE_RUNTIME_FUNCTION_ENTRY pFunc = reinterpret_cast<PIMAGE_RUNTIME_FUNCTION_ENTRY>(
-		GetImageDirectoryData(hModule, TRUE, IMAGE_DIRECTORY_ENTRY_EXCEPTION, &size));
-
-	if (!pFunc)
+	auto entry = FindFunctionEntry(GetFunctionTable(hModule), address);
+	if (!entry)
 		return nullptr;
 
-	DWORD count = size / sizeof(IMAGE_RUNTIME_FUNCTION_ENTRY);
+	return PtrOffset(hModule, entry->BeginAddress);
+}
 
-	for (size_t i = 0u; i < count; ++i)
+//
+// Stack capture.
+//
+// With frame pointers, each frame starts with the caller's frame pointer followed by the return
+// address, so the stack is walked by following that chain, checked against the bounds of the
+// thread's stack. Otherwise (x64 code built without frame pointers), the stack is unwound by
+// `RtlCaptureStackBackTrace`, which uses the function tables.
+//
+
+#ifdef MEMORIA_USE_FRAME_POINTERS
+	#pragma optimize("y", off)
+#endif
+
+size_t CaptureStackTrace(void **frames, size_t max_frames, size_t skip)
+{
+	if (!frames || max_frames == 0)
+		return 0;
+
+	size_t count = 0;
+
+#ifdef MEMORIA_USE_FRAME_POINTERS
+	auto tib = reinterpret_cast<const NT_TIB *>(NtCurrentTeb());
+
+	uintptr_t stack_low = reinterpret_cast<uintptr_t>(tib->StackLimit);
+	uintptr_t stack_high = reinterpret_cast<uintptr_t>(tib->StackBase);
+
+	// The frame of this function; its return address is the first frame.
+	auto frame = reinterpret_cast<void **>(_AddressOfReturnAddress()) - 1;
+
+	// Counted down separately, the fallback below still needs the full count.
+	size_t remaining = skip;
+
+	while (count < max_frames)
 	{
-		if (!pFunc[i].BeginAddress || !pFunc[i].EndAddress)
-			continue;
+		uintptr_t current = reinterpret_cast<uintptr_t>(frame);
+
+		if (current < stack_low || current + 2 * sizeof(void *) > stack_high || (current & (sizeof(void *) - 1)) != 0)
+			break;
 
-		uintptr_t addr_begin = reinterpret_cast<uintptr_t>(hModule) + pFunc[i].BeginAddress;
-		uintptr_t addr_end = reinterpret_cast<uintptr_t>(hModule) + pFunc[i].EndAddress;
+		void *return_address = frame[1];
 
-		uintptr_t addr_needed = reinterpret_cast<uintptr_t>(address);
+		if (!return_address)
+			break;
 
-		if (IsInBounds(addr_needed, addr_begin, addr_end))
-			return reinterpret_cast<void *>(addr_begin);
+		if (remaining > 0)
+			--remaining;
+		else
+			frames[count++] = return_address;
+
+		// Frames are at increasing addresses; anything else ends the chain.
+		auto next = static_cast<void **>(frame[0]);
+
+		if (next <= frame)
+			break;
+
+		frame = next;
 	}
 
-	return nullptr;
+	if (count > 0)
+		return count;
+#endif
+
+	// Skip this function as well.
+	return RtlCaptureStackBackTrace(static_cast<DWORD>(skip + 1), static_cast<DWORD>(max_frames), frames, nullptr);
 }
 
+#ifdef MEMORIA_USE_FRAME_POINTERS
+	#pragma optimize("", on)
+#endif
+
 Memoria::FixedVector<void *, 128> GetStackBacktrace()
 {
 	Memoria::FixedVector<void *, 128> result{};
 
 	void *callers[128];
-	int count = RtlCaptureStackBackTrace(2, _countof(callers), callers, NULL);
-	
-	for (int i = 0; i < count; i++)
+	size_t count = CaptureStackTrace(callers, _countof(callers), 2);
+
+	for (size_t i = 0; i < count; i++)
 		result.push_back(callers[i]);
 
 	return result;
 }
 
+//
+// Trace store.
+//
+// Frames are kept in chunks that are never moved, so returned frame pointers stay valid. A trace
+// is found again by the hash of its frames; traces with the same hash are chained and told apart
+// by their frames.
+//
+
+static constexpr size_t kTraceChunkFrames = 16384;
+
+struct StackTraceRecord_t
+{
+	void **Frames;
+	uint32_t Count;
+
+	// Id of the next trace with the same hash, or 0.
+	uint32_t Next;
+};
+
+static SRWLOCK gTraceLock = SRWLOCK_INIT;
+
+static Memoria::Vector<StackTraceRecord_t> gTraces;
+static Memoria::HashMap<uint64_t, uint32_t> gTraceIndex;
+
+static Memoria::Vector<void **> gTraceChunks;
+static size_t gTraceChunkUsed = 0;
+
+static uint64_t HashStackTrace(void *const *frames, size_t count)
+{
+	uint64_t hash = 0xCBF29CE484222325ull ^ count;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		hash ^= static_cast<uint64_t>(reinterpret_cast<uintptr_t>(frames[i]));
+		hash *= 0x100000001B3ull;
+		hash ^= hash >> 29;
+	}
+
+	return hash;
+}
+
+// Must be called with the lock held; returns 0 if the trace is not stored.
+static uint32_t FindStackTrace(uint64_t hash, void *const *frames, size_t count)
+{
+	auto head = gTraceIndex.find(hash);
+
+	for (uint32_t id = head ? *head : 0; id != 0; id = gTraces[id - 1].Next)
+	{
+		const StackTraceRecord_t &record = gTraces[id - 1];
+
+		if (record.Count == count && MemEqual(record.Frames, frames, count * sizeof(void *)))
+			return id;
+	}
+
+	return 0;
+}
+
+// Must be called with the lock held exclusively.
+static void **AllocateTraceFrames(size_t count)
+{
+	if (gTraceChunks.empty() || gTraceChunkUsed + count > kTraceChunkFrames)
+	{
+		auto chunk = static_cast<void **>(VirtualAlloc(nullptr, kTraceChunkFrames * sizeof(void *), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+
+		if (!chunk)
+			return nullptr;
+
+		gTraceChunks.push_back(chunk);
+		gTraceChunkUsed = 0;
+	}
+
+	void **frames = &gTraceChunks.back()[gTraceChunkUsed];
+	gTraceChunkUsed += count;
+
+	return frames;
+}
+
+uint32_t InternStackTrace(void *const *frames, size_t count)
+{
+	if (!frames || count == 0 || count > MEMORIA_MAX_STACK_FRAMES)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return 0;
+	}
+
+	uint64_t hash = HashStackTrace(frames, count);
+
+	AcquireSRWLockShared(&gTraceLock);
+	uint32_t id = FindStackTrace(hash, frames, count);
+	ReleaseSRWLockShared(&gTraceLock);
+
+	if (id)
+		return id;
+
+	AcquireSRWLockExclusive(&gTraceLock);
+
+	// Another thread may have stored it in the meantime.
+	id = FindStackTrace(hash, frames, count);
+
+	if (!id)
+	{
+		if (void **copy = AllocateTraceFrames(count))
+		{
+			MemCopy(copy, frames, count * sizeof(void *));
+
+			auto head = gTraceIndex.find(hash);
+
+			gTraces.push_back({ copy, static_cast<uint32_t>(count), head ? *head : 0 });
+			id = static_cast<uint32_t>(gTraces.size());
+
+			// The new trace becomes the head of the chain.
+			if (head)
+				*head = id;
+			else
+				gTraceIndex.insert(hash, id);
+		}
+		else
+		{
+			SetError(ME_INVALID_MEMORY);
+		}
+	}
+
+	ReleaseSRWLockExclusive(&gTraceLock);
+
+	return id;
+}
+
+uint32_t CaptureStackTraceId(size_t skip)
+{
+	void *frames[MEMORIA_MAX_STACK_FRAMES];
+
+	// Skip this function as well.
+	size_t count = CaptureStackTrace(frames, _countof(frames), skip + 1);
+
+	return count ? InternStackTrace(frames, count) : 0;
+}
+
+void *const *GetStackTrace(uint32_t id, size_t *count)
+{
+	void *const *frames = nullptr;
+	size_t size = 0;
+
+	AcquireSRWLockShared(&gTraceLock);
+
+	if (id != 0 && id <= gTraces.size())
+	{
+		frames = gTraces[id - 1].Frames;
+		size = gTraces[id - 1].Count;
+	}
+
+	ReleaseSRWLockShared(&gTraceLock);
+
+	if (count)
+		*count = size;
+
+	return frames;
+}
+
+size_t GetStackTraceCount()
+{
+	AcquireSRWLockShared(&gTraceLock);
+	size_t count = gTraces.size();
+	ReleaseSRWLockShared(&gTraceLock);
+
+	return count;
+}
+
 //Memoria::Vector<std::string> GetBeautyStackBacktrace()
 //{
 //	Memoria::Vector<std::string> result{};
@@ -0,0 +1,88 @@
+#include "memoria_core_hash.hpp"
+
+#include <intrin.h>
+#include <nmmintrin.h>
+
+MEMORIA_BEGIN
+
+// Reflected Castagnoli polynomial.
+static constexpr uint32_t kCRC32CPolynomial = 0x82F63B78;
+
+struct CRC32CTable_t
+{
+	uint32_t Values[256];
+
+	constexpr CRC32CTable_t() : Values()
+	{
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			uint32_t value = i;
+
+			for (int bit = 0; bit < 8; ++bit)
+				value = (value >> 1) ^ ((value & 1) ? kCRC32CPolynomial : 0);
+
+			Values[i] = value;
+		}
+	}
+};
+
+static constexpr CRC32CTable_t gCRC32CTable;
+
+static uint32_t CRC32CSoftware(const uint8_t *data, size_t size, uint32_t crc)
+{
+	for (size_t i = 0; i < size; ++i)
+		crc = gCRC32CTable.Values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+	return crc;
+}
+
+static uint32_t CRC32CHardware(const uint8_t *data, size_t size, uint32_t crc)
+{
+	for (; size != 0 && (reinterpret_cast<uintptr_t>(data) & 7) != 0; --size)
+		crc = _mm_crc32_u8(crc, *data++);
+
+#ifdef MEMORIA_64BIT
+	uint64_t crc64 = crc;
+
+	for (; size >= 8; size -= 8, data += 8)
+		crc64 = _mm_crc32_u64(crc64, *reinterpret_cast<const uint64_t *>(data));
+
+	crc = static_cast<uint32_t>(crc64);
+#else
+	for (; size >= 4; size -= 4, data += 4)
+		crc = _mm_crc32_u32(crc, *reinterpret_cast<const uint32_t *>(data));
+#endif
+
+	for (; size != 0; --size)
+		crc = _mm_crc32_u8(crc, *data++);
+
+	return crc;
+}
+
+static bool HasSSE42()
+{
+	// 0 - unknown, 1 - unsupported, 2 - supported.
+	static volatile int supported = 0;
+
+	if (supported == 0)
+	{
+		int info[4];
+		__cpuid(info, 1);
+
+		supported = (info[2] & (1 << 20)) ? 2 : 1;
+	}
+
+	return supported == 2;
+}
+
+uint32_t CRC32C(const void *data, size_t size, uint32_t crc)
+{
+	auto bytes = static_cast<const uint8_t *>(data);
+
+	crc = ~crc;
+	crc = HasSSE42() ? CRC32CHardware(bytes, size, crc) : CRC32CSoftware(bytes, size, crc);
+
+	return ~crc;
+}
+
+MEMORIA_END
\ No newline at end of file
@@ -6,14 +6,37 @@
 
 #include "memoria_core_write.hpp"
 #include "memoria_core_misc.hpp"
+#include "memoria_core_mempool.hpp"
+#include "memoria_core_errors.hpp"
+#include "memoria_core_options.hpp"
+
+#include "memoria_ext_logger.hpp"
 
 #include "hde32.h"
 #include "hde64.h"
 
 #include "memoria_utils_list.hpp"
+#include "memoria_utils_hashmap.hpp"
 
 MEMORIA_BEGIN
 
+// In hot-patch mode code is published atomically, as other threads may be executing it.
+static bool CommitCode(CWriteBuffer &buf, void *addr_target)
+{
+	if (IsHotPatchModeActive())
+		return WriteCodeAtomic(addr_target, buf.GetData(), buf.GetSize());
+
+	return buf.Clone(addr_target, true);
+}
+
+static bool RestoreCode(void *addr_target, const void *data, size_t size)
+{
+	if (IsHotPatchModeActive())
+		return WriteCodeAtomic(addr_target, data, size);
+
+	return WriteMemory(addr_target, data, size);
+}
+
 static size_t WriteJumpRel32(void *addr_target, const void *addr_value)
 {
 	CIndependentBuffer64 buf;
@@ -21,7 +44,7 @@ static size_t WriteJumpRel32(void *addr_target, const void *addr_value)
 	buf.WriteU8(0xE9);                          // JMP rel32
 	buf.WriteRelative(addr_target, addr_value, 1); // rel32
 
-	if (addr_value && !buf.Clone(addr_target, true))
+	if (addr_value && !CommitCode(buf, addr_target))
 		return 0;
 
 	return buf.GetSize();
@@ -34,7 +57,7 @@ static size_t WriteCallRel32(void *addr_target, const void *addr_value)
 	buf.WriteU8(0xE8);                          // CALL rel32
 	buf.WriteRelative(addr_target, addr_value, 1); // rel32
 
-	if (addr_value && !buf.Clone(addr_target, true))
+	if (addr_value && !CommitCode(buf, addr_target))
 		return 0;
 
 	return buf.GetSize();
@@ -48,7 +71,7 @@ static size_t WritePushRet32(void *addr_target, const void *addr_value)
 	buf.WritePointer(addr_value); // imm32
 	buf.WriteU8(0xC3);            // RET
 
-	if (addr_value && !buf.Clone(addr_target, true))
+	if (addr_value && !CommitCode(buf, addr_target))
 		return 0;
 
 	return buf.GetSize();
@@ -62,7 +85,7 @@ static size_t WriteJumpAbs32(void *addr_target, const void *addr_value)
 	buf.WritePointer(addr_value); // imm32
 	buf.WriteU16(0xE0FF);         // JMP EAX
 
-	if (addr_value && !buf.Clone(addr_target, true))
+	if (addr_value && !CommitCode(buf, addr_target))
 		return 0;
 
 	return buf.GetSize();
@@ -84,7 +107,7 @@ static size_t WriteJumpRel64(void *addr_target, const void *addr_value)
 	buf.WriteU8(0xE9);                          // JMP
 	buf.WriteRelative(addr_target, addr_value, 1); // rel32
 
-	if (addr_value && !buf.Clone(addr_target, true))
+	if (addr_value && !CommitCode(buf, addr_target))
 		return 0;
 
 	return buf.GetSize();
@@ -100,7 +123,7 @@ static size_t WriteCallRel64(void *addr_target, const void *addr_value)
 	buf.WriteU8(0xE8);                          // CALL
 	buf.WriteRelative(addr_target, addr_value, 1); // rel32
 
-	if (addr_value && !buf.Clone(addr_target, true))
+	if (addr_value && !CommitCode(buf, addr_target))
 		return 0;
 
 	return buf.GetSize();
@@ -116,7 +139,7 @@ static size_t WritePushRet64(void *addr_target, const void *addr_value)
 	buf.WriteU8(0x50);            // PUSH RAX
 	buf.WriteU8(0xC3);            // RET
 
-	if (addr_value && !buf.Clone(addr_target, true))
+	if (addr_value && !CommitCode(buf, addr_target))
 		return 0;
 
 	return buf.GetSize();
@@ -131,7 +154,7 @@ static size_t WriteJumpAbs64(void *addr_target, const void *addr_value)
 	buf.WritePointer(addr_value); // IMM64
 	buf.WriteU16(0xE0FF);         // JMP RAX
 
-	if (addr_value && !buf.Clone(addr_target, true))
+	if (addr_value && !CommitCode(buf, addr_target))
 		return 0;
 
 	return buf.GetSize();
@@ -145,7 +168,7 @@ static size_t WriteJumpMem64(void *addr_target, const void *addr_value)
 	buf.WriteU32(0);              // 0
 	buf.WritePointer(addr_value); // DQ IMM64
 
-	if (addr_value && !buf.Clone(addr_target, true))
+	if (addr_value && !CommitCode(buf, addr_target))
 		return 0;
 
 	return buf.GetSize();
@@ -319,17 +342,27 @@ CTrampoline::CTrampoline(CHookMgr *manager, void *target, const void *hook, bool
 	std::memset(_backup, 0x90, sizeof(_backup));
 #endif
 
-	CWriteBuffer buf(GetJmpHook(), 5);
-	buf.WriteU8(0xE9);
-	buf.WriteRelative(_hook, GetJmpHook());
+	// The object lives in the writable view of the code arena, while relative
+	// operands are computed against the executable view.
+	CWriteBuffer buf(_backup, sizeof(_backup), GetJmpHook());
+
+	buf.WriteU8(0xE9);                      // JMP rel32
+	buf.WriteRelative(buf.GetAddress() - 1, _hook, 1);
 
-	MemCopy(GetOriginal(), target, size);
+	buf.WriteData(target, size);
 
-	auto _backup_new = PtrOffset(GetOriginal(), size);
-	auto _target_new = PtrOffset(target, size);
+	buf.WriteU8(0xE9);                      // JMP rel32
+	buf.WriteRelative(buf.GetAddress() - 1, PtrAdvance(target, size), 1);
+}
 
-	// funny ternary stuff
-	((_x64) ? (WriteHook64) : (WriteHook32))(_backup_new, _target_new, eInvokeMethod::JumpRel);
+void *CTrampoline::GetJmpHook()
+{
+	return _manager->ToExecutable(&_backup[0]);
+}
+
+void *CTrampoline::GetOriginal()
+{
+	return _manager->ToExecutable(&_backup[5]);
 }
 
 CTrampoline::~CTrampoline()
@@ -356,12 +389,50 @@ bool CTrampoline::Unhook()
 	if (!IsActive())
 		return false;
 
-	return WriteMemory(_pointer, _backup, _size);
+	return RestoreCode(_pointer, GetOriginal(), _size);
+}
+
+CHookCounters::CHookCounters(const void *target, const void *hook, void *allocation)
+	: _target(target)
+	, _hook(hook)
+	, _allocation(allocation)
+{
+	Reset();
+}
+
+uint64_t CHookCounters::GetCalls() const
+{
+	uint64_t result = 0;
+
+	for (auto &shard : _shards)
+		result += shard.Calls;
+
+	return result;
+}
+
+uint64_t CHookCounters::GetCycles() const
+{
+	uint64_t result = 0;
+
+	for (auto &shard : _shards)
+		result += shard.Cycles;
+
+	return result;
+}
+
+void CHookCounters::Reset()
+{
+	for (auto &shard : _shards)
+	{
+		_InterlockedExchange64(&shard.Calls, 0);
+		_InterlockedExchange64(&shard.Cycles, 0);
+	}
 }
 
 CHookMgr::~CHookMgr()
 {
-	Free(_data);
+	for (auto counters : _counters)
+		Free(counters->_allocation);
 }
 
 CHookMgr::CHookMgr(const void *addr_nearest, size_t max_hooks)
@@ -369,22 +440,56 @@ CHookMgr::CHookMgr(const void *addr_nearest, size_t max_hooks)
 	_max_hooks = max_hooks;
 	_hooks = 0;
 
-	_data = AllocFar(addr_nearest, _max_hooks * sizeof(CTrampoline), true, true, true);
+	_code.Create(addr_nearest, _max_hooks * sizeof(CTrampoline));
 }
 
-CTrampoline *CHookMgr::Allocate(void *target, const void *hook, bool is_x64, eInvokeMethod method)
+void *CHookMgr::AllocateCode(size_t size)
 {
-	if (_hooks >= _max_hooks)
+	if (!_code.IsValid())
 		return nullptr;
 
-	if (_data == nullptr)
+	// Code is allocated in slots of the trampoline size, so the slab stays a plain array.
+	size_t slots = (size + sizeof(CTrampoline) - 1) / sizeof(CTrampoline);
+
+	for (size_t i = 0; i < _free_code.size(); ++i)
+	{
+		if (_free_code[i].Slots != slots)
+			continue;
+
+		void *result = PtrAdvance(_code.GetWritable(), sizeof(CTrampoline) * _free_code[i].First);
+
+		_free_code[i] = _free_code.back();
+		_free_code.pop_back();
+
+		return result;
+	}
+
+	if (_hooks + slots > _max_hooks)
 		return nullptr;
 
-	uintptr_t base = reinterpret_cast<uintptr_t>(_data);
-	size_t offset = sizeof(CTrampoline) * _hooks;
+	void *result = PtrAdvance(_code.GetWritable(), sizeof(CTrampoline) * _hooks);
+	_hooks += slots;
+
+	return result;
+}
+
+void CHookMgr::FreeCode(void *code, size_t size)
+{
+	size_t first = (static_cast<uint8_t *>(code) - static_cast<uint8_t *>(_code.GetWritable())) / sizeof(CTrampoline);
+	size_t slots = (size + sizeof(CTrampoline) - 1) / sizeof(CTrampoline);
+
+	if (first + slots == _hooks)
+		_hooks = first;
+	else
+		_free_code.push_back({ first, slots });
+}
 
-	CTrampoline *result = reinterpret_cast<CTrampoline *>(base + offset);
-	++_hooks;
+CTrampoline *CHookMgr::Allocate(void *target, const void *hook, bool is_x64, eInvokeMethod method)
+{
+	CTrampoline *result = reinterpret_cast<CTrampoline *>(AllocateCode(sizeof(CTrampoline)));
+
+	if (result == nullptr)
+		return nullptr;
 
 	size_t size;
 
@@ -400,14 +505,636 @@ CTrampoline *CHookMgr::Allocate(void *target, const void *hook, bool is_x64, eIn
 	}
 
 	std::construct_at(result, this, target, hook, is_x64, static_cast<uint8_t>(size), method);
+	_code.Flush(result->GetJmpHook(), sizeof(CTrampoline) - sizeof(CTrampolineBase));
+
+	return result;
+}
+
+static size_t WriteCounterStub64(CWriteBuffer &buf, CHookCounterShard *shards, const void *hook)
+{
+	buf.WriteU8(0x65);                      // MOV RAX, GS:[0x48]
+	buf.WriteU32(0x25048B48);
+	buf.WriteU32(0x48);
+	buf.WriteU8(0xC1);                      // SHR EAX, 2
+	buf.WriteU16(0x02E8);
+	buf.WriteU8(0x83);                      // AND EAX, SHARDS - 1
+	buf.WriteU8(0xE0);
+	buf.WriteU8(MEMORIA_HOOK_STATS_SHARDS - 1);
+	buf.WriteU8(0xC1);                      // SHL EAX, 6
+	buf.WriteU16(0x06E0);
+	buf.WriteU16(0xBA49);                   // MOV R10, IMM64
+	buf.WritePointer(shards);               // IMM64
+	buf.WriteU32(0x04FF49F0);               // LOCK INC QWORD PTR [R10+RAX]
+	buf.WriteU8(0x02);
+	buf.WriteU16(0x25FF);                   // JMP [RIP+0]
+	buf.WriteU32(0);                        // 0
+	buf.WritePointer(hook);                 // DQ IMM64
+
+	return buf.GetSize();
+}
+
+static size_t WriteCounterStub32(CWriteBuffer &buf, CHookCounterShard *shards, const void *hook)
+{
+	auto calls_lo = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&shards->Calls));
+
+	buf.WriteU16(0xA164);                   // MOV EAX, FS:[0x24]
+	buf.WriteU32(0x24);
+	buf.WriteU8(0xC1);                      // SHR EAX, 2
+	buf.WriteU16(0x02E8);
+	buf.WriteU8(0x83);                      // AND EAX, SHARDS - 1
+	buf.WriteU8(0xE0);
+	buf.WriteU8(MEMORIA_HOOK_STATS_SHARDS - 1);
+	buf.WriteU8(0xC1);                      // SHL EAX, 6
+	buf.WriteU16(0x06E0);
+	buf.WriteU8(0xF0);                      // LOCK ADD DWORD PTR [EAX+calls_lo], 1
+	buf.WriteU16(0x8083);
+	buf.WriteU32(calls_lo);
+	buf.WriteU8(0x01);
+	buf.WriteU16(0x0773);                   // JNC +7
+	buf.WriteU8(0xF0);                      // LOCK INC DWORD PTR [EAX+calls_hi]
+	buf.WriteU16(0x80FF);
+	buf.WriteU32(calls_lo + 4);
+	buf.WriteU8(0xE9);                      // JMP rel32
+	buf.WriteRelative(buf.GetAddress() - 1, hook, 1);
+
+	return buf.GetSize();
+}
+
+//
+// Instruction relocation for displaced code. Relative branches are re-encoded against their
+// new location (switching to absolute forms when the target is out of rel32 range on x64),
+// and RIP-relative operands are re-based. Branches into the displaced range itself and
+// LOOP/JECXZ-style instructions cannot be relocated and make the whole operation fail.
+//
+
+static void WriteJump(CWriteBuffer &buf, const void *addr_value, bool is_x64)
+{
+	void *ip = buf.GetAddress();
+
+	if (is_x64 && !IsIn32BitRange(ip, addr_value, -5))
+	{
+		buf.WriteU16(0x25FF);         // JMP [RIP+0]
+		buf.WriteU32(0);              // 0
+		buf.WritePointer(addr_value); // DQ IMM64
+		return;
+	}
+
+	buf.WriteU8(0xE9);                     // JMP rel32
+	buf.WriteRelative(ip, addr_value, 1);  // rel32
+}
+
+static void WriteCall(CWriteBuffer &buf, const void *addr_value, bool is_x64)
+{
+	void *ip = buf.GetAddress();
+
+	if (is_x64 && !IsIn32BitRange(ip, addr_value, -5))
+	{
+		buf.WriteU16(0x15FF);         // CALL [RIP+2]
+		buf.WriteU32(2);              // 2
+		buf.WriteU16(0x08EB);         // JMP +8
+		buf.WritePointer(addr_value); // DQ IMM64
+		return;
+	}
+
+	buf.WriteU8(0xE8);                     // CALL rel32
+	buf.WriteRelative(ip, addr_value, 1);  // rel32
+}
+
+static void WriteJcc(CWriteBuffer &buf, uint8_t condition, const void *addr_value, bool is_x64)
+{
+	void *ip = buf.GetAddress();
+
+	if (is_x64 && !IsIn32BitRange(ip, addr_value, -6))
+	{
+		buf.WriteU8(0x70 | (condition ^ 1)); // J!cc over the absolute jump
+		buf.WriteU8(14);
+		buf.WriteU16(0x25FF);                // JMP [RIP+0]
+		buf.WriteU32(0);                     // 0
+		buf.WritePointer(addr_value);        // DQ IMM64
+		return;
+	}
+
+	buf.WriteU8(0x0F);                     // Jcc rel32
+	buf.WriteU8(0x80 | condition);
+	buf.WriteRelative(ip, addr_value, 2);  // rel32
+}
+
+static bool RelocateInstructions(CWriteBuffer &buf, const void *src, size_t size, bool is_x64)
+{
+	auto begin = reinterpret_cast<const uint8_t *>(src);
+	size_t offset = 0;
+
+	while (offset < size)
+	{
+		const uint8_t *ip = begin + offset;
+
+		size_t len;
+		uint8_t opcode;
+		uint8_t opcode2;
+		size_t imm_size;
+		bool relative;
+		bool rip_relative;
+
+		if (is_x64)
+		{
+			hde64s hs;
+			len = hde64_disasm(ip, &hs);
+
+			if (hs.flags & F64_ERROR)
+				return false;
+
+			opcode = hs.opcode;
+			opcode2 = hs.opcode2;
+			relative = (hs.flags & F64_RELATIVE) != 0;
+			rip_relative = (hs.flags & F64_MODRM) && hs.modrm_mod == 0 && hs.modrm_rm == 5;
+
+			imm_size = 0;
+			if (hs.flags & F64_IMM8) imm_size += 1;
+			if (hs.flags & F64_IMM16) imm_size += 2;
+			if (hs.flags & F64_IMM32) imm_size += 4;
+			if (hs.flags & F64_IMM64) imm_size += 8;
+		}
+		else
+		{
+			hde32s hs;
+			len = hde32_disasm(ip, &hs);
+
+			if (hs.flags & F32_ERROR)
+				return false;
+
+			opcode = hs.opcode;
+			opcode2 = hs.opcode2;
+			relative = (hs.flags & F32_RELATIVE) != 0;
+			rip_relative = false;
+
+			imm_size = 0;
+			if (hs.flags & F32_IMM8) imm_size += 1;
+			if (hs.flags & F32_IMM16) imm_size += 2;
+			if (hs.flags & F32_IMM32) imm_size += 4;
+		}
+
+		if (relative)
+		{
+			ptrdiff_t rel = (imm_size == 1)
+				? static_cast<int8_t>(ip[len - 1])
+				: *reinterpret_cast<const int32_t *>(&ip[len - 4]);
+
+			const uint8_t *branch = ip + len + rel;
+
+			if (branch >= begin && branch < begin + size)
+				return false;
+
+			if (opcode == 0xE8)
+				WriteCall(buf, branch, is_x64);
+			else if (opcode == 0xE9 || opcode == 0xEB)
+				WriteJump(buf, branch, is_x64);
+			else if ((opcode & 0xF0) == 0x70)
+				WriteJcc(buf, opcode & 0x0F, branch, is_x64);
+			else if (opcode == 0x0F && (opcode2 & 0xF0) == 0x80)
+				WriteJcc(buf, opcode2 & 0x0F, branch, is_x64);
+			else
+				return false;
+		}
+		else if (rip_relative)
+		{
+			size_t disp_offset = len - imm_size - sizeof(int32_t);
+			const uint8_t *data = ip + len + *reinterpret_cast<const int32_t *>(&ip[disp_offset]);
+
+			uint8_t *dest = buf.GetPointer();
+			uint8_t *dest_ip = buf.GetAddress();
+
+			if (buf.GetOffset() + len > buf.GetCapacity() || !IsIn32BitRange(dest_ip + len, data))
+				return false;
+
+			buf.WriteData(ip, len);
+
+			*reinterpret_cast<int32_t *>(&dest[disp_offset]) = static_cast<int32_t>(data - (dest_ip + len));
+		}
+		else
+		{
+			buf.WriteData(ip, len);
+		}
+
+		offset += len;
+	}
+
+	return true;
+}
+
+//
+// Mid-function hook stub:
+//
+// <return address>            ; x64 only, see below
+// PUSHF                       ; Flags field of the context
+// LEA  xSP, [xSP - regs]      ; rest of the context, LEA keeps the flags intact
+// MOV  [xSP + i], reg         ; every register from the mask and every volatile one
+// MOV  xBX, xSP               ; xBX = context, preserved by the callback
+// AND  xSP, -16
+// SUB  xSP, frame             ; shadow space/argument and volatile XMM registers
+// MOVAPS [xSP + ...], xmm
+// CALL callback
+// MOVAPS xmm, [xSP + ...]
+// MOV  xSP, xBX
+// MOV  reg, [xSP + i]         ; xBX last
+// LEA  xSP, [xSP + regs]
+// POPF
+// <drop return address>       ; x64 only
+// <relocated instructions>
+// JMP  target + size
+//
+// On x64 the stub is described to the unwinder, so exceptions and stack walks from the
+// callback reach the hooked function. The stub first stores the target address below the
+// stack pointer, which makes it look like a function called from the hook location. From
+// PUSHF to POPF it is covered by unwind info that uses xBX as frame register. The relocated
+// instructions run on the stack of the target and, like those of trampolines, are not covered.
+//
+
+static constexpr size_t kMidHookStubSize = 512 - sizeof(CMidHook);
+
+#ifdef MEMORIA_64BIT
+static constexpr uint32_t kMidHookRegisters = 16;
+static constexpr uint32_t kMidHookVolatileMask = MHR_AX | MHR_CX | MHR_DX | MHR_R8 | MHR_R9 | MHR_R10 | MHR_R11;
+static constexpr uint32_t kMidHookVolatileXmm = 6;
+#else
+static constexpr uint32_t kMidHookRegisters = 8;
+static constexpr uint32_t kMidHookVolatileMask = MHR_AX | MHR_CX | MHR_DX;
+static constexpr uint32_t kMidHookVolatileXmm = 8;
+#endif
+
+// Offsets in the stub, for its unwind info.
+struct MidHookLayout_t
+{
+	// Where the unwind info and the function table entry were placed.
+	size_t UnwindInfo;
+	size_t FunctionTable;
+
+	// Range covered by the unwind info.
+	size_t Begin;
+	size_t End;
+
+	// End of each prologue instruction described by an unwind code, relative to `Begin`.
+	size_t Pushf;
+	size_t Allocate;
+	size_t SaveBx;
+	size_t SetFrame;
+};
+
+#ifdef MEMORIA_64BIT
+#define MEMORIA_UWOP_ALLOC_SMALL 2
+#define MEMORIA_UWOP_SET_FPREG 3
+#define MEMORIA_UWOP_SAVE_NONVOL 4
+
+// Writes `UNWIND_INFO` and `RUNTIME_FUNCTION` for the stub, relative to `base`.
+static void WriteMidHookUnwindInfo(CWriteBuffer &buf, const void *base, MidHookLayout_t &layout)
+{
+	// Both must be 4-byte aligned.
+	while (reinterpret_cast<uintptr_t>(buf.GetAddress()) & 3)
+		buf.WriteU8(0xCC);
+
+	constexpr uint32_t regs_size = kMidHookRegisters * sizeof(uintptr_t);
+
+	layout.UnwindInfo = buf.GetSize();
+
+	buf.WriteU8(1);                                       // Version 1, no handler
+	buf.WriteU8(static_cast<uint8_t>(layout.SetFrame));   // SizeOfProlog
+	buf.WriteU8(5);                                       // CountOfCodes
+	buf.WriteU8(3);                                       // Frame register xBX, offset 0
+
+	// In reverse order of the prologue.
+	buf.WriteU8(static_cast<uint8_t>(layout.SetFrame));
+	buf.WriteU8(MEMORIA_UWOP_SET_FPREG);
+
+	buf.WriteU8(static_cast<uint8_t>(layout.SaveBx));
+	buf.WriteU8(MEMORIA_UWOP_SAVE_NONVOL | (3 << 4));     // xBX, at its context slot
+	buf.WriteU16(3);
+
+	buf.WriteU8(static_cast<uint8_t>(layout.Allocate));
+	buf.WriteU8(MEMORIA_UWOP_ALLOC_SMALL | (((regs_size - 8) / 8) << 4));
+
+	buf.WriteU8(static_cast<uint8_t>(layout.Pushf));
+	buf.WriteU8(MEMORIA_UWOP_ALLOC_SMALL);                // 8 bytes
+
+	buf.WriteU16(0);                                      // The code array has an even length
+
+	uint32_t stub_rva = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(buf.GetAddress()) - buf.GetSize() - reinterpret_cast<uintptr_t>(base));
+
+	layout.FunctionTable = buf.GetSize();
+
+	buf.WriteU32(stub_rva + static_cast<uint32_t>(layout.Begin));
+	buf.WriteU32(stub_rva + static_cast<uint32_t>(layout.End));
+	buf.WriteU32(stub_rva + static_cast<uint32_t>(layout.UnwindInfo));
+}
+#endif
+
+// Moves `reg` to or from the context slot `slot`, which is the register's own slot by default.
+static void WriteContextMove(CWriteBuffer &buf, uint8_t opcode, uint32_t reg, uint32_t slot = UINT32_MAX)
+{
+	if (slot == UINT32_MAX)
+		slot = reg;
+
+#ifdef MEMORIA_64BIT
+	buf.WriteU8(reg >= 8 ? 0x4C : 0x48);                  // REX.W (+ REX.R)
+#endif
+	buf.WriteU8(opcode);                                  // MOV [xSP + disp8], reg / MOV reg, [xSP + disp8]
+	buf.WriteU8(0x44 | ((reg & 7) << 3));
+	buf.WriteU8(0x24);
+	buf.WriteU8(static_cast<uint8_t>(slot * sizeof(uintptr_t)));
+}
+
+static bool WriteMidHookStub(CWriteBuffer &buf, void *target, size_t size, MidHookCallback_t callback, uint32_t mask, const void *base, MidHookLayout_t &layout)
+{
+	constexpr uint32_t regs_size = kMidHookRegisters * sizeof(uintptr_t);
+	constexpr uint32_t xmm_offset = IsX64() ? 32 : 16;
+	constexpr uint32_t frame_size = xmm_offset + kMidHookVolatileXmm * 16;
+
+	// Bytes between the context and the stack pointer of the target.
+	constexpr uint32_t context_size = regs_size + sizeof(uintptr_t) + (IsX64() ? sizeof(uintptr_t) : 0);
+
+	// xBX holds the context pointer across the callback.
+	uint32_t saved = (mask | kMidHookVolatileMask | MHR_BX) & ~MHR_SP;
+
+#ifdef MEMORIA_64BIT
+	// Neither LEA nor MOV change the flags.
+	buf.WriteU32(0x24648D48);                             // LEA RSP, [RSP - 8]
+	buf.WriteU8(0xF8);
+	buf.WriteU16(0x04C7);                                 // MOV DWORD PTR [RSP], IMM32
+	buf.WriteU8(0x24);
+	buf.WriteU32(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(target)));
+	buf.WriteU32(0x042444C7);                             // MOV DWORD PTR [RSP + 4], IMM32
+	buf.WriteU32(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(target) >> 32));
+#endif
+
+	layout.Begin = buf.GetSize();
+
+	buf.WriteU8(0x9C);                                    // PUSHF
+
+	layout.Pushf = buf.GetSize() - layout.Begin;
+
+#ifdef MEMORIA_64BIT
+	buf.WriteU32(0x24A48D48);                             // LEA RSP, [RSP - regs_size]
+#else
+	buf.WriteU16(0xA48D);                                 // LEA ESP, [ESP - regs_size]
+	buf.WriteU8(0x24);
+#endif
+	buf.WriteI32(-static_cast<int32_t>(regs_size));
+
+	layout.Allocate = buf.GetSize() - layout.Begin;
+
+	for (uint32_t reg = 0; reg < kMidHookRegisters; ++reg)
+	{
+		if (saved & (1 << reg))
+			WriteContextMove(buf, 0x89, reg);
+
+		if (reg == 3 /* xBX */)
+			layout.SaveBx = buf.GetSize() - layout.Begin;
+	}
+
+	if (mask & MHR_SP)
+	{
+#ifdef MEMORIA_64BIT
+		buf.WriteU32(0x24848D48);                         // LEA RAX, [RSP + regs_size + flags]
+#else
+		buf.WriteU16(0x848D);                             // LEA EAX, [ESP + regs_size + flags]
+		buf.WriteU8(0x24);
+#endif
+		buf.WriteU32(context_size);
+
+		WriteContextMove(buf, 0x89, 0 /* xAX */, 4 /* xSP */);
+	}
+
+#ifdef MEMORIA_64BIT
+	buf.WriteU8(0x48);
+#endif
+	buf.WriteU16(0xE389);                                 // MOV xBX, xSP
+
+	layout.SetFrame = buf.GetSize() - layout.Begin;
+
+#ifdef MEMORIA_64BIT
+	buf.WriteU8(0x48);
+#endif
+	buf.WriteU16(0xE483);                                 // AND xSP, -16
+	buf.WriteU8(0xF0);
+
+#ifdef MEMORIA_64BIT
+	buf.WriteU8(0x48);
+#endif
+	buf.WriteU16(0xEC81);                                 // SUB xSP, frame_size
+	buf.WriteU32(frame_size);
+
+	for (uint32_t xmm = 0; xmm < kMidHookVolatileXmm; ++xmm)
+	{
+		buf.WriteU16(0x290F);                             // MOVAPS [xSP + disp32], xmm
+		buf.WriteU8(0x84 | (xmm << 3));
+		buf.WriteU8(0x24);
+		buf.WriteU32(xmm_offset + xmm * 16);
+	}
+
+#ifdef MEMORIA_64BIT
+	buf.WriteU8(0x48);
+	buf.WriteU16(0xD989);                                 // MOV RCX, RBX
+	buf.WriteU16(0xB848);                                 // MOV RAX, IMM64
+#else
+	buf.WriteU16(0x1C89);                                 // MOV [ESP], EBX
+	buf.WriteU8(0x24);
+	buf.WriteU8(0xB8);                                    // MOV EAX, IMM32
+#endif
+	buf.WritePointer(reinterpret_cast<const void *>(callback));
+	buf.WriteU16(0xD0FF);                                 // CALL xAX
+
+	for (uint32_t xmm = 0; xmm < kMidHookVolatileXmm; ++xmm)
+	{
+		buf.WriteU16(0x280F);                             // MOVAPS xmm, [xSP + disp32]
+		buf.WriteU8(0x84 | (xmm << 3));
+		buf.WriteU8(0x24);
+		buf.WriteU32(xmm_offset + xmm * 16);
+	}
+
+#ifdef MEMORIA_64BIT
+	buf.WriteU8(0x48);
+#endif
+	buf.WriteU16(0xDC89);                                 // MOV xSP, xBX
+
+	// xBX last, it is the frame register until then.
+	for (uint32_t reg = 0; reg < kMidHookRegisters; ++reg)
+	{
+		if ((saved & (1 << reg)) && reg != 3 /* xBX */)
+			WriteContextMove(buf, 0x8B, reg);
+	}
+
+	WriteContextMove(buf, 0x8B, 3 /* xBX */);
+
+#ifdef MEMORIA_64BIT
+	buf.WriteU32(0x24A48D48);                             // LEA RSP, [RSP + regs_size]
+#else
+	buf.WriteU16(0xA48D);                                 // LEA ESP, [ESP + regs_size]
+	buf.WriteU8(0x24);
+#endif
+	buf.WriteU32(regs_size);
+
+	buf.WriteU8(0x9D);                                    // POPF
+
+	layout.End = buf.GetSize();
+
+#ifdef MEMORIA_64BIT
+	buf.WriteU32(0x24648D48);                             // LEA RSP, [RSP + 8]
+	buf.WriteU8(0x08);
+#endif
+
+	if (!RelocateInstructions(buf, target, size, IsX64()))
+		return false;
+
+	WriteJump(buf, PtrAdvance(target, size), IsX64());
+
+#ifdef MEMORIA_64BIT
+	WriteMidHookUnwindInfo(buf, base, layout);
+#endif
+
+	// Running out of space makes `CWriteBuffer` silently drop the tail.
+	return buf.GetSize() + 16 <= buf.GetCapacity();
+}
+
+CMidHook::CMidHook(CHookMgr *manager, void *target, MidHookCallback_t callback, uint32_t mask, uint8_t size)
+	: _manager(manager)
+	, _target(target)
+	, _callback(callback)
+	, _mask(mask)
+	, _size(size)
+#ifdef MEMORIA_64BIT
+	, _function_table(nullptr)
+#endif
+{
+	MemCopy(_original, target, size);
+}
+
+bool CMidHook::IsActive()
+{
+	return MemCompare(_target, _original, _size) != 0;
+}
+
+bool CMidHook::Hook()
+{
+	if (IsActive())
+		return false;
+
+	return (IsX64() ? WriteHook64 : WriteHook32)(_target, _manager->ToExecutable(GetStub()), eInvokeMethod::JumpRel);
+}
+
+bool CMidHook::Unhook()
+{
+	if (!IsActive())
+		return false;
+
+	return RestoreCode(_target, _original, _size);
+}
+
+CMidHook *CHookMgr::AllocateMidHook(void *target, MidHookCallback_t callback, uint32_t mask)
+{
+	size_t size = IsX64()
+		? CalculateInstructionBoundary64(target, CalculateHookSize64(target, eInvokeMethod::JumpRel))
+		: CalculateInstructionBoundary32(target, CalculateHookSize32(target, eInvokeMethod::JumpRel));
+
+	if (size > sizeof(CMidHook::_original))
+		return nullptr;
+
+	auto result = reinterpret_cast<CMidHook *>(AllocateCode(sizeof(CMidHook) + kMidHookStubSize));
+
+	if (result == nullptr)
+		return nullptr;
+
+	std::construct_at(result, this, target, callback, mask, static_cast<uint8_t>(size));
+
+	void *stub = ToExecutable(result->GetStub());
+	CWriteBuffer buf(result->GetStub(), kMidHookStubSize, stub);
+
+	MidHookLayout_t layout = {};
+
+	if (!WriteMidHookStub(buf, target, size, callback, mask, _code.GetExecutable(), layout))
+	{
+		FreeCode(result, sizeof(CMidHook) + kMidHookStubSize);
+		return nullptr;
+	}
+
+	_code.Flush(stub, buf.GetSize());
+
+#ifdef MEMORIA_64BIT
+	auto table = static_cast<RUNTIME_FUNCTION *>(PtrAdvance(stub, layout.FunctionTable));
+
+	if (!RtlAddFunctionTable(table, 1, reinterpret_cast<DWORD64>(_code.GetExecutable())))
+	{
+		FreeCode(result, sizeof(CMidHook) + kMidHookStubSize);
+		return nullptr;
+	}
+
+	result->_function_table = table;
+#endif
+
+	return result;
+}
+
+void CHookMgr::FreeMidHook(CMidHook *hook)
+{
+#ifdef MEMORIA_64BIT
+	if (hook->_function_table)
+		RtlDeleteFunctionTable(hook->_function_table);
+#endif
+
+	FreeCode(hook, sizeof(CMidHook) + kMidHookStubSize);
+}
+
+CTrampoline *CHookMgr::AllocateInstrumented(void *target, const void *hook, bool is_x64, eInvokeMethod method, CHookCounters **counters)
+{
+	void *stub = AllocateCode(64);
+
+	if (stub == nullptr)
+		return nullptr;
+
+	void *allocation = New(sizeof(CHookCounters) + alignof(CHookCounters));
+
+	if (allocation == nullptr)
+	{
+		FreeCode(stub, 64);
+		return nullptr;
+	}
+
+	auto result_counters = reinterpret_cast<CHookCounters *>(Align(allocation, alignof(CHookCounters)));
+	std::construct_at(result_counters, target, hook, allocation);
+
+	void *stub_code = ToExecutable(stub);
+	CWriteBuffer buf(stub, 64, stub_code);
+
+	if (is_x64)
+		WriteCounterStub64(buf, result_counters->_shards, hook);
+	else
+		WriteCounterStub32(buf, result_counters->_shards, hook);
+
+	_code.Flush(stub_code, buf.GetSize());
+
+	CTrampoline *result = Allocate(target, stub_code, is_x64, method);
+
+	if (result == nullptr)
+	{
+		Free(allocation);
+		FreeCode(stub, 64);
+		return nullptr;
+	}
+
+	_counters.push_back(result_counters);
+
+	if (counters)
+		*counters = result_counters;
+
 	return result;
 }
 
 bool CHookMgr::IsNear(const void *addr) const
 {
-	return IsIn32BitRange(_data, addr);
+	return IsIn32BitRange(_code.GetExecutable(), addr);
 }
 
+// Guards the manager list and the counters of every manager: shared for statistics
+// snapshots, exclusive while managers and trampolines are allocated.
+static SRWLOCK gTrampolineMgrLock = SRWLOCK_INIT;
+
 static Memoria::List<CHookMgr> gTrampolineMgrs;
 
 static CHookMgr *FindNearestTrampolineMgr(const void *addr)
@@ -422,13 +1149,25 @@ static CHookMgr *FindNearestTrampolineMgr(const void *addr)
 	return &gTrampolineMgrs.back();
 }
 
-static bool HookInternal(void *target, const void *hook, void *trampoline, bool is_x64, eInvokeMethod method)
+static bool HookInternal(void *target, const void *hook, void *trampoline, bool is_x64, eInvokeMethod method, CHookCounters **counters = nullptr, bool instrumented = false)
 {
+	AcquireSRWLockExclusive(&gTrampolineMgrLock);
+
 	auto mgr = FindNearestTrampolineMgr(target);
-	if (!mgr)
-		return false;
 
-	CTrampoline *tmp = mgr->Allocate(target, hook, is_x64, method);
+	CTrampoline *tmp = nullptr;
+
+	if (mgr)
+	{
+		tmp = instrumented
+			? mgr->AllocateInstrumented(target, hook, is_x64, method, counters)
+			: mgr->Allocate(target, hook, is_x64, method);
+	}
+
+	ReleaseSRWLockExclusive(&gTrampolineMgrLock);
+
+	if (!tmp)
+		return false;
 
 	if (!tmp->Hook())
 		return false;
@@ -454,48 +1193,434 @@ bool Hook64(void *target, const void *hook, void *trampoline, eInvokeMethod meth
 	return HookInternal(target, hook, trampoline, true, method);
 }
 
+bool HookInstrumented(void *target, const void *hook, void *trampoline, CHookCounters **counters)
+{
+	return HookInternal(target, hook, trampoline, IsX64(), eInvokeMethod::JumpRel, counters, true);
+}
+
+bool MidHook(void *target, MidHookCallback_t callback, uint32_t mask, CMidHook **handle)
+{
+	if (target == nullptr || callback == nullptr)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	AcquireSRWLockExclusive(&gTrampolineMgrLock);
+
+	auto mgr = FindNearestTrampolineMgr(target);
+	CMidHook *tmp = mgr ? mgr->AllocateMidHook(target, callback, mask & MHR_ALL) : nullptr;
+
+	ReleaseSRWLockExclusive(&gTrampolineMgrLock);
+
+	if (!tmp)
+		return false;
+
+	if (!tmp->Hook())
+	{
+		AcquireSRWLockExclusive(&gTrampolineMgrLock);
+		mgr->FreeMidHook(tmp);
+		ReleaseSRWLockExclusive(&gTrampolineMgrLock);
+
+		return false;
+	}
+
+	if (handle)
+		*handle = tmp;
+
+	return true;
+}
+
+Memoria::Vector<HookStats_t> GetHookStats()
+{
+	Memoria::Vector<HookStats_t> result;
+
+	AcquireSRWLockShared(&gTrampolineMgrLock);
+
+	for (auto &mgr : gTrampolineMgrs)
+	{
+		for (auto counters : mgr.GetCounters())
+			result.push_back({ counters->GetTarget(), counters->GetHook(), counters->GetCalls(), counters->GetCycles() });
+	}
+
+	ReleaseSRWLockShared(&gTrampolineMgrLock);
+
+	return result;
+}
+
+void ResetHookStats()
+{
+	AcquireSRWLockShared(&gTrampolineMgrLock);
+
+	for (auto &mgr : gTrampolineMgrs)
+	{
+		for (auto counters : mgr.GetCounters())
+			counters->Reset();
+	}
+
+	ReleaseSRWLockShared(&gTrampolineMgrLock);
+}
+
+void DumpHookStats()
+{
+	auto stats = GetHookStats();
+
+	for (auto &entry : stats)
+	{
+		char target[128];
+		char hook[128];
+
+		BeautifyPointer(entry.Target, target, sizeof(target));
+		BeautifyPointer(entry.Hook, hook, sizeof(hook));
+
+		uint64_t average = entry.Calls ? entry.Cycles / entry.Calls : 0;
+
+		DispatchLog("Hook %s -> %s: %llu calls, %llu cycles, %llu cycles/call", target, hook, entry.Calls, entry.Cycles, average);
+	}
+}
+
+// Serializes `StartHookStatsDump` and `StopHookStatsDump`.
+static SRWLOCK gHookStatsDumpLock = SRWLOCK_INIT;
+
+// Every dump thread gets its own stop event as parameter and closes it on exit, so a thread
+// stopped from a log callback ends on its own even if a new one is started meanwhile.
+static HANDLE gHookStatsDumpThread = nullptr;
+static HANDLE gHookStatsDumpStop = nullptr;
+static volatile uint32_t gHookStatsDumpInterval = 0;
+
+static bool gHookStatsDumpExitRegistered = false;
+
+static void HookStatsDumpThread(LPVOID param)
+{
+	HANDLE stop = static_cast<HANDLE>(param);
+
+	// The stop event also ends the wait, so stopping does not take up to a whole interval.
+	while (WaitForSingleObject(stop, gHookStatsDumpInterval) == WAIT_TIMEOUT)
+		DumpHookStats();
+
+	CloseHandle(stop);
+}
+
+bool StartHookStatsDump(uint32_t interval_ms)
+{
+	if (interval_ms == 0)
+		return false;
+
+	AcquireSRWLockExclusive(&gHookStatsDumpLock);
+
+	gHookStatsDumpInterval = interval_ms;
+
+	if (!gHookStatsDumpThread)
+	{
+		HANDLE stop = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+
+		if (stop)
+		{
+			gHookStatsDumpThread = BeginThreadHandle(HookStatsDumpThread, stop);
+
+			if (gHookStatsDumpThread)
+				gHookStatsDumpStop = stop;
+			else
+				CloseHandle(stop);
+		}
+
+		if (gHookStatsDumpThread && !gHookStatsDumpExitRegistered)
+		{
+			gHookStatsDumpExitRegistered = true;
+			RegisterOnExitCallback(StopHookStatsDump);
+		}
+	}
+
+	bool result = gHookStatsDumpThread != nullptr;
+
+	ReleaseSRWLockExclusive(&gHookStatsDumpLock);
+
+	return result;
+}
+
+void StopHookStatsDump()
+{
+	AcquireSRWLockExclusive(&gHookStatsDumpLock);
+
+	HANDLE thread = gHookStatsDumpThread;
+
+	// Signaled while the lock is held: the thread only closes the event after it was signaled.
+	if (thread)
+		SetEvent(gHookStatsDumpStop);
+
+	gHookStatsDumpThread = nullptr;
+	gHookStatsDumpStop = nullptr;
+
+	ReleaseSRWLockExclusive(&gHookStatsDumpLock);
+
+	if (!thread)
+		return;
+
+	// Waited for without the lock, so a log callback of the last dump may still start or stop
+	// the dump. The thread itself cannot wait for its own exit.
+	if (GetThreadId(thread) != GetCurrentThreadId())
+		WaitForSingleObject(thread, INFINITE);
+
+	CloseHandle(thread);
+}
+
 MEMORIA_END
 
 MEMORIA_BEGIN
 
-CShadowVTable::CShadowVTable(void *instance)
+struct ShadowVTable_t
 {
-	Assert(instance != nullptr);
+	// Allocation holding the copied RTTI locator followed by the methods.
+	void **allocation;
+
+	void **shadow;
+	size_t method_count;
+	size_t references;
+};
+
+static SRWLOCK gShadowVTablesLock = SRWLOCK_INIT;
+
+// Original vtable -> shadow.
+static Memoria::HashMap<void **, ShadowVTable_t> gShadowVTables;
+
+// Shadow -> original vtable.
+static Memoria::HashMap<void **, void **> gShadowVTableOriginals;
+
+// Instance -> number of `CShadowVTable` objects shadowing it.
+static Memoria::HashMap<void *, size_t> gShadowVTableInstances;
+
+static PIMAGE_SECTION_HEADER FindImageSection(HMODULE module, const void *addr)
+{
+	auto dos = reinterpret_cast<PIMAGE_DOS_HEADER>(module);
+	auto nt = reinterpret_cast<PIMAGE_NT_HEADERS>(PtrAdvance(module, dos->e_lfanew));
+	auto section = IMAGE_FIRST_SECTION(nt);
+
+	for (WORD i = 0; i < nt->FileHeader.NumberOfSections; ++i, ++section)
+	{
+		auto begin = PtrAdvance(module, section->VirtualAddress);
+		auto end = PtrAdvance(begin, section->Misc.VirtualSize);
+
+		if (IsInBounds(addr, begin, end))
+			return section;
+	}
+
+	return nullptr;
+}
+
+size_t CShadowVTableRegistry::CountMethods(void **vtable)
+{
+	if (vtable == nullptr)
+		return 0;
+
+	auto module = reinterpret_cast<HMODULE>(GetBaseAddress(vtable));
+
+	if (module == nullptr)
+	{
+		// Not an image (e.g. a vtable generated at runtime), so there are no section bounds
+		// to rely on. Fall back to counting executable entries.
+		size_t count = 0;
+
+		while (IsMemoryValid(&vtable[count]) && vtable[count] && IsMemoryExecutable(vtable[count]))
+			++count;
+
+		return count;
+	}
+
+	auto vtable_section = FindImageSection(module, vtable);
+
+	if (vtable_section == nullptr)
+		return 0;
+
+	auto vtable_end = PtrAdvance(module, vtable_section->VirtualAddress + vtable_section->Misc.VirtualSize);
+	size_t count = 0;
+
+	while (&vtable[count + 1] <= vtable_end)
+	{
+		auto section = FindImageSection(module, vtable[count]);
+
+		if (section == nullptr || !(section->Characteristics & IMAGE_SCN_MEM_EXECUTE))
+			break;
+
+		++count;
+	}
+
+	return count;
+}
+
+void **CShadowVTableRegistry::Acquire(void **vtable, size_t method_count)
+{
+	if (vtable == nullptr)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return nullptr;
+	}
+
+	AcquireSRWLockExclusive(&gShadowVTablesLock);
+
+	if (auto original = gShadowVTableOriginals.find(vtable))
+		vtable = *original;
+
+	if (auto entry = gShadowVTables.find(vtable))
+	{
+		AssertMsg(method_count <= entry->method_count, "Shadow vtable was created with fewer methods than requested.");
+
+		++entry->references;
+		void **result = entry->shadow;
+
+		ReleaseSRWLockExclusive(&gShadowVTablesLock);
+		return result;
+	}
+
+	if (method_count == 0)
+		method_count = CountMethods(vtable);
+
+	if (method_count == 0)
+	{
+		ReleaseSRWLockExclusive(&gShadowVTablesLock);
+
+		SetError(ME_NOT_FOUND);
+		return nullptr;
+	}
 
-	auto _instance = (void ***)instance;
-	void **_vmt_org = *_instance;
+	auto allocation = reinterpret_cast<void **>(New((method_count + 1) * sizeof(void *)));
 
-	size_t methodCount = 0;
-	while (_vmt_org[methodCount])
-		methodCount++;
+	if (allocation == nullptr)
+	{
+		ReleaseSRWLockExclusive(&gShadowVTablesLock);
+		return nullptr;
+	}
+
+	allocation[0] = IsMemoryValid(&vtable[-1]) ? vtable[-1] : nullptr;
+	MemCopy(&allocation[1], vtable, method_count * sizeof(void *));
+
+	ShadowVTable_t entry = { allocation, &allocation[1], method_count, 1 };
+
+	gShadowVTables.insert(vtable, entry);
+	gShadowVTableOriginals.insert(entry.shadow, vtable);
+
+	ReleaseSRWLockExclusive(&gShadowVTablesLock);
+	return entry.shadow;
+}
+
+bool CShadowVTableRegistry::Release(void **vtable)
+{
+	AcquireSRWLockExclusive(&gShadowVTablesLock);
+
+	auto entry = gShadowVTables.find(vtable);
+
+	if (entry == nullptr)
+	{
+		ReleaseSRWLockExclusive(&gShadowVTablesLock);
+		return false;
+	}
+
+	if (--entry->references == 0)
+	{
+		gShadowVTableOriginals.erase(entry->shadow);
+		Free(entry->allocation);
+
+		gShadowVTables.erase(vtable);
+	}
+
+	ReleaseSRWLockExclusive(&gShadowVTablesLock);
+	return true;
+}
+
+void **CShadowVTableRegistry::FindShadow(void **vtable)
+{
+	AcquireSRWLockShared(&gShadowVTablesLock);
+
+	auto entry = gShadowVTables.find(vtable);
+	void **result = entry ? entry->shadow : nullptr;
+
+	ReleaseSRWLockShared(&gShadowVTablesLock);
+	return result;
+}
 
-	std::construct_at(this, instance, methodCount);
+void **CShadowVTableRegistry::FindOriginal(void **shadow)
+{
+	AcquireSRWLockShared(&gShadowVTablesLock);
+
+	auto original = gShadowVTableOriginals.find(shadow);
+	void **result = original ? *original : nullptr;
+
+	ReleaseSRWLockShared(&gShadowVTablesLock);
+	return result;
+}
+
+size_t CShadowVTableRegistry::GetMethodCount(void **vtable)
+{
+	AcquireSRWLockShared(&gShadowVTablesLock);
+
+	auto entry = gShadowVTables.find(vtable);
+	size_t result = entry ? entry->method_count : 0;
+
+	ReleaseSRWLockShared(&gShadowVTablesLock);
+	return result;
+}
+
+CShadowVTable::CShadowVTable(void *instance)
+	: CShadowVTable(instance, 0)
+{
 }
 
 CShadowVTable::CShadowVTable(void *instance, size_t methodCount)
 {
 	Assert(instance != nullptr);
-	Assert(methodCount > 0);
 
 	this->_instance = reinterpret_cast<Class *>(instance);
 	void **_vmt_org = this->_instance->vtable;
 
-	_vmt_shadow = std::make_unique<void *[]>(methodCount);
+	// The instance may already use a shadow.
+	if (auto original = CShadowVTableRegistry::FindOriginal(_vmt_org))
+		_vmt_org = original;
 
-	MemCopy(_vmt_shadow.get(), _vmt_org, methodCount * sizeof(void *));
-	std::construct_at(&_vmt_original, instance);
+	_vmt_shadow = CShadowVTableRegistry::Acquire(_vmt_org, methodCount);
+	Assert(_vmt_shadow != nullptr);
 
-	this->_instance->vtable = _vmt_shadow.get();
+	_vmt_original = CVTable(&_vmt_org);
+
+	if (!_vmt_shadow)
+		return;
+
+	AcquireSRWLockExclusive(&gShadowVTablesLock);
+
+	if (auto owners = gShadowVTableInstances.find(instance))
+		++*owners;
+	else
+		gShadowVTableInstances.insert(instance, 1);
+
+	this->_instance->vtable = _vmt_shadow;
+
+	ReleaseSRWLockExclusive(&gShadowVTablesLock);
 }
 
 CShadowVTable::~CShadowVTable()
 {
-	_instance->vtable = _vmt_original.value();
+	if (!_vmt_shadow)
+		return;
+
+	AcquireSRWLockExclusive(&gShadowVTablesLock);
+
+	// Only the last owner restores the original, the others still rely on the shadow.
+	auto owners = gShadowVTableInstances.find(_instance);
+
+	if (!owners || --*owners == 0)
+	{
+		gShadowVTableInstances.erase(_instance);
+		_instance->vtable = _vmt_original.value();
+	}
+
+	ReleaseSRWLockExclusive(&gShadowVTablesLock);
+
+	CShadowVTableRegistry::Release(_vmt_original.value());
 }
 
 void CShadowVTable::Hook(size_t index, const void *callback)
 {
-	Memoria::WritePointer(&(_vmt_shadow.get()[index]), callback);
+	Assert(index < CShadowVTableRegistry::GetMethodCount(_vmt_original.value()));
+
+	Memoria::WritePointer(&_vmt_shadow[index], callback);
 }
 
 MEMORIA_END
\ No newline at end of file
@@ -1,46 +1,235 @@
 #include "memoria_core_mempool.hpp"
 
+#include "memoria_core_arena.hpp"
 #include "memoria_core_misc.hpp"
 #include "memoria_utils_assert.hpp"
-#include "memoria_utils_list.hpp"
+#include "memoria_utils_hashmap.hpp"
+#include "memoria_utils_string.hpp"
+#include "memoria_utils_vector.hpp"
 
 #include <Windows.h>
 
 MEMORIA_BEGIN
 
-class CMemoryChunk
+//
+// Registry of allocated chunks.
+//
+// Chunks are stored in a dense array, so `FreeAll` walks contiguous memory, and indexed by
+// address in an open-addressing table, so `Free` does not search. Removal moves the last
+// chunk into the hole and uses backward-shift deletion in the table, so neither structure
+// accumulates holes or tombstones.
+//
+// Both structures are backed by `VirtualAlloc` directly; the pool must not depend on
+// `::operator new`, which may itself be routed here.
+//
+
+struct MemoryChunk_t
 {
-public:
+	void *Pointer;
+	size_t Size;
+
 	// true : VirtualAlloc
 	// false: HeapAlloc
-	bool _is_virtual = false;
+	bool IsVirtual;
+
+	// Owner of an arena slab; such chunks are released by the arena.
+	CArena *Arena;
+};
+
+// Slot value `0` marks an empty slot, otherwise it is the chunk index plus one.
+static uint32_t *gChunkIndex = nullptr;
+static size_t gChunkIndexCapacity = 0;
+
+static MemoryChunk_t *gChunks = nullptr;
+static size_t gChunkCount = 0;
+static size_t gChunkCapacity = 0;
+
+static MemPoolStats_t gPoolStats = {};
+
+static SRWLOCK gPoolLock = SRWLOCK_INIT;
+
+static size_t GetSizeClass(size_t size, bool is_virtual)
+{
+	if (is_virtual)
+		return MEMORIA_MEMPOOL_CLASSES - 1;
+
+	size_t index = 0;
+
+	for (size_t class_size = 16; class_size < size && index < MEMORIA_MEMPOOL_CLASSES - 2; class_size *= 2)
+		++index;
+
+	return index;
+}
+
+static void *AllocTable(size_t size)
+{
+	return VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+}
+
+static void FreeTable(void *table)
+{
+	if (table)
+		VirtualFree(table, 0, MEM_RELEASE);
+}
 
-	void *_chunk = nullptr;
+static size_t GetChunkSlot(const void *addr)
+{
+	return HashMapHasher<const void *>::Hash(addr) & (gChunkIndexCapacity - 1);
+}
 
-public:
-	CMemoryChunk() = default;
-	CMemoryChunk(void *chunk, bool is_virtual) : _chunk(chunk), _is_virtual(is_virtual) {}
+static void InsertChunkSlot(size_t index)
+{
+	size_t mask = gChunkIndexCapacity - 1;
+	size_t slot = GetChunkSlot(gChunks[index].Pointer);
 
-	~CMemoryChunk()
-	{ 
-		bool freed = false;
+	while (gChunkIndex[slot] != 0)
+		slot = (slot + 1) & mask;
 
-		if (_chunk)
+	gChunkIndex[slot] = static_cast<uint32_t>(index + 1);
+}
+
+static size_t FindChunkSlot(const void *addr)
+{
+	if (gChunkIndexCapacity == 0)
+		return SIZE_MAX;
+
+	size_t mask = gChunkIndexCapacity - 1;
+	size_t slot = GetChunkSlot(addr);
+
+	while (gChunkIndex[slot] != 0)
+	{
+		if (gChunks[gChunkIndex[slot] - 1].Pointer == addr)
+			return slot;
+
+		slot = (slot + 1) & mask;
+	}
+
+	return SIZE_MAX;
+}
+
+static void EraseChunkSlot(size_t slot)
+{
+	size_t mask = gChunkIndexCapacity - 1;
+	size_t hole = slot;
+
+	gChunkIndex[hole] = 0;
+
+	// Backward-shift deletion: pull later entries of the cluster into the hole
+	// unless that would move them before their home slot.
+	for (size_t next = (hole + 1) & mask; gChunkIndex[next] != 0; next = (next + 1) & mask)
+	{
+		size_t home = GetChunkSlot(gChunks[gChunkIndex[next] - 1].Pointer);
+
+		if (((next - home) & mask) >= ((next - hole) & mask))
 		{
-			if (_is_virtual)
-				freed = VirtualFree(_chunk, 0, MEM_RELEASE) != FALSE;
-			else
-				freed = HeapFree(GetProcessHeap(), 0, _chunk) != FALSE;
+			gChunkIndex[hole] = gChunkIndex[next];
+			gChunkIndex[next] = 0;
+			hole = next;
 		}
+	}
+}
+
+static bool GrowChunks()
+{
+	if (gChunkCount < gChunkCapacity && (gChunkCount + 1) * 2 <= gChunkIndexCapacity)
+		return true;
+
+	if (gChunkCount + 1 > UINT32_MAX - 1)
+		return false;
+
+	if (gChunkCount >= gChunkCapacity)
+	{
+		size_t capacity = gChunkCapacity ? gChunkCapacity * 2 : 4096 / sizeof(MemoryChunk_t);
+		auto chunks = static_cast<MemoryChunk_t *>(AllocTable(capacity * sizeof(MemoryChunk_t)));
 
-		Assert(freed);
+		if (!chunks)
+			return false;
+
+		if (gChunkCount)
+			MemCopy(chunks, gChunks, gChunkCount * sizeof(MemoryChunk_t));
+
+		FreeTable(gChunks);
+
+		gChunks = chunks;
+		gChunkCapacity = capacity;
 	}
 
-	bool IsVirtual() const { return _is_virtual; }
-	void *GetPointer() const { return _chunk; }
-};
+	// Keep the load factor of the index at or below 1/2.
+	if ((gChunkCount + 1) * 2 > gChunkIndexCapacity)
+	{
+		size_t capacity = gChunkIndexCapacity ? gChunkIndexCapacity * 2 : 4096 / sizeof(uint32_t);
+		auto index = static_cast<uint32_t *>(AllocTable(capacity * sizeof(uint32_t)));
+
+		if (!index)
+			return false;
+
+		FreeTable(gChunkIndex);
+
+		gChunkIndex = index;
+		gChunkIndexCapacity = capacity;
+
+		for (size_t i = 0; i < gChunkCount; ++i)
+			InsertChunkSlot(i);
+	}
+
+	return true;
+}
+
+static void AccountChunk(const MemoryChunk_t &chunk, bool add)
+{
+	// Arena slabs are not handed out; `GetMemPoolStats` adds the blocks in use of the default arena.
+	if (chunk.Arena)
+		return;
+
+	auto &stats = gPoolStats.Classes[GetSizeClass(chunk.Size, chunk.IsVirtual)];
+
+	if (add)
+	{
+		++gPoolStats.Chunks;
+		gPoolStats.Bytes += chunk.Size;
+		++stats.Chunks;
+		stats.Bytes += chunk.Size;
+	}
+	else
+	{
+		--gPoolStats.Chunks;
+		gPoolStats.Bytes -= chunk.Size;
+		--stats.Chunks;
+		stats.Bytes -= chunk.Size;
+	}
+}
+
+static void ReleaseChunk(const MemoryChunk_t &chunk)
+{
+	bool freed;
+
+	if (chunk.IsVirtual)
+		freed = VirtualFree(chunk.Pointer, 0, MEM_RELEASE) != FALSE;
+	else
+		freed = HeapFree(GetProcessHeap(), 0, chunk.Pointer) != FALSE;
+
+	Assert(freed);
+}
 
-static Memoria::List<CMemoryChunk> AllocatedChunks;
+static bool RegisterChunk(void *addr, size_t size, bool is_virtual, CArena *arena = nullptr)
+{
+	AcquireSRWLockExclusive(&gPoolLock);
+
+	if (!GrowChunks())
+	{
+		ReleaseSRWLockExclusive(&gPoolLock);
+		return false;
+	}
+
+	size_t index = gChunkCount++;
+
+	gChunks[index] = { addr, size, is_virtual, arena };
+	InsertChunkSlot(index);
+	AccountChunk(gChunks[index], true);
+
+	ReleaseSRWLockExclusive(&gPoolLock);
+	return true;
+}
 
 static DWORD CreateVirtualFlags(bool bExecutable, bool bReadable, bool bWritable)
 {
@@ -87,6 +276,11 @@ static void *AllocEx(const void *addr_source, size_t size, bool is_executable, b
 	if (size == 0)
 		return nullptr;
 
+	// Plain read-write memory is served by the arena, which packs small objects
+	// and does not round sizes up to whole pages.
+	if (addr_source == nullptr && !is_executable && is_readable && is_writable)
+		return GetDefaultArena()->Allocate(size, true);
+
 	void *result;
 	bool is_virtual;
 
@@ -107,30 +301,156 @@ static void *AllocEx(const void *addr_source, size_t size, bool is_executable, b
 	if (!result)
 		return nullptr;
 
-	AllocatedChunks.emplace_front(result, is_virtual);
+	if (!RegisterChunk(result, size, is_virtual))
+	{
+		ReleaseChunk({ result, size, is_virtual });
+		return nullptr;
+	}
+
+	return result;
+}
+
+static void RemoveChunk(size_t slot)
+{
+	size_t index = gChunkIndex[slot] - 1;
+
+	AccountChunk(gChunks[index], false);
+	EraseChunkSlot(slot);
+
+	// Move the last chunk into the hole to keep the array dense.
+	size_t last = --gChunkCount;
+
+	if (index != last)
+	{
+		gChunkIndex[FindChunkSlot(gChunks[last].Pointer)] = static_cast<uint32_t>(index + 1);
+		gChunks[index] = gChunks[last];
+	}
+}
+
+bool RegisterArenaSlab(void *base, size_t size, CArena *arena)
+{
+	return RegisterChunk(base, size, true, arena);
+}
+
+void UnregisterArenaSlab(void *base)
+{
+	AcquireSRWLockExclusive(&gPoolLock);
+
+	size_t slot = FindChunkSlot(base);
+
+	if (slot != SIZE_MAX)
+		RemoveChunk(slot);
+
+	ReleaseSRWLockExclusive(&gPoolLock);
+}
+
+CArena *FindArenaSlab(const void *base)
+{
+	AcquireSRWLockShared(&gPoolLock);
+
+	size_t slot = FindChunkSlot(base);
+	CArena *result = (slot != SIZE_MAX) ? gChunks[gChunkIndex[slot] - 1].Arena : nullptr;
+
+	ReleaseSRWLockShared(&gPoolLock);
 	return result;
 }
 
 bool Free(void *addr)
 {
-	for (auto it = AllocatedChunks.begin(); it != AllocatedChunks.end(); ++it)
+	AcquireSRWLockExclusive(&gPoolLock);
+
+	size_t slot = FindChunkSlot(addr);
+
+	if (slot == SIZE_MAX || gChunks[gChunkIndex[slot] - 1].Arena != nullptr)
 	{
-		if (it->GetPointer() == addr)
-		{
-			AllocatedChunks.erase(it);
-			return true;
-		}
+		ReleaseSRWLockExclusive(&gPoolLock);
+
+		// Blocks inside arena slabs are not registered individually.
+		CArena *arena = CArena::FromPointer(addr);
+		return arena ? arena->Free(addr) : false;
 	}
 
-	return false;
+	MemoryChunk_t chunk = gChunks[gChunkIndex[slot] - 1];
+	RemoveChunk(slot);
+
+	ReleaseSRWLockExclusive(&gPoolLock);
+
+	ReleaseChunk(chunk);
+	return true;
 }
 
 bool FreeAll()
 {
-	AllocatedChunks.clear();
+	// Everything allocated by `New` lives in the default arena.
+	GetDefaultArena()->Reset();
+
+	AcquireSRWLockExclusive(&gPoolLock);
+
+	// Slabs of other arenas stay registered, they are owned by their arena.
+	size_t kept = 0;
+
+	for (size_t i = 0; i < gChunkCount; ++i)
+	{
+		if (gChunks[i].Arena)
+			gChunks[kept++] = gChunks[i];
+		else
+			ReleaseChunk(gChunks[i]);
+	}
+
+	gChunkCount = kept;
+
+	if (gChunkIndex)
+	{
+		MemFill(gChunkIndex, 0, gChunkIndexCapacity * sizeof(uint32_t));
+
+		for (size_t i = 0; i < gChunkCount; ++i)
+			InsertChunkSlot(i);
+	}
+
+	gPoolStats = {};
+
+	ReleaseSRWLockExclusive(&gPoolLock);
 	return true;
 }
 
+MemPoolStats_t GetMemPoolStats()
+{
+	static_assert(MEMORIA_ARENA_SMALL_CLASSES <= MEMORIA_MEMPOOL_CLASSES - 2, "Small arena classes must map to pool classes.");
+
+	AcquireSRWLockShared(&gPoolLock);
+	MemPoolStats_t result = gPoolStats;
+	ReleaseSRWLockShared(&gPoolLock);
+
+	// Queried after releasing the pool lock, the arena takes it while holding its own lock.
+	ArenaStats_t arena = GetDefaultArena()->GetStats();
+
+	// Small arena classes have the sizes of the first pool classes; page runs are virtual memory.
+	for (size_t i = 0; i <= MEMORIA_ARENA_SMALL_CLASSES; ++i)
+	{
+		const ArenaClassStats_t &usage = (i < MEMORIA_ARENA_SMALL_CLASSES) ? arena.Small[i] : arena.Pages;
+		MemPoolClassStats_t &stats = result.Classes[(i < MEMORIA_ARENA_SMALL_CLASSES) ? i : MEMORIA_MEMPOOL_CLASSES - 1];
+
+		stats.Chunks += usage.Blocks;
+		stats.Bytes += usage.Bytes;
+
+		result.Chunks += usage.Blocks;
+		result.Bytes += usage.Bytes;
+	}
+
+	return result;
+}
+
+size_t GetMemPoolClassSize(size_t index)
+{
+	if (index >= MEMORIA_MEMPOOL_CLASSES - 1)
+		return SIZE_MAX;
+
+	if (index == MEMORIA_MEMPOOL_CLASSES - 2)
+		return 4095;
+
+	return static_cast<size_t>(16) << index;
+}
+
 void *New(size_t size)
 {
 	return AllocEx(nullptr, size, false, true, true);
@@ -141,61 +461,249 @@ void *Alloc(size_t size, bool is_executable, bool is_readable, bool is_writable)
 	return AllocEx(nullptr, size, is_executable, is_readable, is_writable);
 }
 
-void *AllocNear(const void *addr_source, size_t size, bool is_executable, bool is_readable, bool is_writable)
+//
+// Map of free address ranges used to place near and far allocations.
+//
+// The address space around the source is enumerated with `VirtualQuery` once, and the free
+// gaps are kept for subsequent requests. Placement follows the allocation granularity, as
+// `VirtualAlloc` reserves whole 64 KiB granules. The map may become stale when the process
+// allocates elsewhere; a failed placement simply triggers a rescan.
+//
+
+struct FreeGap_t
 {
-	if (!addr_source)
-		return nullptr;
+	uintptr_t Begin;
+	uintptr_t End;
+};
 
-	size = Align(size, 4096);
+static SRWLOCK gRegionLock = SRWLOCK_INIT;
+
+static Memoria::FixedVector<FreeGap_t, 1024> gFreeGaps;
 
-	uintptr_t addr = reinterpret_cast<uintptr_t>(addr_source);
+// Address window covered by `gFreeGaps`; empty if the map has not been built.
+static uintptr_t gFreeGapsLow = 0;
+static uintptr_t gFreeGapsHigh = 0;
+
+static uintptr_t gMinAppAddress = 0;
+static uintptr_t gMaxAppAddress = 0;
+static uintptr_t gGranularity = 0;
+
+// Largest distance that keeps a block reachable with a 32-bit relative displacement.
+static constexpr uintptr_t kMaxRelDistance = 0x7FFF0000;
+
+static void InitRegionInfo()
+{
+	if (gGranularity != 0)
+		return;
+
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+
+	gMinAppAddress = reinterpret_cast<uintptr_t>(info.lpMinimumApplicationAddress);
+	gMaxAppAddress = reinterpret_cast<uintptr_t>(info.lpMaximumApplicationAddress);
+	gGranularity = info.dwAllocationGranularity;
+}
 
+static uintptr_t AlignUp(uintptr_t value, uintptr_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static uintptr_t AlignDown(uintptr_t value, uintptr_t alignment)
+{
+	return value & ~(alignment - 1);
+}
+
+static void GetRegionWindow(uintptr_t source, uintptr_t *low, uintptr_t *high)
+{
 #ifdef MEMORIA_32BIT
-	uintptr_t max_addr = 0x7FFFFFFF;
+	// The whole address space is reachable with a 32-bit displacement.
+	(void)source;
+
+	*low = gMinAppAddress;
+	*high = gMaxAppAddress;
 #else
-	uintptr_t max_addr = addr + 0x7FFFFFFF;
+	*low = (source - gMinAppAddress > kMaxRelDistance) ? source - kMaxRelDistance : gMinAppAddress;
+	*high = (gMaxAppAddress - source > kMaxRelDistance) ? source + kMaxRelDistance : gMaxAppAddress;
 #endif
+}
+
+static void ScanFreeGaps(uintptr_t low, uintptr_t high)
+{
+	gFreeGaps.clear();
 
-	while (addr < max_addr)
+	MEMORY_BASIC_INFORMATION mbi;
+	uintptr_t addr = low;
+
+	while (addr < high && VirtualQuery(reinterpret_cast<void *>(addr), &mbi, sizeof(mbi)) != 0)
 	{
-		void *mem = AllocEx(reinterpret_cast<void *>(addr), size, is_executable, is_readable, is_writable);
+		uintptr_t begin = reinterpret_cast<uintptr_t>(mbi.BaseAddress);
+		uintptr_t end = begin + mbi.RegionSize;
 
-		if (mem)
-			return mem;
+		if (end <= addr)
+			break;
 
-		addr += size;
+		if (mbi.State == MEM_FREE)
+		{
+			if (gFreeGaps.full())
+			{
+				// The map covers only the part scanned so far.
+				high = addr;
+				break;
+			}
+
+			gFreeGaps.push_back({ begin > low ? begin : low, end < high ? end : high });
+		}
+
+		addr = end;
 	}
 
-	return nullptr;
+	gFreeGapsLow = low;
+	gFreeGapsHigh = high;
 }
 
-void *AllocFar(const void *addr_source, size_t size, bool is_executable, bool is_readable, bool is_writable)
+//
+// Returns the best granule-aligned address for a block of `size` bytes, or `0`.
+// `near` selects the address closest to `source`, otherwise the farthest address
+// above `source` that is still reachable from it.
+//
+static uintptr_t FindFreeGap(uintptr_t source, size_t size, bool near, size_t *gap_index)
+{
+	uintptr_t best = 0;
+	uintptr_t best_distance = 0;
+
+	for (size_t i = 0; i < gFreeGaps.size(); ++i)
+	{
+		const FreeGap_t &gap = gFreeGaps[i];
+
+		if (gap.End - gap.Begin < size)
+			continue;
+
+		uintptr_t first = AlignUp(gap.Begin, gGranularity);
+		uintptr_t last = AlignDown(gap.End - size, gGranularity);
+
+		if (first > last || first == 0)
+			continue;
+
+		uintptr_t candidate;
+
+		if (near)
+		{
+			uintptr_t target = AlignDown(source, gGranularity);
+			candidate = (target < first) ? first : (target > last) ? last : target;
+		}
+		else
+		{
+			if (last <= source)
+				continue;
+
+			candidate = last;
+		}
+
+#ifdef MEMORIA_64BIT
+		uintptr_t reach = (candidate + size > source) ? candidate + size - source : source - candidate;
+
+		if (reach > kMaxRelDistance)
+			continue;
+#endif
+
+		uintptr_t distance = (candidate > source) ? candidate - source : source - candidate;
+
+		if (best == 0 || (near ? distance < best_distance : distance > best_distance))
+		{
+			best = candidate;
+			best_distance = distance;
+			*gap_index = i;
+		}
+	}
+
+	return best;
+}
+
+void *AllocInRegion(const void *addr_source, size_t size, bool near, RegionAllocator_t allocator, void *context)
 {
 	if (!addr_source)
 		return nullptr;
 
+	InitRegionInfo();
+
 	size = Align(size, 4096);
 
-#ifdef MEMORIA_32BIT
-	uintptr_t addr = 0x7FFFFFFF;
-#else
-	uintptr_t addr = reinterpret_cast<uintptr_t>(addr_source) + 0x7FFFFFFF;
-#endif
+	uintptr_t source = reinterpret_cast<uintptr_t>(addr_source);
+	uintptr_t low, high;
+
+	GetRegionWindow(source, &low, &high);
+
+	AcquireSRWLockExclusive(&gRegionLock);
 
-	addr = (addr - size) & ~15;
-	uintptr_t min_addr = addr_source ? reinterpret_cast<uintptr_t>(addr_source) : 0;
+	bool rescanned = false;
 
-	while (addr > min_addr)
+	if (gFreeGapsLow > low || gFreeGapsHigh < high || gFreeGapsLow == gFreeGapsHigh)
 	{
-		void *mem = AllocEx(reinterpret_cast<void *>(addr), size, is_executable, is_readable, is_writable);
+		ScanFreeGaps(low, high);
+		rescanned = true;
+	}
+
+	void *result = nullptr;
 
-		if (mem)
-			return mem;
+	for (;;)
+	{
+		size_t index = 0;
+		uintptr_t addr = FindFreeGap(source, size, near, &index);
 
-		addr = (addr - size) & ~15;
+		if (addr != 0)
+		{
+			result = allocator(reinterpret_cast<void *>(addr), size, context);
+
+			if (result)
+			{
+				// The reservation takes whole granules; split the gap around it.
+				FreeGap_t &gap = gFreeGaps[index];
+				uintptr_t end = AlignUp(addr + size, gGranularity);
+
+				if (end < gap.End && !gFreeGaps.full())
+					gFreeGaps.push_back({ end, gap.End });
+
+				gap.End = addr;
+				break;
+			}
+		}
+
+		// Either nothing fits or the map is stale.
+		if (rescanned)
+			break;
+
+		ScanFreeGaps(low, high);
+		rescanned = true;
 	}
 
-	return nullptr;
+	ReleaseSRWLockExclusive(&gRegionLock);
+	return result;
+}
+
+struct RegionFlags_t
+{
+	bool IsExecutable;
+	bool IsReadable;
+	bool IsWritable;
+};
+
+static void *AllocRegionChunk(void *addr, size_t size, void *context)
+{
+	auto flags = static_cast<const RegionFlags_t *>(context);
+	return AllocEx(addr, size, flags->IsExecutable, flags->IsReadable, flags->IsWritable);
+}
+
+void *AllocNear(const void *addr_source, size_t size, bool is_executable, bool is_readable, bool is_writable)
+{
+	RegionFlags_t flags = { is_executable, is_readable, is_writable };
+	return AllocInRegion(addr_source, size, true, AllocRegionChunk, &flags);
+}
+
+void *AllocFar(const void *addr_source, size_t size, bool is_executable, bool is_readable, bool is_writable)
+{
+	RegionFlags_t flags = { is_executable, is_readable, is_writable };
+	return AllocInRegion(addr_source, size, false, AllocRegionChunk, &flags);
 }
 
 MEMORIA_END
\ No newline at end of file
@@ -2,8 +2,11 @@
 
 #include "memoria_utils_string.hpp"
 #include "memoria_utils_format.hpp"
+#include "memoria_utils_vector.hpp"
+#include "memoria_utils_hashmap.hpp"
 
 #include <Windows.h>
+#include <intrin.h>
 #include <inttypes.h>
 
 #include "memoria_utils_secure.hpp"
@@ -35,6 +38,81 @@ bool IsMemoryValid(const void *addr, ptrdiff_t offset)
 	return !(memInfo.Protect == 0 || memInfo.Protect == PAGE_NOACCESS);
 }
 
+// Access violations, including faults of memory-mapped files and guard pages, are handled;
+// everything else is passed on.
+static int GuardedAccessFilter(EXCEPTION_POINTERS *info)
+{
+	const EXCEPTION_RECORD *record = info->ExceptionRecord;
+
+	switch (record->ExceptionCode)
+	{
+	case EXCEPTION_ACCESS_VIOLATION:
+	case EXCEPTION_IN_PAGE_ERROR:
+		return EXCEPTION_EXECUTE_HANDLER;
+
+	case EXCEPTION_GUARD_PAGE:
+	{
+		// The system clears the guard of the page before raising the exception. Restore it,
+		// so the access stays invisible to the owner of the page, e.g. a stack or a watchdog.
+		MEMORY_BASIC_INFORMATION mbi;
+		void *addr = reinterpret_cast<void *>(record->ExceptionInformation[1]);
+
+		if (record->NumberParameters >= 2 && VirtualQuery(addr, &mbi, sizeof(mbi)) != 0)
+		{
+			DWORD old_protect;
+			VirtualProtect(addr, 1, mbi.Protect | PAGE_GUARD, &old_protect);
+		}
+
+		return EXCEPTION_EXECUTE_HANDLER;
+	}
+
+	default:
+		return EXCEPTION_CONTINUE_SEARCH;
+	}
+}
+
+bool GuardedCopy(void *dest, const void *source, size_t size)
+{
+	__try
+	{
+		__movsb(static_cast<unsigned char *>(dest), static_cast<const unsigned char *>(source), size);
+	}
+	__except (GuardedAccessFilter(GetExceptionInformation()))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool GuardedCompare(const void *addr1, const void *addr2, size_t size, bool *equal)
+{
+	__try
+	{
+		*equal = MemEqual(addr1, addr2, size);
+	}
+	__except (GuardedAccessFilter(GetExceptionInformation()))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool GuardedCall(void (*fn)(void *context), void *context)
+{
+	__try
+	{
+		fn(context);
+	}
+	__except (GuardedAccessFilter(GetExceptionInformation()))
+	{
+		return false;
+	}
+
+	return true;
+}
+
 bool IsMemoryExecutable(const void *addr, ptrdiff_t offset)
 {
 	if (offset != 0)
@@ -290,25 +368,40 @@ bool BeautifyPointer(const void *addr, char *out, size_t max_size)
 	}
 
 	void *base = GetBaseAddress(addr);
-	if (!base)
+
+	char modname[64];
+	if (!base || !GetModuleName((HMODULE)base, modname, sizeof(modname)))
+		return BeautifyPointer(addr, nullptr, nullptr, out, max_size);
+
+	return BeautifyPointer(addr, base, modname, out, max_size);
+}
+
+bool BeautifyPointer(const void *addr, const void *module, const char *module_name, char *out, size_t max_size)
+{
+	if (!out || max_size == 0)
+		return false;
+
+	if (!addr)
 	{
-		FormatBufSafe(out, max_size, "%p", addr);
+		StrNCopyA(out, "null", max_size);
 		return true;
 	}
 
-	char modname[64];
-	if (!GetModuleName((HMODULE)base, modname, sizeof(modname)))
+	if (!module || !module_name || !module_name[0])
 	{
 		FormatBufSafe(out, max_size, "%p", addr);
 		return true;
 	}
 
+	char modname[64];
+	StrNCopySafeA(modname, sizeof(modname), module_name, _TRUNCATE);
+
 	char *last_dot = FindLastCharA(modname, '.');
 	if (last_dot)
 		*last_dot = '\0';
 
-	uintptr_t offset = (uintptr_t)addr - (uintptr_t)base;
-	FormatBuf(out, "%s.%llx", modname, (unsigned long long)offset);
+	uintptr_t offset = (uintptr_t)addr - (uintptr_t)module;
+	FormatBufSafe(out, max_size, "%s.%llx", modname, (unsigned long long)offset);
 	return true;
 }
 
@@ -364,6 +457,11 @@ DWORD BeginThread(void (*fnFunction)(LPVOID), LPVOID param)
 	return nThreadId;	
 }
 
+HANDLE BeginThreadHandle(void (*fnFunction)(LPVOID), LPVOID param)
+{
+	return CreateThread(nullptr, 0, reinterpret_cast<LPTHREAD_START_ROUTINE>(fnFunction), param, 0, nullptr);
+}
+
 DWORD BeginThread(void (*fnFunction)())
 {
 	DWORD nThreadId;
@@ -440,18 +538,401 @@ static void EnumModules(EnumModulesFn_t fn, LPVOID param)
 	}
 }
 
-using EnumExports_t = bool(*)(PLDR_DATA_TABLE_ENTRY entry, const char *name, void *address, WORD ordinal, LPVOID param);
+//
+// Export index.
+//
+// The loaded modules are indexed once by the hash of their name, and the exports of a module are
+// indexed by the hash of their name the first time the module is searched. A lookup is then one
+// probe per table instead of hashing every module and export name of the process. Forwarded
+// exports are kept as such and resolved on lookup through the index of the target module, by name
+// or by ordinal (`Dll.#123`); a target module that is not loaded yet is loaded first.
+//
+// The module list is rebuilt after a module was loaded, and the index of a module is dropped when
+// it is unloaded; both are reported by `LdrRegisterDllNotification`.
+//
+
+struct ExportIndex_t
+{
+	HMODULE Module;
+	fnv1a_t NameHash;
+	bool Built;
+
+	// Export name hash -> RVA.
+	Memoria::HashMap<fnv1a_t, uint32_t> Exports;
+
+	// Export address table, for lookups by ordinal.
+	const uint32_t *Functions;
+	uint32_t FunctionCount;
+	uint32_t OrdinalBase;
+
+	// Bounds of the export directory; RVAs inside it point to forwarder strings.
+	uint32_t DirectoryBegin;
+	uint32_t DirectoryEnd;
+};
+
+//
+// A lookup of one export. `Module` restricts it to that module and `ModuleHash` to the first
+// module of that name; with neither set, the modules are searched in load order.
+//
+struct ExportQuery_t
+{
+	HMODULE Module;
+	fnv1a_t ModuleHash;
+
+	fnv1a_t SymbolHash;
+
+	// Set for forwarders by ordinal.
+	bool ByOrdinal;
+	uint32_t Ordinal;
+
+	// Position in `gExportModules` after the last match, and the module matched there, so a
+	// search of all modules can go on past a forwarder that could not be resolved.
+	size_t Next;
+	HMODULE Last;
+};
+
+struct LDR_DLL_NOTIFICATION_DATA
+{
+	ULONG Flags;
+	const UNICODE_STRING *FullDllName;
+	const UNICODE_STRING *BaseDllName;
+	PVOID DllBase;
+	ULONG SizeOfImage;
+};
+
+#define LDR_DLL_NOTIFICATION_REASON_LOADED   1
+#define LDR_DLL_NOTIFICATION_REASON_UNLOADED 2
+
+using LdrDllNotificationFn_t = VOID(CALLBACK *)(ULONG reason, const LDR_DLL_NOTIFICATION_DATA *data, PVOID context);
+using LdrRegisterDllNotificationFn_t = LONG(NTAPI *)(ULONG flags, LdrDllNotificationFn_t callback, PVOID context, PVOID *cookie);
+using LdrUnregisterDllNotificationFn_t = LONG(NTAPI *)(PVOID cookie);
+
+// Forwarders may chain; this bounds the resolution of cyclic ones.
+static constexpr int kMaxForwarderDepth = 8;
+
+static SRWLOCK gExportIndexLock = SRWLOCK_INIT;
+
+// Owns the indices, by module base.
+static Memoria::HashMap<HMODULE, ExportIndex_t *> gExportIndices;
+
+// The loaded modules in load order, and by name hash. Rebuilt when `gExportModulesValid` is cleared.
+static Memoria::Vector<ExportIndex_t *> gExportModules;
+static Memoria::HashMap<fnv1a_t, ExportIndex_t *> gExportModulesByName;
+static bool gExportModulesValid = false;
+
+static volatile LONG gDllNotificationState = 0;
+
+// Set once; `FreeExportIndex` resets the notification state, but stays registered for later cycles.
+static volatile LONG gExportIndexExitRegistered = 0;
+static PVOID gDllNotificationCookie = nullptr;
+static LdrUnregisterDllNotificationFn_t gLdrUnregisterDllNotification = nullptr;
+
+// Must be called with the lock held exclusively.
+static void BuildModuleIndex()
+{
+	gExportModules.clear();
+	gExportModulesByName.clear();
+
+	EnumModules(+[](PLDR_DATA_TABLE_ENTRY entry, LPVOID param) -> bool
+		{
+			HMODULE module = reinterpret_cast<HMODULE>(entry->DllBase);
+			fnv1a_t hash = FNV1a64(entry->BaseDllName.Buffer);
+
+			ExportIndex_t *index = nullptr;
+
+			if (auto existing = gExportIndices.find(module))
+			{
+				index = *existing;
+
+				// The base address was reused by another module.
+				if (index->NameHash != hash)
+				{
+					delete index;
+					gExportIndices.erase(module);
+
+					index = nullptr;
+				}
+			}
+
+			if (!index)
+			{
+				index = new ExportIndex_t();
+
+				index->Module = module;
+				index->NameHash = hash;
+				index->Built = false;
+
+				gExportIndices.insert(module, index);
+			}
+
+			gExportModules.push_back(index);
+
+			// The first module in load order wins, same as with a linear search.
+			if (!gExportModulesByName.contains(hash))
+				gExportModulesByName.insert(hash, index);
+
+			return true;
+		}, nullptr);
+
+	gExportModulesValid = true;
+}
+
+// Must be called with the lock held exclusively.
+static void BuildExportIndex(ExportIndex_t *index)
+{
+	index->Built = true;
+	index->Functions = nullptr;
+	index->FunctionCount = 0;
+	index->OrdinalBase = 0;
+	index->DirectoryBegin = 0;
+	index->DirectoryEnd = 0;
+
+	PIMAGE_DOS_HEADER dosHeader = (PIMAGE_DOS_HEADER)index->Module;
+	if (dosHeader->e_magic != IMAGE_DOS_SIGNATURE)
+		return;
+
+	PIMAGE_NT_HEADERS ntHeaders = (PIMAGE_NT_HEADERS)((PBYTE)index->Module + dosHeader->e_lfanew);
+	if (ntHeaders->Signature != IMAGE_NT_SIGNATURE)
+		return;
+
+	DWORD exportRva = ntHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress;
+	DWORD exportSize = ntHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].Size;
+
+	if (exportRva == 0 || exportSize == 0)
+		return;
+
+	PIMAGE_EXPORT_DIRECTORY exportDir = (PIMAGE_EXPORT_DIRECTORY)((PBYTE)index->Module + exportRva);
+
+	PDWORD functions = (PDWORD)((PBYTE)index->Module + exportDir->AddressOfFunctions);
+	PDWORD names = (PDWORD)((PBYTE)index->Module + exportDir->AddressOfNames);
+	PWORD ordinals = (PWORD)((PBYTE)index->Module + exportDir->AddressOfNameOrdinals);
+
+	index->Functions = reinterpret_cast<const uint32_t *>(functions);
+	index->FunctionCount = exportDir->NumberOfFunctions;
+	index->OrdinalBase = exportDir->Base;
+	index->DirectoryBegin = exportRva;
+	index->DirectoryEnd = exportRva + exportSize;
+	index->Exports.reserve(exportDir->NumberOfNames);
+
+	for (DWORD i = 0; i < exportDir->NumberOfNames; i++)
+	{
+		if (ordinals[i] >= exportDir->NumberOfFunctions)
+			continue;
+
+		fnv1a_t hash = FNV1a64((const char *)((PBYTE)index->Module + names[i]));
+
+		if (!index->Exports.contains(hash))
+			index->Exports.insert(hash, functions[ordinals[i]]);
+	}
+}
+
+static bool SearchExports(const ExportIndex_t *index, const ExportQuery_t &query, void **result, const char **forwarder)
+{
+	uint32_t rva;
+
+	if (query.ByOrdinal)
+	{
+		if (query.Ordinal < index->OrdinalBase || query.Ordinal - index->OrdinalBase >= index->FunctionCount)
+			return false;
+
+		// Unused slots of the table are zero.
+		rva = index->Functions[query.Ordinal - index->OrdinalBase];
+
+		if (rva == 0)
+			return false;
+	}
+	else
+	{
+		auto entry = index->Exports.find(query.SymbolHash);
+
+		if (!entry)
+			return false;
+
+		rva = *entry;
+	}
+
+	void *address = PtrAdvance(index->Module, rva);
+
+	if (rva >= index->DirectoryBegin && rva < index->DirectoryEnd)
+		*forwarder = static_cast<const char *>(address);
+	else
+		*result = address;
+
+	return true;
+}
+
+//
+// Searches the index, building the missing parts only if `build` is set; the lock must then be
+// held exclusively, otherwise at least shared.
+//
+// Returns `false` if a missing part is needed and `build` is not set.
+//
+static bool SearchExportIndex(ExportQuery_t &query, bool build, void **result, const char **forwarder)
+{
+	if (!gExportModulesValid)
+	{
+		if (!build)
+			return false;
+
+		BuildModuleIndex();
+	}
+
+	if (query.Module || query.ModuleHash != 0)
+	{
+		ExportIndex_t *const *index = query.Module ? gExportIndices.find(query.Module) : gExportModulesByName.find(query.ModuleHash);
+
+		if (!index)
+			return true;
+
+		if (!(*index)->Built)
+		{
+			if (!build)
+				return false;
+
+			BuildExportIndex(*index);
+		}
+
+		SearchExports(*index, query, result, forwarder);
+		return true;
+	}
+
+	// The list may have been rebuilt since the last match; go on after the module matched there.
+	if (query.Next != 0 && (query.Next > gExportModules.size() || gExportModules[query.Next - 1]->Module != query.Last))
+	{
+		for (size_t i = 0; i < gExportModules.size(); ++i)
+		{
+			if (gExportModules[i]->Module == query.Last)
+			{
+				query.Next = i + 1;
+				break;
+			}
+		}
+	}
+
+	for (size_t i = query.Next; i < gExportModules.size(); ++i)
+	{
+		ExportIndex_t *index = gExportModules[i];
+
+		if (!index->Built)
+		{
+			if (!build)
+				return false;
+
+			BuildExportIndex(index);
+		}
+
+		if (SearchExports(index, query, result, forwarder))
+		{
+			query.Next = i + 1;
+			query.Last = index->Module;
+			return true;
+		}
+	}
+
+	return true;
+}
+
+static VOID CALLBACK OnDllNotification(ULONG reason, const LDR_DLL_NOTIFICATION_DATA *data, PVOID context)
+{
+	AcquireSRWLockExclusive(&gExportIndexLock);
+
+	gExportModulesValid = false;
+
+	if (reason == LDR_DLL_NOTIFICATION_REASON_UNLOADED)
+	{
+		HMODULE module = reinterpret_cast<HMODULE>(data->DllBase);
+
+		if (auto index = gExportIndices.find(module))
+		{
+			delete *index;
+			gExportIndices.erase(module);
+		}
+	}
+
+	ReleaseSRWLockExclusive(&gExportIndexLock);
+}
+
+static void RegisterDllNotification()
+{
+	if (InterlockedCompareExchange(&gDllNotificationState, 1, 0) != 0)
+		return;
+
+	constexpr fnv1a_t kNtdllHash = FNV1a64("ntdll.dll");
+	constexpr fnv1a_t kRegisterHash = FNV1a64("LdrRegisterDllNotification");
+	constexpr fnv1a_t kUnregisterHash = FNV1a64("LdrUnregisterDllNotification");
+
+	void *registerFn = nullptr;
+	void *unregisterFn = nullptr;
+	const char *forwarder = nullptr;
+
+	ExportQuery_t registerQuery{};
+	registerQuery.ModuleHash = kNtdllHash;
+	registerQuery.SymbolHash = kRegisterHash;
+
+	ExportQuery_t unregisterQuery{};
+	unregisterQuery.ModuleHash = kNtdllHash;
+	unregisterQuery.SymbolHash = kUnregisterHash;
+
+	AcquireSRWLockExclusive(&gExportIndexLock);
+
+	SearchExportIndex(registerQuery, true, &registerFn, &forwarder);
+	SearchExportIndex(unregisterQuery, true, &unregisterFn, &forwarder);
+
+	ReleaseSRWLockExclusive(&gExportIndexLock);
+
+	// Not called with the lock held: the loader may be delivering a notification,
+	// which waits for the lock, while holding its own.
+	if (registerFn && unregisterFn &&
+		reinterpret_cast<LdrRegisterDllNotificationFn_t>(registerFn)(0, OnDllNotification, nullptr, &gDllNotificationCookie) >= 0)
+	{
+		gLdrUnregisterDllNotification = reinterpret_cast<LdrUnregisterDllNotificationFn_t>(unregisterFn);
+
+		if (InterlockedExchange(&gExportIndexExitRegistered, 1) == 0)
+			RegisterOnExitCallback(FreeExportIndex);
+	}
+
+	// A module may have been loaded while the list was built without notifications.
+	AcquireSRWLockExclusive(&gExportIndexLock);
+	gExportModulesValid = false;
+	ReleaseSRWLockExclusive(&gExportIndexLock);
+}
+
+static void *ResolveForwardExport(const char *forward_str, int depth);
 
-static bool IsForwardExport(void *function_ptr, PIMAGE_EXPORT_DIRECTORY exportDir, DWORD exportSize)
+static void *LookupExport(ExportQuery_t &query, int depth)
 {
-	BYTE *ptr = (BYTE *)function_ptr;
-	BYTE *start = (BYTE *)exportDir;
-	BYTE *end = start + exportSize;
+	RegisterDllNotification();
+
+	for (;;)
+	{
+		void *result = nullptr;
+		const char *forwarder = nullptr;
+
+		AcquireSRWLockShared(&gExportIndexLock);
+		bool found = SearchExportIndex(query, false, &result, &forwarder);
+		ReleaseSRWLockShared(&gExportIndexLock);
+
+		if (!found)
+		{
+			AcquireSRWLockExclusive(&gExportIndexLock);
+			SearchExportIndex(query, true, &result, &forwarder);
+			ReleaseSRWLockExclusive(&gExportIndexLock);
+		}
+
+		if (!forwarder)
+			return result;
+
+		// Resolved outside of the lock, the target module is looked up the same way.
+		if (depth < kMaxForwarderDepth && (result = ResolveForwardExport(forwarder, depth + 1)) != nullptr)
+			return result;
 
-	return ptr >= start && ptr < end;
+		// A forwarder that cannot be resolved does not hide an export of the same name in a later module.
+		if (query.Module || query.ModuleHash != 0)
+			return nullptr;
+	}
 }
 
-static void *ResolveForwardExport(const char *forward_str, bool force_load_library)
+static void *ResolveForwardExport(const char *forward_str, int depth)
 {
 	char dll_name_raw[256];
 	char func_name[256];
@@ -480,168 +961,119 @@ static void *ResolveForwardExport(const char *forward_str, bool force_load_libra
 	if (len < 4 || StrLCompA(dll_name_full + len - 4, const_cast<const char *>(suffix), 4) != 0)
 		StrNCatA(dll_name_full, const_cast<const char *>(suffix), 4);
 
-	HMODULE module = GetModuleHandleDirect(FNV1a64(dll_name_full));
-	if (!module)
-	{
-		// TODO: force_load_library
-		return nullptr;
-	}
+	ExportQuery_t query{};
 
-	PIMAGE_DOS_HEADER dosHeader = (PIMAGE_DOS_HEADER)module;
-	if (dosHeader->e_magic != IMAGE_DOS_SIGNATURE)
-		return nullptr;
-
-	PIMAGE_NT_HEADERS ntHeaders = (PIMAGE_NT_HEADERS)((PBYTE)module + dosHeader->e_lfanew);
-	if (ntHeaders->Signature != IMAGE_NT_SIGNATURE)
-		return nullptr;
-
-	PIMAGE_EXPORT_DIRECTORY exportDir = (PIMAGE_EXPORT_DIRECTORY)((PBYTE)module + ntHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress);
-	DWORD exportSize = ntHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].Size;
-
-	if (!exportDir || exportSize == 0)
-		return nullptr;
-
-	PDWORD functions = (PDWORD)((PBYTE)module + exportDir->AddressOfFunctions);
-	PDWORD names = (PDWORD)((PBYTE)module + exportDir->AddressOfNames);
-	PWORD ordinals = (PWORD)((PBYTE)module + exportDir->AddressOfNameOrdinals);
-
-	for (DWORD i = 0; i < exportDir->NumberOfNames; i++)
+	if (func_name[0] == '#')
 	{
-		const char *name = (const char *)((PBYTE)module + names[i]);
+		if (func_name[1] == '\0')
+			return nullptr;
+
+		query.ByOrdinal = true;
 
-		if (StrCompA(name, func_name) == 0)
+		for (const char *digit = &func_name[1]; *digit; ++digit)
 		{
-			if (ordinals[i] >= exportDir->NumberOfFunctions)
+			if (*digit < '0' || *digit > '9' || query.Ordinal > 0xFFFF)
 				return nullptr;
 
-			return (void *)((PBYTE)module + functions[ordinals[i]]);
+			query.Ordinal = query.Ordinal * 10 + (*digit - '0');
 		}
 	}
-
-	return nullptr;
-}
-
-static void EnumExports(HMODULE hModule, EnumExports_t fn, LPVOID param)
-{
-	struct Args_t
+	else
 	{
-		HMODULE Target;
-		EnumExports_t Processor;
-		LPVOID Param;
-	} args;
+		query.SymbolHash = FNV1a64(func_name);
+	}
 
-	args.Target = hModule;
-	args.Processor = fn;
-	args.Param = param;
+	query.Module = GetModuleHandleDirect(FNV1a64(dll_name_full));
 
-	EnumModules(+[](PLDR_DATA_TABLE_ENTRY entry, LPVOID param) -> bool
-		{
-			Args_t *args = reinterpret_cast<Args_t *>(param);
+	if (!query.Module)
+	{
+		// API set names are only known to the loader, which also loads the target if needed,
+		// as it would when binding an import of the forwarded name.
+		query.Module = GetModuleHandleA(dll_name_full);
 
-			if (args->Target && entry->DllBase != args->Target)
-				return true;
+		if (!query.Module)
+			query.Module = LoadLibraryA(dll_name_full);
 
-			HMODULE hModule = (HMODULE)entry->DllBase;
+		if (!query.Module)
+			return nullptr;
 
-			PIMAGE_DOS_HEADER dosHeader = (PIMAGE_DOS_HEADER)hModule;
-			if (dosHeader->e_magic != IMAGE_DOS_SIGNATURE)
-				return true;
+		// Without DLL notifications the module list may not know the module yet.
+		AcquireSRWLockExclusive(&gExportIndexLock);
 
-			PIMAGE_NT_HEADERS ntHeaders = (PIMAGE_NT_HEADERS)((PBYTE)hModule + dosHeader->e_lfanew);
-			if (ntHeaders->Signature != IMAGE_NT_SIGNATURE)
-				return true;
+		if (!gExportIndices.contains(query.Module))
+			gExportModulesValid = false;
 
-			PIMAGE_EXPORT_DIRECTORY exportDir = (PIMAGE_EXPORT_DIRECTORY)((PBYTE)hModule + ntHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress);
-			DWORD exportSize = ntHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].Size;
+		ReleaseSRWLockExclusive(&gExportIndexLock);
+	}
 
-			if (!exportDir || exportSize == 0)
-				return true;
+	return LookupExport(query, depth);
+}
 
-			PDWORD functions = (PDWORD)((PBYTE)hModule + exportDir->AddressOfFunctions);
-			PDWORD names = (PDWORD)((PBYTE)hModule + exportDir->AddressOfNames);
-			PWORD ordinals = (PWORD)((PBYTE)hModule + exportDir->AddressOfNameOrdinals);
+void FreeExportIndex()
+{
+	if (gLdrUnregisterDllNotification)
+	{
+		gLdrUnregisterDllNotification(gDllNotificationCookie);
 
-			for (DWORD i = 0; i < exportDir->NumberOfNames; i++)
-			{
-				if (ordinals[i] >= exportDir->NumberOfFunctions)
-					continue;
+		gLdrUnregisterDllNotification = nullptr;
+		gDllNotificationCookie = nullptr;
+	}
 
-				const char *function_name = (const char *)((PBYTE)hModule + names[i]);
-				void *function_ptr = (void *)((PBYTE)hModule + functions[ordinals[i]]);
+	AcquireSRWLockExclusive(&gExportIndexLock);
 
-				if (IsForwardExport(function_ptr, exportDir, exportSize))
-				{
-					function_ptr = ResolveForwardExport(static_cast<const char *>(function_ptr), true);
+	gExportIndices.for_each([](HMODULE, ExportIndex_t *index) { delete index; });
+	gExportIndices.clear();
 
-					if (!function_ptr)
-						continue;
-				}
+	gExportModules.clear();
+	gExportModulesByName.clear();
+	gExportModulesValid = false;
 
-				if (!args->Processor(entry, function_name, function_ptr, ordinals[i], args->Param))
-					return false;
-			}
+	ReleaseSRWLockExclusive(&gExportIndexLock);
 
-			return true;
-		}, &args);
+	InterlockedExchange(&gDllNotificationState, 0);
 }
 
 HMODULE GetModuleHandleDirect(fnv1a_t module_name_hash)
 {
-	struct Args_t
-	{
-		HMODULE Result;
-		uint64_t Hash;
-	} args;
+	RegisterDllNotification();
 
-	args.Result = nullptr;
-	args.Hash = module_name_hash;
+	HMODULE result = nullptr;
 
-	EnumModules(+[](PLDR_DATA_TABLE_ENTRY entry, LPVOID param) -> bool
-		{
-			Args_t *args = reinterpret_cast<Args_t *>(param);
+	AcquireSRWLockShared(&gExportIndexLock);
 
-			if (FNV1a64(entry->BaseDllName.Buffer) == args->Hash)
-			{
-				args->Result = reinterpret_cast<HMODULE>(entry->DllBase);
-				return false;
-			}
+	bool valid = gExportModulesValid;
 
-			return true;
-		}, &args);
+	if (valid)
+	{
+		if (auto index = gExportModulesByName.find(module_name_hash))
+			result = (*index)->Module;
+	}
 
-	return args.Result;
-}
+	ReleaseSRWLockShared(&gExportIndexLock);
 
-void *GetProcAddressDirect(fnv1a_t module_name_hash, fnv1a_t function_name_hash)
-{
-	struct Args_t
+	if (!valid)
 	{
-		uint64_t ModuleHash;
-		uint64_t SymbolHash;
-		void *Result;
-	} args;
+		AcquireSRWLockExclusive(&gExportIndexLock);
 
-	args.ModuleHash = module_name_hash;
-	args.SymbolHash = function_name_hash;
-	args.Result = nullptr;
+		if (!gExportModulesValid)
+			BuildModuleIndex();
 
-	EnumExports(NULL, +[](PLDR_DATA_TABLE_ENTRY entry, const char *name, void *address, WORD ordinal, LPVOID param) -> bool
-		{
-			Args_t *args = reinterpret_cast<Args_t *>(param);
+		if (auto index = gExportModulesByName.find(module_name_hash))
+			result = (*index)->Module;
 
-			if (args->ModuleHash != 0 && FNV1a64(entry->BaseDllName.Buffer) != args->ModuleHash)
-				return true;
+		ReleaseSRWLockExclusive(&gExportIndexLock);
+	}
 
-			if (FNV1a64(name) == args->SymbolHash)
-			{
-				args->Result = address;
-				return false;
-			}
+	return result;
+}
 
-			return true;
-		}, &args);
+void *GetProcAddressDirect(fnv1a_t module_name_hash, fnv1a_t function_name_hash)
+{
+	ExportQuery_t query{};
+	query.ModuleHash = module_name_hash;
+	query.SymbolHash = function_name_hash;
 
-	return args.Result;
+	return LookupExport(query, 0);
 }
 
 void *GetProcAddressDirect(fnv1a_t function_name_hash)
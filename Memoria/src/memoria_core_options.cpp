@@ -13,6 +13,13 @@ struct MemoriaContext_t
 	// It is recommended to disable this if you're confident that the memory is guaranteed to be valid.
 	bool SafeMode = true;
 
+	// Hooks are installed and removed with `WriteCodeAtomic` instead of `WriteMemory`,
+	// so they can be toggled while other threads execute the patched code.
+	//
+	// Disabled by default, because publishing through `cmpxchg` and the guard protocol
+	// is slower than a plain copy when no other thread can run the code.
+	bool HotPatch = false;
+
 	MemoriaContext_t() = default;
 };
 
@@ -28,4 +35,14 @@ bool IsSafeModeActive()
 	return memoria_ctx.SafeMode;
 }
 
+void SetHotPatchModeState(bool value)
+{
+	memoria_ctx.HotPatch = value;
+}
+
+bool IsHotPatchModeActive()
+{
+	return memoria_ctx.HotPatch;
+}
+
 MEMORIA_END
\ No newline at end of file
@@ -8,145 +8,125 @@
 
 MEMORIA_BEGIN
 
-std::optional<uint8_t> ReadU8(const void *addr, ptrdiff_t offset)
+// Copies small power-of-two sizes with a single unaligned load.
+static __forceinline void CopyElement(void *dest, const void *source, size_t size)
 {
-	if (IsSafeModeActive() && !IsMemoryValid(addr, offset))
+	switch (size)
 	{
-		SetError(ME_INVALID_MEMORY);
-		return std::nullopt;
+	case 1: *static_cast<uint8_t *>(dest) = *static_cast<const uint8_t *>(source); break;
+	case 2: *static_cast<uint16_t *>(dest) = *static_cast<const uint16_t UNALIGNED *>(source); break;
+	case 4: *static_cast<uint32_t *>(dest) = *static_cast<const uint32_t UNALIGNED *>(source); break;
+	case 8: *static_cast<uint64_t *>(dest) = *static_cast<const uint64_t UNALIGNED *>(source); break;
+	default: MemCopy(dest, source, size); break;
 	}
-
-	return *reinterpret_cast<uint8_t *>(reinterpret_cast<uintptr_t>(addr) + offset);
 }
 
-std::optional<uint16_t> ReadU16(const void *addr, ptrdiff_t offset)
+// In safe mode the read is attempted under a guard instead of querying the memory first,
+// so a successful read costs no system call.
+static __forceinline bool ReadElement(void *dest, const void *source, size_t size)
 {
-	if (IsSafeModeActive() && !IsMemoryValid(addr, offset))
+	if (!IsSafeModeActive())
 	{
-		SetError(ME_INVALID_MEMORY);
-		return std::nullopt;
+		CopyElement(dest, source, size);
+		return true;
 	}
-	return *reinterpret_cast<uint16_t *>(reinterpret_cast<uintptr_t>(addr) + offset);
-}
 
-std::optional<uint32_t> ReadU24(const void *addr, ptrdiff_t offset)
-{
-	if (IsSafeModeActive() && !IsMemoryValid(addr, offset))
+	if (!source || !GuardedCopy(dest, source, size))
 	{
 		SetError(ME_INVALID_MEMORY);
-		return std::nullopt;
+		return false;
 	}
 
-	uint32_t value = (*reinterpret_cast<uint8_t *>(reinterpret_cast<uintptr_t>(addr) + offset)) |
-		((*reinterpret_cast<uint8_t *>(reinterpret_cast<uintptr_t>(addr) + offset + 1)) << 8) |
-		((*reinterpret_cast<uint8_t *>(reinterpret_cast<uintptr_t>(addr) + offset + 2)) << 16);
+	return true;
+}
+
+template <typename T>
+static std::optional<T> ReadValue(const void *addr, ptrdiff_t offset)
+{
+	T value;
+
+	if (!ReadElement(&value, reinterpret_cast<const void *>(reinterpret_cast<uintptr_t>(addr) + offset), sizeof(T)))
+		return std::nullopt;
 
 	return value;
 }
 
-std::optional<uint32_t> ReadU32(const void *addr, ptrdiff_t offset)
+static std::optional<uint32_t> ReadValue24(const void *addr, ptrdiff_t offset)
 {
-	if (IsSafeModeActive() && !IsMemoryValid(addr, offset))
-	{
-		SetError(ME_INVALID_MEMORY);
+	uint8_t bytes[3];
+
+	if (!ReadElement(bytes, reinterpret_cast<const void *>(reinterpret_cast<uintptr_t>(addr) + offset), sizeof(bytes)))
 		return std::nullopt;
-	}
-	return *reinterpret_cast<uint32_t *>(reinterpret_cast<uintptr_t>(addr) + offset);
+
+	return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) | (static_cast<uint32_t>(bytes[2]) << 16);
 }
 
-std::optional<uint64_t> ReadU64(const void *addr, ptrdiff_t offset)
+std::optional<uint8_t> ReadU8(const void *addr, ptrdiff_t offset)
 {
-	if (IsSafeModeActive() && !IsMemoryValid(addr, offset))
-	{
-		SetError(ME_INVALID_MEMORY);
-		return std::nullopt;
-	}
+	return ReadValue<uint8_t>(addr, offset);
+}
 
-	return *reinterpret_cast<uint64_t *>(reinterpret_cast<uintptr_t>(addr) + offset);
+std::optional<uint16_t> ReadU16(const void *addr, ptrdiff_t offset)
+{
+	return ReadValue<uint16_t>(addr, offset);
 }
 
-std::optional<int8_t> ReadI8(const void *addr, ptrdiff_t offset)
+std::optional<uint32_t> ReadU24(const void *addr, ptrdiff_t offset)
 {
-	if (IsSafeModeActive() && !IsMemoryValid(addr, offset))
-	{
-		SetError(ME_INVALID_MEMORY);
-		return std::nullopt;
-	}
+	return ReadValue24(addr, offset);
+}
 
-	return *reinterpret_cast<int8_t *>(reinterpret_cast<uintptr_t>(addr) + offset);
+std::optional<uint32_t> ReadU32(const void *addr, ptrdiff_t offset)
+{
+	return ReadValue<uint32_t>(addr, offset);
 }
 
-std::optional<int16_t> ReadI16(const void *addr, ptrdiff_t offset)
+std::optional<uint64_t> ReadU64(const void *addr, ptrdiff_t offset)
 {
-	if (IsSafeModeActive() && !IsMemoryValid(addr, offset))
-	{
-		SetError(ME_INVALID_MEMORY);
-		return std::nullopt;
-	}
+	return ReadValue<uint64_t>(addr, offset);
+}
+
+std::optional<int8_t> ReadI8(const void *addr, ptrdiff_t offset)
+{
+	return ReadValue<int8_t>(addr, offset);
+}
 
-	return *reinterpret_cast<int16_t *>(reinterpret_cast<uintptr_t>(addr) + offset);
+std::optional<int16_t> ReadI16(const void *addr, ptrdiff_t offset)
+{
+	return ReadValue<int16_t>(addr, offset);
 }
 
 std::optional<int32_t> ReadI24(const void *addr, ptrdiff_t offset)
 {
-	if (IsSafeModeActive() && !IsMemoryValid(addr, offset))
-	{
-		SetError(ME_INVALID_MEMORY);
-		return std::nullopt;
-	}
+	auto value = ReadValue24(addr, offset);
 
-	uint32_t value = (*reinterpret_cast<const uint8_t *>(reinterpret_cast<uintptr_t>(addr) + offset)) |
-		((*reinterpret_cast<const uint8_t *>(reinterpret_cast<uintptr_t>(addr) + offset + 1)) << 8) |
-		((*reinterpret_cast<const uint8_t *>(reinterpret_cast<uintptr_t>(addr) + offset + 2)) << 16);
+	if (!value)
+		return std::nullopt;
 
-	if (value & 0x800000)
-		value |= 0xFF000000;
+	if (*value & 0x800000)
+		*value |= 0xFF000000;
 
-	return static_cast<int32_t>(value);
+	return static_cast<int32_t>(*value);
 }
 
 std::optional<int32_t> ReadI32(const void *addr, ptrdiff_t offset)
 {
-	if (IsSafeModeActive() && !IsMemoryValid(addr, offset))
-	{
-		SetError(ME_INVALID_MEMORY);
-		return std::nullopt;
-	}
-
-	return *reinterpret_cast<int32_t *>(reinterpret_cast<uintptr_t>(addr) + offset);
+	return ReadValue<int32_t>(addr, offset);
 }
 
 std::optional<int64_t> ReadI64(const void *addr, ptrdiff_t offset)
 {
-	if (IsSafeModeActive() && !IsMemoryValid(addr, offset))
-	{
-		SetError(ME_INVALID_MEMORY);
-		return std::nullopt;
-	}
-
-	return *reinterpret_cast<int64_t *>(reinterpret_cast<uintptr_t>(addr) + offset);
+	return ReadValue<int64_t>(addr, offset);
 }
 
 std::optional<float> ReadFloat(const void *addr, ptrdiff_t offset)
 {
-	if (IsSafeModeActive() && !IsMemoryValid(addr, offset))
-	{
-		SetError(ME_INVALID_MEMORY);
-		return std::nullopt;
-	}
-
-	return *reinterpret_cast<float *>(reinterpret_cast<uintptr_t>(addr) + offset);
+	return ReadValue<float>(addr, offset);
 }
 
 std::optional<double> ReadDouble(const void *addr, ptrdiff_t offset)
 {
-	if (IsSafeModeActive() && !IsMemoryValid(addr, offset))
-	{
-		SetError(ME_INVALID_MEMORY);
-		return std::nullopt;
-	}
-
-	return *reinterpret_cast<double *>(reinterpret_cast<uintptr_t>(addr) + offset);
+	return ReadValue<double>(addr, offset);
 }
 
 bool ReadAStr(const void *addr, char *out, size_t max_size, ptrdiff_t offset)
@@ -154,14 +134,22 @@ bool ReadAStr(const void *addr, char *out, size_t max_size, ptrdiff_t offset)
 	if (!out || max_size == 0)
 		return false;
 
-	if (IsSafeModeActive() && !IsMemoryValid(addr, offset))
+	const char *src = reinterpret_cast<const char *>(reinterpret_cast<uintptr_t>(addr) + offset);
+
+	if (!IsSafeModeActive())
 	{
+		StrNCopySafeA(out, max_size, src, _TRUNCATE);
+		return true;
+	}
+
+	if (!src || !GuardedInvoke([&]() { StrNCopySafeA(out, max_size, src, _TRUNCATE); }))
+	{
+		out[0] = '\0';
+
 		SetError(ME_INVALID_MEMORY);
 		return false;
 	}
 
-	const char *src = reinterpret_cast<const char *>(reinterpret_cast<uintptr_t>(addr) + offset);
-	StrNCopySafeA(out, max_size, src, _TRUNCATE);
 	return true;
 }
 
@@ -170,17 +158,93 @@ bool ReadWStr(const void *addr, wchar_t *out, size_t max_size, ptrdiff_t offset)
 	if (!out || max_size == 0)
 		return false;
 
-	if (IsSafeModeActive() && !IsMemoryValid(addr, offset))
+	const wchar_t *src = reinterpret_cast<const wchar_t *>(reinterpret_cast<uintptr_t>(addr) + offset);
+
+	if (!IsSafeModeActive())
 	{
+		StrNCopySafeW(out, max_size, src, _TRUNCATE);
+		return true;
+	}
+
+	if (!src || !GuardedInvoke([&]() { StrNCopySafeW(out, max_size, src, _TRUNCATE); }))
+	{
+		out[0] = L'\0';
+
 		SetError(ME_INVALID_MEMORY);
 		return false;
 	}
 
-	const wchar_t *src = reinterpret_cast<const wchar_t *>(reinterpret_cast<uintptr_t>(addr) + offset);
-	StrNCopySafeW(out, max_size, src, _TRUNCATE);
 	return true;
 }
 
+bool ReadRaw(const void *addr, void *out, size_t size, ptrdiff_t offset)
+{
+	return ReadElement(out, reinterpret_cast<const void *>(reinterpret_cast<uintptr_t>(addr) + offset), size);
+}
+
+size_t ReadGather(const void *const *addrs, size_t count, void *out, size_t element_size, bool *valid)
+{
+	auto dest = static_cast<uint8_t *>(out);
+	size_t result = 0;
+
+	if (!IsSafeModeActive())
+	{
+		for (size_t i = 0; i < count; ++i)
+			CopyElement(&dest[i * element_size], addrs[i], element_size);
+
+		if (valid)
+			MemFill(valid, true, count * sizeof(bool));
+
+		return count;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		bool readable = addrs[i] && GuardedCopy(&dest[i * element_size], addrs[i], element_size);
+
+		if (!readable)
+			MemFill(&dest[i * element_size], 0, element_size);
+
+		if (valid)
+			valid[i] = readable;
+
+		result += readable;
+	}
+
+	if (result != count)
+		SetError(ME_INVALID_MEMORY);
+
+	return result;
+}
+
+size_t ReadFields(const void *base, std::span<const ReadField_t> fields)
+{
+	bool safe_mode = IsSafeModeActive();
+	size_t result = 0;
+
+	for (auto &field : fields)
+	{
+		auto addr = reinterpret_cast<const void *>(reinterpret_cast<uintptr_t>(base) + field.Offset);
+
+		if (!safe_mode)
+		{
+			CopyElement(field.Out, addr, field.Size);
+		}
+		else if (!base || !GuardedCopy(field.Out, addr, field.Size))
+		{
+			MemFill(field.Out, 0, field.Size);
+			continue;
+		}
+
+		++result;
+	}
+
+	if (result != fields.size())
+		SetError(ME_INVALID_MEMORY);
+
+	return result;
+}
+
 bool GetMemoryBlock(const void *source, size_t size, void *dest)
 {
 	if (source == nullptr || dest == nullptr)
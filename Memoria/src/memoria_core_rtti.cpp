@@ -8,6 +8,24 @@
 
 MEMORIA_BEGIN
 
+// x86 images refer to the RTTI structures by address, x64 images by RVA.
+#ifdef MEMORIA_64BIT
+template <typename T>
+using RTTIRef = int32_t;
+
+static constexpr unsigned long kLocatorSignature = 1;
+#else
+template <typename T>
+using RTTIRef = T *;
+
+static constexpr unsigned long kLocatorSignature = 0;
+#endif
+
+// Base class descriptor attribute: `ClassDescriptor` is present.
+static constexpr unsigned long kBaseHasHierarchy = 0x40;
+
+struct RTTIClassHierarchyDescriptor;
+
 // Structure that represents the RTTI type descriptor
 struct RTTITypeDescriptor
 {
@@ -34,20 +52,22 @@ struct PtrToMember
 struct RTTIBaseClassDescriptor
 {
 	// TypeDescriptor of this base class
-	RTTITypeDescriptor *TypeDescriptor;
+	RTTIRef<RTTITypeDescriptor> TypeDescriptor;
 	// Number of direct bases of this base class
 	unsigned long NumContainedBases;
 	// Pointer-to-member displacement info
 	PtrToMember Where;
 	// Flags, usually 0
 	unsigned long Attributes;
+	// Class Hierarchy information of this base class, if `kBaseHasHierarchy` is set
+	RTTIRef<RTTIClassHierarchyDescriptor> ClassDescriptor;
 };
 
 // Structure for the base class array
 struct RTTIBaseClassArray
 {
 	// Array of base class descriptors
-	RTTIBaseClassDescriptor *ArrayOfBaseClassDescriptors[1];
+	RTTIRef<RTTIBaseClassDescriptor> ArrayOfBaseClassDescriptors[1];
 };
 
 // Structure for the class hierarchy descriptor
@@ -60,24 +80,39 @@ struct RTTIClassHierarchyDescriptor
 	// Number of base classes. Count includes the class itself
 	unsigned long NumBaseClasses;
 	// Array of base class descriptors
-	RTTIBaseClassArray *BaseClassArray;
+	RTTIRef<RTTIBaseClassArray> BaseClassArray;
 };
 
 // Structure for the complete object locator
 struct RTTICompleteObjectLocator
 {
-	// Always 0?
+	// 0 on x86, 1 on x64
 	unsigned long Signature;
 	// Offset of VFTable within the class
 	unsigned long Offset;
 	// Constructor displacement offset
 	unsigned long CDOffset;
 	// Class Information
-	RTTITypeDescriptor *TypeDescriptor;
+	RTTIRef<RTTITypeDescriptor> TypeDescriptor;
 	// Class Hierarchy information
-	RTTIClassHierarchyDescriptor *ClassDescriptor;
+	RTTIRef<RTTIClassHierarchyDescriptor> ClassDescriptor;
+#ifdef MEMORIA_64BIT
+	// RVA of this locator
+	RTTIRef<RTTICompleteObjectLocator> Self;
+#endif
 };
 
+template <typename T>
+static T *ResolveRTTIRef(uintptr_t image_base, RTTIRef<T> ref)
+{
+#ifdef MEMORIA_64BIT
+	return reinterpret_cast<T *>(image_base + static_cast<uint32_t>(ref));
+#else
+	(void)image_base;
+	return ref;
+#endif
+}
+
 //static const char *rtti_headers[] =
 //{
 //	// Class type identifier
@@ -170,13 +205,53 @@ void *GetRTTIDescriptor(const void *addr_start, const void *addr_min, const void
 
 void **GetVTableForDescriptor(const void *addr_start, const void *addr_min, const void *addr_max, const void *rtti_descriptor)
 {
+#ifdef MEMORIA_64BIT
+	// Locators refer to the descriptor by RVA, which is neither an absolute nor a relative
+	// reference, so the RVA itself is searched for.
+	auto image_base = reinterpret_cast<uintptr_t>(GetBaseAddress(rtti_descriptor));
+
+	if (!image_base)
+	{
+		SetError(ME_NOT_FOUND);
+		return nullptr;
+	}
+
+	uint32_t rva = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(rtti_descriptor) - image_base);
+
+	// Locators are 4-byte aligned, so only aligned candidates within the range are read.
+	uintptr_t begin = reinterpret_cast<uintptr_t>(addr_start > addr_min ? addr_start : addr_min);
+	uintptr_t end = reinterpret_cast<uintptr_t>(addr_max);
+
+	for (uintptr_t addr = (begin + 3) & ~static_cast<uintptr_t>(3); addr < end && end - addr >= sizeof(RTTICompleteObjectLocator); addr += 4)
+	{
+		auto l = reinterpret_cast<const RTTICompleteObjectLocator *>(addr);
+
+		if (static_cast<uint32_t>(l->TypeDescriptor) != rva)
+			continue;
+
+		// The signature is 1 on x64, and a locator refers to itself, which rules out other
+		// values that equal the RVA.
+		if (l->Signature != kLocatorSignature || l->Offset != 0 || l->CDOffset != 0 ||
+			static_cast<uint32_t>(l->Self) != static_cast<uint32_t>(addr - image_base))
+		{
+			continue;
+		}
+
+		// The vtable is preceded by the address of its locator.
+		if (auto vmt = FindReference(addr_start, addr_min, addr_max, l, 0, true, false))
+			return (void **)PtrOffset(vmt, sizeof(void *));
+	}
+
+	SetError(ME_NOT_FOUND);
+	return nullptr;
+#else
 	auto refs = FindReferences(addr_start, addr_min, addr_max, rtti_descriptor, 0, true, true, false, false, 4, 0);
 	
 	for (auto &ref : refs)
 	{
 		RTTICompleteObjectLocator *l = (RTTICompleteObjectLocator *)((char *)ref.xref - sizeof(unsigned long) * 3);
 
-		if (l->Signature == 0 && l->Offset == 0 && l->CDOffset == 0)
+		if (l->Signature == kLocatorSignature && l->Offset == 0 && l->CDOffset == 0)
 		{
 			if (auto vmt = FindReference(addr_start, addr_min, addr_max, l, 0, true, true))
 			{
@@ -186,6 +261,7 @@ void **GetVTableForDescriptor(const void *addr_start, const void *addr_min, cons
 	}
 
 	return nullptr;
+#endif
 }
 
 void **GetVTableForClass(const void *addr_start, const void *addr_min, const void *addr_max, const char *rtti_name)
@@ -197,4 +273,425 @@ void **GetVTableForClass(const void *addr_start, const void *addr_min, const voi
 	return GetVTableForDescriptor(addr_start, addr_min, addr_max, desc);
 }
 
+//
+// CRttiCatalog
+//
+
+// Case-insensitive, same as the name comparison of `GetRTTIDescriptor`.
+static fnv1a_t HashTypeName(const char *name)
+{
+	fnv1a_t hash = FNV1A_64_BASIS;
+
+	for (; *name; ++name)
+		hash = (hash ^ static_cast<uint8_t>(tolower_constexpr(*name))) * FNV1A_64_PRIME;
+
+	return hash;
+}
+
+// Decorates a plain class name: `ns::CFoo` becomes `.?AVCFoo@ns@@` for `kind` 'V'.
+static bool DecorateClassName(const char *name, char kind, char *out, size_t max_size)
+{
+	if (StrLenA(name) + 7 > max_size)
+		return false;
+
+	const char *components[32];
+	size_t lengths[32];
+	size_t count = 0;
+
+	const char *component = name;
+
+	for (const char *p = name; ; ++p)
+	{
+		if (*p != '\0' && !(p[0] == ':' && p[1] == ':'))
+			continue;
+
+		if (p == component || count == _countof(components))
+			return false;
+
+		components[count] = component;
+		lengths[count++] = p - component;
+
+		if (*p == '\0')
+			break;
+
+		component = ++p + 1;
+	}
+
+	size_t pos = 0;
+
+	out[pos++] = '.';
+	out[pos++] = '?';
+	out[pos++] = 'A';
+	out[pos++] = kind;
+
+	// Innermost name first.
+	while (count--)
+	{
+		MemCopy(&out[pos], components[count], lengths[count]);
+		pos += lengths[count];
+		out[pos++] = '@';
+	}
+
+	out[pos++] = '@';
+	out[pos] = '\0';
+
+	return true;
+}
+
+bool CRttiCatalog::IsInImage(uintptr_t addr, size_t size) const
+{
+	return addr >= _image_begin && addr <= _image_end && size <= _image_end - addr;
+}
+
+const char *CRttiCatalog::GetTypeName(const void *type_descriptor) const
+{
+	uintptr_t addr = reinterpret_cast<uintptr_t>(type_descriptor);
+
+	if ((addr & (sizeof(void *) - 1)) != 0 || !IsInImage(addr, sizeof(RTTITypeDescriptor) + 3))
+		return nullptr;
+
+	const char *name = static_cast<const RTTITypeDescriptor *>(type_descriptor)->Name;
+
+	if (name[0] != '.' || name[1] != '?' || name[2] != 'A')
+		return nullptr;
+
+	// The name has to end inside the image.
+	size_t max_length = _image_end - reinterpret_cast<uintptr_t>(name);
+
+	for (size_t i = 3; i < max_length; ++i)
+	{
+		if (name[i] == '\0')
+			return name;
+	}
+
+	return nullptr;
+}
+
+const void *CRttiCatalog::GetLocator(uintptr_t addr) const
+{
+	if ((addr & 3) != 0 || !IsInImage(addr, sizeof(RTTICompleteObjectLocator)))
+		return nullptr;
+
+	auto locator = reinterpret_cast<const RTTICompleteObjectLocator *>(addr);
+
+	if (locator->Signature != kLocatorSignature)
+		return nullptr;
+
+#ifdef MEMORIA_64BIT
+	if (static_cast<uint32_t>(locator->Self) != addr - _image_begin)
+		return nullptr;
+#endif
+
+	auto hierarchy = ResolveRTTIRef<RTTIClassHierarchyDescriptor>(_image_begin, locator->ClassDescriptor);
+
+	if (!IsInImage(reinterpret_cast<uintptr_t>(hierarchy), sizeof(RTTIClassHierarchyDescriptor)) || hierarchy->Signature != 0)
+		return nullptr;
+
+	if (!GetTypeName(ResolveRTTIRef<RTTITypeDescriptor>(_image_begin, locator->TypeDescriptor)))
+		return nullptr;
+
+	return locator;
+}
+
+uint32_t CRttiCatalog::AddClass(const void *type_descriptor)
+{
+	if (auto index = _by_descriptor.find(type_descriptor))
+		return *index;
+
+	uint32_t index = static_cast<uint32_t>(_classes.size());
+	const char *name = GetTypeName(type_descriptor);
+
+	_classes.push_back({ name, type_descriptor, nullptr, 0, 0, 0 });
+	_hierarchy_read.push_back(false);
+
+	_by_descriptor.insert(type_descriptor, index);
+
+	// On a hash collision the name stays with the first class.
+	_by_name.emplace(HashTypeName(name), index);
+
+	return index;
+}
+
+void CRttiCatalog::AddVTable(void **vtable, const void *locator)
+{
+	if (_by_vtable.contains(vtable))
+		return;
+
+	auto col = static_cast<const RTTICompleteObjectLocator *>(locator);
+	uint32_t index = AddClass(ResolveRTTIRef<RTTITypeDescriptor>(_image_begin, col->TypeDescriptor));
+
+	if (col->Offset == 0 && col->CDOffset == 0 && !_classes[index].VTable)
+		_classes[index].VTable = vtable;
+
+	_by_vtable.insert(vtable, static_cast<uint32_t>(_vtables.size()));
+	_vtables.push_back({ vtable, locator, index, static_cast<uint32_t>(col->Offset) });
+
+	if (!_hierarchy_read[index])
+		ReadHierarchy(index, ResolveRTTIRef<RTTIClassHierarchyDescriptor>(_image_begin, col->ClassDescriptor));
+}
+
+void CRttiCatalog::ReadHierarchy(uint32_t index, const void *hierarchy)
+{
+	_hierarchy_read[index] = true;
+
+	auto chd = static_cast<const RTTIClassHierarchyDescriptor *>(hierarchy);
+
+	if (!IsInImage(reinterpret_cast<uintptr_t>(chd), sizeof(RTTIClassHierarchyDescriptor)) || chd->Signature != 0)
+		return;
+
+	auto array = ResolveRTTIRef<RTTIBaseClassArray>(_image_begin, chd->BaseClassArray);
+	size_t count = chd->NumBaseClasses;
+
+	if (count == 0 || !IsInImage(reinterpret_cast<uintptr_t>(array), count * sizeof(array->ArrayOfBaseClassDescriptors[0])))
+		return;
+
+	uint32_t first = static_cast<uint32_t>(_bases.size());
+
+	// The first entry is the class itself.
+	for (size_t i = 1; i < count; ++i)
+	{
+		auto bcd = ResolveRTTIRef<RTTIBaseClassDescriptor>(_image_begin, array->ArrayOfBaseClassDescriptors[i]);
+
+		if (!IsInImage(reinterpret_cast<uintptr_t>(bcd), sizeof(RTTIBaseClassDescriptor)))
+			break;
+
+		auto type_descriptor = ResolveRTTIRef<RTTITypeDescriptor>(_image_begin, bcd->TypeDescriptor);
+
+		if (!GetTypeName(type_descriptor))
+			break;
+
+		_bases.push_back(AddClass(type_descriptor));
+	}
+
+	uint32_t base_count = static_cast<uint32_t>(_bases.size()) - first;
+
+	_classes[index].Attributes = chd->Attributes;
+	_classes[index].FirstBase = first;
+	_classes[index].BaseCount = base_count;
+
+	// Bases without a vtable of their own are only reachable from here.
+	for (uint32_t i = 0; i < base_count; ++i)
+	{
+		uint32_t base = _bases[first + i];
+
+		if (_hierarchy_read[base])
+			continue;
+
+		auto bcd = ResolveRTTIRef<RTTIBaseClassDescriptor>(_image_begin, array->ArrayOfBaseClassDescriptors[i + 1]);
+
+		if (bcd->Attributes & kBaseHasHierarchy)
+			ReadHierarchy(base, ResolveRTTIRef<RTTIClassHierarchyDescriptor>(_image_begin, bcd->ClassDescriptor));
+	}
+}
+
+bool CRttiCatalog::Build(HMODULE module)
+{
+	if (!module)
+		module = GetModuleHandleA(nullptr);
+
+	if (!module)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	auto dos = reinterpret_cast<PIMAGE_DOS_HEADER>(module);
+	auto nt = reinterpret_cast<PIMAGE_NT_HEADERS>(reinterpret_cast<uintptr_t>(module) + dos->e_lfanew);
+
+	if (dos->e_magic != IMAGE_DOS_SIGNATURE || nt->Signature != IMAGE_NT_SIGNATURE)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	_classes.clear();
+	_vtables.clear();
+	_bases.clear();
+	_by_name.clear();
+	_by_descriptor.clear();
+	_by_vtable.clear();
+	_hierarchy_read.clear();
+
+	_module = module;
+	_image_begin = reinterpret_cast<uintptr_t>(module);
+	_image_end = _image_begin + nt->OptionalHeader.SizeOfImage;
+
+	Memoria::Vector<std::pair<uintptr_t, uintptr_t>> data;
+	Memoria::Vector<std::pair<uintptr_t, uintptr_t>> code;
+
+	auto section = IMAGE_FIRST_SECTION(nt);
+
+	for (unsigned int i = 0; i < nt->FileHeader.NumberOfSections; ++i, ++section)
+	{
+		uintptr_t begin = _image_begin + section->VirtualAddress;
+		uintptr_t end = begin + section->Misc.VirtualSize;
+
+		if (!IsInImage(begin, end - begin))
+			continue;
+
+		if (section->Characteristics & IMAGE_SCN_MEM_EXECUTE)
+			code.push_back({ begin, end });
+		else if ((section->Characteristics & (IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ)) == (IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ) &&
+			!(section->Characteristics & IMAGE_SCN_MEM_DISCARDABLE))
+			data.push_back({ begin, end });
+	}
+
+	auto is_code = [&code](uintptr_t addr)
+	{
+		for (auto &[begin, end] : code)
+		{
+			if (addr >= begin && addr < end)
+				return true;
+		}
+
+		return false;
+	};
+
+	// A vtable is preceded by a pointer to its locator and starts with a pointer to code.
+	for (auto &[begin, end] : data)
+	{
+		auto slot = reinterpret_cast<uintptr_t *>((begin + sizeof(void *) - 1) & ~(sizeof(void *) - 1));
+		auto last = reinterpret_cast<uintptr_t *>(end) - 1;
+
+		for (; slot < last; ++slot)
+		{
+			if (slot[0] - _image_begin >= _image_end - _image_begin || !is_code(slot[1]))
+				continue;
+
+			if (auto locator = GetLocator(slot[0]))
+				AddVTable(reinterpret_cast<void **>(&slot[1]), locator);
+		}
+	}
+
+	if (_vtables.empty())
+	{
+		SetError(ME_NOT_FOUND);
+		return false;
+	}
+
+	return true;
+}
+
+const RttiClass_t *CRttiCatalog::FindDecoratedClass(const char *name) const
+{
+	auto index = _by_name.find(HashTypeName(name));
+
+	if (!index || StrICompA(_classes[*index].Name, name) != 0)
+	{
+		SetError(ME_NOT_FOUND);
+		return nullptr;
+	}
+
+	return &_classes[*index];
+}
+
+const RttiClass_t *CRttiCatalog::FindClass(const char *name) const
+{
+	if (!name || !*name)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return nullptr;
+	}
+
+	if (name[0] == '.' && name[1] == '?')
+		return FindDecoratedClass(name);
+
+	char decorated[1024];
+
+	if (!DecorateClassName(name, 'V', decorated, sizeof(decorated)))
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return nullptr;
+	}
+
+	if (auto cls = FindDecoratedClass(decorated))
+		return cls;
+
+	// Same name as a struct.
+	decorated[3] = 'U';
+
+	return FindDecoratedClass(decorated);
+}
+
+const RttiClass_t *CRttiCatalog::FindClassByDescriptor(const void *type_descriptor) const
+{
+	auto index = _by_descriptor.find(type_descriptor);
+
+	if (!index)
+	{
+		SetError(ME_NOT_FOUND);
+		return nullptr;
+	}
+
+	return &_classes[*index];
+}
+
+const RttiVTable_t *CRttiCatalog::FindVTable(const void *vtable) const
+{
+	auto index = _by_vtable.find(vtable);
+
+	if (!index)
+	{
+		SetError(ME_NOT_FOUND);
+		return nullptr;
+	}
+
+	return &_vtables[*index];
+}
+
+const RttiClass_t *CRttiCatalog::FindClassByVTable(const void *vtable) const
+{
+	auto entry = FindVTable(vtable);
+
+	return entry ? &_classes[entry->Class] : nullptr;
+}
+
+void **CRttiCatalog::GetVTable(const char *name) const
+{
+	auto cls = FindClass(name);
+
+	if (!cls)
+		return nullptr;
+
+	if (!cls->VTable)
+		SetError(ME_NOT_FOUND);
+
+	return cls->VTable;
+}
+
+const RttiClass_t *CRttiCatalog::GetBase(const RttiClass_t &cls, size_t index) const
+{
+	if (index >= cls.BaseCount)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return nullptr;
+	}
+
+	return &_classes[_bases[cls.FirstBase + index]];
+}
+
+bool CRttiCatalog::IsDerivedFrom(const RttiClass_t &cls, const RttiClass_t &base) const
+{
+	if (&cls == &base)
+		return true;
+
+	for (uint32_t i = 0; i < cls.BaseCount; ++i)
+	{
+		if (&_classes[_bases[cls.FirstBase + i]] == &base)
+			return true;
+	}
+
+	return false;
+}
+
+std::unique_ptr<CRttiCatalog> CRttiCatalog::Create(HMODULE module)
+{
+	auto catalog = std::make_unique<CRttiCatalog>();
+
+	if (!catalog->Build(module))
+		return {};
+
+	return catalog;
+}
+
 MEMORIA_END
\ No newline at end of file
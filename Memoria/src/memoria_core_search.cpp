@@ -17,34 +17,9 @@ static bool FindMemoryCmp(const void *addr1, const void *addr2, size_t size, voi
 	return MemCompare(addr1, addr2, size) == 0;
 }
 
-void *FindMemory(const void *addr_start, const void *addr_min, const void *addr_max, const void *data, size_t size, bool backward, 
-	ptrdiff_t offset = 0, FindMemoryCmp_t comparator = FindMemoryCmp, void *comparator_param = nullptr)
+static void *ScanMemory(const void *addr_start, const void *addr_min, const void *addr_max, const void *data, size_t size, bool backward,
+	ptrdiff_t offset, FindMemoryCmp_t comparator, void *comparator_param)
 {
-	Assert(addr_min != nullptr && addr_max != nullptr && addr_min <= addr_max);
-
-	if (IsSafeModeActive())
-	{
-		if (!IsMemoryValid(addr_start) || !IsMemoryValid(addr_min) || !IsMemoryValid(addr_max))
-		{
-			SetError(ME_INVALID_MEMORY);
-			return nullptr;
-		}
-
-		if (!IsMemoryValid(data))
-		{
-			SetError(ME_INVALID_MEMORY);
-			return nullptr;
-		}
-
-		if (size == 0)
-		{
-			SetError(ME_INVALID_ARGUMENT);
-			return nullptr;
-		}
-	}
-
-	if (!comparator)
-		comparator = FindMemoryCmp;
 
 	const void *result = static_cast<const void *>(addr_start);
 	addr_max = reinterpret_cast<const void *>(reinterpret_cast<intptr_t>(addr_max) - size);
@@ -67,6 +42,36 @@ void *FindMemory(const void *addr_start, const void *addr_min, const void *addr_
 	return nullptr;
 }
 
+void *FindMemory(const void *addr_start, const void *addr_min, const void *addr_max, const void *data, size_t size, bool backward, 
+	ptrdiff_t offset = 0, FindMemoryCmp_t comparator = FindMemoryCmp, void *comparator_param = nullptr)
+{
+	Assert(addr_min != nullptr && addr_max != nullptr && addr_min <= addr_max);
+
+	if (!comparator)
+		comparator = FindMemoryCmp;
+
+	if (!IsSafeModeActive())
+		return ScanMemory(addr_start, addr_min, addr_max, data, size, backward, offset, comparator, comparator_param);
+
+	if (!addr_start || !data || size == 0)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return nullptr;
+	}
+
+	// The range is scanned under a guard: unreadable pages inside it fail the search
+	// instead of crashing, and no page has to be queried up front.
+	void *result = nullptr;
+
+	if (!GuardedInvoke([&]() { result = ScanMemory(addr_start, addr_min, addr_max, data, size, backward, offset, comparator, comparator_param); }))
+	{
+		SetError(ME_INVALID_MEMORY);
+		return nullptr;
+	}
+
+	return result;
+}
+
 uint8_t *FindU8(const void *addr_start, const void *addr_min, const void *addr_max, uint8_t value, bool backward, ptrdiff_t offset)
 {
 	return static_cast<uint8_t *>(FindMemory(addr_start, addr_min, addr_max, &value, sizeof(value), backward, offset));
@@ -192,32 +197,9 @@ void *FindFirstSignature(const void *addr_start, const void *addr_min, const voi
 	return nullptr;
 }
 
-Memoria::Vector<Ref_t> FindReferences(const void *addr_start, const void *addr_min, const void *addr_max, const void *data, uint16_t opcode,
-	bool search_absolute, bool search_relative, bool stop_on_first_found, bool backward, ptrdiff_t pre_offset, ptrdiff_t offset)
+static void ScanReferences(Memoria::Vector<Ref_t> &refs, const void *addr_start, const void *addr_min, const void *addr_max, const void *data, uint16_t opcode,
+	bool search_absolute, bool search_relative, bool backward, ptrdiff_t pre_offset, ptrdiff_t offset)
 {
-	Memoria::Vector<Ref_t> refs{};
-
-	if (!search_absolute && !search_relative)
-	{
-		SetError(ME_INVALID_ARGUMENT);
-		return refs;
-	}
-
-	if (IsSafeModeActive())
-	{
-		if (!IsMemoryValid(addr_start) || !IsMemoryValid(addr_min) || !IsMemoryValid(addr_max))
-		{
-			SetError(ME_INVALID_ARGUMENT);
-			return refs;
-		}
-
-		if (!IsMemoryValid(data))
-		{
-			SetError(ME_INVALID_ARGUMENT);
-			return refs;
-		}
-	}
-
 	const bool has_opcode_header = (opcode != 0);
 	const bool is_two_bytes_opcode = (has_opcode_header) && (opcode > 255);
 	void *result = const_cast<void *>(addr_start);
@@ -232,7 +214,7 @@ Memoria::Vector<Ref_t> FindReferences(const void *addr_start, const void *addr_m
 		if (!IsInBounds(result, addr_min, addr_max))
 		{
 			SetError(ME_NOT_FOUND);
-			return refs;
+			return;
 		}
 
 		void *addr_abs;
@@ -254,7 +236,7 @@ Memoria::Vector<Ref_t> FindReferences(const void *addr_start, const void *addr_m
 			if (result == nullptr)
 			{
 				SetError(ME_NOT_FOUND);
-				return refs;
+				return;
 			}
 
 			result = PtrOffset(result, offs);
@@ -284,6 +266,34 @@ Memoria::Vector<Ref_t> FindReferences(const void *addr_start, const void *addr_m
 		else
 			result = PtrAdvance(result, 1);
 	} while (true);
+}
+
+Memoria::Vector<Ref_t> FindReferences(const void *addr_start, const void *addr_min, const void *addr_max, const void *data, uint16_t opcode,
+	bool search_absolute, bool search_relative, bool stop_on_first_found, bool backward, ptrdiff_t pre_offset, ptrdiff_t offset)
+{
+	Memoria::Vector<Ref_t> refs{};
+
+	if (!search_absolute && !search_relative)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return refs;
+	}
+
+	if (!IsSafeModeActive())
+	{
+		ScanReferences(refs, addr_start, addr_min, addr_max, data, opcode, search_absolute, search_relative, backward, pre_offset, offset);
+		return refs;
+	}
+
+	if (!addr_start)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return refs;
+	}
+
+	// `refs` lives outside the guard, so references found before a fault are kept.
+	if (!GuardedInvoke([&]() { ScanReferences(refs, addr_start, addr_min, addr_max, data, opcode, search_absolute, search_relative, backward, pre_offset, offset); }))
+		SetError(ME_INVALID_MEMORY);
 
 	return refs;
 }
@@ -341,17 +351,8 @@ enum class hde64_flags_t : uint32_t
     PrefixRex     = 0x40000000,
 };
 
-void *FindRelative(const void *addr_start, const void *addr_min, const void *addr_max, uint16_t opcode, size_t index, bool backward, ptrdiff_t offset)
+static void *ScanRelative(const void *addr_start, const void *addr_min, const void *addr_max, uint16_t opcode, size_t index, ptrdiff_t offset)
 {
-	if (IsSafeModeActive())
-	{
-		if (!IsMemoryValid(addr_start) || !IsMemoryValid(addr_min) || !IsMemoryValid(addr_max))
-		{
-			SetError(ME_INVALID_MEMORY);
-			return nullptr;
-		}
-	}
-
 	void *result = const_cast<void *>(addr_start);
 	hde64s hs;
 
@@ -402,4 +403,26 @@ void *FindRelative(const void *addr_start, const void *addr_min, const void *add
 	return result;
 }
 
+void *FindRelative(const void *addr_start, const void *addr_min, const void *addr_max, uint16_t opcode, size_t index, bool backward, ptrdiff_t offset)
+{
+	if (!IsSafeModeActive())
+		return ScanRelative(addr_start, addr_min, addr_max, opcode, index, offset);
+
+	if (!addr_start)
+	{
+		SetError(ME_INVALID_MEMORY);
+		return nullptr;
+	}
+
+	void *result = nullptr;
+
+	if (!GuardedInvoke([&]() { result = ScanRelative(addr_start, addr_min, addr_max, opcode, index, offset); }))
+	{
+		SetError(ME_INVALID_MEMORY);
+		return nullptr;
+	}
+
+	return result;
+}
+
 MEMORIA_END
\ No newline at end of file
@@ -0,0 +1,403 @@
+#include "memoria_core_source.hpp"
+
+#include "memoria_core_misc.hpp"
+#include "memoria_core_write.hpp"
+#include "memoria_core_errors.hpp"
+
+#include "memoria_utils_string.hpp"
+
+MEMORIA_BEGIN
+
+static constexpr uintptr_t kSourcePageMask = MEMORIA_SOURCE_PAGE_SIZE - 1;
+
+//
+// CLocalMemorySource
+//
+
+bool CLocalMemorySource::Read(const void *addr, void *out, size_t size)
+{
+	if (!addr || !GuardedCopy(out, addr, size))
+	{
+		SetError(ME_INVALID_MEMORY);
+		return false;
+	}
+
+	return true;
+}
+
+bool CLocalMemorySource::Write(void *addr, const void *data, size_t size)
+{
+	return WriteMemory(addr, data, size);
+}
+
+bool CLocalMemorySource::Query(const void *addr, MEMORY_BASIC_INFORMATION *mbi)
+{
+	return VirtualQuery(addr, mbi, sizeof(*mbi)) != 0;
+}
+
+IMemorySource *GetLocalMemorySource()
+{
+	static CLocalMemorySource source;
+	return &source;
+}
+
+//
+// CRemoteMemorySource
+//
+
+CRemoteMemorySource::~CRemoteMemorySource()
+{
+	Close();
+}
+
+bool CRemoteMemorySource::Open(DWORD pid)
+{
+	Close();
+
+	_process = OpenProcess(PROCESS_VM_READ | PROCESS_VM_WRITE | PROCESS_VM_OPERATION | PROCESS_QUERY_INFORMATION, FALSE, pid);
+	_owned = true;
+
+	if (!_process)
+	{
+		_owned = false;
+
+		SetError(ME_NOT_FOUND);
+		return false;
+	}
+
+	return true;
+}
+
+void CRemoteMemorySource::Attach(HANDLE process)
+{
+	Close();
+
+	_process = process;
+	_owned = false;
+}
+
+void CRemoteMemorySource::Close()
+{
+	if (_process && _owned)
+		CloseHandle(_process);
+
+	_process = nullptr;
+	_owned = false;
+}
+
+bool CRemoteMemorySource::Read(const void *addr, void *out, size_t size)
+{
+	SIZE_T read = 0;
+
+	if (!_process || !ReadProcessMemory(_process, addr, out, size, &read) || read != size)
+	{
+		SetError(ME_INVALID_MEMORY);
+		return false;
+	}
+
+	return true;
+}
+
+bool CRemoteMemorySource::Write(void *addr, const void *data, size_t size)
+{
+	if (!_process)
+		return false;
+
+	SIZE_T written = 0;
+
+	// `WriteProcessMemory` itself makes read-only image pages writable, but not all
+	// protections; fall back to changing the protection explicitly.
+	if (!WriteProcessMemory(_process, addr, data, size, &written) || written != size)
+	{
+		DWORD protection = 0;
+
+		if (!VirtualProtectEx(_process, addr, size, PAGE_EXECUTE_READWRITE, &protection))
+		{
+			SetError(ME_INVALID_PROTECTION_1);
+			return false;
+		}
+
+		bool result = WriteProcessMemory(_process, addr, data, size, &written) && written == size;
+		VirtualProtectEx(_process, addr, size, protection, &protection);
+
+		if (!result)
+		{
+			SetError(ME_INVALID_MEMORY);
+			return false;
+		}
+	}
+
+	FlushInstructionCache(_process, addr, size);
+	return true;
+}
+
+bool CRemoteMemorySource::Query(const void *addr, MEMORY_BASIC_INFORMATION *mbi)
+{
+	return _process && VirtualQueryEx(_process, addr, mbi, sizeof(*mbi)) != 0;
+}
+
+//
+// CCachedMemorySource
+//
+
+CCachedMemorySource::~CCachedMemorySource()
+{
+	Release();
+}
+
+bool CCachedMemorySource::Create(IMemorySource *source, size_t max_pages)
+{
+	Release();
+
+	if (!source || max_pages < MEMORIA_SOURCE_BATCH_PAGES || max_pages > UINT32_MAX)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	// The cached pages are followed by the staging area of one batch.
+	_data = static_cast<uint8_t *>(VirtualAlloc(nullptr, (max_pages + MEMORIA_SOURCE_BATCH_PAGES) * MEMORIA_SOURCE_PAGE_SIZE,
+		MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+	_slots = static_cast<Slot_t *>(VirtualAlloc(nullptr, max_pages * sizeof(Slot_t), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+
+	if (!_data || !_slots)
+	{
+		Release();
+
+		SetError(ME_INVALID_MEMORY);
+		return false;
+	}
+
+	_source = source;
+	_staging = &_data[max_pages * MEMORIA_SOURCE_PAGE_SIZE];
+	_capacity = max_pages;
+	_index.reserve(max_pages);
+
+	return true;
+}
+
+void CCachedMemorySource::Release()
+{
+	if (_data)
+		VirtualFree(_data, 0, MEM_RELEASE);
+
+	if (_slots)
+		VirtualFree(_slots, 0, MEM_RELEASE);
+
+	_data = nullptr;
+	_staging = nullptr;
+	_slots = nullptr;
+	_capacity = 0;
+	_source = nullptr;
+
+	Invalidate();
+}
+
+void CCachedMemorySource::Invalidate()
+{
+	_index.clear();
+	_used = 0;
+	_next = 0;
+}
+
+uint32_t CCachedMemorySource::AllocateSlot(uintptr_t page)
+{
+	uint32_t slot;
+
+	if (_used < _capacity)
+	{
+		slot = static_cast<uint32_t>(_used++);
+	}
+	else
+	{
+		slot = static_cast<uint32_t>(_next);
+		_next = (_next + 1) % _capacity;
+
+		_index.erase(_slots[slot].Page);
+	}
+
+	_slots[slot] = { page, false };
+	_index.insert(page, slot);
+
+	return slot;
+}
+
+void CCachedMemorySource::Fetch(uintptr_t page)
+{
+	// Extend the miss to the following pages that are not cached either.
+	size_t count = 1;
+
+	while (count < MEMORIA_SOURCE_BATCH_PAGES && !_index.contains(page + count * MEMORIA_SOURCE_PAGE_SIZE))
+		++count;
+
+	bool batch = _source->Read(reinterpret_cast<const void *>(page), _staging, count * MEMORIA_SOURCE_PAGE_SIZE);
+
+	// A batch fails as a whole if any page of it is unreadable. Then only the requested page
+	// is fetched on its own; the others are fetched when they are accessed.
+	if (!batch)
+		count = 1;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		uintptr_t address = page + i * MEMORIA_SOURCE_PAGE_SIZE;
+
+		uint32_t slot = AllocateSlot(address);
+		uint8_t *data = &_data[slot * MEMORIA_SOURCE_PAGE_SIZE];
+
+		if (batch)
+		{
+			MemCopy(data, &_staging[i * MEMORIA_SOURCE_PAGE_SIZE], MEMORIA_SOURCE_PAGE_SIZE);
+			_slots[slot].Readable = true;
+		}
+		else
+		{
+			_slots[slot].Readable = _source->Read(reinterpret_cast<const void *>(address), data, MEMORIA_SOURCE_PAGE_SIZE);
+		}
+	}
+}
+
+const CCachedMemorySource::Slot_t *CCachedMemorySource::GetPage(uintptr_t page)
+{
+	if (auto slot = _index.find(page))
+	{
+		++_hits;
+		return &_slots[*slot];
+	}
+
+	++_misses;
+	Fetch(page);
+
+	auto slot = _index.find(page);
+	return slot ? &_slots[*slot] : nullptr;
+}
+
+bool CCachedMemorySource::Read(const void *addr, void *out, size_t size)
+{
+	if (!_source)
+		return false;
+
+	auto dest = static_cast<uint8_t *>(out);
+	uintptr_t begin = reinterpret_cast<uintptr_t>(addr);
+	uintptr_t end = begin + size;
+
+	while (begin < end)
+	{
+		uintptr_t page = begin & ~kSourcePageMask;
+		uintptr_t page_end = page + MEMORIA_SOURCE_PAGE_SIZE;
+		size_t chunk = ((page_end < end) ? page_end : end) - begin;
+
+		const Slot_t *slot = GetPage(page);
+
+		if (!slot || !slot->Readable)
+		{
+			SetError(ME_INVALID_MEMORY);
+			return false;
+		}
+
+		size_t index = slot - _slots;
+		MemCopy(dest, &_data[index * MEMORIA_SOURCE_PAGE_SIZE + (begin - page)], chunk);
+
+		dest += chunk;
+		begin += chunk;
+	}
+
+	return true;
+}
+
+bool CCachedMemorySource::Write(void *addr, const void *data, size_t size)
+{
+	if (!_source || !_source->Write(addr, data, size))
+		return false;
+
+	// Keep the cached copies of the written pages in sync.
+	auto source = static_cast<const uint8_t *>(data);
+	uintptr_t begin = reinterpret_cast<uintptr_t>(addr);
+	uintptr_t end = begin + size;
+
+	while (begin < end)
+	{
+		uintptr_t page = begin & ~kSourcePageMask;
+		uintptr_t page_end = page + MEMORIA_SOURCE_PAGE_SIZE;
+		size_t chunk = ((page_end < end) ? page_end : end) - begin;
+
+		if (auto slot = _index.find(page); slot && _slots[*slot].Readable)
+			MemCopy(&_data[*slot * MEMORIA_SOURCE_PAGE_SIZE + (begin - page)], source, chunk);
+
+		source += chunk;
+		begin += chunk;
+	}
+
+	return true;
+}
+
+bool CCachedMemorySource::Query(const void *addr, MEMORY_BASIC_INFORMATION *mbi)
+{
+	return _source && _source->Query(addr, mbi);
+}
+
+//
+// CMemoryView
+//
+
+bool CMemoryView::Map(IMemorySource *source, const void *addr, size_t size)
+{
+	_copy.clear();
+
+	_local = nullptr;
+	_remote = reinterpret_cast<uintptr_t>(addr);
+	_size = 0;
+
+	if (!source || !addr || size == 0)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	if (source->IsLocal())
+	{
+		_local = static_cast<const uint8_t *>(addr);
+		_size = size;
+
+		return true;
+	}
+
+	_copy.resize(size);
+
+	// Try the whole range in one transfer first; if it contains unreadable pages,
+	// copy page by page and zero-fill the gaps.
+	if (!source->Read(addr, _copy.data(), size))
+	{
+		bool any = false;
+		uintptr_t begin = _remote;
+		uintptr_t end = begin + size;
+
+		while (begin < end)
+		{
+			uintptr_t page_end = (begin & ~kSourcePageMask) + MEMORIA_SOURCE_PAGE_SIZE;
+			size_t chunk = ((page_end < end) ? page_end : end) - begin;
+			uint8_t *dest = &_copy[begin - _remote];
+
+			if (source->Read(reinterpret_cast<const void *>(begin), dest, chunk))
+				any = true;
+			else
+				MemFill(dest, 0, chunk);
+
+			begin += chunk;
+		}
+
+		if (!any)
+		{
+			_copy.clear();
+
+			SetError(ME_INVALID_MEMORY);
+			return false;
+		}
+	}
+
+	_local = _copy.data();
+	_size = size;
+
+	return true;
+}
+
+MEMORIA_END
\ No newline at end of file
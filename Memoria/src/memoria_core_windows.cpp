@@ -1,6 +1,7 @@
 #include "memoria_core_windows.hpp"
 
 #include "memoria_core_misc.hpp"
+#include "memoria_core_errors.hpp"
 #include "memoria_utils_string.hpp"
 
 #include <VersionHelpers.h>
@@ -359,4 +360,114 @@ DWORD GetMainThreadId()
 	return result;
 }
 
+// Number of times a thread stopped at an unsafe address is let go and caught again.
+static constexpr int kMaxSuspendAttempts = 64;
+
+Memoria::Vector<HANDLE> SuspendOtherThreads()
+{
+	Memoria::Vector<HANDLE> result;
+	SuspendOtherThreads(result, nullptr, nullptr);
+
+	return result;
+}
+
+bool SuspendOtherThreads(Memoria::Vector<HANDLE> &threads, ThreadIpFilterFn is_unsafe, void *param)
+{
+	threads.clear();
+
+	auto hThreadSnap = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+	if (hThreadSnap == INVALID_HANDLE_VALUE)
+		return true;
+
+	THREADENTRY32 te32;
+	te32.dwSize = sizeof(THREADENTRY32);
+
+	DWORD pid = GetCurrentProcessId();
+	DWORD tid = GetCurrentThreadId();
+
+	if (Thread32First(hThreadSnap, &te32))
+	{
+		do
+		{
+			if (te32.th32OwnerProcessID != pid || te32.th32ThreadID == tid)
+				continue;
+
+			HANDLE thread = OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT, FALSE, te32.th32ThreadID);
+
+			if (thread != nullptr)
+				threads.push_back(thread);
+		} while (Thread32Next(hThreadSnap, &te32));
+	}
+
+	CloseHandle(hThreadSnap);
+
+	// Suspend only after all handles are collected: a suspended thread may own the heap
+	// lock, so nothing is allocated from here on.
+	for (HANDLE &thread : threads)
+	{
+		if (SuspendThread(thread) == static_cast<DWORD>(-1))
+		{
+			CloseHandle(thread);
+			thread = nullptr;
+		}
+	}
+
+	// `SuspendThread` only requests the suspension; `GetThreadContext` returns once
+	// the thread has actually stopped.
+	for (HANDLE &thread : threads)
+	{
+		for (int attempt = 0; thread != nullptr; ++attempt)
+		{
+			alignas(16) CONTEXT context;
+			context.ContextFlags = CONTEXT_CONTROL;
+
+			if (!GetThreadContext(thread, &context))
+				break;
+
+#ifdef MEMORIA_64BIT
+			auto ip = reinterpret_cast<const void *>(context.Rip);
+#else
+			auto ip = reinterpret_cast<const void *>(context.Eip);
+#endif
+
+			if (!is_unsafe || !is_unsafe(ip, param))
+				break;
+
+			if (attempt == kMaxSuspendAttempts)
+			{
+				ResumeThreads(threads);
+
+				SetError(ME_THREAD_BUSY);
+				return false;
+			}
+
+			// Let the thread run past the address and catch it again.
+			ResumeThread(thread);
+			Sleep(1);
+
+			if (SuspendThread(thread) == static_cast<DWORD>(-1))
+			{
+				CloseHandle(thread);
+				thread = nullptr;
+			}
+		}
+	}
+
+	return true;
+}
+
+void ResumeThreads(Memoria::Vector<HANDLE> &threads)
+{
+	for (HANDLE thread : threads)
+	{
+		if (thread == nullptr)
+			continue;
+
+		ResumeThread(thread);
+		CloseHandle(thread);
+	}
+
+	threads.clear();
+}
+
 MEMORIA_END
\ No newline at end of file
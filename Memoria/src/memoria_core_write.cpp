@@ -3,9 +3,18 @@
 #include "memoria_core_options.hpp"
 #include "memoria_core_misc.hpp"
 #include "memoria_core_errors.hpp"
+#include "memoria_core_windows.hpp"
 
 #include "memoria_utils_string.hpp"
 
+#ifdef MEMORIA_64BIT
+#include "hde64.h"
+#else
+#include "hde32.h"
+#endif
+
+#include <intrin.h>
+
 #include <Windows.h>
 #include <string_view>
 
@@ -142,6 +151,286 @@ bool WritePointer(void *addr, const void *value, ptrdiff_t offset)
 	return WriteMemory(addr, &value, sizeof(value), offset);
 }
 
+bool WritePointerAtomic(void *addr, const void *value, void **previous)
+{
+	if ((reinterpret_cast<uintptr_t>(addr) & (sizeof(void *) - 1)) != 0)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	if (IsSafeModeActive() && !IsMemoryValid(addr))
+	{
+		SetError(ME_INVALID_MEMORY);
+		return false;
+	}
+
+	DWORD new_protection, old_protection;
+
+	if (IsMemoryExecutable(addr))
+		new_protection = PAGE_EXECUTE_READWRITE;
+	else
+		new_protection = PAGE_READWRITE;
+
+	if (!VirtualProtect(addr, sizeof(void *), new_protection, &old_protection))
+	{
+		SetError(ME_INVALID_PROTECTION_1);
+		return false;
+	}
+
+	void *result = InterlockedExchangePointer(reinterpret_cast<void *volatile *>(addr), const_cast<void *>(value));
+
+	if (previous)
+		*previous = result;
+
+	if (!VirtualProtect(addr, sizeof(void *), old_protection, &old_protection))
+	{
+		SetError(ME_INVALID_PROTECTION_2);
+		return false;
+	}
+
+	return true;
+}
+
+//
+// Stores `size` bytes at `addr` with a single interlocked operation, provided that the range
+// lies within one aligned 8-byte window (16-byte on x64). The surrounding bytes of the window
+// are preserved.
+//
+static bool StoreAligned(void *addr, const void *data, size_t size)
+{
+	uintptr_t begin = reinterpret_cast<uintptr_t>(addr);
+	uintptr_t end = begin + size;
+
+	uintptr_t window = begin & ~static_cast<uintptr_t>(7);
+
+	if (end <= window + 8)
+	{
+		auto target = reinterpret_cast<volatile int64_t *>(window);
+		int64_t expected = *target;
+
+		while (true)
+		{
+			int64_t desired = expected;
+			MemCopy(PtrAdvance(&desired, begin - window), data, size);
+
+			int64_t result = _InterlockedCompareExchange64(target, desired, expected);
+
+			if (result == expected)
+				return true;
+
+			expected = result;
+		}
+	}
+
+#ifdef MEMORIA_64BIT
+	window = begin & ~static_cast<uintptr_t>(15);
+
+	if (end <= window + 16)
+	{
+		auto target = reinterpret_cast<volatile int64_t *>(window);
+		alignas(16) int64_t expected[2] = { target[0], target[1] };
+
+		while (true)
+		{
+			alignas(16) int64_t desired[2] = { expected[0], expected[1] };
+			MemCopy(PtrAdvance(desired, begin - window), data, size);
+
+			// On failure `expected` receives the current value.
+			if (_InterlockedCompareExchange128(target, desired[1], desired[0], expected))
+				return true;
+		}
+	}
+#endif
+
+	return false;
+}
+
+//
+// Addresses currently guarded with `int3`. A thread hitting one of them waits until the
+// guard is removed and then re-executes the instruction.
+//
+static constexpr size_t kMaxCodeGuards = 16;
+static void *volatile gCodeGuards[kMaxCodeGuards];
+static PVOID gCodeGuardHandler = nullptr;
+static SRWLOCK gCodeGuardLock = SRWLOCK_INIT;
+static bool gCodeGuardExitRegistered = false;
+
+// Set only after the handler is registered, so no thread plants a guard before.
+static volatile LONG gCodeGuardHandlerInstalled = 0;
+
+static LONG CALLBACK CodeGuardHandler(PEXCEPTION_POINTERS info)
+{
+	if (info->ExceptionRecord->ExceptionCode != EXCEPTION_BREAKPOINT)
+		return EXCEPTION_CONTINUE_SEARCH;
+
+	void *address = info->ExceptionRecord->ExceptionAddress;
+
+	for (size_t i = 0; i < kMaxCodeGuards; ++i)
+	{
+		if (gCodeGuards[i] != address)
+			continue;
+
+		while (gCodeGuards[i] == address)
+			YieldProcessor();
+
+#ifdef MEMORIA_64BIT
+		info->ContextRecord->Rip = reinterpret_cast<DWORD64>(address);
+#else
+		info->ContextRecord->Eip = reinterpret_cast<DWORD>(address);
+#endif
+
+		return EXCEPTION_CONTINUE_EXECUTION;
+	}
+
+	return EXCEPTION_CONTINUE_SEARCH;
+}
+
+static void RemoveCodeGuardHandler()
+{
+	AcquireSRWLockExclusive(&gCodeGuardLock);
+
+	if (gCodeGuardHandler)
+	{
+		InterlockedExchange(&gCodeGuardHandlerInstalled, 0);
+
+		RemoveVectoredExceptionHandler(gCodeGuardHandler);
+		gCodeGuardHandler = nullptr;
+	}
+
+	ReleaseSRWLockExclusive(&gCodeGuardLock);
+}
+
+static bool InstallCodeGuardHandler()
+{
+	if (gCodeGuardHandlerInstalled)
+		return true;
+
+	AcquireSRWLockExclusive(&gCodeGuardLock);
+
+	if (!gCodeGuardHandler)
+	{
+		gCodeGuardHandler = AddVectoredExceptionHandler(1, CodeGuardHandler);
+
+		if (gCodeGuardHandler && !gCodeGuardExitRegistered)
+		{
+			gCodeGuardExitRegistered = true;
+			RegisterOnExitCallback(RemoveCodeGuardHandler);
+		}
+
+		if (gCodeGuardHandler)
+			InterlockedExchange(&gCodeGuardHandlerInstalled, 1);
+	}
+
+	bool result = gCodeGuardHandler != nullptr;
+
+	ReleaseSRWLockExclusive(&gCodeGuardLock);
+	return result;
+}
+
+// Returns the slot of the guard, or `SIZE_MAX` if the handler cannot be installed.
+static size_t AddCodeGuard(void *addr)
+{
+	if (!InstallCodeGuardHandler())
+		return SIZE_MAX;
+
+	while (true)
+	{
+		for (size_t i = 0; i < kMaxCodeGuards; ++i)
+		{
+			if (InterlockedCompareExchangePointer(&gCodeGuards[i], addr, nullptr) == nullptr)
+				return i;
+		}
+
+		YieldProcessor();
+	}
+}
+
+static size_t GetInstructionLength(const void *addr)
+{
+#ifdef MEMORIA_64BIT
+	hde64s hs;
+	return hde64_disasm(addr, &hs);
+#else
+	hde32s hs;
+	return hde32_disasm(addr, &hs);
+#endif
+}
+
+bool WriteCodeAtomic(void *addr, const void *data, size_t size)
+{
+	if (size == 0)
+		return true;
+
+	if (IsSafeModeActive() && !IsMemoryValid(addr))
+	{
+		SetError(ME_INVALID_MEMORY);
+		return false;
+	}
+
+	// Cover the whole interlocked window, which may start before `addr`.
+	auto window = reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) & ~static_cast<uintptr_t>(15));
+	size_t window_size = Align(size + (reinterpret_cast<uintptr_t>(addr) & 15), 16);
+
+	DWORD old_protection;
+
+	if (!VirtualProtect(window, window_size, PAGE_EXECUTE_READWRITE, &old_protection))
+	{
+		SetError(ME_INVALID_PROTECTION_1);
+		return false;
+	}
+
+	HANDLE process = GetCurrentProcess();
+
+	if (!StoreAligned(addr, data, size))
+	{
+		static constexpr uint8_t jmp_self[] = { 0xEB, 0xFE }; // JMP $
+		static constexpr uint8_t int3[] = { 0xCC };           // INT3
+
+		size_t guard_size = sizeof(jmp_self);
+		size_t guard_index = SIZE_MAX;
+
+		// The jump would cut into the following instruction if the current one is shorter;
+		// a thread may be about to execute that one.
+		if (GetInstructionLength(addr) < sizeof(jmp_self) || !StoreAligned(addr, jmp_self, sizeof(jmp_self)))
+		{
+			guard_index = AddCodeGuard(addr);
+
+			if (guard_index == SIZE_MAX)
+			{
+				VirtualProtect(window, window_size, old_protection, &old_protection);
+
+				SetError(ME_INVALID_MEMORY);
+				return false;
+			}
+
+			guard_size = sizeof(int3);
+
+			StoreAligned(addr, int3, sizeof(int3));
+		}
+
+		FlushInstructionCache(process, addr, size);
+
+		MemCopy(PtrAdvance(addr, guard_size), PtrAdvance(data, guard_size), size - guard_size);
+		FlushInstructionCache(process, addr, size);
+
+		StoreAligned(addr, data, guard_size);
+
+		if (guard_index != SIZE_MAX)
+			gCodeGuards[guard_index] = nullptr;
+	}
+
+	FlushInstructionCache(process, addr, size);
+
+	if (!VirtualProtect(window, window_size, old_protection, &old_protection))
+	{
+		SetError(ME_INVALID_PROTECTION_2);
+		return false;
+	}
+
+	return true;
+}
+
 bool WriteRelative(void *addr, const void *value, ptrdiff_t offset)
 {
 	if (!IsIn32BitRange(addr, value))
@@ -181,4 +470,301 @@ bool FillNops(void *addr, size_t size)
 	return FillChar(addr, 0x90, size);
 }
 
+static bool IsWritableProtection(DWORD protection)
+{
+	switch (protection & 0xFF)
+	{
+	case PAGE_READWRITE:
+	case PAGE_WRITECOPY:
+	case PAGE_EXECUTE_READWRITE:
+	case PAGE_EXECUTE_WRITECOPY:
+		return true;
+	}
+
+	return false;
+}
+
+static bool IsExecutableProtection(DWORD protection)
+{
+	switch (protection & 0xFF)
+	{
+	case PAGE_EXECUTE:
+	case PAGE_EXECUTE_READ:
+	case PAGE_EXECUTE_READWRITE:
+	case PAGE_EXECUTE_WRITECOPY:
+		return true;
+	}
+
+	return false;
+}
+
+static uint8_t *PageDown(uint8_t *addr)
+{
+	return reinterpret_cast<uint8_t *>(reinterpret_cast<uintptr_t>(addr) & ~static_cast<uintptr_t>(0xFFF));
+}
+
+static uint8_t *PageUp(uint8_t *addr)
+{
+	return PageDown(addr + 0xFFF);
+}
+
+uint8_t *CWriteSession::Stage(void *addr, size_t size)
+{
+	if (_committed || addr == nullptr || size == 0)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return nullptr;
+	}
+
+	size_t offset = _data.size();
+
+	_data.resize(offset + size);
+	_writes.push_back({ static_cast<uint8_t *>(addr), offset, size });
+
+	return &_data[offset];
+}
+
+bool CWriteSession::Write(void *addr, const void *data, size_t size)
+{
+	if (data == nullptr)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	uint8_t *staged = Stage(addr, size);
+
+	if (staged == nullptr)
+		return false;
+
+	MemCopy(staged, data, size);
+	return true;
+}
+
+bool CWriteSession::Fill(void *addr, uint8_t value, size_t size)
+{
+	uint8_t *staged = Stage(addr, size);
+
+	if (staged == nullptr)
+		return false;
+
+	MemFill(staged, value, size);
+	return true;
+}
+
+void CWriteSession::Prepare()
+{
+	// Writes are applied in staging order, so overlapping writes behave as if written
+	// one by one; only the page ranges are computed from a sorted copy.
+	Memoria::Vector<Write_t> sorted;
+	sorted.reserve(_writes.size());
+
+	for (auto &write : _writes)
+		sorted.push_back(write);
+
+	sorted.sort([](const Write_t &a, const Write_t &b, void *) -> int
+	{
+		return (a.Address < b.Address) ? -1 : (a.Address > b.Address) ? 1 : 0;
+	});
+
+	_ranges.clear();
+
+	size_t pages = 0;
+
+	for (size_t i = 0; i < sorted.size();)
+	{
+		// Merge writes touching the same or adjacent pages.
+		Range_t range = { PageDown(sorted[i].Address), PageUp(sorted[i].Address + sorted[i].Size) };
+
+		for (++i; i < sorted.size() && sorted[i].Address <= range.End; ++i)
+		{
+			uint8_t *write_end = PageUp(sorted[i].Address + sorted[i].Size);
+
+			if (write_end > range.End)
+				range.End = write_end;
+		}
+
+		pages += (range.End - range.Begin) / 0x1000;
+		_ranges.push_back(range);
+	}
+
+	// A range splits into at most one region per page.
+	_regions.clear();
+	_regions.reserve(pages);
+
+	_backup.resize(_data.size());
+}
+
+bool CWriteSession::Unprotect()
+{
+	MEMORY_BASIC_INFORMATION mbi = {};
+	uint8_t *mbi_end = nullptr;
+
+	for (auto &range : _ranges)
+	{
+		// Split the range into regions of equal protection; a region reported by
+		// `VirtualQuery` usually covers many ranges, so it is queried once.
+		for (uint8_t *addr = range.Begin; addr < range.End;)
+		{
+			if (addr < static_cast<uint8_t *>(mbi.BaseAddress) || addr >= mbi_end)
+			{
+				if (VirtualQuery(addr, &mbi, sizeof(mbi)) == 0 || mbi.State != MEM_COMMIT)
+				{
+					SetError(ME_INVALID_MEMORY);
+					return false;
+				}
+
+				mbi_end = static_cast<uint8_t *>(mbi.BaseAddress) + mbi.RegionSize;
+			}
+
+			uint8_t *region_end = (mbi_end < range.End) ? mbi_end : range.End;
+			Region_t region = { addr, static_cast<size_t>(region_end - addr), 0, IsExecutableProtection(mbi.Protect) };
+
+			if (!IsWritableProtection(mbi.Protect))
+			{
+				DWORD protection = region.Executable ? PAGE_EXECUTE_READWRITE : PAGE_READWRITE;
+
+				if (!VirtualProtect(region.Base, region.Size, protection, &region.Protection))
+				{
+					SetError(ME_INVALID_PROTECTION_1);
+					return false;
+				}
+			}
+
+			_regions.push_back(region);
+			addr = region_end;
+		}
+	}
+
+	return true;
+}
+
+bool CWriteSession::Protect()
+{
+	bool result = true;
+
+	for (size_t i = _regions.size(); i-- > 0;)
+	{
+		Region_t &region = _regions[i];
+		DWORD protection;
+
+		if (region.Protection != 0 && !VirtualProtect(region.Base, region.Size, region.Protection, &protection))
+		{
+			SetError(ME_INVALID_PROTECTION_2);
+			result = false;
+		}
+
+		if (region.Executable)
+			FlushInstructionCache(GetCurrentProcess(), region.Base, region.Size);
+	}
+
+	_regions.clear();
+	return result;
+}
+
+bool CWriteSession::IsInsideWrite(const void *ip, void *param)
+{
+	auto session = static_cast<const CWriteSession *>(param);
+	auto addr = static_cast<const uint8_t *>(ip);
+
+	for (auto &write : session->_writes)
+	{
+		if (addr > write.Address && addr < write.Address + write.Size)
+			return true;
+	}
+
+	return false;
+}
+
+bool CWriteSession::Apply(bool restore, bool suspend_threads, bool *written)
+{
+	*written = false;
+
+	Prepare();
+
+	Memoria::Vector<HANDLE> threads;
+
+	if (suspend_threads && !SuspendOtherThreads(threads, IsInsideWrite, this))
+		return false;
+
+	if (!Unprotect())
+	{
+		Protect();
+		ResumeThreads(threads);
+
+		return false;
+	}
+
+	// Copied with `rep movsb`, as in `GuardedCopy`; sessions can hold large writes.
+	if (restore)
+	{
+		// Reverse order, so overlapping writes restore the oldest bytes last.
+		for (size_t i = _writes.size(); i-- > 0;)
+			__movsb(_writes[i].Address, &_backup[_writes[i].Offset], _writes[i].Size);
+	}
+	else
+	{
+		for (auto &write : _writes)
+		{
+			__movsb(&_backup[write.Offset], write.Address, write.Size);
+			__movsb(write.Address, &_data[write.Offset], write.Size);
+		}
+	}
+
+	*written = true;
+
+	bool result = Protect();
+	ResumeThreads(threads);
+
+	return result;
+}
+
+bool CWriteSession::Commit(bool suspend_threads)
+{
+	if (_committed)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	if (_writes.empty())
+		return true;
+
+	bool written;
+	bool result = Apply(false, suspend_threads, &written);
+
+	if (written)
+		_committed = true;
+
+	return result;
+}
+
+bool CWriteSession::Rollback(bool suspend_threads)
+{
+	if (!_committed)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	bool written;
+	bool result = Apply(true, suspend_threads, &written);
+
+	if (written)
+		_committed = false;
+
+	return result;
+}
+
+void CWriteSession::Clear()
+{
+	_writes.clear();
+	_data.clear();
+	_backup.clear();
+	_ranges.clear();
+	_regions.clear();
+
+	_committed = false;
+}
+
 MEMORIA_END
\ No newline at end of file
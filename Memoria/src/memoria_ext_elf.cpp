@@ -0,0 +1,735 @@
+#include "memoria_ext_elf.hpp"
+
+#include "memoria_core_misc.hpp"
+#include "memoria_core_errors.hpp"
+
+#include "memoria_utils_string.hpp"
+
+MEMORIA_BEGIN
+
+//
+// ELF structures, as in <elf.h>, which is not available everywhere.
+//
+
+#define ELF_CLASS32 1
+#define ELF_CLASS64 2
+#define ELF_DATA2LSB 1
+
+#define ELF_PT_LOAD 1
+#define ELF_PT_DYNAMIC 2
+#define ELF_PT_GNU_RELRO 0x6474E552
+
+#define ELF_SHT_NOBITS 8
+#define ELF_SHN_UNDEF 0
+
+#define ELF_DT_NULL 0
+#define ELF_DT_HASH 4
+#define ELF_DT_STRTAB 5
+#define ELF_DT_SYMTAB 6
+#define ELF_DT_STRSZ 10
+#define ELF_DT_GNU_HASH 0x6FFFFEF5
+
+struct Elf32Ehdr_t
+{
+	uint8_t e_ident[16];
+	uint16_t e_type;
+	uint16_t e_machine;
+	uint32_t e_version;
+	uint32_t e_entry;
+	uint32_t e_phoff;
+	uint32_t e_shoff;
+	uint32_t e_flags;
+	uint16_t e_ehsize;
+	uint16_t e_phentsize;
+	uint16_t e_phnum;
+	uint16_t e_shentsize;
+	uint16_t e_shnum;
+	uint16_t e_shstrndx;
+};
+
+struct Elf64Ehdr_t
+{
+	uint8_t e_ident[16];
+	uint16_t e_type;
+	uint16_t e_machine;
+	uint32_t e_version;
+	uint64_t e_entry;
+	uint64_t e_phoff;
+	uint64_t e_shoff;
+	uint32_t e_flags;
+	uint16_t e_ehsize;
+	uint16_t e_phentsize;
+	uint16_t e_phnum;
+	uint16_t e_shentsize;
+	uint16_t e_shnum;
+	uint16_t e_shstrndx;
+};
+
+struct Elf32Phdr_t
+{
+	uint32_t p_type;
+	uint32_t p_offset;
+	uint32_t p_vaddr;
+	uint32_t p_paddr;
+	uint32_t p_filesz;
+	uint32_t p_memsz;
+	uint32_t p_flags;
+	uint32_t p_align;
+};
+
+struct Elf64Phdr_t
+{
+	uint32_t p_type;
+	uint32_t p_flags;
+	uint64_t p_offset;
+	uint64_t p_vaddr;
+	uint64_t p_paddr;
+	uint64_t p_filesz;
+	uint64_t p_memsz;
+	uint64_t p_align;
+};
+
+struct Elf32Shdr_t
+{
+	uint32_t sh_name;
+	uint32_t sh_type;
+	uint32_t sh_flags;
+	uint32_t sh_addr;
+	uint32_t sh_offset;
+	uint32_t sh_size;
+	uint32_t sh_link;
+	uint32_t sh_info;
+	uint32_t sh_addralign;
+	uint32_t sh_entsize;
+};
+
+struct Elf64Shdr_t
+{
+	uint32_t sh_name;
+	uint32_t sh_type;
+	uint64_t sh_flags;
+	uint64_t sh_addr;
+	uint64_t sh_offset;
+	uint64_t sh_size;
+	uint32_t sh_link;
+	uint32_t sh_info;
+	uint64_t sh_addralign;
+	uint64_t sh_entsize;
+};
+
+struct Elf32Dyn_t
+{
+	int32_t d_tag;
+	uint32_t d_val;
+};
+
+struct Elf64Dyn_t
+{
+	int64_t d_tag;
+	uint64_t d_val;
+};
+
+struct Elf32Sym_t
+{
+	uint32_t st_name;
+	uint32_t st_value;
+	uint32_t st_size;
+	uint8_t st_info;
+	uint8_t st_other;
+	uint16_t st_shndx;
+};
+
+struct Elf64Sym_t
+{
+	uint32_t st_name;
+	uint8_t st_info;
+	uint8_t st_other;
+	uint16_t st_shndx;
+	uint64_t st_value;
+	uint64_t st_size;
+};
+
+static_assert(sizeof(Elf32Ehdr_t) == 52 && sizeof(Elf64Ehdr_t) == 64);
+static_assert(sizeof(Elf32Phdr_t) == 32 && sizeof(Elf64Phdr_t) == 56);
+static_assert(sizeof(Elf32Shdr_t) == 40 && sizeof(Elf64Shdr_t) == 64);
+static_assert(sizeof(Elf32Sym_t) == 16 && sizeof(Elf64Sym_t) == 24);
+
+struct Elf32Traits_t
+{
+	using Ehdr = Elf32Ehdr_t;
+	using Phdr = Elf32Phdr_t;
+	using Shdr = Elf32Shdr_t;
+	using Dyn = Elf32Dyn_t;
+	using Sym = Elf32Sym_t;
+
+	// Word of the `DT_GNU_HASH` bloom filter.
+	using Word = uint32_t;
+};
+
+struct Elf64Traits_t
+{
+	using Ehdr = Elf64Ehdr_t;
+	using Phdr = Elf64Phdr_t;
+	using Shdr = Elf64Shdr_t;
+	using Dyn = Elf64Dyn_t;
+	using Sym = Elf64Sym_t;
+
+	using Word = uint64_t;
+};
+
+void *CElfModule::Translate(uint64_t vaddr, size_t size) const
+{
+	for (auto &segment : _segments)
+	{
+		if (vaddr >= segment.VirtualAddress && vaddr - segment.VirtualAddress + size <= segment.Size)
+			return PtrAdvance(segment.Address, static_cast<size_t>(vaddr - segment.VirtualAddress));
+	}
+
+	return nullptr;
+}
+
+void *CElfModule::TranslateDynamic(uint64_t value) const
+{
+	// glibc relocates the pointers of the dynamic section in place, other loaders do not.
+	// A linked address of a shared object is far below its load bias, so the two are told apart.
+	if (_layout == eElfLayout::Loaded && _bias != 0 && value >= _bias)
+		value -= _bias;
+
+	return Translate(value);
+}
+
+const void *CElfModule::TranslateOffset(uint64_t offset, uint64_t size) const
+{
+	if (offset > _file_size || size > _file_size - offset)
+		return nullptr;
+
+	return &_image[offset];
+}
+
+size_t CElfModule::GetMappedSize(const void *ptr) const
+{
+	uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+
+	for (auto &segment : _segments)
+	{
+		uintptr_t begin = reinterpret_cast<uintptr_t>(segment.Address);
+
+		if (address >= begin && address - begin < segment.Size)
+			return segment.Size - (address - begin);
+	}
+
+	return 0;
+}
+
+// Compares `name` with a string that may not be terminated within `size` bytes.
+static bool CompareName(const char *str, size_t size, const char *name)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (str[i] != name[i])
+			return false;
+
+		if (!name[i])
+			return true;
+	}
+
+	return false;
+}
+
+template <typename traits>
+bool CElfModule::ParseImage()
+{
+	using Ehdr = typename traits::Ehdr;
+	using Phdr = typename traits::Phdr;
+	using Shdr = typename traits::Shdr;
+	using Dyn = typename traits::Dyn;
+
+	auto ehdr = reinterpret_cast<const Ehdr *>(_image);
+
+	if (ehdr->e_phentsize != sizeof(Phdr) || ehdr->e_phnum == 0)
+		return false;
+
+	// For loaded images the bounds are known after the segment mapping the header is found.
+	if (_layout == eElfLayout::File && !TranslateOffset(ehdr->e_phoff, static_cast<uint64_t>(ehdr->e_phnum) * sizeof(Phdr)))
+		return false;
+
+	auto phdrs = reinterpret_cast<const Phdr *>(&_image[ehdr->e_phoff]);
+
+	if (_layout == eElfLayout::Loaded)
+	{
+		const Phdr *header = nullptr;
+
+		for (uint16_t i = 0; i < ehdr->e_phnum && !header; ++i)
+		{
+			if (phdrs[i].p_type == ELF_PT_LOAD && phdrs[i].p_offset == 0)
+				header = &phdrs[i];
+		}
+
+		if (!header)
+			return false;
+
+		_bias = reinterpret_cast<uintptr_t>(_image) - static_cast<uintptr_t>(header->p_vaddr);
+		_file_size = static_cast<size_t>(header->p_filesz);
+
+		if (!TranslateOffset(ehdr->e_phoff, static_cast<uint64_t>(ehdr->e_phnum) * sizeof(Phdr)))
+			return false;
+	}
+
+	uint64_t dynamic = 0;
+	uint64_t dynamic_size = 0;
+	uint64_t relro = 0;
+	uint64_t relro_size = 0;
+
+	uintptr_t lowest = UINTPTR_MAX;
+	uintptr_t highest = 0;
+
+	for (uint16_t i = 0; i < ehdr->e_phnum; ++i)
+	{
+		const Phdr &phdr = phdrs[i];
+
+		if (phdr.p_type == ELF_PT_DYNAMIC)
+		{
+			dynamic = phdr.p_vaddr;
+			dynamic_size = phdr.p_memsz;
+		}
+		else if (phdr.p_type == ELF_PT_GNU_RELRO)
+		{
+			relro = phdr.p_vaddr;
+			relro_size = phdr.p_memsz;
+		}
+
+		if (phdr.p_type != ELF_PT_LOAD)
+			continue;
+
+		ElfSegment_t segment;
+
+		segment.VirtualAddress = phdr.p_vaddr;
+		segment.Flags = phdr.p_flags;
+
+		if (_layout == eElfLayout::Loaded)
+		{
+			segment.Address = reinterpret_cast<void *>(_bias + static_cast<uintptr_t>(phdr.p_vaddr));
+			segment.Size = static_cast<size_t>(phdr.p_memsz);
+		}
+		else
+		{
+			if (phdr.p_offset > _image_size)
+				continue;
+
+			uint64_t available = _image_size - phdr.p_offset;
+
+			segment.Address = const_cast<uint8_t *>(&_image[phdr.p_offset]);
+			segment.Size = static_cast<size_t>((phdr.p_filesz < available) ? phdr.p_filesz : available);
+		}
+
+		uintptr_t begin = reinterpret_cast<uintptr_t>(segment.Address);
+
+		if (begin < lowest)
+			lowest = begin;
+
+		if (begin + segment.Size > highest)
+			highest = begin + segment.Size;
+
+		_segments.push_back(segment);
+	}
+
+	if (_segments.empty())
+		return false;
+
+	if (_layout == eElfLayout::Loaded)
+	{
+		_address = reinterpret_cast<void *>(lowest);
+		_size = highest - lowest;
+		_image_size = _size;
+	}
+
+	if (relro_size != 0)
+	{
+		_relro = Translate(relro, static_cast<size_t>(relro_size));
+		_relro_size = _relro ? static_cast<size_t>(relro_size) : 0;
+	}
+
+	if (auto dyn = static_cast<const Dyn *>(Translate(dynamic, static_cast<size_t>(dynamic_size))); dyn && dynamic_size)
+	{
+		for (size_t i = 0; i < dynamic_size / sizeof(Dyn) && dyn[i].d_tag != ELF_DT_NULL; ++i)
+		{
+			switch (dyn[i].d_tag)
+			{
+			case ELF_DT_HASH:
+				_hash = static_cast<const uint32_t *>(TranslateDynamic(dyn[i].d_val));
+				break;
+			case ELF_DT_GNU_HASH:
+				_gnu_hash = static_cast<const uint32_t *>(TranslateDynamic(dyn[i].d_val));
+				break;
+			case ELF_DT_SYMTAB:
+				_symtab = TranslateDynamic(dyn[i].d_val);
+				break;
+			case ELF_DT_STRTAB:
+				_strtab = static_cast<const char *>(TranslateDynamic(dyn[i].d_val));
+				break;
+			case ELF_DT_STRSZ:
+				_strsz = static_cast<size_t>(dyn[i].d_val);
+				break;
+			}
+		}
+	}
+
+	// Names are only read within the mapped part of the string table.
+	if (_strtab)
+	{
+		size_t mapped = GetMappedSize(_strtab);
+
+		if (_strsz == 0 || _strsz > mapped)
+			_strsz = mapped;
+	}
+
+	if (ehdr->e_shoff != 0 && ehdr->e_shnum != 0 && ehdr->e_shentsize == sizeof(Shdr) && ehdr->e_shstrndx < ehdr->e_shnum)
+	{
+		auto shdrs = static_cast<const Shdr *>(TranslateOffset(ehdr->e_shoff, static_cast<uint64_t>(ehdr->e_shnum) * sizeof(Shdr)));
+
+		if (shdrs)
+		{
+			const Shdr &names = shdrs[ehdr->e_shstrndx];
+
+			_section_names = static_cast<const char *>(TranslateOffset(names.sh_offset, names.sh_size));
+
+			if (_section_names)
+			{
+				_section_names_size = static_cast<size_t>(names.sh_size);
+				_sections = shdrs;
+				_section_count = ehdr->e_shnum;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool CElfModule::Parse(const void *image, size_t size, eElfLayout layout)
+{
+	_image = static_cast<const uint8_t *>(image);
+	_image_size = size;
+	_file_size = size;
+	_layout = layout;
+	_bias = 0;
+
+	_address = image;
+	_size = size;
+
+	_segments.clear();
+	_relro = nullptr;
+	_relro_size = 0;
+	_symtab = nullptr;
+	_strtab = nullptr;
+	_strsz = 0;
+	_hash = nullptr;
+	_gnu_hash = nullptr;
+	_sections = nullptr;
+	_section_count = 0;
+	_section_names = nullptr;
+	_section_names_size = 0;
+
+	if (!image || (layout == eElfLayout::File && size < sizeof(Elf32Ehdr_t)))
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	if (_image[0] != 0x7F || _image[1] != 'E' || _image[2] != 'L' || _image[3] != 'F' || _image[5] != ELF_DATA2LSB)
+	{
+		SetError(ME_INVALID_MEMORY);
+		return false;
+	}
+
+	bool result;
+
+	if (_image[4] == ELF_CLASS64)
+	{
+		_is64 = true;
+		result = (layout == eElfLayout::Loaded || size >= sizeof(Elf64Ehdr_t)) && ParseImage<Elf64Traits_t>();
+	}
+	else if (_image[4] == ELF_CLASS32)
+	{
+		_is64 = false;
+		result = ParseImage<Elf32Traits_t>();
+	}
+	else
+	{
+		result = false;
+	}
+
+	if (!result)
+	{
+		SetError(ME_INVALID_MEMORY);
+		return false;
+	}
+
+	return true;
+}
+
+template <typename traits>
+bool CElfModule::MatchSymbol(const void *symbol, const char *name) const
+{
+	auto sym = static_cast<const typename traits::Sym *>(symbol);
+
+	if (sym->st_shndx == ELF_SHN_UNDEF || sym->st_name >= _strsz)
+		return false;
+
+	return CompareName(&_strtab[sym->st_name], _strsz - sym->st_name, name);
+}
+
+template <typename traits>
+void *CElfModule::FindSymbolGnu(const char *name) const
+{
+	using Word = typename traits::Word;
+	using Sym = typename traits::Sym;
+
+	constexpr uint32_t kWordBits = sizeof(Word) * 8;
+
+	size_t table_size = GetMappedSize(_gnu_hash);
+
+	if (table_size < 4 * sizeof(uint32_t))
+		return nullptr;
+
+	uint32_t bucket_count = _gnu_hash[0];
+	uint32_t symbol_offset = _gnu_hash[1];
+	uint32_t bloom_size = _gnu_hash[2];
+	uint32_t bloom_shift = _gnu_hash[3];
+
+	if (bucket_count == 0 || bloom_size == 0)
+		return nullptr;
+
+	uint64_t chain_begin = 4 * sizeof(uint32_t) + static_cast<uint64_t>(bloom_size) * sizeof(Word) + static_cast<uint64_t>(bucket_count) * sizeof(uint32_t);
+
+	if (chain_begin > table_size)
+		return nullptr;
+
+	auto bloom = reinterpret_cast<const Word *>(&_gnu_hash[4]);
+	auto buckets = reinterpret_cast<const uint32_t *>(&bloom[bloom_size]);
+	auto chain = &buckets[bucket_count];
+	auto symbols = static_cast<const Sym *>(_symtab);
+
+	// The chain has no stored length and runs to the end of the table.
+	uint64_t chain_count = (table_size - chain_begin) / sizeof(uint32_t);
+	uint64_t symbol_count = GetMappedSize(_symtab) / sizeof(Sym);
+
+	uint32_t hash = ElfGnuHash(name);
+
+	// Two bits of the hash must be set in the filter, which rejects most absent names
+	// without touching the buckets.
+	Word word = bloom[(hash / kWordBits) % bloom_size];
+	Word mask = (Word(1) << (hash % kWordBits)) | (Word(1) << ((hash >> bloom_shift) % kWordBits));
+
+	if ((word & mask) != mask)
+		return nullptr;
+
+	uint32_t index = buckets[hash % bucket_count];
+
+	if (index < symbol_offset)
+		return nullptr;
+
+	// The chain holds the hashes of the symbols of the bucket; the lowest bit marks its end.
+	for (; index - symbol_offset < chain_count && index < symbol_count; ++index)
+	{
+		uint32_t chain_hash = chain[index - symbol_offset];
+
+		if ((hash | 1) == (chain_hash | 1) && MatchSymbol<traits>(&symbols[index], name))
+			return Translate(symbols[index].st_value);
+
+		if (chain_hash & 1)
+			break;
+	}
+
+	return nullptr;
+}
+
+template <typename traits>
+void *CElfModule::FindSymbolSysV(const char *name) const
+{
+	using Sym = typename traits::Sym;
+
+	size_t table_size = GetMappedSize(_hash);
+
+	if (table_size < 2 * sizeof(uint32_t))
+		return nullptr;
+
+	uint32_t bucket_count = _hash[0];
+	uint32_t chain_count = _hash[1];
+
+	if (bucket_count == 0 || 2 * sizeof(uint32_t) + (static_cast<uint64_t>(bucket_count) + chain_count) * sizeof(uint32_t) > table_size)
+		return nullptr;
+
+	auto buckets = &_hash[2];
+	auto chain = &buckets[bucket_count];
+	auto symbols = static_cast<const Sym *>(_symtab);
+
+	// `chain_count` is the number of symbols; the table may still be cut short.
+	uint64_t symbol_count = GetMappedSize(_symtab) / sizeof(Sym);
+
+	if (symbol_count > chain_count)
+		symbol_count = chain_count;
+
+	// A chain visits every symbol at most once, unless the table loops.
+	uint32_t steps = 0;
+
+	for (uint32_t index = buckets[ElfSysVHash(name) % bucket_count]; index != 0 && index < symbol_count && steps < chain_count; index = chain[index], ++steps)
+	{
+		if (MatchSymbol<traits>(&symbols[index], name))
+			return Translate(symbols[index].st_value);
+	}
+
+	return nullptr;
+}
+
+void *CElfModule::FindSymbol(const char *name) const
+{
+	void *result = nullptr;
+
+	if (name && _symtab && _strtab)
+	{
+		if (_gnu_hash)
+			result = _is64 ? FindSymbolGnu<Elf64Traits_t>(name) : FindSymbolGnu<Elf32Traits_t>(name);
+		else if (_hash)
+			result = _is64 ? FindSymbolSysV<Elf64Traits_t>(name) : FindSymbolSysV<Elf32Traits_t>(name);
+	}
+
+	if (!result)
+		SetError(ME_NOT_FOUND);
+
+	return result;
+}
+
+template <typename traits>
+std::pair<void *, size_t> CElfModule::FindSectionHeader(const char *name) const
+{
+	auto shdrs = static_cast<const typename traits::Shdr *>(_sections);
+
+	for (uint16_t i = 0; i < _section_count; ++i)
+	{
+		auto &shdr = shdrs[i];
+
+		if (shdr.sh_name >= _section_names_size || !CompareName(&_section_names[shdr.sh_name], _section_names_size - shdr.sh_name, name))
+			continue;
+
+		size_t size = static_cast<size_t>(shdr.sh_size);
+		void *address;
+
+		// Allocated sections are found through their segment, others only exist in the file.
+		if (shdr.sh_addr != 0)
+			address = Translate(shdr.sh_addr, size);
+		else if (_layout == eElfLayout::File && shdr.sh_type != ELF_SHT_NOBITS)
+			address = const_cast<void *>(TranslateOffset(shdr.sh_offset, size));
+		else
+			address = nullptr;
+
+		if (!address || size == 0)
+			return {};
+
+		return std::make_pair(address, size);
+	}
+
+	return {};
+}
+
+std::pair<void *, size_t> CElfModule::GetSectionInfo(const char *name) const
+{
+	if (!name || !*name)
+		return {};
+
+	if (_sections)
+	{
+		auto info = _is64 ? FindSectionHeader<Elf64Traits_t>(name) : FindSectionHeader<Elf32Traits_t>(name);
+
+		if (info.first)
+			return info;
+	}
+
+	// Without section headers, the segment the section is placed in.
+	if (StrCompA(name, ".text") == 0)
+	{
+		for (auto &segment : _segments)
+		{
+			if (segment.Flags & MEMORIA_ELF_PF_X)
+				return std::make_pair(segment.Address, segment.Size);
+		}
+	}
+	else if (StrCompA(name, ".rodata") == 0)
+	{
+		for (auto &segment : _segments)
+		{
+			if ((segment.Flags & (MEMORIA_ELF_PF_R | MEMORIA_ELF_PF_W | MEMORIA_ELF_PF_X)) == MEMORIA_ELF_PF_R)
+				return std::make_pair(segment.Address, segment.Size);
+		}
+	}
+	else if (StrCompA(name, ".data.rel.ro") == 0 || StrCompA(name, ".got") == 0)
+	{
+		if (_relro)
+			return std::make_pair(_relro, _relro_size);
+	}
+
+	return {};
+}
+
+std::unique_ptr<CMemoryBlock> CElfModule::GetSegment(uint32_t flags) const
+{
+	for (auto &segment : _segments)
+	{
+		if ((segment.Flags & flags) == flags && segment.Size != 0)
+			return std::make_unique<CMemoryBlock>(segment.Address, segment.Size);
+	}
+
+	return {};
+}
+
+std::unique_ptr<CMemoryBlock> CElfModule::GetSection(const char *name) const
+{
+	auto [ptr, size] = GetSectionInfo(name);
+	if (!ptr)
+		return {};
+
+	return std::make_unique<CMemoryBlock>(ptr, size);
+}
+
+bool CElfModule::SigSec(const char *section, const CSignature &signature, SigCallbackFn cb, void *lpParam)
+{
+	auto [ptr, size] = GetSectionInfo(section);
+	if (!ptr)
+		return false;
+
+	CSigHandle sig(ptr, PtrOffset(ptr, size - 1));
+	sig.FindSignature(signature);
+
+	cb(sig, lpParam);
+
+	return true;
+}
+
+bool CElfModule::SigSec(const char *section, const char *signature, SigCallbackFn cb, void *lpParam)
+{
+	CSignature sig(signature);
+	return SigSec(section, sig, cb, lpParam);
+}
+
+bool CElfModule::SigSec(const char *section, SigCallbackFn cb, void *lpParam)
+{
+	auto [ptr, size] = GetSectionInfo(section);
+	if (!ptr)
+		return false;
+
+	CSigHandle sig(ptr, PtrOffset(ptr, size - 1));
+	cb(sig, lpParam);
+
+	return true;
+}
+
+std::unique_ptr<CElfModule> CElfModule::CreateFromImage(const void *image, size_t size, eElfLayout layout)
+{
+	auto module = std::make_unique<CElfModule>();
+
+	if (!module->Parse(image, size, layout))
+		return {};
+
+	return module;
+}
+
+MEMORIA_END
\ No newline at end of file
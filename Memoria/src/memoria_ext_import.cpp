@@ -0,0 +1,438 @@
+#include "memoria_ext_import.hpp"
+
+#include "memoria_core_debug.hpp"
+#include "memoria_core_errors.hpp"
+#include "memoria_core_misc.hpp"
+#include "memoria_core_windows.hpp"
+#include "memoria_core_write.hpp"
+
+MEMORIA_BEGIN
+
+static uint64_t CombineImportHash(fnv1a_t module_hash, fnv1a_t symbol_hash)
+{
+	return module_hash ^ (symbol_hash * 0x9E3779B97F4A7C15ull);
+}
+
+// Imports by ordinal are indexed under a pseudo symbol hash, which cannot collide
+// with a hash of a name in practice.
+static fnv1a_t OrdinalHash(uint16_t ordinal)
+{
+	return 0x4F52440000000000ull | ordinal;
+}
+
+CImportIndex::CImportIndex(HMODULE module)
+	: _module(module)
+{
+}
+
+void CImportIndex::AddSlot(const ImportSlot_t &slot)
+{
+	_slots.push_back(slot);
+}
+
+template <typename thunk_t>
+void CImportIndex::AddThunks(const char *module_name, const thunk_t *names, void **slots, bool delayed)
+{
+	fnv1a_t module_hash = FNV1a64(module_name);
+
+	for (size_t i = 0; names[i].u1.AddressOfData != 0; ++i)
+	{
+		ImportSlot_t slot = {};
+
+		slot.Slot = &slots[i];
+		slot.Next = SIZE_MAX;
+		slot.NextSymbol = SIZE_MAX;
+		slot.ModuleHash = module_hash;
+		slot.ModuleName = module_name;
+		slot.Delayed = delayed;
+
+		if (IMAGE_SNAP_BY_ORDINAL(names[i].u1.Ordinal))
+		{
+			slot.ByOrdinal = true;
+			slot.Ordinal = static_cast<uint16_t>(names[i].u1.Ordinal & 0xFFFF);
+		}
+		else
+		{
+			auto by_name = reinterpret_cast<PIMAGE_IMPORT_BY_NAME>(PtrAdvance(_module, static_cast<size_t>(names[i].u1.AddressOfData)));
+
+			slot.Name = by_name->Name;
+			slot.SymbolHash = FNV1a64(by_name->Name);
+			slot.Ordinal = by_name->Hint;
+		}
+
+		AddSlot(slot);
+	}
+}
+
+bool CImportIndex::Build()
+{
+	auto dos = reinterpret_cast<PIMAGE_DOS_HEADER>(_module);
+
+	if (dos == nullptr || dos->e_magic != IMAGE_DOS_SIGNATURE)
+		return false;
+
+	uint32_t size = 0;
+	auto desc = reinterpret_cast<PIMAGE_IMPORT_DESCRIPTOR>(GetImageDirectoryData(_module, true, IMAGE_DIRECTORY_ENTRY_IMPORT, &size));
+
+	for (; desc && desc->Name != 0; ++desc)
+	{
+		// Bound images without a name table keep only resolved addresses in the IAT.
+		if (desc->OriginalFirstThunk == 0)
+			continue;
+
+		auto name = reinterpret_cast<const char *>(PtrAdvance(_module, desc->Name));
+		auto names = reinterpret_cast<const IMAGE_THUNK_DATA *>(PtrAdvance(_module, desc->OriginalFirstThunk));
+		auto slots = reinterpret_cast<void **>(PtrAdvance(_module, desc->FirstThunk));
+
+		AddThunks(name, names, slots, false);
+	}
+
+	auto delay = reinterpret_cast<PIMAGE_DELAYLOAD_DESCRIPTOR>(GetImageDirectoryData(_module, true, IMAGE_DIRECTORY_ENTRY_DELAY_IMPORT, &size));
+
+	for (; delay && delay->DllNameRVA != 0; ++delay)
+	{
+		// Pre-VC7 descriptors store absolute addresses; those are not produced by any supported toolchain.
+		if (!delay->Attributes.RvaBased || delay->ImportNameTableRVA == 0)
+			continue;
+
+		auto name = reinterpret_cast<const char *>(PtrAdvance(_module, delay->DllNameRVA));
+		auto names = reinterpret_cast<const IMAGE_THUNK_DATA *>(PtrAdvance(_module, delay->ImportNameTableRVA));
+		auto slots = reinterpret_cast<void **>(PtrAdvance(_module, delay->ImportAddressTableRVA));
+
+		AddThunks(name, names, slots, true);
+	}
+
+	// The vector does not grow past this point, so the index may refer to its elements.
+	_index.reserve(_slots.size());
+	_symbols.reserve(_slots.size());
+
+	// In reverse, so every chain starts with the first entry in table order.
+	for (size_t i = _slots.size(); i-- > 0;)
+	{
+		auto &slot = _slots[i];
+		fnv1a_t symbol_hash = slot.ByOrdinal ? OrdinalHash(slot.Ordinal) : slot.SymbolHash;
+		uint64_t key = CombineImportHash(slot.ModuleHash, symbol_hash);
+
+		if (auto next = _index.find(key))
+			slot.Next = *next;
+
+		_index.insert(key, i);
+
+		if (slot.ByOrdinal)
+			continue;
+
+		if (auto next = _symbols.find(slot.SymbolHash))
+			slot.NextSymbol = *next;
+
+		_symbols.insert(slot.SymbolHash, i);
+	}
+
+	return true;
+}
+
+const ImportSlot_t *CImportIndex::Scan(size_t index, fnv1a_t module_hash, fnv1a_t symbol_hash, bool by_ordinal, uint16_t ordinal) const
+{
+	// Chains are built by hash, so entries of colliding keys are skipped here.
+	while (index != SIZE_MAX)
+	{
+		auto &slot = _slots[index];
+
+		bool match = by_ordinal
+			? slot.ByOrdinal && slot.Ordinal == ordinal && slot.ModuleHash == module_hash
+			: !slot.ByOrdinal && slot.SymbolHash == symbol_hash && (module_hash == 0 || slot.ModuleHash == module_hash);
+
+		if (match)
+			return &slot;
+
+		index = (module_hash != 0) ? slot.Next : slot.NextSymbol;
+	}
+
+	return nullptr;
+}
+
+const ImportSlot_t *CImportIndex::Find(fnv1a_t module_hash, fnv1a_t symbol_hash) const
+{
+	const size_t *index = (module_hash != 0)
+		? _index.find(CombineImportHash(module_hash, symbol_hash))
+		: _symbols.find(symbol_hash);
+
+	if (index == nullptr)
+		return nullptr;
+
+	return Scan(*index, module_hash, symbol_hash, false, 0);
+}
+
+const ImportSlot_t *CImportIndex::FindByOrdinal(fnv1a_t module_hash, uint16_t ordinal) const
+{
+	const size_t *index = _index.find(CombineImportHash(module_hash, OrdinalHash(ordinal)));
+
+	if (index == nullptr)
+		return nullptr;
+
+	return Scan(*index, module_hash, 0, true, ordinal);
+}
+
+const ImportSlot_t *CImportIndex::FindNext(const ImportSlot_t *slot, fnv1a_t module_hash) const
+{
+	if (slot == nullptr)
+		return nullptr;
+
+	size_t next = (module_hash != 0) ? slot->Next : slot->NextSymbol;
+
+	return Scan(next, module_hash, slot->SymbolHash, slot->ByOrdinal, slot->Ordinal);
+}
+
+static SRWLOCK gImportIndicesLock = SRWLOCK_INIT;
+static Memoria::HashMap<HMODULE, CImportIndex *> gImportIndices;
+
+// Invalidated indices; callers may still hold them, so they are kept until the process exits.
+static Memoria::Vector<CImportIndex *> gRetiredImportIndices;
+
+struct ImportHook_t
+{
+	void *Original;
+	const void *Hook;
+};
+
+// Installed hooks by entry address. Held exclusively while entries are written.
+static SRWLOCK gImportHooksLock = SRWLOCK_INIT;
+static Memoria::HashMap<void **, ImportHook_t> gImportHooks;
+
+CImportIndex *GetImportIndex(HMODULE module)
+{
+	if (module == nullptr)
+		module = GetModuleHandleA(nullptr);
+
+	AcquireSRWLockShared(&gImportIndicesLock);
+
+	auto cached = gImportIndices.find(module);
+	CImportIndex *result = cached ? *cached : nullptr;
+
+	ReleaseSRWLockShared(&gImportIndicesLock);
+
+	if (result)
+		return result;
+
+	AcquireSRWLockExclusive(&gImportIndicesLock);
+
+	// Another thread may have built it in the meantime.
+	if (auto existing = gImportIndices.find(module))
+	{
+		result = *existing;
+		ReleaseSRWLockExclusive(&gImportIndicesLock);
+
+		return result;
+	}
+
+	result = new CImportIndex(module);
+
+	if (!result->Build())
+	{
+		delete result;
+		ReleaseSRWLockExclusive(&gImportIndicesLock);
+
+		SetError(ME_INVALID_MEMORY);
+		return nullptr;
+	}
+
+	gImportIndices.insert(module, result);
+	ReleaseSRWLockExclusive(&gImportIndicesLock);
+
+	return result;
+}
+
+void InvalidateImportIndex(HMODULE module)
+{
+	AcquireSRWLockExclusive(&gImportIndicesLock);
+
+	if (module == nullptr)
+	{
+		gImportIndices.for_each([](HMODULE, CImportIndex *index) { gRetiredImportIndices.push_back(index); });
+		gImportIndices.clear();
+	}
+	else if (auto index = gImportIndices.find(module))
+	{
+		gRetiredImportIndices.push_back(*index);
+		gImportIndices.erase(module);
+	}
+
+	ReleaseSRWLockExclusive(&gImportIndicesLock);
+
+	// Hooks whose entry was released or overwritten by someone else are forgotten;
+	// the others stay installed and can still be removed through a new index.
+	Memoria::Vector<void **> stale;
+
+	AcquireSRWLockExclusive(&gImportHooksLock);
+
+	gImportHooks.for_each([&stale](void **slot, const ImportHook_t &hook)
+	{
+		void *value = nullptr;
+
+		if (!GuardedCopy(&value, slot, sizeof(value)) || value != hook.Hook)
+			stale.push_back(slot);
+	});
+
+	for (void **slot : stale)
+		gImportHooks.erase(slot);
+
+	ReleaseSRWLockExclusive(&gImportHooksLock);
+}
+
+//
+// A delay-loaded entry initially points to a thunk inside the importing module, which
+// resolves the import and overwrites the entry on the first call. Hooking such an entry
+// as is would lose the hook on that first call, so the import is resolved up front.
+//
+static void *ResolveDelayedSlot(HMODULE module, const ImportSlot_t &slot)
+{
+	void *value = *slot.Slot;
+
+	if (!IsInBounds(value, module, PtrAdvance(module, GetModuleSize(module))))
+		return value;
+
+	HMODULE library = LoadLibraryA(slot.ModuleName);
+
+	if (library == nullptr)
+		return nullptr;
+
+	return reinterpret_cast<void *>(GetProcAddress(library, slot.ByOrdinal ? MAKEINTRESOURCEA(slot.Ordinal) : slot.Name));
+}
+
+// Hooks `slot` and the other entries of the same symbol.
+static bool HookImportSlots(const CImportIndex *index, const ImportSlot_t *slot, fnv1a_t module_hash, const void *hook, void *original)
+{
+	if (slot == nullptr)
+	{
+		SetError(ME_NOT_FOUND);
+		return false;
+	}
+
+	bool result = true;
+	void *first_original = nullptr;
+
+	AcquireSRWLockExclusive(&gImportHooksLock);
+
+	for (; slot; slot = index->FindNext(slot, module_hash))
+	{
+		void *previous;
+
+		if (auto existing = gImportHooks.find(slot->Slot))
+		{
+			// Already hooked, only the hook itself is replaced.
+			previous = existing->Original;
+		}
+		else
+		{
+			previous = *slot->Slot;
+
+			if (slot->Delayed)
+				previous = ResolveDelayedSlot(index->GetModule(), *slot);
+
+			if (previous == nullptr)
+			{
+				SetError(ME_NOT_FOUND);
+				result = false;
+
+				continue;
+			}
+		}
+
+		if (!WritePointerAtomic(slot->Slot, hook))
+		{
+			result = false;
+			continue;
+		}
+
+		gImportHooks.insert(slot->Slot, { previous, hook });
+
+		if (first_original == nullptr)
+			first_original = previous;
+	}
+
+	ReleaseSRWLockExclusive(&gImportHooksLock);
+
+	// Also on partial failure: the hooked entries already call the hook.
+	if (original && first_original)
+		*reinterpret_cast<void **>(original) = first_original;
+
+	return result;
+}
+
+static bool UnhookImportSlots(const CImportIndex *index, const ImportSlot_t *slot, fnv1a_t module_hash)
+{
+	bool result = false;
+
+	AcquireSRWLockExclusive(&gImportHooksLock);
+
+	for (; slot; slot = index->FindNext(slot, module_hash))
+	{
+		auto existing = gImportHooks.find(slot->Slot);
+
+		if (existing && WritePointerAtomic(slot->Slot, existing->Original))
+		{
+			gImportHooks.erase(slot->Slot);
+			result = true;
+		}
+	}
+
+	ReleaseSRWLockExclusive(&gImportHooksLock);
+
+	if (!result)
+		SetError(ME_NOT_FOUND);
+
+	return result;
+}
+
+bool HookImport(HMODULE module, fnv1a_t module_hash, fnv1a_t symbol_hash, const void *hook, void *original)
+{
+	if (hook == nullptr)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	auto index = GetImportIndex(module);
+
+	if (index == nullptr)
+		return false;
+
+	return HookImportSlots(index, index->Find(module_hash, symbol_hash), module_hash, hook, original);
+}
+
+bool HookImportByOrdinal(HMODULE module, fnv1a_t module_hash, uint16_t ordinal, const void *hook, void *original)
+{
+	if (hook == nullptr)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	auto index = GetImportIndex(module);
+
+	if (index == nullptr)
+		return false;
+
+	return HookImportSlots(index, index->FindByOrdinal(module_hash, ordinal), module_hash, hook, original);
+}
+
+bool UnhookImport(HMODULE module, fnv1a_t module_hash, fnv1a_t symbol_hash)
+{
+	auto index = GetImportIndex(module);
+
+	if (index == nullptr)
+		return false;
+
+	return UnhookImportSlots(index, index->Find(module_hash, symbol_hash), module_hash);
+}
+
+bool UnhookImportByOrdinal(HMODULE module, fnv1a_t module_hash, uint16_t ordinal)
+{
+	auto index = GetImportIndex(module);
+
+	if (index == nullptr)
+		return false;
+
+	return UnhookImportSlots(index, index->FindByOrdinal(module_hash, ordinal), module_hash);
+}
+
+MEMORIA_END
\ No newline at end of file
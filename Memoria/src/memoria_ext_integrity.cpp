@@ -0,0 +1,486 @@
+#include "memoria_ext_integrity.hpp"
+
+#include "memoria_core_hash.hpp"
+#include "memoria_core_misc.hpp"
+#include "memoria_core_write.hpp"
+#include "memoria_core_errors.hpp"
+
+#include "memoria_ext_logger.hpp"
+#include "memoria_ext_patch.hpp"
+
+#include "memoria_utils_string.hpp"
+#include "memoria_utils_vector.hpp"
+#include "memoria_utils_hashmap.hpp"
+
+MEMORIA_BEGIN
+
+static constexpr uintptr_t kIntegrityPageSize = 0x1000;
+static constexpr uint32_t kIntegrityNoPatch = UINT32_MAX;
+
+struct IntegrityRange_t
+{
+	uint8_t *Address;
+	uint32_t Size;
+
+	// Id of the patch, or `kIntegrityNoPatch` for code ranges.
+	uint32_t PatchId;
+
+	// Offset of the expected bytes of code ranges in `gIntegrityBytes`.
+	uint32_t DataOffset;
+};
+
+struct IntegrityPage_t
+{
+	uint8_t *Base;
+
+	// Hash of the page when its ranges were last found intact.
+	uint32_t Hash;
+	bool Verified;
+
+	// Ranges on this page: `gIntegrityLinks[FirstLink .. FirstLink + LinkCount)`.
+	uint32_t FirstLink;
+	uint32_t LinkCount;
+};
+
+static SRWLOCK gIntegrityLock = SRWLOCK_INIT;
+
+static Memoria::Vector<IntegrityRange_t> gIntegrityRanges;
+static Memoria::Vector<uint8_t> gIntegrityBytes;
+
+// Built lazily from the ranges by `RebuildIntegrityPages`.
+static Memoria::Vector<IntegrityPage_t> gIntegrityPages;
+static Memoria::Vector<uint32_t> gIntegrityLinks;
+static Memoria::HashMap<uintptr_t, uint32_t> gIntegrityPageIndex;
+static bool gIntegrityDirty = false;
+
+// Next page to check.
+static size_t gIntegrityCursor = 0;
+
+static IntegrityCallback_t gIntegrityCallback = nullptr;
+static IntegrityStats_t gIntegrityStats = {};
+
+// Copy of the page being hashed; a static buffer avoids a page-sized stack frame.
+static uint8_t gIntegrityPageCopy[kIntegrityPageSize];
+
+// Violations found by one check. They are handled after `gIntegrityLock` is released,
+// so the callback may watch or unwatch ranges.
+struct IntegrityFindings_t
+{
+	Memoria::Vector<IntegrityViolation_t> Violations;
+
+	// Expected bytes of each violated code range, in the order of `Violations`.
+	Memoria::Vector<uint8_t> Bytes;
+};
+
+template <typename fn_t>
+static void ForEachRangePage(const IntegrityRange_t &range, fn_t fn)
+{
+	uintptr_t begin = reinterpret_cast<uintptr_t>(range.Address) & ~(kIntegrityPageSize - 1);
+	uintptr_t end = reinterpret_cast<uintptr_t>(range.Address) + range.Size;
+
+	for (uintptr_t page = begin; page < end; page += kIntegrityPageSize)
+		fn(page);
+}
+
+static void RebuildIntegrityPages()
+{
+	gIntegrityPages.clear();
+	gIntegrityPageIndex.clear();
+
+	// Count the ranges per page, then place the links with a prefix sum.
+	for (auto &range : gIntegrityRanges)
+	{
+		ForEachRangePage(range, [](uintptr_t page)
+		{
+			if (auto index = gIntegrityPageIndex.find(page))
+			{
+				gIntegrityPages[*index].LinkCount++;
+				return;
+			}
+
+			gIntegrityPageIndex.insert(page, static_cast<uint32_t>(gIntegrityPages.size()));
+			gIntegrityPages.push_back({ reinterpret_cast<uint8_t *>(page), 0, false, 0, 1 });
+		});
+	}
+
+	uint32_t links = 0;
+
+	for (auto &page : gIntegrityPages)
+	{
+		page.FirstLink = links;
+		links += page.LinkCount;
+		page.LinkCount = 0;
+	}
+
+	gIntegrityLinks.resize(links);
+
+	for (size_t i = 0; i < gIntegrityRanges.size(); ++i)
+	{
+		ForEachRangePage(gIntegrityRanges[i], [i](uintptr_t page)
+		{
+			auto &entry = gIntegrityPages[*gIntegrityPageIndex.find(page)];
+			gIntegrityLinks[entry.FirstLink + entry.LinkCount++] = static_cast<uint32_t>(i);
+		});
+	}
+
+	// New pages have no verified hash yet, so their first check compares all ranges.
+	gIntegrityStats.Pages = gIntegrityPages.size();
+	gIntegrityStats.Ranges = gIntegrityRanges.size();
+
+	gIntegrityCursor = 0;
+	gIntegrityDirty = false;
+}
+
+static bool AddIntegrityRange(const void *addr, size_t size, uint32_t patch_id, const void *expected)
+{
+	if (!addr || size == 0 || size > UINT32_MAX)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	AcquireSRWLockExclusive(&gIntegrityLock);
+
+	IntegrityRange_t range = { static_cast<uint8_t *>(const_cast<void *>(addr)), static_cast<uint32_t>(size), patch_id, 0 };
+
+	if (expected)
+	{
+		range.DataOffset = static_cast<uint32_t>(gIntegrityBytes.size());
+
+		gIntegrityBytes.resize(gIntegrityBytes.size() + size);
+		MemCopy(&gIntegrityBytes[range.DataOffset], expected, size);
+	}
+
+	gIntegrityRanges.push_back(range);
+	gIntegrityDirty = true;
+
+	ReleaseSRWLockExclusive(&gIntegrityLock);
+
+	return true;
+}
+
+bool WatchPatch(CPatch *patch)
+{
+	if (!patch)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	return AddIntegrityRange(patch->GetAddress(), patch->GetSize(), patch->GetId(), nullptr);
+}
+
+bool WatchPatches()
+{
+	for (uint32_t id = 0; id < GetPatchCount(); ++id)
+	{
+		if (!WatchPatch(GetPatch(id)))
+			return false;
+	}
+
+	return true;
+}
+
+bool WatchCode(const void *addr, size_t size)
+{
+	if (!IsMemoryValid(addr))
+	{
+		SetError(ME_INVALID_MEMORY);
+		return false;
+	}
+
+	return AddIntegrityRange(addr, size, kIntegrityNoPatch, addr);
+}
+
+void UnwatchAll()
+{
+	AcquireSRWLockExclusive(&gIntegrityLock);
+
+	gIntegrityRanges.clear();
+	gIntegrityBytes.clear();
+	gIntegrityDirty = true;
+
+	ReleaseSRWLockExclusive(&gIntegrityLock);
+}
+
+void UnwatchPatches()
+{
+	AcquireSRWLockExclusive(&gIntegrityLock);
+
+	// Code ranges keep their offsets into `gIntegrityBytes`.
+	size_t kept = 0;
+
+	for (auto &range : gIntegrityRanges)
+	{
+		if (range.PatchId == kIntegrityNoPatch)
+			gIntegrityRanges[kept++] = range;
+	}
+
+	gIntegrityRanges.resize(kept);
+	gIntegrityDirty = true;
+
+	ReleaseSRWLockExclusive(&gIntegrityLock);
+}
+
+void SetIntegrityCallback(IntegrityCallback_t callback)
+{
+	AcquireSRWLockExclusive(&gIntegrityLock);
+	gIntegrityCallback = callback;
+	ReleaseSRWLockExclusive(&gIntegrityLock);
+}
+
+// Compares one range with its expected bytes and records a divergence.
+// Returns `true` if the range is intact.
+static bool CheckIntegrityRange(IntegrityRange_t &range, IntegrityFindings_t &findings)
+{
+	CPatch *patch = nullptr;
+	bool intact;
+
+	if (range.PatchId != kIntegrityNoPatch)
+	{
+		patch = GetPatch(range.PatchId);
+
+		// The patch registry was released.
+		if (!patch || patch->GetAddress() != range.Address)
+			return true;
+
+		intact = patch->IsValid();
+	}
+	else
+	{
+		// The range may extend to a page that was released since.
+		if (!GuardedCompare(range.Address, &gIntegrityBytes[range.DataOffset], range.Size, &intact))
+			return true;
+	}
+
+	if (intact)
+		return true;
+
+	gIntegrityStats.Violations++;
+
+	findings.Violations.push_back({ range.Address, range.Size, patch });
+
+	if (!patch)
+	{
+		size_t offset = findings.Bytes.size();
+
+		findings.Bytes.resize(offset + range.Size);
+		MemCopy(&findings.Bytes[offset], &gIntegrityBytes[range.DataOffset], range.Size);
+	}
+
+	return false;
+}
+
+// Reports a violation and writes the expected bytes back if requested.
+// `expected` points to the bytes of a code range and is advanced past them.
+static void HandleIntegrityViolation(const IntegrityViolation_t &violation, const uint8_t *&expected, IntegrityCallback_t callback)
+{
+	bool reapply;
+
+	if (callback)
+	{
+		reapply = callback(violation);
+	}
+	else
+	{
+		char where[128];
+		BeautifyPointer(violation.Address, where, sizeof(where));
+
+		DispatchLog("Integrity violation at %s (%u bytes), reapplying", where, static_cast<uint32_t>(violation.Size));
+		reapply = true;
+	}
+
+	if (reapply)
+	{
+		if (violation.Patch)
+			violation.Patch->Toggle(violation.Patch->IsActive());
+		else
+			WriteMemory(violation.Address, expected, violation.Size);
+	}
+
+	if (!violation.Patch)
+		expected += violation.Size;
+}
+
+// Returns the number of violations on the page.
+static size_t CheckIntegrityPage(IntegrityPage_t &page, IntegrityFindings_t &findings)
+{
+	gIntegrityStats.PagesChecked++;
+
+	// Hashed from a copy, as the page may be released at any time, e.g. by unloading its module.
+	if (!GuardedCopy(gIntegrityPageCopy, page.Base, kIntegrityPageSize))
+	{
+		page.Verified = false;
+		return 0;
+	}
+
+	uint32_t hash = CRC32C(gIntegrityPageCopy, kIntegrityPageSize);
+
+	if (page.Verified && hash == page.Hash)
+		return 0;
+
+	gIntegrityStats.PagesChanged++;
+
+	// Other data on the page may change freely, so a different hash alone is no violation.
+	size_t violations = 0;
+
+	for (uint32_t i = 0; i < page.LinkCount; ++i)
+	{
+		if (!CheckIntegrityRange(gIntegrityRanges[gIntegrityLinks[page.FirstLink + i]], findings))
+			++violations;
+	}
+
+	// Reapplied ranges are verified again by the next check.
+	page.Hash = hash;
+	page.Verified = (violations == 0);
+
+	return violations;
+}
+
+size_t CheckIntegrity(uint32_t budget_us)
+{
+	LARGE_INTEGER frequency, start, now;
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start);
+
+	int64_t budget = static_cast<int64_t>(budget_us) * frequency.QuadPart / 1000000;
+
+	AcquireSRWLockExclusive(&gIntegrityLock);
+
+	if (gIntegrityDirty)
+		RebuildIntegrityPages();
+
+	IntegrityFindings_t findings;
+	size_t count = gIntegrityPages.size();
+
+	// Always make progress, even if the budget is smaller than one page.
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (gIntegrityCursor >= count)
+			gIntegrityCursor = 0;
+
+		CheckIntegrityPage(gIntegrityPages[gIntegrityCursor++], findings);
+
+		if (budget_us != 0)
+		{
+			QueryPerformanceCounter(&now);
+
+			if (now.QuadPart - start.QuadPart >= budget)
+				break;
+		}
+	}
+
+	IntegrityCallback_t callback = gIntegrityCallback;
+
+	ReleaseSRWLockExclusive(&gIntegrityLock);
+
+	const uint8_t *expected = findings.Bytes.data();
+
+	for (auto &violation : findings.Violations)
+		HandleIntegrityViolation(violation, expected, callback);
+
+	return findings.Violations.size();
+}
+
+static SRWLOCK gIntegrityMonitorLock = SRWLOCK_INIT;
+
+// Every monitor thread gets its own stop event as parameter and closes it on exit. A thread
+// stopped by its own callback may thus still be finishing a check while a new one is started.
+static HANDLE gIntegrityMonitorThread = nullptr;
+static HANDLE gIntegrityMonitorStop = nullptr;
+static volatile uint32_t gIntegrityMonitorInterval = 0;
+static volatile uint32_t gIntegrityMonitorBudget = 0;
+
+static bool gIntegrityMonitorExitRegistered = false;
+
+static void IntegrityMonitorThread(LPVOID param)
+{
+	HANDLE stop = static_cast<HANDLE>(param);
+
+	// The stop event also ends the wait early.
+	while (WaitForSingleObject(stop, gIntegrityMonitorInterval) == WAIT_TIMEOUT)
+		CheckIntegrity(gIntegrityMonitorBudget);
+
+	CloseHandle(stop);
+}
+
+bool StartIntegrityMonitor(uint32_t interval_ms, uint32_t budget_us)
+{
+	if (interval_ms == 0)
+		return false;
+
+	AcquireSRWLockExclusive(&gIntegrityMonitorLock);
+
+	gIntegrityMonitorInterval = interval_ms;
+	gIntegrityMonitorBudget = budget_us;
+
+	if (!gIntegrityMonitorThread)
+	{
+		HANDLE stop = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+
+		if (stop)
+		{
+			gIntegrityMonitorThread = BeginThreadHandle(IntegrityMonitorThread, stop);
+
+			if (gIntegrityMonitorThread)
+				gIntegrityMonitorStop = stop;
+			else
+				CloseHandle(stop);
+		}
+
+		if (gIntegrityMonitorThread && !gIntegrityMonitorExitRegistered)
+		{
+			gIntegrityMonitorExitRegistered = true;
+			RegisterOnExitCallback(StopIntegrityMonitor);
+		}
+	}
+
+	bool result = gIntegrityMonitorThread != nullptr;
+
+	ReleaseSRWLockExclusive(&gIntegrityMonitorLock);
+
+	return result;
+}
+
+void StopIntegrityMonitor()
+{
+	AcquireSRWLockExclusive(&gIntegrityMonitorLock);
+
+	HANDLE thread = gIntegrityMonitorThread;
+
+	// Signaled while the lock is held: the thread only closes the event after it was signaled.
+	if (thread)
+		SetEvent(gIntegrityMonitorStop);
+
+	gIntegrityMonitorThread = nullptr;
+	gIntegrityMonitorStop = nullptr;
+
+	ReleaseSRWLockExclusive(&gIntegrityMonitorLock);
+
+	if (!thread)
+		return;
+
+	// Waited for without the lock, so the callback of the last check may still start or stop
+	// the monitor. It runs on the thread and cannot wait for its own exit.
+	if (GetThreadId(thread) != GetCurrentThreadId())
+		WaitForSingleObject(thread, INFINITE);
+
+	CloseHandle(thread);
+}
+
+IntegrityStats_t GetIntegrityStats()
+{
+	AcquireSRWLockExclusive(&gIntegrityLock);
+
+	if (gIntegrityDirty)
+		RebuildIntegrityPages();
+
+	IntegrityStats_t result = gIntegrityStats;
+
+	ReleaseSRWLockExclusive(&gIntegrityLock);
+
+	return result;
+}
+
+MEMORIA_END
\ No newline at end of file
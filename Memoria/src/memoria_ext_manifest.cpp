@@ -0,0 +1,408 @@
+#include "memoria_ext_manifest.hpp"
+
+#include "memoria_core_hook.hpp"
+#include "memoria_core_misc.hpp"
+#include "memoria_core_search.hpp"
+#include "memoria_core_windows.hpp"
+#include "memoria_core_errors.hpp"
+
+#include "memoria_ext_patch.hpp"
+
+#include "memoria_utils_string.hpp"
+
+MEMORIA_BEGIN
+
+static uint32_t GetModuleTimeDateStamp(HMODULE module)
+{
+	auto dos = reinterpret_cast<PIMAGE_DOS_HEADER>(module);
+	auto nt = reinterpret_cast<PIMAGE_NT_HEADERS>(reinterpret_cast<uint8_t *>(module) + dos->e_lfanew);
+
+	return nt->FileHeader.TimeDateStamp;
+}
+
+static fnv1a_t GetModuleNameHash(HMODULE module)
+{
+	wchar_t path[MAX_PATH];
+	DWORD length = GetModuleFileNameW(module, path, MAX_PATH);
+
+	if (length == 0 || length >= MAX_PATH)
+		return 0;
+
+	const wchar_t *name = path;
+
+	for (DWORD i = 0; i < length; ++i)
+	{
+		if (path[i] == L'\\' || path[i] == L'/')
+			name = &path[i + 1];
+	}
+
+	return FNV1a64(name);
+}
+
+uint32_t CManifestWriter::AddData(const void *data, size_t size)
+{
+	auto offset = static_cast<uint32_t>(_data.size());
+
+	_data.resize(_data.size() + size);
+	MemCopy(&_data[offset], data, size);
+
+	return offset;
+}
+
+bool CManifestWriter::AddEntry(eManifestEntry kind, const void *addr, size_t size, const void *original, const void *patch,
+	const char *signature, ptrdiff_t signature_delta, fnv1a_t hook_name)
+{
+	HMODULE module = nullptr;
+
+	if (!GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+		static_cast<LPCSTR>(addr), &module))
+	{
+		SetError(ME_NOT_FOUND);
+		return false;
+	}
+
+	size_t signature_size = signature ? StrLenA(signature) : 0;
+
+	if (size == 0 || size > UINT32_MAX || signature_size > UINT16_MAX)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	ManifestModule_t record = { GetModuleNameHash(module), GetModuleTimeDateStamp(module), GetModuleSize(module) };
+
+	if (record.NameHash == 0)
+	{
+		SetError(ME_NOT_FOUND);
+		return false;
+	}
+
+	uint32_t module_index = 0;
+
+	while (module_index < _modules.size() && _modules[module_index].NameHash != record.NameHash)
+		++module_index;
+
+	if (module_index == _modules.size())
+		_modules.push_back(record);
+
+	ManifestEntry_t entry = {};
+
+	entry.Module = module_index;
+	entry.Kind = kind;
+	entry.SignatureSize = static_cast<uint16_t>(signature_size);
+	entry.Rva = static_cast<uint32_t>(static_cast<const uint8_t *>(addr) - reinterpret_cast<uint8_t *>(module));
+	entry.Size = static_cast<uint32_t>(size);
+	entry.OriginalOffset = AddData(original, size);
+	entry.PatchOffset = patch ? AddData(patch, size) : 0;
+	entry.SignatureOffset = signature ? AddData(signature, signature_size + 1) : 0;
+	entry.SignatureDelta = static_cast<int32_t>(signature_delta);
+	entry.HookName = hook_name;
+
+	_entries.push_back(entry);
+	return true;
+}
+
+bool CManifestWriter::AddPatch(CPatch *patch, const char *signature, ptrdiff_t signature_delta)
+{
+	if (!patch)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	return AddEntry(eManifestEntry::Patch, patch->GetAddress(), patch->GetSize(), patch->GetDataOrigin(), patch->GetDataPatch(),
+		signature, signature_delta, 0);
+}
+
+bool CManifestWriter::AddPatches()
+{
+	for (uint32_t id = 0; id < GetPatchCount(); ++id)
+	{
+		if (!AddPatch(GetPatch(id)))
+			return false;
+	}
+
+	return true;
+}
+
+bool CManifestWriter::AddHook(fnv1a_t name, const void *target, size_t size, const char *signature, ptrdiff_t signature_delta)
+{
+	if (!target || !IsMemoryValid(target))
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	return AddEntry(eManifestEntry::Hook, target, size, target, nullptr, signature, signature_delta, name);
+}
+
+bool CManifestWriter::Save(const char *path) const
+{
+	ManifestHeader_t header = {};
+
+	header.Magic = MEMORIA_MANIFEST_MAGIC;
+	header.Version = MEMORIA_MANIFEST_VERSION;
+	header.PointerSize = sizeof(void *);
+	header.ModuleCount = static_cast<uint32_t>(_modules.size());
+	header.EntryCount = static_cast<uint32_t>(_entries.size());
+	header.ModulesOffset = sizeof(ManifestHeader_t);
+	header.EntriesOffset = header.ModulesOffset + header.ModuleCount * sizeof(ManifestModule_t);
+	header.DataOffset = header.EntriesOffset + header.EntryCount * sizeof(ManifestEntry_t);
+	header.DataSize = static_cast<uint32_t>(_data.size());
+
+	HANDLE file = CreateFileA(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	auto write = [file](const void *data, size_t size) -> bool
+	{
+		DWORD written = 0;
+		return size == 0 || (WriteFile(file, data, static_cast<DWORD>(size), &written, nullptr) && written == size);
+	};
+
+	bool result = write(&header, sizeof(header))
+		&& write(_modules.data(), _modules.size() * sizeof(ManifestModule_t))
+		&& write(_entries.data(), _entries.size() * sizeof(ManifestEntry_t))
+		&& write(_data.data(), _data.size());
+
+	CloseHandle(file);
+
+	return result;
+}
+
+CManifest::~CManifest()
+{
+	Close();
+}
+
+bool CManifest::Open(const char *path)
+{
+	Close();
+
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		SetError(ME_NOT_FOUND);
+		return false;
+	}
+
+	LARGE_INTEGER size = {};
+	HANDLE mapping = nullptr;
+
+	if (GetFileSizeEx(file, &size) && size.QuadPart >= static_cast<LONGLONG>(sizeof(ManifestHeader_t)) && size.QuadPart <= UINT32_MAX)
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	// The view keeps the mapping alive.
+	if (mapping)
+	{
+		_view = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		_size = static_cast<size_t>(size.QuadPart);
+
+		CloseHandle(mapping);
+	}
+
+	CloseHandle(file);
+
+	if (!_view || !Validate())
+	{
+		Close();
+
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	return true;
+}
+
+void CManifest::Close()
+{
+	if (_view)
+		UnmapViewOfFile(_view);
+
+	_view = nullptr;
+	_size = 0;
+}
+
+bool CManifest::Validate() const
+{
+	auto header = GetHeader();
+
+	if (header->Magic != MEMORIA_MANIFEST_MAGIC || header->Version != MEMORIA_MANIFEST_VERSION || header->PointerSize != sizeof(void *))
+		return false;
+
+	uint64_t modules_end = header->ModulesOffset + static_cast<uint64_t>(header->ModuleCount) * sizeof(ManifestModule_t);
+	uint64_t entries_end = header->EntriesOffset + static_cast<uint64_t>(header->EntryCount) * sizeof(ManifestEntry_t);
+	uint64_t data_end = header->DataOffset + static_cast<uint64_t>(header->DataSize);
+
+	if (modules_end > _size || entries_end > _size || data_end > _size)
+		return false;
+
+	// Records are used in place, so all blob references are checked once here.
+	auto entries = GetEntries();
+
+	for (uint32_t i = 0; i < header->EntryCount; ++i)
+	{
+		auto &entry = entries[i];
+
+		if (entry.Module >= header->ModuleCount || entry.Size == 0)
+			return false;
+
+		if (entry.OriginalOffset + static_cast<uint64_t>(entry.Size) > header->DataSize)
+			return false;
+
+		if (entry.Kind == eManifestEntry::Patch && entry.PatchOffset + static_cast<uint64_t>(entry.Size) > header->DataSize)
+			return false;
+
+		if (entry.SignatureSize != 0 && (entry.SignatureOffset + static_cast<uint64_t>(entry.SignatureSize) >= header->DataSize
+			|| GetData(entry.SignatureOffset)[entry.SignatureSize] != '\0'))
+			return false;
+	}
+
+	return true;
+}
+
+const ManifestEntry_t *CManifest::GetEntries() const
+{
+	return _view ? reinterpret_cast<const ManifestEntry_t *>(_view + GetHeader()->EntriesOffset) : nullptr;
+}
+
+const ManifestModule_t *CManifest::GetModules() const
+{
+	return _view ? reinterpret_cast<const ManifestModule_t *>(_view + GetHeader()->ModulesOffset) : nullptr;
+}
+
+uint8_t *CManifest::Locate(const ManifestEntry_t &entry, uint8_t *base, size_t size, bool same_build, bool *rescanned) const
+{
+	const uint8_t *original = GetData(entry.OriginalOffset);
+
+	*rescanned = false;
+
+	if (same_build && entry.Rva + static_cast<uint64_t>(entry.Size) <= size)
+	{
+		uint8_t *addr = base + entry.Rva;
+
+		if (MemEqual(addr, original, entry.Size))
+			return addr;
+	}
+
+	// Only entries that failed verification are scanned for.
+	uint8_t *found;
+
+	if (entry.SignatureSize != 0)
+	{
+		found = static_cast<uint8_t *>(FindSignature(base, base, base + size - 1, reinterpret_cast<const char *>(GetData(entry.SignatureOffset))));
+
+		if (found)
+			found += entry.SignatureDelta;
+	}
+	else
+	{
+		// Short byte sequences occur all over a module, so the bytes alone only identify
+		// the place if they are long enough and unique.
+		if (entry.Size < MEMORIA_MANIFEST_MIN_RESCAN)
+			return nullptr;
+
+		found = static_cast<uint8_t *>(FindBlock(base, base, base + size - 1, original, entry.Size));
+
+		if (found && found + 1 < base + size && FindBlock(found + 1, base, base + size - 1, original, entry.Size))
+			return nullptr;
+	}
+
+	if (!found || found < base || found + entry.Size > base + size || !MemEqual(found, original, entry.Size))
+		return nullptr;
+
+	*rescanned = true;
+	return found;
+}
+
+ManifestResult_t CManifest::Apply(const char *group, const ManifestHook_t *hooks, size_t hook_count) const
+{
+	ManifestResult_t result = {};
+
+	if (!_view)
+		return result;
+
+	auto header = GetHeader();
+	auto modules = GetModules();
+	auto entries = GetEntries();
+
+	CPatchGroup *patches = GetPatchGroup(group);
+
+	if (!patches)
+	{
+		result.Failed = header->EntryCount;
+		return result;
+	}
+
+	Memoria::Vector<uint8_t *> bases(header->ModuleCount);
+	Memoria::Vector<size_t> sizes(header->ModuleCount);
+	Memoria::Vector<bool> same_build(header->ModuleCount);
+
+	for (uint32_t i = 0; i < header->ModuleCount; ++i)
+	{
+		HMODULE module = GetModuleHandleDirect(modules[i].NameHash);
+
+		bases[i] = reinterpret_cast<uint8_t *>(module);
+		sizes[i] = module ? GetModuleSize(module) : 0;
+		same_build[i] = module && GetModuleTimeDateStamp(module) == modules[i].TimeDateStamp && sizes[i] == modules[i].SizeOfImage;
+	}
+
+	// Patches located so far; they fail together if the write session fails.
+	size_t patches_verified = 0;
+	size_t patches_rescanned = 0;
+
+	for (uint32_t i = 0; i < header->EntryCount; ++i)
+	{
+		auto &entry = entries[i];
+		bool rescanned = false;
+
+		uint8_t *addr = bases[entry.Module]
+			? Locate(entry, bases[entry.Module], sizes[entry.Module], same_build[entry.Module], &rescanned)
+			: nullptr;
+
+		bool applied = false;
+
+		if (addr && entry.Kind == eManifestEntry::Patch)
+		{
+			applied = patches->Add(CreatePatch(addr, GetData(entry.PatchOffset), entry.Size, false));
+		}
+		else if (addr && entry.Kind == eManifestEntry::Hook)
+		{
+			for (size_t j = 0; j < hook_count; ++j)
+			{
+				if (hooks[j].Name == entry.HookName)
+				{
+					applied = Hook(addr, hooks[j].Hook, hooks[j].Trampoline);
+					break;
+				}
+			}
+		}
+
+		if (!applied)
+			result.Failed++;
+		else if (entry.Kind == eManifestEntry::Hook)
+			(rescanned ? result.Rescanned : result.Verified)++;
+		else
+			(rescanned ? patches_rescanned : patches_verified)++;
+	}
+
+	// All patches are written in one session.
+	if (patches->Apply())
+	{
+		result.Verified += patches_verified;
+		result.Rescanned += patches_rescanned;
+	}
+	else
+	{
+		result.Failed += patches_verified + patches_rescanned;
+	}
+
+	return result;
+}
+
+MEMORIA_END
\ No newline at end of file
@@ -6,20 +6,224 @@
 #include "memoria_core_debug.hpp"
 #include "memoria_core_write.hpp"
 #include "memoria_core_misc.hpp"
+#include "memoria_core_errors.hpp"
+#include "memoria_core_source.hpp"
+
+#include "memoria_ext_integrity.hpp"
 
 #include "memoria_utils_assert.hpp"
 #include "memoria_utils_string.hpp"
+#include "memoria_utils_hashmap.hpp"
 
 MEMORIA_BEGIN
 
-static Memoria::FixedVector<CPatch, MAX_PATCHES_COUNT> Patches{};
+//
+// Patch registry.
+//
+// Patches are allocated in chunks, so they never move and an id maps to a patch in O(1).
+// The bytes of all patches live in one arena, and the ids are additionally kept sorted by
+// address for overlap queries. All storage is plain memory, so the registry needs no dynamic
+// initializer. It comes from `VirtualAlloc` directly rather than from `New`: `FreeAll` resets
+// the default arena, and patches have to outlive it until `FreePatches` restores them.
+//
+
+static constexpr uint32_t kPatchChunkShift = 8;
+static constexpr uint32_t kPatchChunkSize = 1 << kPatchChunkShift;
+
+static SRWLOCK gPatchLock = SRWLOCK_INIT;
+
+static CPatch **gPatchChunks = nullptr;
+static size_t gPatchChunkCount = 0;
+static size_t gPatchChunkCapacity = 0;
+
+static uint32_t gPatchCount = 0;
+
+// Ids sorted by address; the capacity follows the chunk capacity.
+static uint32_t *gPatchIndex = nullptr;
+
+static uint8_t *gPatchBytes = nullptr;
+static size_t gPatchBytesSize = 0;
+static size_t gPatchBytesCapacity = 0;
+
+// Size of the largest patch; bounds the backward scan of overlap queries.
+static size_t gMaxPatchSize = 0;
+
+static bool gPatchCleanupRegistered = false;
+
+static void *AllocRegistry(size_t size)
+{
+	return VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+}
+
+static void FreeRegistry(void *memory)
+{
+	if (memory)
+		VirtualFree(memory, 0, MEM_RELEASE);
+}
+
+static CPatch *GetPatchUnlocked(uint32_t id)
+{
+	return &gPatchChunks[id >> kPatchChunkShift][id & (kPatchChunkSize - 1)];
+}
+
+static bool GrowPatchBytes(size_t size)
+{
+	if (gPatchBytesSize + size <= gPatchBytesCapacity)
+		return true;
+
+	size_t capacity = gPatchBytesCapacity ? gPatchBytesCapacity : 4096;
+
+	while (capacity < gPatchBytesSize + size)
+		capacity *= 2;
+
+	if (capacity > UINT32_MAX)
+		return false;
+
+	auto bytes = static_cast<uint8_t *>(AllocRegistry(capacity));
+
+	if (!bytes)
+		return false;
+
+	if (gPatchBytes)
+	{
+		MemCopy(bytes, gPatchBytes, gPatchBytesSize);
+		FreeRegistry(gPatchBytes);
+	}
+
+	gPatchBytes = bytes;
+	gPatchBytesCapacity = capacity;
+
+	return true;
+}
+
+static bool GrowPatchChunks()
+{
+	if (gPatchCount < gPatchChunkCount * kPatchChunkSize)
+		return true;
+
+	if (gPatchChunkCount == gPatchChunkCapacity)
+	{
+		size_t capacity = gPatchChunkCapacity ? gPatchChunkCapacity * 2 : 16;
+
+		auto chunks = static_cast<CPatch **>(AllocRegistry(capacity * sizeof(CPatch *)));
+		auto index = static_cast<uint32_t *>(AllocRegistry(capacity * kPatchChunkSize * sizeof(uint32_t)));
+
+		if (!chunks || !index)
+		{
+			if (chunks)
+				FreeRegistry(chunks);
+
+			if (index)
+				FreeRegistry(index);
+
+			return false;
+		}
+
+		if (gPatchChunks)
+		{
+			MemCopy(chunks, gPatchChunks, gPatchChunkCount * sizeof(CPatch *));
+			MemCopy(index, gPatchIndex, gPatchCount * sizeof(uint32_t));
+
+			FreeRegistry(gPatchChunks);
+			FreeRegistry(gPatchIndex);
+		}
+
+		gPatchChunks = chunks;
+		gPatchIndex = index;
+		gPatchChunkCapacity = capacity;
+	}
+
+	auto chunk = static_cast<CPatch *>(AllocRegistry(kPatchChunkSize * sizeof(CPatch)));
+
+	if (!chunk)
+		return false;
+
+	gPatchChunks[gPatchChunkCount++] = chunk;
+	return true;
+}
+
+// Returns the position of the first id in the index whose patch starts at or after `addr`.
+static size_t LowerBoundPatch(uintptr_t addr)
+{
+	size_t lo = 0;
+	size_t hi = gPatchCount;
+
+	while (lo < hi)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (reinterpret_cast<uintptr_t>(GetPatchUnlocked(gPatchIndex[mid])->GetAddress()) < addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+template <typename fn_t>
+static void ForEachOverlappingPatch(const void *addr, size_t size, fn_t fn)
+{
+	uintptr_t begin = reinterpret_cast<uintptr_t>(addr);
+	uintptr_t end = begin + size;
+
+	for (size_t i = LowerBoundPatch(begin > gMaxPatchSize ? begin - gMaxPatchSize : 0); i < gPatchCount; ++i)
+	{
+		CPatch *patch = GetPatchUnlocked(gPatchIndex[i]);
+		uintptr_t patch_begin = reinterpret_cast<uintptr_t>(patch->GetAddress());
+
+		if (patch_begin >= end)
+			break;
+
+		if (patch_begin + patch->GetSize() > begin && !fn(patch))
+			break;
+	}
+}
+
+CPatch::CPatch(void *dest_address, uint32_t id, uint32_t data_offset, uint32_t size)
+	: _dest_address(dest_address)
+	, _data_offset(data_offset)
+	, _size(size)
+	, _id(id)
+	, _active(false)
+{
+}
+
+const uint8_t *CPatch::GetDataOrigin() const
+{
+	return &gPatchBytes[_data_offset];
+}
+
+const uint8_t *CPatch::GetDataPatch() const
+{
+	return &gPatchBytes[_data_offset + _size];
+}
+
+#ifdef _DEBUG
+Memoria::Vector<void *> CPatch::GetBacktrace() const
+{
+	Memoria::Vector<void *> result;
+
+	size_t count = 0;
+	void *const *frames = GetStackTrace(_trace_id, &count);
+
+	result.resize(count);
+	MemCopy(result.data(), frames, count * sizeof(void *));
+
+	return result;
+}
+#endif
 
 bool CPatch::IsActive() const
 {
 	if (!_dest_address)
 		return false;
 
-	return _active;
+	AcquireSRWLockShared(&gPatchLock);
+	bool active = _active;
+	ReleaseSRWLockShared(&gPatchLock);
+
+	return active;
 }
 
 bool CPatch::IsValid() const
@@ -27,22 +231,16 @@ bool CPatch::IsValid() const
 	if (!_dest_address)
 		return false;
 
-	bool equal;
-
-	if (_active)
-		equal = MemCompare(_dest_address, _data_patch.data(), _data_patch.size()) == 0;
-	else
-		equal = MemCompare(_dest_address, _data_origin.data(), _data_origin.size()) == 0;
+	AcquireSRWLockShared(&gPatchLock);
+	bool equal = MemCompare(_dest_address, _active ? GetDataPatch() : GetDataOrigin(), _size) == 0;
+	ReleaseSRWLockShared(&gPatchLock);
 
 	return equal;
 }
 
 void CPatch::Apply()
 {
-	if (!_dest_address)
-		return;
-
-	if (_data_origin.empty() || _data_patch.empty())
+	if (!_dest_address || _size == 0)
 		return;
 
 	if (!IsActive())
@@ -51,10 +249,7 @@ void CPatch::Apply()
 
 void CPatch::Restore()
 {
-	if (!_dest_address)
-		return;
-
-	if (_data_origin.empty() || _data_patch.empty())
+	if (!_dest_address || _size == 0)
 		return;
 
 	if (IsActive())
@@ -63,60 +258,176 @@ void CPatch::Restore()
 
 void CPatch::Toggle(bool state)
 {
-	if (!_dest_address)
+	if (!_dest_address || _size == 0)
 		return;
 
-	if (_data_origin.empty() || _data_patch.empty())
-		return;
+	// Exclusive, as `ToggleSet` reads and writes `_active` under the lock.
+	AcquireSRWLockExclusive(&gPatchLock);
 
 	if (IsMemoryValid(_dest_address))
-	{
-		if (state)
-			WriteMemory(_dest_address, _data_patch.data(), _data_patch.size());
-		else
-			WriteMemory(_dest_address, _data_origin.data(), _data_origin.size());
-	}
+		WriteMemory(_dest_address, state ? GetDataPatch() : GetDataOrigin(), _size);
 
 	_active = state;
+
+	ReleaseSRWLockExclusive(&gPatchLock);
 }
 
-CPatch::CPatch(void *dest_address, const void *source_address, size_t size, bool instant_deploy)
-	: _dest_address(dest_address)
-	, _active(false)
-#ifdef _DEBUG
-	, _stack_backtrace(GetStackBacktrace())
-#endif
+CPatch *CreatePatch(void *dest_address, const void *source_address, size_t size, bool instant_deploy)
 {
 	Assert(dest_address && source_address && size);
 
-	if (dest_address && source_address && size > 0)
+	if (!dest_address || !source_address || size == 0 || size > UINT32_MAX / 2)
 	{
-		_data_origin.zero_initialize();
-		_data_patch.zero_initialize();
-
-		MemCopy(_data_origin.data(), dest_address, size);
-		MemCopy(_data_patch.data(), source_address, size);
+		SetError(ME_INVALID_ARGUMENT);
+		return nullptr;
 	}
-	else
+
+	size_t bytes = size * 2;
+
+#ifdef _DEBUG
+	uint32_t trace_id = CaptureStackTraceId(1);
+#endif
+
+	AcquireSRWLockExclusive(&gPatchLock);
+
+	if (!GrowPatchBytes(bytes) || !GrowPatchChunks())
 	{
-		_dest_address = {};
+		ReleaseSRWLockExclusive(&gPatchLock);
 
-		_data_origin.clear();
-		_data_patch.clear();
+		SetError(ME_INVALID_MEMORY);
+		return nullptr;
 	}
 
+	auto offset = static_cast<uint32_t>(gPatchBytesSize);
+
+	MemCopy(&gPatchBytes[offset], dest_address, size);
+	MemCopy(&gPatchBytes[offset + size], source_address, size);
+
+	uint32_t id = gPatchCount;
+	CPatch *patch = GetPatchUnlocked(id);
+
+	std::construct_at(patch, dest_address, id, offset, static_cast<uint32_t>(size));
+
+#ifdef _DEBUG
+	patch->_trace_id = trace_id;
+#endif
+
+	gPatchBytesSize += bytes;
+
+	// Keep the index sorted; patches at the same address stay in creation order.
+	size_t position = LowerBoundPatch(reinterpret_cast<uintptr_t>(dest_address) + 1);
+
+	MemMove(&gPatchIndex[position + 1], &gPatchIndex[position], (gPatchCount - position) * sizeof(uint32_t));
+	gPatchIndex[position] = id;
+
+	++gPatchCount;
+
+	if (size > gMaxPatchSize)
+		gMaxPatchSize = size;
+
+	if (!gPatchCleanupRegistered)
+	{
+		gPatchCleanupRegistered = true;
+		RegisterOnExitCallback([]() { FreePatches(); });
+	}
+
+	ReleaseSRWLockExclusive(&gPatchLock);
+
 	if (instant_deploy)
-		Apply();
+		patch->Apply();
+
+	return patch;
+}
+
+CSourcePatch::~CSourcePatch()
+{
+	Release();
+}
+
+bool CSourcePatch::Create(IMemorySource *source, void *dest_address, const void *data, size_t size, bool instant_deploy)
+{
+	Assert(source && dest_address && data && size);
+
+	if (!source || !dest_address || !data || size == 0)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	Release();
+
+	_data.resize(size * 2);
+
+	if (!source->Read(dest_address, _data.data(), size))
+	{
+		_data.clear();
+
+		SetError(ME_INVALID_MEMORY);
+		return false;
+	}
+
+	MemCopy(&_data[size], data, size);
+
+	_source = source;
+	_dest_address = dest_address;
+	_size = size;
+
+	return !instant_deploy || Apply();
+}
+
+void CSourcePatch::Release()
+{
+	if (_active)
+		Toggle(false);
+
+	_data.clear();
+
+	_source = nullptr;
+	_dest_address = nullptr;
+	_size = 0;
+	_active = false;
+}
+
+bool CSourcePatch::IsValid() const
+{
+	if (!_source)
+		return false;
+
+	Memoria::Vector<uint8_t> current;
+	current.resize(_size);
+
+	if (!_source->Read(_dest_address, current.data(), _size))
+		return false;
+
+	return MemCompare(current.data(), &_data[_active ? _size : 0], _size) == 0;
+}
+
+bool CSourcePatch::Toggle(bool state)
+{
+	if (!_source)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	if (state == _active)
+		return true;
+
+	if (!_source->Write(_dest_address, &_data[state ? _size : 0], _size))
+		return false;
+
+	_active = state;
+	return true;
 }
 
 CPatch *PatchU8(void *addr, uint8_t value, bool instant_deploy, ptrdiff_t offset)
 {
-	return new CPatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
+	return CreatePatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
 }
 
 CPatch *PatchU16(void *addr, uint16_t value, bool instant_deploy, ptrdiff_t offset)
 {
-	return new CPatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
+	return CreatePatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
 }
 
 CPatch *PatchU24(void *addr, uint32_t value, bool instant_deploy, ptrdiff_t offset)
@@ -128,32 +439,32 @@ CPatch *PatchU24(void *addr, uint32_t value, bool instant_deploy, ptrdiff_t offs
 		static_cast<uint8_t>((value >> 16) & 0xFF)
 	};
 
-	return new CPatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &bytes, 3, instant_deploy);
+	return CreatePatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &bytes, 3, instant_deploy);
 }
 
 CPatch *PatchU24(void *addr, uint8_t value[3], bool instant_deploy, ptrdiff_t offset)
 {
-	return new CPatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, 3, instant_deploy);
+	return CreatePatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, 3, instant_deploy);
 }
 
 CPatch *PatchU32(void *addr, uint32_t value, bool instant_deploy, ptrdiff_t offset)
 {
-	return new CPatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
+	return CreatePatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
 }
 
 CPatch *PatchU64(void *addr, uint64_t value, bool instant_deploy, ptrdiff_t offset)
 {
-	return new CPatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
+	return CreatePatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
 }
 
 CPatch *PatchI8(void *addr, int8_t value, bool instant_deploy, ptrdiff_t offset)
 {
-	return new CPatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
+	return CreatePatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
 }
 
 CPatch *PatchI16(void *addr, int16_t value, bool instant_deploy, ptrdiff_t offset)
 {
-	return new CPatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
+	return CreatePatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
 }
 
 CPatch *PatchI24(void *addr, int32_t value, bool instant_deploy, ptrdiff_t offset)
@@ -165,37 +476,37 @@ CPatch *PatchI24(void *addr, int32_t value, bool instant_deploy, ptrdiff_t offse
 		static_cast<int8_t>((value >> 16) & 0xFF)
 	};
 
-	return new CPatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &bytes, 3, instant_deploy);
+	return CreatePatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &bytes, 3, instant_deploy);
 }
 
 CPatch *PatchI24(void *addr, int8_t value[3], bool instant_deploy, ptrdiff_t offset)
 {
-	return new CPatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, 3, instant_deploy);
+	return CreatePatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, 3, instant_deploy);
 }
 
 CPatch *PatchI32(void *addr, int32_t value, bool instant_deploy, ptrdiff_t offset)
 {
-	return new CPatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
+	return CreatePatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
 }
 
 CPatch *PatchI64(void *addr, int64_t value, bool instant_deploy, ptrdiff_t offset)
 {
-	return new CPatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
+	return CreatePatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
 }
 
 CPatch *PatchFloat(void *addr, float value, bool instant_deploy, ptrdiff_t offset)
 {
-	return new CPatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
+	return CreatePatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
 }
 
 CPatch *PatchDouble(void *addr, double value, bool instant_deploy, ptrdiff_t offset)
 {
-	return new CPatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
+	return CreatePatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
 }
 
 CPatch *PatchPointer(void *addr, const void *value, bool instant_deploy, ptrdiff_t offset)
 {
-	return new CPatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
+	return CreatePatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &value, sizeof(value), instant_deploy);
 }
 
 CPatch *PatchRelative(void *addr, const void *value, bool instant_deploy, ptrdiff_t offset)
@@ -206,7 +517,7 @@ CPatch *PatchRelative(void *addr, const void *value, bool instant_deploy, ptrdif
 #pragma warning(suppress : 4244) // conversion from '__int64' to 'uint32_t', possible loss of data
 	uint32_t rel = (uint8_t *)value - ((uint8_t *)addr + sizeof(int32_t));
 
-	return new CPatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &rel, sizeof(rel), instant_deploy);
+	return CreatePatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), &rel, sizeof(rel), instant_deploy);
 }
 
 CPatch *PatchAStr(void *addr, const char *value, bool instant_deploy, ptrdiff_t offset)
@@ -215,7 +526,7 @@ CPatch *PatchAStr(void *addr, const char *value, bool instant_deploy, ptrdiff_t
 		return nullptr;
 
 	size_t len = StrLenA(value);
-	return new CPatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), value,
+	return CreatePatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), value,
 		(len + 1) * sizeof(char), instant_deploy);
 }
 
@@ -225,21 +536,303 @@ CPatch *PatchWStr(void *addr, const wchar_t *value, bool instant_deploy, ptrdiff
 		return nullptr;
 
 	size_t len = StrLenW(value);
-	return new CPatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), value,
+	return CreatePatch(reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(addr) + offset), value,
 		(len + 1) * sizeof(wchar_t), instant_deploy);
 }
 
-Memoria::FixedVector<CPatch, MAX_PATCHES_COUNT> &GetPatches()
+size_t GetPatchCount()
 {
-	return Patches;
+	AcquireSRWLockShared(&gPatchLock);
+	size_t count = gPatchCount;
+	ReleaseSRWLockShared(&gPatchLock);
+
+	return count;
 }
 
-bool FreePatches()
+CPatch *GetPatch(uint32_t id)
+{
+	AcquireSRWLockShared(&gPatchLock);
+	CPatch *result = (id < gPatchCount) ? GetPatchUnlocked(id) : nullptr;
+	ReleaseSRWLockShared(&gPatchLock);
+
+	return result;
+}
+
+CPatch *FindPatch(const void *addr, size_t size)
+{
+	CPatch *result = nullptr;
+
+	AcquireSRWLockShared(&gPatchLock);
+
+	ForEachOverlappingPatch(addr, size, [&](CPatch *patch)
+	{
+		result = patch;
+		return false;
+	});
+
+	ReleaseSRWLockShared(&gPatchLock);
+
+	return result;
+}
+
+Memoria::Vector<CPatch *> FindPatches(const void *addr, size_t size)
+{
+	Memoria::Vector<CPatch *> result;
+
+	AcquireSRWLockShared(&gPatchLock);
+
+	ForEachOverlappingPatch(addr, size, [&](CPatch *patch)
+	{
+		result.push_back(patch);
+		return true;
+	});
+
+	ReleaseSRWLockShared(&gPatchLock);
+
+	return result;
+}
+
+static bool IsPatchMemoryValid(const CPatch *patch)
+{
+	return IsMemoryValid(patch->GetAddress()) && IsMemoryValid(patch->GetAddress(), patch->GetSize() - 1);
+}
+
+bool CPatch::ToggleSetUnlocked(const uint32_t *ids, size_t count, bool state, bool suspend_threads)
+{
+	CWriteSession session;
+	Memoria::Vector<CPatch *> pending;
+
+	if (!ids)
+		count = gPatchCount;
+
+	auto get = [&](size_t i) { return GetPatchUnlocked(ids ? ids[i] : static_cast<uint32_t>(i)); };
+
+	// Forward order when applying and the reverse when restoring, so overlapping
+	// patches end up the same as if they were toggled one by one.
+	for (size_t i = 0; i < count; ++i)
+	{
+		CPatch *patch = get(state ? i : count - 1 - i);
+
+		if (patch->_active == state)
+			continue;
+
+		// Nothing is left to restore in memory that was released, e.g. by unloading
+		// the module; such patches are simply no longer active.
+		if (!state && !IsPatchMemoryValid(patch))
+		{
+			patch->_active = false;
+			continue;
+		}
+
+		session.Write(patch->GetAddress(), state ? patch->GetDataPatch() : patch->GetDataOrigin(), patch->GetSize());
+		pending.push_back(patch);
+	}
+
+	bool result = session.Commit(suspend_threads);
+
+	// The bytes were written but the protection could not be restored; undo the writes
+	// so the memory matches the recorded patch states.
+	if (!result && session.IsCommitted())
+		session.Rollback(suspend_threads);
+
+	if (result)
+	{
+		for (CPatch *patch : pending)
+			patch->_active = state;
+	}
+	else if (!state)
+	{
+		// Restoring is best effort: one patch that cannot be written must not keep
+		// the others, e.g. in `FreePatches`, from being restored.
+		result = true;
+
+		for (CPatch *patch : pending)
+		{
+			if (WriteMemory(patch->GetAddress(), patch->GetDataOrigin(), patch->GetSize()))
+				patch->_active = false;
+			else
+				result = false;
+		}
+	}
+
+	return result;
+}
+
+bool CPatch::ToggleSet(const uint32_t *ids, size_t count, bool state, bool suspend_threads)
+{
+	AcquireSRWLockExclusive(&gPatchLock);
+	bool result = ToggleSetUnlocked(ids, count, state, suspend_threads);
+	ReleaseSRWLockExclusive(&gPatchLock);
+
+	return result;
+}
+
+bool CPatch::ToggleAll(bool state, bool suspend_threads)
+{
+	return ToggleSet(nullptr, 0, state, suspend_threads);
+}
+
+//
+// Patch groups.
+//
+
+static Memoria::HashMap<fnv1a_t, CPatchGroup *> gPatchGroups;
+
+bool CPatchGroup::Add(CPatch *patch)
 {
-	for (auto &patch : GetPatches())
-		patch.Restore();
+	if (!patch)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	AcquireSRWLockExclusive(&gPatchLock);
+
+	bool found = false;
+
+	for (uint32_t id : _patches)
+	{
+		if (id == patch->GetId())
+		{
+			found = true;
+			break;
+		}
+	}
+
+	if (!found)
+		_patches.push_back(patch->GetId());
+
+	ReleaseSRWLockExclusive(&gPatchLock);
 
 	return true;
 }
 
+size_t CPatchGroup::GetSize() const
+{
+	AcquireSRWLockShared(&gPatchLock);
+	size_t size = _patches.size();
+	ReleaseSRWLockShared(&gPatchLock);
+
+	return size;
+}
+
+bool CPatchGroup::IsActive() const
+{
+	AcquireSRWLockShared(&gPatchLock);
+	bool active = _active;
+	ReleaseSRWLockShared(&gPatchLock);
+
+	return active;
+}
+
+bool CPatchGroup::Toggle(bool state, bool suspend_threads)
+{
+	// One exclusive section, as `Add` may grow `_patches` concurrently.
+	AcquireSRWLockExclusive(&gPatchLock);
+
+	bool result = CPatch::ToggleSetUnlocked(_patches.data(), _patches.size(), state, suspend_threads);
+
+	if (result)
+		_active = state;
+
+	ReleaseSRWLockExclusive(&gPatchLock);
+
+	return result;
+}
+
+CPatchGroup *GetPatchGroup(const char *name)
+{
+	if (!name)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return nullptr;
+	}
+
+	return GetPatchGroup(FNV1a64(name));
+}
+
+CPatchGroup *GetPatchGroup(fnv1a_t name_hash)
+{
+	AcquireSRWLockExclusive(&gPatchLock);
+
+	CPatchGroup *result = nullptr;
+
+	if (auto existing = gPatchGroups.find(name_hash))
+	{
+		result = *existing;
+	}
+	else
+	{
+		result = new CPatchGroup(name_hash);
+		gPatchGroups.insert(name_hash, result);
+	}
+
+	ReleaseSRWLockExclusive(&gPatchLock);
+
+	return result;
+}
+
+CPatchGroup *FindPatchGroup(fnv1a_t name_hash)
+{
+	AcquireSRWLockShared(&gPatchLock);
+
+	auto existing = gPatchGroups.find(name_hash);
+	CPatchGroup *result = existing ? *existing : nullptr;
+
+	ReleaseSRWLockShared(&gPatchLock);
+
+	return result;
+}
+
+bool ApplyPatches()
+{
+	return CPatch::ToggleAll(true);
+}
+
+bool RestorePatches()
+{
+	return CPatch::ToggleAll(false);
+}
+
+bool FreePatches()
+{
+	// The integrity monitor looks patches up by id, which are reused after this.
+	UnwatchPatches();
+
+	bool result = RestorePatches();
+
+	AcquireSRWLockExclusive(&gPatchLock);
+
+	gPatchGroups.for_each([](fnv1a_t, CPatchGroup *group) { delete group; });
+	gPatchGroups.clear();
+
+	for (size_t i = 0; i < gPatchChunkCount; ++i)
+		FreeRegistry(gPatchChunks[i]);
+
+	if (gPatchChunks)
+	{
+		FreeRegistry(gPatchChunks);
+		FreeRegistry(gPatchIndex);
+	}
+
+	if (gPatchBytes)
+		FreeRegistry(gPatchBytes);
+
+	gPatchChunks = nullptr;
+	gPatchChunkCount = 0;
+	gPatchChunkCapacity = 0;
+	gPatchCount = 0;
+	gPatchIndex = nullptr;
+
+	gPatchBytes = nullptr;
+	gPatchBytesSize = 0;
+	gPatchBytesCapacity = 0;
+
+	gMaxPatchSize = 0;
+
+	ReleaseSRWLockExclusive(&gPatchLock);
+
+	return result;
+}
+
 MEMORIA_END
\ No newline at end of file
@@ -52,16 +52,19 @@ void CSigHandle::SetOutputInternally(const void *value, bool deref)
 	if (!_output)
 		return;
 	
-	if (value && AssertIf(Memoria::IsMemoryValid(value)))
+	if (!value)
 	{
-		if (deref)
-			*_output = *reinterpret_cast<void **>(const_cast<void *>(value));
-		else
-			*_output = reinterpret_cast<void **>(const_cast<void *>(value));
+		*_output = {};
+	}
+	else if (deref)
+	{
+		// Dereferenced under a guard instead of querying the memory first.
+		if (!AssertIf(Memoria::GuardedCopy(_output, value, sizeof(void *))))
+			*_output = {};
 	}
 	else
 	{
-		*_output = {};
+		*_output = reinterpret_cast<void **>(const_cast<void *>(value));
 	}
 
 #ifdef _DEBUG
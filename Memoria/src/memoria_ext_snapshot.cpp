@@ -0,0 +1,340 @@
+#include "memoria_ext_snapshot.hpp"
+
+#include "memoria_core_hash.hpp"
+#include "memoria_core_errors.hpp"
+
+#include <emmintrin.h>
+#include <intrin.h>
+
+MEMORIA_BEGIN
+
+static constexpr size_t kSnapshotPageSize = 0x1000;
+static constexpr uintptr_t kSnapshotPageMask = kSnapshotPageSize - 1;
+
+alignas(16) static const uint8_t gZeroPage[kSnapshotPageSize] = {};
+
+static void AddChange(Memoria::Vector<SnapshotChange_t> &changes, uint8_t *address, size_t size)
+{
+	// Ranges touching the previous one are merged, also across pages.
+	if (!changes.empty())
+	{
+		auto &last = changes.back();
+
+		if (last.Address + last.Size == address)
+		{
+			last.Size += size;
+			return;
+		}
+	}
+
+	changes.push_back({ address, size });
+}
+
+static void CompareBytes(const uint8_t *old_data, const uint8_t *new_data, size_t size, uint8_t *address, Memoria::Vector<SnapshotChange_t> &changes)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= size; i += 16)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&old_data[i]));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&new_data[i]));
+
+		uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b))) & 0xFFFF;
+
+		// One range per run of differing bytes in the block.
+		while (mask)
+		{
+			unsigned long start, length;
+
+			_BitScanForward(&start, mask);
+			_BitScanForward(&length, ~(mask >> start));
+
+			AddChange(changes, &address[i + start], length);
+			mask &= ~(((1u << length) - 1) << start);
+		}
+	}
+
+	for (; i < size; ++i)
+	{
+		if (old_data[i] != new_data[i])
+			AddChange(changes, &address[i], 1);
+	}
+}
+
+bool CSnapshot::Add(const void *addr, size_t size)
+{
+	if (!addr || size == 0)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	uintptr_t begin = reinterpret_cast<uintptr_t>(addr) & ~kSnapshotPageMask;
+	uintptr_t end = (reinterpret_cast<uintptr_t>(addr) + size + kSnapshotPageMask) & ~kSnapshotPageMask;
+
+	Region_t region;
+
+	region.Base = reinterpret_cast<uint8_t *>(begin);
+	region.Size = end - begin;
+	region.FirstPage = _pages.size();
+
+	// `GetWriteWatch` fails for memory that was not allocated with `MEM_WRITE_WATCH`,
+	// and for ranges spanning several allocations.
+	PVOID address = nullptr;
+	ULONG_PTR count = 0;
+	ULONG granularity = 0;
+
+	region.WriteWatch = GetWriteWatch(0, region.Base, region.Size, &address, &count, &granularity) == 0;
+
+	for (uintptr_t page = begin; page < end; page += kSnapshotPageSize)
+		_pages.push_back({ reinterpret_cast<uint8_t *>(page), 0, kZeroPage, false });
+
+	_regions.push_back(region);
+	_captured = false;
+
+	return true;
+}
+
+bool CSnapshot::Capture()
+{
+	if (_regions.empty())
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	_data.clear();
+
+	size_t reserved = 0;
+
+	for (auto &region : _regions)
+	{
+		// Reset before copying: a write during the copy is reported by the next diff.
+		if (region.WriteWatch)
+			ResetWriteWatch(region.Base, region.Size);
+
+		for (size_t i = 0; i < region.Size / kSnapshotPageSize; ++i)
+		{
+			Page_t &page = _pages[region.FirstPage + i];
+
+			page.DataOffset = kZeroPage;
+			page.Hash = 0;
+
+			if (_data.size() + kSnapshotPageSize > kZeroPage)
+			{
+				_data.clear();
+
+				SetError(ME_INVALID_MEMORY);
+				return false;
+			}
+
+			// Copied straight into the storage, which is given back if the page needs none.
+			// `resize` grows to the exact size, so the storage is reserved in doubling steps.
+			size_t offset = _data.size();
+
+			if (offset + kSnapshotPageSize > reserved)
+			{
+				reserved = (reserved != 0) ? reserved * 2 : kSnapshotPageSize * 16;
+				_data.reserve(reserved);
+			}
+
+			_data.resize(offset + kSnapshotPageSize);
+
+			uint8_t *copy = &_data[offset];
+
+			page.Readable = GuardedCopy(copy, page.Address, kSnapshotPageSize);
+
+			if (page.Readable)
+			{
+				page.Hash = CRC32C(copy, kSnapshotPageSize);
+
+				if (!MemEqual(copy, gZeroPage, kSnapshotPageSize))
+				{
+					page.DataOffset = static_cast<uint32_t>(offset);
+					continue;
+				}
+			}
+
+			_data.resize(offset);
+		}
+	}
+
+	_captured = true;
+	return true;
+}
+
+const uint8_t *CSnapshot::GetPageData(const Page_t &page) const
+{
+	return (page.DataOffset == kZeroPage) ? gZeroPage : &_data[page.DataOffset];
+}
+
+size_t CSnapshot::FindPage(const uint8_t *addr) const
+{
+	for (auto &region : _regions)
+	{
+		if (addr >= region.Base && addr < region.Base + region.Size)
+			return region.FirstPage + (addr - region.Base) / kSnapshotPageSize;
+	}
+
+	return SIZE_MAX;
+}
+
+bool CSnapshot::Read(const void *addr, void *out, size_t size) const
+{
+	if (!_captured)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return false;
+	}
+
+	auto dest = static_cast<uint8_t *>(out);
+	auto begin = static_cast<const uint8_t *>(addr);
+	auto end = begin + size;
+
+	while (begin < end)
+	{
+		size_t index = FindPage(begin);
+
+		if (index == SIZE_MAX || !_pages[index].Readable)
+		{
+			SetError(ME_INVALID_MEMORY);
+			return false;
+		}
+
+		const Page_t &page = _pages[index];
+		size_t offset = begin - page.Address;
+		size_t chunk = kSnapshotPageSize - offset;
+
+		if (chunk > static_cast<size_t>(end - begin))
+			chunk = end - begin;
+
+		MemCopy(dest, GetPageData(page) + offset, chunk);
+
+		dest += chunk;
+		begin += chunk;
+	}
+
+	return true;
+}
+
+void CSnapshot::GetCleanPages(Memoria::Vector<bool> &clean) const
+{
+	clean.resize(_pages.size());
+
+	Memoria::Vector<PVOID> addresses;
+
+	for (auto &region : _regions)
+	{
+		if (!region.WriteWatch)
+			continue;
+
+		size_t count = region.Size / kSnapshotPageSize;
+
+		addresses.resize(count);
+
+		ULONG_PTR written = count;
+		ULONG granularity = 0;
+
+		// If the query fails, all pages of the region are compared.
+		if (GetWriteWatch(0, region.Base, region.Size, addresses.data(), &written, &granularity) != 0)
+			continue;
+
+		for (size_t i = 0; i < count; ++i)
+			clean[region.FirstPage + i] = true;
+
+		for (size_t i = 0; i < written; ++i)
+			clean[region.FirstPage + (static_cast<uint8_t *>(addresses[i]) - region.Base) / kSnapshotPageSize] = false;
+	}
+}
+
+Memoria::Vector<SnapshotChange_t> CSnapshot::Diff() const
+{
+	Memoria::Vector<SnapshotChange_t> changes;
+
+	if (!_captured)
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return changes;
+	}
+
+	Memoria::Vector<bool> clean;
+	GetCleanPages(clean);
+
+	// On the heap, as a page-sized stack frame needs a stack probe.
+	Memoria::Vector<uint8_t> scratch;
+	scratch.resize(kSnapshotPageSize);
+
+	uint8_t *buffer = scratch.data();
+
+	for (size_t i = 0; i < _pages.size(); ++i)
+	{
+		if (clean[i])
+			continue;
+
+		const Page_t &page = _pages[i];
+		bool readable = GuardedCopy(buffer, page.Address, kSnapshotPageSize);
+
+		// A page that became readable or unreadable changed as a whole.
+		if (readable != page.Readable)
+		{
+			AddChange(changes, page.Address, kSnapshotPageSize);
+			continue;
+		}
+
+		if (!readable)
+			continue;
+
+		// Compared byte by byte in any case: an equal checksum does not prove equal contents,
+		// and hashing the live page would cost as much as the comparison.
+		CompareBytes(GetPageData(page), buffer, kSnapshotPageSize, page.Address, changes);
+	}
+
+	return changes;
+}
+
+Memoria::Vector<SnapshotChange_t> CSnapshot::Diff(const CSnapshot &other) const
+{
+	Memoria::Vector<SnapshotChange_t> changes;
+
+	if (!_captured || !other._captured || _pages.size() != other._pages.size())
+	{
+		SetError(ME_INVALID_ARGUMENT);
+		return changes;
+	}
+
+	for (size_t i = 0; i < _pages.size(); ++i)
+	{
+		const Page_t &old_page = _pages[i];
+		const Page_t &new_page = other._pages[i];
+
+		if (old_page.Address != new_page.Address)
+		{
+			changes.clear();
+
+			SetError(ME_INVALID_ARGUMENT);
+			return changes;
+		}
+
+		if (old_page.Readable != new_page.Readable)
+		{
+			AddChange(changes, old_page.Address, kSnapshotPageSize);
+			continue;
+		}
+
+		if (!old_page.Readable)
+			continue;
+
+		const uint8_t *old_data = GetPageData(old_page);
+		const uint8_t *new_data = other.GetPageData(new_page);
+
+		// Different checksums prove a change; equal ones are confirmed against the copies.
+		if (old_page.Hash == new_page.Hash && (old_data == new_data || MemEqual(old_data, new_data, kSnapshotPageSize)))
+			continue;
+
+		CompareBytes(old_data, new_data, kSnapshotPageSize, old_page.Address, changes);
+	}
+
+	return changes;
+}
+
+MEMORIA_END
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "memoria_utils_assert.hpp"
 
 #include <stdint.h>
+#include <emmintrin.h>
 
 MEMORIA_BEGIN
 
@@ -51,6 +52,29 @@ int MemCompare(const void *lpBlock1, const void *lpBlock2, size_t dwSize)
 	return 0;
 }
 
+bool MemEqual(const void *lpBlock1, const void *lpBlock2, size_t dwSize)
+{
+	const unsigned char *p1 = static_cast<const unsigned char *>(lpBlock1);
+	const unsigned char *p2 = static_cast<const unsigned char *>(lpBlock2);
+
+	for (; dwSize >= 16; dwSize -= 16, p1 += 16, p2 += 16)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p1));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p2));
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF)
+			return false;
+	}
+
+	for (size_t i = 0; i < dwSize; ++i)
+	{
+		if (p1[i] != p2[i])
+			return false;
+	}
+
+	return true;
+}
+
 void *MemCopy(void *lpDestination, const void *lpSource, size_t dwSize)
 {
 	volatile unsigned char *dest = static_cast<unsigned char *>(lpDestination);
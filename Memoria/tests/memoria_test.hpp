@@ -0,0 +1,66 @@
+//
+// memoria_test.hpp
+//
+// Minimal test harness of the Memoria test runner.
+//
+// Tests register themselves with `MEMORIA_TEST` and are run in registration order by
+// `memoria_test_main.cpp`. A failed check is reported and the test continues; `MEMORIA_REQUIRE`
+// returns from the test instead. Functions declared with `MEMORIA_TEST_CHILD` are not run as
+// tests, but in a child process started by `StartChild`, e.g. as the target of remote memory access.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <Windows.h>
+
+namespace MemoriaTest
+{
+	using TestFunction_t = void(*)();
+
+	// Registers a test, or a child process entry if `child` is set. Called by the macros below.
+	extern bool Register(const char *name, TestFunction_t function, bool child);
+
+	// Reports a failed check of the running test.
+	extern void Fail(const char *file, int line, const char *expression);
+
+	/**
+	 * @brief Starts this executable with the child entry `name`.
+	 *
+	 * @param process Receives the process, to be closed by the caller.
+	 * @param output Receives the read end of a pipe connected to the standard output of the child.
+	 *
+	 * @return `false` if the process could not be started.
+	 */
+	extern bool StartChild(const char *name, PROCESS_INFORMATION *process, HANDLE *output);
+
+	/**
+	 * @brief Copies `size` bytes of machine code into new executable memory.
+	 *
+	 * @return The address of the copy, which is never freed, or `nullptr`.
+	 */
+	extern void *CreateCode(const void *code, size_t size);
+
+	/**
+	 * @brief Creates a function returning `value`, padded so that a hook of any method fits
+	 *        into its first instruction and the nops behind it.
+	 */
+	extern int (*CreateConstantFunction(int value))();
+}
+
+#define MEMORIA_TEST(name) \
+	static void Test_##name(); \
+	static const bool gTestRegistered_##name = MemoriaTest::Register(#name, Test_##name, false); \
+	static void Test_##name()
+
+#define MEMORIA_TEST_CHILD(name) \
+	static void Child_##name(); \
+	static const bool gChildRegistered_##name = MemoriaTest::Register(#name, Child_##name, true); \
+	static void Child_##name()
+
+#define MEMORIA_CHECK(expression) \
+	do { if (!(expression)) MemoriaTest::Fail(__FILE__, __LINE__, #expression); } while (0)
+
+#define MEMORIA_REQUIRE(expression) \
+	do { if (!(expression)) { MemoriaTest::Fail(__FILE__, __LINE__, #expression); return; } } while (0)
\ No newline at end of file
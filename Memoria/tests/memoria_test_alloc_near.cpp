@@ -0,0 +1,78 @@
+#include "memoria_test.hpp"
+
+#include "memoria_core_mempool.hpp"
+
+// `true` if every byte of the block can be reached from `source` with a 32-bit displacement.
+static bool IsReachable(const void *source, const void *block, size_t size)
+{
+#ifdef MEMORIA_32BIT
+	// Displacements wrap around the whole address space.
+	(void)source, (void)block, (void)size;
+	return true;
+#else
+	auto from = reinterpret_cast<intptr_t>(source);
+	auto begin = reinterpret_cast<intptr_t>(block);
+	auto end = begin + static_cast<intptr_t>(size);
+
+	return begin - from >= INT32_MIN && end - from <= INT32_MAX;
+#endif
+}
+
+static uintptr_t GetDistance(const void *a, const void *b)
+{
+	auto x = reinterpret_cast<uintptr_t>(a);
+	auto y = reinterpret_cast<uintptr_t>(b);
+
+	return (x > y) ? x - y : y - x;
+}
+
+MEMORIA_TEST(AllocNearIsReachable)
+{
+	const void *source = reinterpret_cast<const void *>(MemoriaTest::CreateCode);
+
+	void *near_block = Memoria::AllocNear(source, 100, true);
+	void *far_block = Memoria::AllocFar(source, 100, true);
+
+	MEMORIA_REQUIRE(near_block && far_block);
+
+	MEMORIA_CHECK(IsReachable(source, near_block, 100));
+	MEMORIA_CHECK(IsReachable(source, far_block, 100));
+
+	// Far blocks are placed above the source, as far away as the displacement allows.
+	MEMORIA_CHECK(far_block > source);
+	MEMORIA_CHECK(GetDistance(source, near_block) < GetDistance(source, far_block));
+
+	MEMORIA_CHECK(Memoria::Free(near_block));
+	MEMORIA_CHECK(Memoria::Free(far_block));
+}
+
+MEMORIA_TEST(AllocNearManyBlocks)
+{
+	const void *source = reinterpret_cast<const void *>(MemoriaTest::CreateCode);
+
+	void *blocks[64];
+
+	for (auto &block : blocks)
+	{
+		block = Memoria::AllocNear(source, 0x3000, true, true, true);
+
+		MEMORIA_REQUIRE(block);
+		MEMORIA_CHECK(IsReachable(source, block, 0x3000));
+	}
+
+	// Each block takes its own allocation granule.
+	for (size_t i = 0; i < _countof(blocks); ++i)
+	{
+		for (size_t j = i + 1; j < _countof(blocks); ++j)
+			MEMORIA_CHECK(GetDistance(blocks[i], blocks[j]) >= 0x10000);
+	}
+
+	for (auto block : blocks)
+		MEMORIA_CHECK(Memoria::Free(block));
+
+	// The map of free gaps is stale now; the gaps are found again by a rescan.
+	void *block = Memoria::AllocNear(source, 0x3000, true);
+	MEMORIA_REQUIRE(block);
+	MEMORIA_CHECK(IsReachable(source, block, 0x3000));
+	MEMORIA_CHECK(Memoria::Free(block));
+}
\ No newline at end of file
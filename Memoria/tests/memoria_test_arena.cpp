@@ -0,0 +1,180 @@
+#include "memoria_test.hpp"
+
+#include "memoria_core_arena.hpp"
+#include "memoria_core_mempool.hpp"
+
+#include <string.h>
+
+static bool IsZero(const void *addr, size_t size)
+{
+	auto bytes = static_cast<const uint8_t *>(addr);
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (bytes[i] != 0)
+			return false;
+	}
+
+	return true;
+}
+
+MEMORIA_TEST(ArenaSmallBlocks)
+{
+	Memoria::CArena arena;
+
+	void *block = arena.Allocate(24);
+	MEMORIA_REQUIRE(block);
+
+	MEMORIA_CHECK((reinterpret_cast<uintptr_t>(block) & 15) == 0);
+	MEMORIA_CHECK(arena.GetSize(block) == 32);
+	MEMORIA_CHECK(Memoria::CArena::FromPointer(block) == &arena);
+	MEMORIA_CHECK(arena.GetStats().Small[1].Blocks == 1);
+
+	memset(block, 0xAB, 32);
+	MEMORIA_CHECK(arena.Free(block));
+	MEMORIA_CHECK(arena.GetStats().Small[1].Blocks == 0);
+
+	// The freed block is reused, and cleared only on request.
+	void *zeroed = arena.Allocate(32, true);
+	MEMORIA_REQUIRE(zeroed);
+	MEMORIA_CHECK(zeroed == block);
+	MEMORIA_CHECK(IsZero(zeroed, 32));
+
+	MEMORIA_CHECK(arena.Free(zeroed));
+}
+
+MEMORIA_TEST(ArenaMediumRunsCoalesce)
+{
+	Memoria::CArena arena;
+
+	const size_t run = 5 * MEMORIA_ARENA_PAGE_SIZE;
+
+	void *first = arena.Allocate(run);
+	void *second = arena.Allocate(run);
+	void *third = arena.Allocate(run);
+
+	MEMORIA_REQUIRE(first && second && third);
+	MEMORIA_CHECK(arena.GetSize(first) == run);
+
+	auto stats = arena.GetStats();
+	MEMORIA_CHECK(stats.Pages.Blocks == 3);
+
+	// The neighbouring runs merge, so ten pages fit without another slab.
+	MEMORIA_CHECK(arena.Free(second));
+	MEMORIA_CHECK(arena.Free(first));
+
+	void *merged = arena.Allocate(2 * run);
+	MEMORIA_REQUIRE(merged);
+
+	MEMORIA_CHECK(arena.GetStats().Slabs == stats.Slabs);
+	MEMORIA_CHECK(arena.GetSize(merged) == 2 * run);
+
+	MEMORIA_CHECK(arena.Free(merged));
+	MEMORIA_CHECK(arena.Free(third));
+	MEMORIA_CHECK(arena.GetStats().Pages.Blocks == 0);
+}
+
+MEMORIA_TEST(ArenaLargeBlocks)
+{
+	Memoria::CArena arena;
+
+	const size_t size = 1024 * 1024 + 1;
+
+	void *block = arena.Allocate(size, true);
+	MEMORIA_REQUIRE(block);
+
+	MEMORIA_CHECK(arena.GetSize(block) >= size);
+	MEMORIA_CHECK(Memoria::CArena::FromPointer(block) == &arena);
+	MEMORIA_CHECK(IsZero(block, size));
+
+	MEMORIA_CHECK(arena.Free(block));
+	MEMORIA_CHECK(arena.GetStats().Pages.Blocks == 0);
+}
+
+MEMORIA_TEST(ArenaRejectsForeignPointers)
+{
+	Memoria::CArena first, second;
+
+	void *block = first.Allocate(64);
+	MEMORIA_REQUIRE(block);
+
+	int local = 0;
+
+	MEMORIA_CHECK(!second.Free(block));
+	MEMORIA_CHECK(Memoria::CArena::FromPointer(&local) == nullptr);
+
+	MEMORIA_CHECK(first.Free(block));
+}
+
+MEMORIA_TEST(ArenaReset)
+{
+	Memoria::CArena arena;
+
+	for (size_t size = 16; size <= 256 * 1024; size *= 2)
+		MEMORIA_REQUIRE(arena.Allocate(size));
+
+	auto stats = arena.GetStats();
+	MEMORIA_CHECK(stats.Slabs > 0);
+
+	arena.Reset();
+
+	auto reset = arena.GetStats();
+
+	MEMORIA_CHECK(reset.Epoch == stats.Epoch + 1);
+	MEMORIA_CHECK(reset.Slabs == 0);
+	MEMORIA_CHECK(reset.Reserved == 0);
+	MEMORIA_CHECK(reset.Pages.Blocks == 0);
+
+	// The arena stays usable.
+	void *block = arena.Allocate(48);
+	MEMORIA_REQUIRE(block);
+	MEMORIA_CHECK(arena.Free(block));
+}
+
+static DWORD WINAPI ArenaThread(LPVOID param)
+{
+	auto arena = static_cast<Memoria::CArena *>(param);
+
+	void *blocks[100];
+
+	for (auto &block : blocks)
+		block = arena->Allocate(16);
+
+	for (auto block : blocks)
+		arena->Free(block);
+
+	return 0;
+}
+
+MEMORIA_TEST(ArenaThreadCachesAreReturned)
+{
+	Memoria::CArena arena;
+
+	HANDLE threads[4];
+
+	for (auto &thread : threads)
+		thread = CreateThread(nullptr, 0, ArenaThread, &arena, 0, nullptr);
+
+	WaitForMultipleObjects(_countof(threads), threads, TRUE, INFINITE);
+
+	for (auto thread : threads)
+		CloseHandle(thread);
+
+	// Blocks cached by the exited threads count as free.
+	MEMORIA_CHECK(arena.GetStats().Small[0].Blocks == 0);
+
+	arena.ReleaseThreadCaches();
+	MEMORIA_CHECK(arena.GetStats().Small[0].Blocks == 0);
+}
+
+MEMORIA_TEST(NewUsesTheDefaultArena)
+{
+	void *block = Memoria::New(40);
+	MEMORIA_REQUIRE(block);
+
+	MEMORIA_CHECK(Memoria::CArena::FromPointer(block) == Memoria::GetDefaultArena());
+	MEMORIA_CHECK(IsZero(block, 40));
+
+	// `Free` routes arena blocks to their arena.
+	MEMORIA_CHECK(Memoria::Free(block));
+}
\ No newline at end of file
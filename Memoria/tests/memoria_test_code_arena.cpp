@@ -0,0 +1,114 @@
+#include "memoria_test.hpp"
+
+#include "memoria_core_codearena.hpp"
+#include "memoria_core_mempool.hpp"
+
+#include <string.h>
+
+static bool IsWithinDisplacement(const void *source, const void *block, size_t size)
+{
+#ifdef MEMORIA_64BIT
+	auto from = reinterpret_cast<intptr_t>(source);
+	auto begin = reinterpret_cast<intptr_t>(block);
+
+	return begin - from >= INT32_MIN && begin + static_cast<intptr_t>(size) - from <= INT32_MAX;
+#else
+	(void)source, (void)block, (void)size;
+	return true;
+#endif
+}
+
+static DWORD GetProtection(const void *addr)
+{
+	MEMORY_BASIC_INFORMATION mbi;
+
+	if (VirtualQuery(addr, &mbi, sizeof(mbi)) != sizeof(mbi))
+		return 0;
+
+	return mbi.Protect;
+}
+
+MEMORIA_TEST(CodeArenaEmitsThroughTheWritableView)
+{
+	static const uint8_t code[] =
+	{
+		0xB8, 0x2A, 0x00, 0x00, 0x00,       // mov eax, 42
+		0xC3,                               // ret
+	};
+
+	const void *source = reinterpret_cast<const void *>(MemoriaTest::CreateCode);
+
+	Memoria::CCodeArena arena;
+
+	MEMORIA_REQUIRE(arena.Create(source, 100));
+	MEMORIA_CHECK(arena.IsValid());
+	MEMORIA_CHECK(arena.GetSize() == 0x10000);
+	MEMORIA_CHECK(!arena.Create(source, 100));
+
+	MEMORIA_CHECK(IsWithinDisplacement(source, arena.GetExecutable(), arena.GetSize()));
+
+	auto writable = static_cast<uint8_t *>(arena.GetWritable()) + 0x100;
+	auto executable = static_cast<uint8_t *>(arena.ToExecutable(writable));
+
+	MEMORIA_CHECK(arena.ToWritable(executable) == writable);
+
+	memcpy(writable, code, sizeof(code));
+	arena.Flush(executable, sizeof(code));
+
+	MEMORIA_CHECK(memcmp(executable, code, sizeof(code)) == 0);
+	MEMORIA_CHECK(reinterpret_cast<int (*)()>(executable)() == 42);
+
+	// Neither view is writable and executable at once.
+	if (arena.IsDualMapped())
+	{
+		MEMORIA_CHECK(GetProtection(executable) == PAGE_EXECUTE_READ);
+		MEMORIA_CHECK(GetProtection(writable) == PAGE_READWRITE);
+	}
+
+	arena.Release();
+
+	MEMORIA_CHECK(!arena.IsValid());
+	MEMORIA_CHECK(arena.GetSize() == 0);
+}
+
+struct RegionRequest_t
+{
+	void *Addr;
+	size_t Size;
+};
+
+static void *ReserveRegion(void *addr, size_t size, void *context)
+{
+	auto request = static_cast<RegionRequest_t *>(context);
+
+	request->Addr = addr;
+	request->Size = size;
+
+	return VirtualAlloc(addr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+static void *RefuseRegion(void *, size_t, void *)
+{
+	return nullptr;
+}
+
+MEMORIA_TEST(AllocInRegionUsesTheAllocator)
+{
+	const void *source = reinterpret_cast<const void *>(MemoriaTest::CreateCode);
+
+	RegionRequest_t request = {};
+	void *block = Memoria::AllocInRegion(source, 100, true, ReserveRegion, &request);
+
+	MEMORIA_REQUIRE(block);
+
+	// The allocator is given a granule-aligned address and a whole number of pages.
+	MEMORIA_CHECK(block == request.Addr);
+	MEMORIA_CHECK((reinterpret_cast<uintptr_t>(block) & 0xFFFF) == 0);
+	MEMORIA_CHECK(request.Size == 0x1000);
+	MEMORIA_CHECK(IsWithinDisplacement(source, block, request.Size));
+
+	VirtualFree(block, 0, MEM_RELEASE);
+
+	MEMORIA_CHECK(Memoria::AllocInRegion(source, 100, true, RefuseRegion, nullptr) == nullptr);
+	MEMORIA_CHECK(Memoria::AllocInRegion(nullptr, 100, true, ReserveRegion, &request) == nullptr);
+}
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "memoria_test.hpp"
+
+#include "memoria_ext_elf.hpp"
+
+#include <string.h>
+
+//
+// A minimal ELF64 shared object in file layout, linked at 0 with a single segment, so file
+// offsets and linked addresses are the same:
+//
+// 0x000 header, 0x040 program headers, 0x100 dynamic section, 0x200 DT_HASH, 0x280 DT_GNU_HASH,
+// 0x300 symbols, 0x400 names, 0x500 code of `alpha`, 0x510 code of `beta`.
+//
+// `gamma` is an undefined symbol, which a lookup must not return.
+//
+
+struct TestElfHeader_t
+{
+	uint8_t Ident[16];
+	uint16_t Type, Machine;
+	uint32_t Version;
+	uint64_t Entry, PhOff, ShOff;
+	uint32_t Flags;
+	uint16_t EhSize, PhEntSize, PhNum, ShEntSize, ShNum, ShStrNdx;
+};
+
+struct TestElfPhdr_t
+{
+	uint32_t Type, Flags;
+	uint64_t Offset, VAddr, PAddr, FileSize, MemSize, Align;
+};
+
+struct TestElfDyn_t
+{
+	int64_t Tag;
+	uint64_t Value;
+};
+
+struct TestElfSym_t
+{
+	uint32_t Name;
+	uint8_t Info, Other;
+	uint16_t ShNdx;
+	uint64_t Value, Size;
+};
+
+static const size_t kTestElfSize = 0x600;
+static const size_t kTestElfHash = 0x200;
+static const size_t kTestElfGnuHash = 0x280;
+
+static void BuildTestElf(uint8_t *image, bool gnu_hash)
+{
+	memset(image, 0, kTestElfSize);
+
+	auto header = reinterpret_cast<TestElfHeader_t *>(image);
+
+	memcpy(header->Ident, "\x7F" "ELF\x02\x01\x01", 7);
+	header->Type = 3;      // ET_DYN
+	header->Machine = 62;  // EM_X86_64
+	header->Version = 1;
+	header->PhOff = 0x40;
+	header->EhSize = sizeof(TestElfHeader_t);
+	header->PhEntSize = sizeof(TestElfPhdr_t);
+	header->PhNum = 2;
+
+	auto phdrs = reinterpret_cast<TestElfPhdr_t *>(&image[0x40]);
+
+	phdrs[0] = { 1, MEMORIA_ELF_PF_R | MEMORIA_ELF_PF_X, 0, 0, 0, kTestElfSize, kTestElfSize, 0x1000 }; // PT_LOAD
+	phdrs[1] = { 2, MEMORIA_ELF_PF_R, 0x100, 0x100, 0x100, 5 * sizeof(TestElfDyn_t), 5 * sizeof(TestElfDyn_t), 8 }; // PT_DYNAMIC
+
+	static const char names[] = "\0alpha\0beta\0gamma";
+
+	auto dyn = reinterpret_cast<TestElfDyn_t *>(&image[0x100]);
+
+	dyn[0] = { gnu_hash ? 0x6FFFFEF5 : 4, gnu_hash ? kTestElfGnuHash : kTestElfHash }; // DT_GNU_HASH or DT_HASH
+	dyn[1] = { 6, 0x300 };                 // DT_SYMTAB
+	dyn[2] = { 5, 0x400 };                 // DT_STRTAB
+	dyn[3] = { 10, sizeof(names) };        // DT_STRSZ
+	dyn[4] = { 0, 0 };                     // DT_NULL
+
+	// One bucket holding the chain 3 -> 2 -> 1.
+	auto hash = reinterpret_cast<uint32_t *>(&image[kTestElfHash]);
+
+	hash[0] = 1;    // buckets
+	hash[1] = 4;    // chain entries, one per symbol
+	hash[2] = 3;    // bucket 0
+	hash[3] = 0;    // chain[0]
+	hash[4] = 0;    // chain[1]
+	hash[5] = 1;    // chain[2]
+	hash[6] = 2;    // chain[3]
+
+	// One bucket starting at symbol 1, and a bloom filter word that accepts every name.
+	auto gnu = reinterpret_cast<uint32_t *>(&image[kTestElfGnuHash]);
+
+	gnu[0] = 1;     // buckets
+	gnu[1] = 1;     // first hashed symbol
+	gnu[2] = 1;     // bloom filter words
+	gnu[3] = 6;     // bloom shift
+	gnu[4] = gnu[5] = 0xFFFFFFFF;
+	gnu[6] = 1;     // bucket 0
+	gnu[7] = Memoria::ElfGnuHash("alpha") & ~1u;
+	gnu[8] = Memoria::ElfGnuHash("beta") & ~1u;
+	gnu[9] = Memoria::ElfGnuHash("gamma") | 1u;
+
+	auto symbols = reinterpret_cast<TestElfSym_t *>(&image[0x300]);
+
+	symbols[1] = { 1, 0x12, 0, 1, 0x500, 16 };  // alpha, STT_FUNC in section 1
+	symbols[2] = { 7, 0x12, 0, 1, 0x510, 16 };  // beta
+	symbols[3] = { 12, 0x12, 0, 0, 0, 0 };      // gamma, undefined
+
+	memcpy(&image[0x400], names, sizeof(names));
+	memset(&image[0x500], 0xC3, 0x20);
+}
+
+MEMORIA_TEST(ElfFindsSymbolsThroughTheHashTables)
+{
+	static uint8_t image[kTestElfSize];
+
+	for (bool gnu_hash : { false, true })
+	{
+		BuildTestElf(image, gnu_hash);
+
+		Memoria::CElfModule module;
+
+		MEMORIA_REQUIRE(module.Parse(image, sizeof(image), Memoria::eElfLayout::File));
+		MEMORIA_CHECK(module.Is64Bit());
+		MEMORIA_CHECK(module.GetSegments().size() == 1);
+		MEMORIA_CHECK(module.GetSegment(MEMORIA_ELF_PF_X) != nullptr);
+		MEMORIA_CHECK(module.GetSegment(MEMORIA_ELF_PF_W) == nullptr);
+
+		MEMORIA_CHECK(module.FindSymbol("alpha") == &image[0x500]);
+		MEMORIA_CHECK(module.FindSymbol("beta") == &image[0x510]);
+
+		MEMORIA_CHECK(module.FindSymbol("gamma") == nullptr);
+		MEMORIA_CHECK(module.FindSymbol("delta") == nullptr);
+		MEMORIA_CHECK(module.FindSymbol("alph") == nullptr);
+	}
+}
+
+MEMORIA_TEST(ElfRejectsBrokenTables)
+{
+	static uint8_t image[kTestElfSize];
+
+	BuildTestElf(image, false);
+
+	// A chain that loops back (3 -> 2 -> 1 -> 3) ends after visiting every symbol once.
+	reinterpret_cast<uint32_t *>(&image[kTestElfHash])[4] = 3;
+
+	Memoria::CElfModule module;
+
+	MEMORIA_REQUIRE(module.Parse(image, sizeof(image), Memoria::eElfLayout::File));
+	MEMORIA_CHECK(module.FindSymbol("delta") == nullptr);
+	MEMORIA_CHECK(module.FindSymbol("alpha") == &image[0x500]);
+
+	// Symbol indices past the table are ignored.
+	BuildTestElf(image, false);
+	reinterpret_cast<uint32_t *>(&image[kTestElfHash])[2] = 1000;
+
+	MEMORIA_REQUIRE(module.Parse(image, sizeof(image), Memoria::eElfLayout::File));
+	MEMORIA_CHECK(module.FindSymbol("alpha") == nullptr);
+
+	// A truncated copy keeps the symbols, but not the code they point at.
+	BuildTestElf(image, false);
+
+	MEMORIA_REQUIRE(module.Parse(image, 0x480, Memoria::eElfLayout::File));
+	MEMORIA_CHECK(module.FindSymbol("alpha") == nullptr);
+
+	// Cut inside the hash table.
+	MEMORIA_REQUIRE(module.Parse(image, kTestElfHash + 8, Memoria::eElfLayout::File));
+	MEMORIA_CHECK(module.FindSymbol("alpha") == nullptr);
+
+	// Not an ELF image at all.
+	image[1] = 'X';
+	MEMORIA_CHECK(!module.Parse(image, sizeof(image), Memoria::eElfLayout::File));
+}
\ No newline at end of file
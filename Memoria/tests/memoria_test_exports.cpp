@@ -0,0 +1,64 @@
+#include "memoria_test.hpp"
+
+#include "memoria_core_hash.hpp"
+#include "memoria_core_misc.hpp"
+
+MEMORIA_TEST(GetProcAddressDirectMatchesTheLoader)
+{
+	HMODULE kernel32 = GetModuleHandleA("kernel32.dll");
+	MEMORIA_REQUIRE(kernel32);
+
+	MEMORIA_CHECK(Memoria::GetModuleHandleDirect(Memoria::FNV1a64("kernel32.dll")) == kernel32);
+
+	// Several of these are forwarded to ntdll or kernelbase.
+	static const char *const names[] =
+	{
+		"GetCurrentProcessId",
+		"HeapAlloc",
+		"HeapFree",
+		"InitializeSRWLock",
+		"EnterCriticalSection",
+		"GetLastError",
+		"VirtualAlloc",
+		"CreateFileW",
+		"Sleep",
+	};
+
+	for (auto name : names)
+	{
+		void *expected = reinterpret_cast<void *>(GetProcAddress(kernel32, name));
+
+		MEMORIA_CHECK(expected != nullptr);
+		MEMORIA_CHECK(Memoria::GetProcAddressDirect(Memoria::FNV1a64("kernel32.dll"), Memoria::FNV1a64(name)) == expected);
+	}
+
+	// The index is reused by later lookups.
+	MEMORIA_CHECK(Memoria::GetProcAddressDirect(Memoria::FNV1a64("kernel32.dll"), Memoria::FNV1a64("HeapAlloc"))
+		== reinterpret_cast<void *>(GetProcAddress(GetModuleHandleA("ntdll.dll"), "RtlAllocateHeap")));
+}
+
+MEMORIA_TEST(GetProcAddressDirectSearchesAllModules)
+{
+	void *expected = reinterpret_cast<void *>(GetProcAddress(GetModuleHandleA("kernel32.dll"), "GetCurrentProcessId"));
+
+	// kernel32 comes before kernelbase in load order.
+	MEMORIA_CHECK(Memoria::GetProcAddressDirect(0, Memoria::FNV1a64("GetCurrentProcessId")) == expected);
+	MEMORIA_CHECK(Memoria::GetProcAddressDirect(Memoria::FNV1a64("GetCurrentProcessId")) == expected);
+
+	MEMORIA_CHECK(Memoria::GetProcAddressDirect(0, Memoria::FNV1a64("NotExportedAnywhere")) == nullptr);
+	MEMORIA_CHECK(Memoria::GetProcAddressDirect(Memoria::FNV1a64("missing.dll"), Memoria::FNV1a64("HeapAlloc")) == nullptr);
+	MEMORIA_CHECK(Memoria::GetModuleHandleDirect(Memoria::FNV1a64("missing.dll")) == nullptr);
+}
+
+MEMORIA_TEST(GetModuleHandleDirectFollowsLoads)
+{
+	HMODULE version = LoadLibraryA("version.dll");
+	MEMORIA_REQUIRE(version);
+
+	// The module list is rebuilt after the load notification.
+	MEMORIA_CHECK(Memoria::GetModuleHandleDirect(Memoria::FNV1a64("version.dll")) == version);
+	MEMORIA_CHECK(Memoria::GetProcAddressDirect(Memoria::FNV1a64("version.dll"), Memoria::FNV1a64("GetFileVersionInfoSizeA"))
+		== reinterpret_cast<void *>(GetProcAddress(version, "GetFileVersionInfoSizeA")));
+
+	FreeLibrary(version);
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "memoria_test.hpp"
+
+#include "memoria_core_debug.hpp"
+
+#include <intrin.h>
+
+// Function tables are only present in x64 images.
+#ifdef MEMORIA_64BIT
+static __declspec(noinline) const void *GetCallSite()
+{
+	return _ReturnAddress();
+}
+
+// Returns an address inside its own code, past the start of the function.
+static __declspec(noinline) const void *GetCodeOfTableTarget()
+{
+	return GetCallSite();
+}
+
+MEMORIA_TEST(FunctionBaseMatchesTheUnwinder)
+{
+	const void *code = GetCodeOfTableTarget();
+
+	DWORD64 image_base = 0;
+	auto expected = RtlLookupFunctionEntry(reinterpret_cast<DWORD64>(code), &image_base, nullptr);
+
+	MEMORIA_REQUIRE(expected);
+
+	void *base = Memoria::GetFunctionBaseAddressFromItsCode(code);
+
+	MEMORIA_CHECK(base == reinterpret_cast<void *>(image_base + expected->BeginAddress));
+	MEMORIA_CHECK(base < code);
+
+	// The first byte of a function belongs to it as well.
+	MEMORIA_CHECK(Memoria::GetFunctionBaseAddressFromItsCode(base) == base);
+
+	// The same range is listed by the full table.
+	bool listed = false;
+
+	for (auto &[begin, end] : Memoria::GetFunctionEntries(static_cast<HMODULE>(reinterpret_cast<void *>(image_base))))
+	{
+		if (begin == base)
+			listed = (code < end);
+	}
+
+	MEMORIA_CHECK(listed);
+}
+
+MEMORIA_TEST(FunctionBaseOutsideOfCode)
+{
+	int local = 0;
+
+	// Not in a module.
+	MEMORIA_CHECK(Memoria::GetFunctionBaseAddressFromItsCode(&local) == nullptr);
+	MEMORIA_CHECK(Memoria::GetFunctionBaseAddressFromItsCode(nullptr) == nullptr);
+
+	// In a module, but not in any function.
+	HMODULE module = GetModuleHandleA(nullptr);
+
+	MEMORIA_CHECK(Memoria::GetFunctionBaseAddressFromItsCode(module) == nullptr);
+}
+#endif
\ No newline at end of file
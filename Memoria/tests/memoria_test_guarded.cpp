@@ -0,0 +1,82 @@
+#include "memoria_test.hpp"
+
+#include "memoria_core_misc.hpp"
+
+static DWORD GetProtection(const void *addr)
+{
+	MEMORY_BASIC_INFORMATION mbi;
+
+	if (VirtualQuery(addr, &mbi, sizeof(mbi)) != sizeof(mbi))
+		return 0;
+
+	return mbi.Protect;
+}
+
+MEMORIA_TEST(GuardedCopyReportsFaults)
+{
+	auto pages = static_cast<uint8_t *>(VirtualAlloc(nullptr, 0x2000, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+	MEMORIA_REQUIRE(pages);
+
+	pages[0] = 0x5A;
+	pages[0xFFF] = 0xA5;
+
+	DWORD old_protection;
+	MEMORIA_REQUIRE(VirtualProtect(&pages[0x1000], 0x1000, PAGE_NOACCESS, &old_protection));
+
+	uint8_t out[16] = {};
+
+	MEMORIA_CHECK(Memoria::GuardedCopy(out, pages, 1));
+	MEMORIA_CHECK(out[0] == 0x5A);
+
+	MEMORIA_CHECK(!Memoria::GuardedCopy(out, &pages[0x1000], sizeof(out)));
+	MEMORIA_CHECK(!Memoria::GuardedCopy(out, &pages[0xFF8], sizeof(out)));
+	MEMORIA_CHECK(!Memoria::GuardedCopy(&pages[0x1000], out, sizeof(out)));
+	MEMORIA_CHECK(!Memoria::GuardedCopy(out, nullptr, sizeof(out)));
+
+	bool equal = false;
+
+	MEMORIA_CHECK(Memoria::GuardedCompare(&pages[0xFFF], &pages[0xFFF], 1, &equal));
+	MEMORIA_CHECK(equal);
+
+	MEMORIA_CHECK(Memoria::GuardedCompare(&pages[0], &pages[0xFFF], 1, &equal));
+	MEMORIA_CHECK(!equal);
+
+	MEMORIA_CHECK(!Memoria::GuardedCompare(&pages[0xFF0], &pages[0x1000], 16, &equal));
+
+	VirtualFree(pages, 0, MEM_RELEASE);
+}
+
+MEMORIA_TEST(GuardedCopyKeepsGuardPages)
+{
+	auto page = static_cast<uint8_t *>(VirtualAlloc(nullptr, 0x1000, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE | PAGE_GUARD));
+	MEMORIA_REQUIRE(page);
+
+	uint8_t out[4];
+
+	// The guard is restored after the hit, so the owner of the page still notices its first access.
+	MEMORIA_CHECK(!Memoria::GuardedCopy(out, page, sizeof(out)));
+	MEMORIA_CHECK((GetProtection(page) & PAGE_GUARD) != 0);
+
+	MEMORIA_CHECK(!Memoria::GuardedCopy(out, page, sizeof(out)));
+	MEMORIA_CHECK((GetProtection(page) & PAGE_GUARD) != 0);
+
+	VirtualFree(page, 0, MEM_RELEASE);
+}
+
+static void WriteThrough(void *context)
+{
+	*static_cast<volatile int *>(context) = 1;
+}
+
+MEMORIA_TEST(GuardedCallCatchesAccessViolations)
+{
+	int value = 0;
+
+	MEMORIA_CHECK(Memoria::GuardedCall(WriteThrough, &value));
+	MEMORIA_CHECK(value == 1);
+
+	MEMORIA_CHECK(!Memoria::GuardedCall(WriteThrough, nullptr));
+
+	volatile int *invalid = nullptr;
+	MEMORIA_CHECK(!Memoria::GuardedInvoke([&] { *invalid = 2; }));
+}
\ No newline at end of file
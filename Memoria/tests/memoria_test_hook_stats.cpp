@@ -0,0 +1,79 @@
+#include "memoria_test.hpp"
+
+#include "memoria_core_hook.hpp"
+
+static int (*gStatsOriginal)() = nullptr;
+static Memoria::CHookCounters *gStatsCounters = nullptr;
+
+static int StatsDetour()
+{
+	Memoria::CHookTimer timer(gStatsCounters);
+	return gStatsOriginal() + 1;
+}
+
+static DWORD WINAPI StatsThread(LPVOID param)
+{
+	auto target = reinterpret_cast<int (*)()>(param);
+
+	for (int i = 0; i < 1000; ++i)
+		target();
+
+	return 0;
+}
+
+MEMORIA_TEST(HookInstrumentedCountsCalls)
+{
+	auto target = MemoriaTest::CreateConstantFunction(10);
+	MEMORIA_REQUIRE(target);
+
+	MEMORIA_REQUIRE(Memoria::HookInstrumented(reinterpret_cast<void *>(target), reinterpret_cast<const void *>(StatsDetour), &gStatsOriginal, &gStatsCounters));
+	MEMORIA_REQUIRE(gStatsCounters);
+
+	MEMORIA_CHECK(target() == 11);
+	MEMORIA_CHECK(gStatsCounters->GetCalls() == 1);
+
+	// Calls from several threads land in different shards and are summed up.
+	HANDLE threads[4];
+
+	for (auto &thread : threads)
+		thread = CreateThread(nullptr, 0, StatsThread, reinterpret_cast<LPVOID>(target), 0, nullptr);
+
+	WaitForMultipleObjects(_countof(threads), threads, TRUE, INFINITE);
+
+	for (auto thread : threads)
+		CloseHandle(thread);
+
+	MEMORIA_CHECK(gStatsCounters->GetCalls() == 4001);
+	MEMORIA_CHECK(gStatsCounters->GetCycles() > 0);
+
+	bool found = false;
+
+	for (auto &entry : Memoria::GetHookStats())
+	{
+		if (entry.Target == reinterpret_cast<const void *>(target))
+		{
+			found = true;
+			MEMORIA_CHECK(entry.Calls == 4001);
+		}
+	}
+
+	MEMORIA_CHECK(found);
+
+	Memoria::ResetHookStats();
+	MEMORIA_CHECK(gStatsCounters->GetCalls() == 0);
+}
+
+MEMORIA_TEST(HookStatsDumpRestarts)
+{
+	MEMORIA_CHECK(!Memoria::StartHookStatsDump(0));
+
+	// Stopping joins the thread, so it can be started again right away.
+	for (int i = 0; i < 3; ++i)
+	{
+		MEMORIA_CHECK(Memoria::StartHookStatsDump(1));
+		Sleep(5);
+		Memoria::StopHookStatsDump();
+	}
+
+	Memoria::StopHookStatsDump();
+}
\ No newline at end of file
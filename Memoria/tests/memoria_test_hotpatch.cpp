@@ -0,0 +1,151 @@
+#include "memoria_test.hpp"
+
+#include "memoria_core_hook.hpp"
+#include "memoria_core_options.hpp"
+#include "memoria_core_write.hpp"
+
+#include <string.h>
+
+struct HotPatchCaller_t
+{
+	int (*Function)();
+
+	// Values the function may return while it is patched.
+	int Old;
+	int New;
+
+	volatile LONG Stop;
+	volatile LONG Calls;
+	volatile LONG Unexpected;
+};
+
+static DWORD WINAPI HotPatchCallerThread(LPVOID param)
+{
+	auto caller = static_cast<HotPatchCaller_t *>(param);
+
+	while (!caller->Stop)
+	{
+		int value = caller->Function();
+
+		if (value != caller->Old && value != caller->New)
+			InterlockedIncrement(&caller->Unexpected);
+
+		InterlockedIncrement(&caller->Calls);
+	}
+
+	return 0;
+}
+
+// Runs `patch` while other threads keep calling the function.
+template <typename patch_t>
+static bool PatchWhileCalled(HotPatchCaller_t &caller, patch_t &&patch)
+{
+	HANDLE threads[3];
+
+	for (auto &thread : threads)
+		thread = CreateThread(nullptr, 0, HotPatchCallerThread, &caller, 0, nullptr);
+
+	while (caller.Calls < 1000)
+		Sleep(0);
+
+	bool result = patch();
+
+	LONG calls = caller.Calls;
+
+	while (caller.Calls < calls + 1000)
+		Sleep(0);
+
+	InterlockedExchange(&caller.Stop, 1);
+	WaitForMultipleObjects(_countof(threads), threads, TRUE, INFINITE);
+
+	for (auto thread : threads)
+		CloseHandle(thread);
+
+	return result;
+}
+
+// `[nop] mov eax, value; ret` at `offset` of a block of int3.
+static uint8_t *CreateValueFunction(size_t offset, bool nop, int value)
+{
+	uint8_t code[64];
+	memset(code, 0xCC, sizeof(code));
+
+	uint8_t *p = &code[offset];
+
+	if (nop)
+		*p++ = 0x90;
+
+	*p++ = 0xB8;
+	memcpy(p, &value, sizeof(value));
+	p[4] = 0xC3;
+
+	return static_cast<uint8_t *>(MemoriaTest::CreateCode(code, sizeof(code))) + offset;
+}
+
+static void TestWriteCodeAtomic(size_t offset, bool nop)
+{
+	uint8_t *function = CreateValueFunction(offset, nop, 1);
+	MEMORIA_REQUIRE(function);
+
+	uint8_t replacement[7] = {};
+	size_t size = 0;
+
+	if (nop)
+		replacement[size++] = 0x90;
+
+	int value = 2;
+
+	replacement[size++] = 0xB8;
+	memcpy(&replacement[size], &value, sizeof(value));
+	size += sizeof(value);
+
+	HotPatchCaller_t caller = { reinterpret_cast<int (*)()>(function), 1, 2 };
+
+	MEMORIA_CHECK(PatchWhileCalled(caller, [&] { return Memoria::WriteCodeAtomic(function, replacement, size); }));
+	MEMORIA_CHECK(caller.Unexpected == 0);
+	MEMORIA_CHECK(memcmp(function, replacement, size) == 0);
+	MEMORIA_CHECK(caller.Function() == 2);
+}
+
+MEMORIA_TEST(WriteCodeAtomicWithinWindow)
+{
+	// One interlocked store.
+	TestWriteCodeAtomic(0, false);
+}
+
+MEMORIA_TEST(WriteCodeAtomicAcrossWindows)
+{
+	// The head is replaced with `jmp $` while the tail is written.
+	TestWriteCodeAtomic(13, false);
+}
+
+MEMORIA_TEST(WriteCodeAtomicWithInt3Guard)
+{
+	// The first instruction is a single byte, so the guard is an int3 handled by the vectored handler.
+	TestWriteCodeAtomic(29, true);
+}
+
+static int HotPatchDetour()
+{
+	return 6;
+}
+
+MEMORIA_TEST(HookInHotPatchMode)
+{
+	auto target = MemoriaTest::CreateConstantFunction(5);
+	MEMORIA_REQUIRE(target);
+
+	HotPatchCaller_t caller = { target, 5, 6 };
+	int (*original)() = nullptr;
+
+	Memoria::SetHotPatchModeState(true);
+
+	MEMORIA_CHECK(PatchWhileCalled(caller, [&] { return Memoria::Hook(reinterpret_cast<void *>(target), reinterpret_cast<const void *>(HotPatchDetour), &original); }));
+
+	Memoria::SetHotPatchModeState(false);
+
+	MEMORIA_CHECK(caller.Unexpected == 0);
+	MEMORIA_CHECK(target() == 6);
+	MEMORIA_REQUIRE(original);
+	MEMORIA_CHECK(original() == 5);
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#include "memoria_test.hpp"
+
+#include "memoria_ext_import.hpp"
+
+static DWORD WINAPI FakeGetCurrentProcessId()
+{
+	return 0x1234;
+}
+
+MEMORIA_TEST(ImportIndexFindsKernelImports)
+{
+	auto index = Memoria::GetImportIndex(nullptr);
+	MEMORIA_REQUIRE(index);
+
+	// Names are hashed case-insensitively; the import directory spells them `KERNEL32.dll`.
+	auto slot = index->Find(Memoria::FNV1a64("kernel32.dll"), Memoria::FNV1a64("GetCurrentProcessId"));
+
+	MEMORIA_REQUIRE(slot);
+	MEMORIA_CHECK(!slot->ByOrdinal);
+	MEMORIA_CHECK(*slot->Slot == reinterpret_cast<void *>(GetProcAddress(GetModuleHandleA("kernel32.dll"), "GetCurrentProcessId")));
+	MEMORIA_CHECK(index->Find(0, Memoria::FNV1a64("GetCurrentProcessId")) == slot);
+
+	MEMORIA_CHECK(index->Find(0, Memoria::FNV1a64("NotImportedAnywhere")) == nullptr);
+}
+
+MEMORIA_TEST(HookImportRedirectsTheSlot)
+{
+	DWORD pid = GetCurrentProcessId();
+	DWORD (WINAPI *original)() = nullptr;
+
+	MEMORIA_REQUIRE(Memoria::HookImport(nullptr, 0, Memoria::FNV1a64("GetCurrentProcessId"), reinterpret_cast<const void *>(FakeGetCurrentProcessId), &original));
+
+	// Calls of this module go through the import table, the function itself is untouched.
+	MEMORIA_CHECK(GetCurrentProcessId() == 0x1234);
+	MEMORIA_REQUIRE(original);
+	MEMORIA_CHECK(original() == pid);
+
+	// The hook state is kept apart from the index, so it survives a rebuild.
+	Memoria::InvalidateImportIndex(nullptr);
+
+	MEMORIA_CHECK(Memoria::UnhookImport(nullptr, 0, Memoria::FNV1a64("GetCurrentProcessId")));
+	MEMORIA_CHECK(GetCurrentProcessId() == pid);
+	MEMORIA_CHECK(!Memoria::UnhookImport(nullptr, 0, Memoria::FNV1a64("GetCurrentProcessId")));
+}
\ No newline at end of file
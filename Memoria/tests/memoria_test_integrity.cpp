@@ -0,0 +1,101 @@
+#include "memoria_test.hpp"
+
+#include "memoria_ext_integrity.hpp"
+#include "memoria_ext_patch.hpp"
+
+static Memoria::IntegrityViolation_t gLastViolation;
+static volatile LONG gViolationCount = 0;
+static bool gReapply = true;
+
+static bool OnViolation(const Memoria::IntegrityViolation_t &violation)
+{
+	gLastViolation = violation;
+	InterlockedIncrement(&gViolationCount);
+
+	return gReapply;
+}
+
+MEMORIA_TEST(IntegrityReportsDivergedPatches)
+{
+	static uint32_t value = 1;
+
+	auto patch = Memoria::PatchU32(&value, 2);
+	MEMORIA_REQUIRE(patch);
+
+	Memoria::SetIntegrityCallback(OnViolation);
+	MEMORIA_REQUIRE(Memoria::WatchPatch(patch));
+
+	gViolationCount = 0;
+	MEMORIA_CHECK(Memoria::CheckIntegrity() == 0);
+
+	// Someone else writes over the patch.
+	value = 3;
+
+	MEMORIA_CHECK(Memoria::CheckIntegrity() == 1);
+	MEMORIA_CHECK(gViolationCount == 1);
+	MEMORIA_CHECK(gLastViolation.Address == &value);
+	MEMORIA_CHECK(gLastViolation.Size == sizeof(value));
+	MEMORIA_CHECK(gLastViolation.Patch == patch);
+	MEMORIA_CHECK(value == 2);
+
+	// Restoring the patch changes the expected bytes instead of being reported.
+	patch->Restore();
+	MEMORIA_CHECK(value == 1);
+	MEMORIA_CHECK(Memoria::CheckIntegrity() == 0);
+
+	// The callback may keep the foreign bytes.
+	gReapply = false;
+	value = 4;
+
+	MEMORIA_CHECK(Memoria::CheckIntegrity() == 1);
+	MEMORIA_CHECK(value == 4);
+
+	gReapply = true;
+	value = 1;
+
+	Memoria::UnwatchAll();
+	Memoria::SetIntegrityCallback(nullptr);
+}
+
+MEMORIA_TEST(IntegrityWatchesCode)
+{
+	static uint8_t code[64] = { 0x90, 0x90, 0x90, 0x90, 0x90 };
+
+	Memoria::SetIntegrityCallback(OnViolation);
+	MEMORIA_REQUIRE(Memoria::WatchCode(code, 5));
+
+	auto stats = Memoria::GetIntegrityStats();
+	MEMORIA_CHECK(stats.Ranges == 1);
+	MEMORIA_CHECK(stats.Pages >= 1);
+
+	// Bytes outside the range are not watched.
+	code[10] = 0xCC;
+	MEMORIA_CHECK(Memoria::CheckIntegrity() == 0);
+
+	code[2] = 0xCC;
+
+	gViolationCount = 0;
+	MEMORIA_CHECK(Memoria::CheckIntegrity() == 1);
+	MEMORIA_CHECK(gLastViolation.Address == code);
+	MEMORIA_CHECK(gLastViolation.Patch == nullptr);
+	MEMORIA_CHECK(code[2] == 0x90);
+
+	// The background monitor finds it as well.
+	MEMORIA_REQUIRE(Memoria::StartIntegrityMonitor(1));
+
+	code[0] = 0xCC;
+
+	for (int i = 0; i < 1000 && code[0] != 0x90; ++i)
+		Sleep(1);
+
+	Memoria::StopIntegrityMonitor();
+
+	MEMORIA_CHECK(code[0] == 0x90);
+	MEMORIA_CHECK(gViolationCount == 2);
+	MEMORIA_CHECK(Memoria::GetIntegrityStats().Violations >= stats.Violations + 2);
+
+	Memoria::UnwatchAll();
+	Memoria::SetIntegrityCallback(nullptr);
+
+	MEMORIA_CHECK(Memoria::GetIntegrityStats().Ranges == 0);
+}
\ No newline at end of file
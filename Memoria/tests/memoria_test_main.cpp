@@ -0,0 +1,164 @@
+#include "memoria_test.hpp"
+
+#include "memoria_common.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace MemoriaTest
+{
+	struct Test_t
+	{
+		const char *Name;
+		TestFunction_t Function;
+		bool Child;
+	};
+
+	static Test_t gTests[512];
+	static size_t gTestCount = 0;
+
+	static const char *gCurrentTest = nullptr;
+	static size_t gFailures = 0;
+
+	bool Register(const char *name, TestFunction_t function, bool child)
+	{
+		if (gTestCount == _countof(gTests))
+		{
+			fprintf(stderr, "Too many tests, %s is not registered.\n", name);
+			return false;
+		}
+
+		gTests[gTestCount++] = { name, function, child };
+		return true;
+	}
+
+	void Fail(const char *file, int line, const char *expression)
+	{
+		fprintf(stderr, "%s(%d): %s: check failed: %s\n", file, line, gCurrentTest ? gCurrentTest : "?", expression);
+		++gFailures;
+	}
+
+	bool StartChild(const char *name, PROCESS_INFORMATION *process, HANDLE *output)
+	{
+		char path[MAX_PATH];
+
+		if (GetModuleFileNameA(nullptr, path, sizeof(path)) == 0)
+			return false;
+
+		char command_line[MAX_PATH + 128];
+		snprintf(command_line, sizeof(command_line), "\"%s\" --child %s", path, name);
+
+		SECURITY_ATTRIBUTES attributes = { sizeof(attributes), nullptr, TRUE };
+		HANDLE read = nullptr, write = nullptr;
+
+		if (!CreatePipe(&read, &write, &attributes, 0))
+			return false;
+
+		// Only the write end is inherited.
+		SetHandleInformation(read, HANDLE_FLAG_INHERIT, 0);
+
+		STARTUPINFOA startup = { sizeof(startup) };
+
+		startup.dwFlags = STARTF_USESTDHANDLES;
+		startup.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+		startup.hStdOutput = write;
+		startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+		bool result = CreateProcessA(nullptr, command_line, nullptr, nullptr, TRUE, 0, nullptr, nullptr, &startup, process) != FALSE;
+
+		CloseHandle(write);
+
+		if (!result)
+		{
+			CloseHandle(read);
+			return false;
+		}
+
+		*output = read;
+		return true;
+	}
+
+	void *CreateCode(const void *code, size_t size)
+	{
+		void *memory = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+
+		if (!memory)
+			return nullptr;
+
+		memcpy(memory, code, size);
+		FlushInstructionCache(GetCurrentProcess(), memory, size);
+
+		return memory;
+	}
+
+	int (*CreateConstantFunction(int value))()
+	{
+		// mov eax, value; 15 x nop; ret
+		uint8_t code[21];
+
+		code[0] = 0xB8;
+		memcpy(&code[1], &value, sizeof(value));
+		memset(&code[5], 0x90, 15);
+		code[20] = 0xC3;
+
+		return reinterpret_cast<int (*)()>(CreateCode(code, sizeof(code)));
+	}
+}
+
+int main(int argc, char **argv)
+{
+	using namespace MemoriaTest;
+
+	if (!Memoria::Startup())
+	{
+		fprintf(stderr, "Memoria::Startup failed.\n");
+		return 1;
+	}
+
+	// `--child <name>` runs a child entry; otherwise all tests, or those whose name contains `argv[1]`.
+	if (argc == 3 && strcmp(argv[1], "--child") == 0)
+	{
+		for (size_t i = 0; i < gTestCount; ++i)
+		{
+			if (gTests[i].Child && strcmp(gTests[i].Name, argv[2]) == 0)
+			{
+				gCurrentTest = gTests[i].Name;
+				gTests[i].Function();
+
+				Memoria::Cleanup();
+				return gFailures ? 1 : 0;
+			}
+		}
+
+		fprintf(stderr, "Unknown child entry %s.\n", argv[2]);
+		return 1;
+	}
+
+	const char *filter = (argc == 2) ? argv[1] : nullptr;
+	size_t run = 0, failed = 0;
+
+	for (size_t i = 0; i < gTestCount; ++i)
+	{
+		if (gTests[i].Child || (filter && !strstr(gTests[i].Name, filter)))
+			continue;
+
+		size_t failures = gFailures;
+
+		gCurrentTest = gTests[i].Name;
+		gTests[i].Function();
+
+		bool passed = gFailures == failures;
+
+		printf("[%s] %s\n", passed ? " OK " : "FAIL", gTests[i].Name);
+
+		++run;
+
+		if (!passed)
+			++failed;
+	}
+
+	Memoria::Cleanup();
+
+	printf("%zu tests, %zu failed\n", run, failed);
+	return failed ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "memoria_test.hpp"
+
+#include "memoria_ext_manifest.hpp"
+#include "memoria_ext_patch.hpp"
+
+static uint8_t gManifestBuffer[32] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+
+#pragma optimize("", off)
+static __declspec(noinline) int ManifestTarget(int value)
+{
+	return value + 1;
+}
+#pragma optimize("", on)
+
+static int (*gManifestOriginal)(int) = nullptr;
+
+static int ManifestDetour(int value)
+{
+	return gManifestOriginal(value) * 10;
+}
+
+MEMORIA_TEST(ManifestRoundTrip)
+{
+	char path[MAX_PATH];
+
+	MEMORIA_REQUIRE(GetTempPathA(sizeof(path), path) != 0);
+	MEMORIA_REQUIRE(lstrcatA(path, "memoria_test.manifest"));
+
+	static const uint8_t kept[] = { 0xAA, 0xBB, 0xCC, 0xDD };
+	static const uint8_t stale[] = { 0xEE, 0xEE, 0xEE, 0xEE };
+
+	auto kept_patch = Memoria::CreatePatch(&gManifestBuffer[0], kept, sizeof(kept), false);
+	auto stale_patch = Memoria::CreatePatch(&gManifestBuffer[8], stale, sizeof(stale), false);
+
+	MEMORIA_REQUIRE(kept_patch && stale_patch);
+
+	{
+		Memoria::CManifestWriter writer;
+
+		MEMORIA_CHECK(writer.AddPatch(kept_patch));
+		MEMORIA_CHECK(writer.AddPatch(stale_patch));
+		MEMORIA_CHECK(writer.AddHook(Memoria::FNV1a64("ManifestTarget"), reinterpret_cast<const void *>(ManifestTarget), 5));
+		MEMORIA_CHECK(writer.GetEntryCount() == 3);
+
+		MEMORIA_REQUIRE(writer.Save(path));
+	}
+
+	// The bytes of one patch change before the manifest is loaded again; it is too short to be searched for.
+	gManifestBuffer[8] = 0x42;
+
+	Memoria::CManifest manifest;
+	MEMORIA_REQUIRE(manifest.Open(path));
+
+	MEMORIA_CHECK(manifest.GetEntryCount() == 3);
+
+	// All entries belong to the test executable.
+	auto modules = manifest.GetModules();
+	auto entries = manifest.GetEntries();
+
+	MEMORIA_REQUIRE(modules && entries);
+	MEMORIA_CHECK(entries[0].Module == 0 && entries[1].Module == 0 && entries[2].Module == 0);
+	MEMORIA_CHECK(entries[0].Kind == Memoria::eManifestEntry::Patch);
+	MEMORIA_CHECK(entries[2].Kind == Memoria::eManifestEntry::Hook);
+	MEMORIA_CHECK(entries[0].Size == sizeof(kept));
+
+	Memoria::ManifestHook_t hooks[] =
+	{
+		{ Memoria::FNV1a64("ManifestTarget"), reinterpret_cast<const void *>(ManifestDetour), &gManifestOriginal },
+	};
+
+	auto result = manifest.Apply("memoria_test_manifest", hooks, _countof(hooks));
+
+	MEMORIA_CHECK(result.Verified == 2);
+	MEMORIA_CHECK(result.Rescanned == 0);
+	MEMORIA_CHECK(result.Failed == 1);
+
+	MEMORIA_CHECK(gManifestBuffer[0] == 0xAA && gManifestBuffer[3] == 0xDD);
+	MEMORIA_CHECK(gManifestBuffer[8] == 0x42);
+	MEMORIA_CHECK(ManifestTarget(4) == 50);
+
+	auto group = Memoria::FindPatchGroup(Memoria::FNV1a64("memoria_test_manifest"));
+
+	MEMORIA_REQUIRE(group);
+	MEMORIA_CHECK(group->GetSize() == 1);
+	MEMORIA_CHECK(group->Restore());
+	MEMORIA_CHECK(gManifestBuffer[0] == 1);
+
+	manifest.Close();
+	MEMORIA_CHECK(!manifest.IsOpen());
+
+	DeleteFileA(path);
+}
+
+MEMORIA_TEST(ManifestRejectsInvalidFiles)
+{
+	char path[MAX_PATH];
+
+	MEMORIA_REQUIRE(GetTempPathA(sizeof(path), path) != 0);
+	MEMORIA_REQUIRE(lstrcatA(path, "memoria_test_invalid.manifest"));
+
+	HANDLE file = CreateFileA(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	MEMORIA_REQUIRE(file != INVALID_HANDLE_VALUE);
+
+	DWORD written;
+	const char garbage[64] = "not a manifest";
+
+	WriteFile(file, garbage, sizeof(garbage), &written, nullptr);
+	CloseHandle(file);
+
+	Memoria::CManifest manifest;
+
+	MEMORIA_CHECK(!manifest.Open(path));
+	MEMORIA_CHECK(!manifest.IsOpen());
+	MEMORIA_CHECK(manifest.GetEntryCount() == 0);
+
+	DeleteFileA(path);
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "memoria_test.hpp"
+
+#include "memoria_core_mempool.hpp"
+
+static size_t FindMemPoolClass(size_t size)
+{
+	size_t index = 0;
+
+	while (Memoria::GetMemPoolClassSize(index) < size)
+		++index;
+
+	return index;
+}
+
+MEMORIA_TEST(MemPoolClassSizes)
+{
+	MEMORIA_CHECK(Memoria::GetMemPoolClassSize(0) == 16);
+	MEMORIA_CHECK(Memoria::GetMemPoolClassSize(1) == 32);
+	MEMORIA_CHECK(Memoria::GetMemPoolClassSize(MEMORIA_MEMPOOL_CLASSES - 2) == 4095);
+	MEMORIA_CHECK(Memoria::GetMemPoolClassSize(MEMORIA_MEMPOOL_CLASSES - 1) == SIZE_MAX);
+}
+
+MEMORIA_TEST(MemPoolTracksChunks)
+{
+	static void *chunks[1000];
+
+	// Executable memory is never served by an arena, so every allocation is a chunk of the pool.
+	const size_t size = 100;
+	const size_t index = FindMemPoolClass(size);
+
+	auto before = Memoria::GetMemPoolStats();
+
+	for (auto &chunk : chunks)
+	{
+		chunk = Memoria::Alloc(size, true);
+		MEMORIA_REQUIRE(chunk);
+	}
+
+	void *page = Memoria::Alloc(8192, true);
+	MEMORIA_REQUIRE(page);
+
+	auto stats = Memoria::GetMemPoolStats();
+
+	MEMORIA_CHECK(stats.Chunks == before.Chunks + _countof(chunks) + 1);
+	MEMORIA_CHECK(stats.Bytes == before.Bytes + _countof(chunks) * size + 8192);
+	MEMORIA_CHECK(stats.Classes[index].Chunks == before.Classes[index].Chunks + _countof(chunks));
+	MEMORIA_CHECK(stats.Classes[MEMORIA_MEMPOOL_CLASSES - 1].Chunks == before.Classes[MEMORIA_MEMPOOL_CLASSES - 1].Chunks + 1);
+
+	// Free every other chunk first so removals move chunks around in the middle of the array.
+	for (size_t i = 0; i < _countof(chunks); i += 2)
+		MEMORIA_CHECK(Memoria::Free(chunks[i]));
+
+	for (size_t i = 1; i < _countof(chunks); i += 2)
+		MEMORIA_CHECK(Memoria::Free(chunks[i]));
+
+	MEMORIA_CHECK(Memoria::Free(page));
+
+	stats = Memoria::GetMemPoolStats();
+
+	MEMORIA_CHECK(stats.Chunks == before.Chunks);
+	MEMORIA_CHECK(stats.Bytes == before.Bytes);
+	MEMORIA_CHECK(stats.Classes[index].Chunks == before.Classes[index].Chunks);
+
+	// Chunks are released once, and unknown addresses are rejected.
+	MEMORIA_CHECK(!Memoria::Free(chunks[0]));
+	MEMORIA_CHECK(!Memoria::Free(&stats));
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "memoria_test.hpp"
+
+#include "memoria_core_hook.hpp"
+
+#include <string.h>
+
+// int Increment(int value), hooked at the `add`.
+#ifdef MEMORIA_64BIT
+static const uint8_t kIncrementCode[] =
+{
+	0x8B, 0xC1,                         // mov eax, ecx
+	0x83, 0xC0, 0x01,                   // add eax, 1
+	0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
+	0xC3,                               // ret
+};
+
+static const size_t kIncrementHookOffset = 2;
+#else
+static const uint8_t kIncrementCode[] =
+{
+	0x8B, 0x44, 0x24, 0x04,             // mov eax, [esp+4]
+	0x83, 0xC0, 0x01,                   // add eax, 1
+	0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90,
+	0xC3,                               // ret
+};
+
+static const size_t kIncrementHookOffset = 4;
+#endif
+
+static volatile uintptr_t gMidHookSp = 0;
+static volatile LONG gMidHookCalls = 0;
+
+static void MidHookCallback(Memoria::MidHookContext_t *context)
+{
+	InterlockedIncrement(&gMidHookCalls);
+
+#ifdef MEMORIA_64BIT
+	context->Rax += 100;
+	gMidHookSp = context->Rsp;
+#else
+	context->Eax += 100;
+	gMidHookSp = context->Esp;
+#endif
+}
+
+MEMORIA_TEST(MidHookModifiesRegisters)
+{
+	auto code = static_cast<uint8_t *>(MemoriaTest::CreateCode(kIncrementCode, sizeof(kIncrementCode)));
+	MEMORIA_REQUIRE(code);
+
+	auto increment = reinterpret_cast<int (*)(int)>(code);
+
+	MEMORIA_CHECK(increment(1) == 2);
+
+	Memoria::CMidHook *handle = nullptr;
+	MEMORIA_REQUIRE(Memoria::MidHook(&code[kIncrementHookOffset], MidHookCallback, Memoria::MHR_ALL, &handle));
+	MEMORIA_REQUIRE(handle);
+
+	MEMORIA_CHECK(increment(1) == 102);
+	MEMORIA_CHECK(gMidHookCalls == 1);
+
+	// The callback sees the stack pointer of the hooked code, which points at the return address.
+	MEMORIA_CHECK(gMidHookSp != 0 && (gMidHookSp & (sizeof(void *) - 1)) == 0);
+
+	MEMORIA_CHECK(handle->Unhook());
+	MEMORIA_CHECK(!handle->IsActive());
+	MEMORIA_CHECK(increment(1) == 2);
+	MEMORIA_CHECK(gMidHookCalls == 1);
+
+	MEMORIA_CHECK(handle->Hook());
+	MEMORIA_CHECK(increment(5) == 106);
+}
+
+MEMORIA_TEST(MidHookWithoutNonVolatileRegisters)
+{
+	auto code = static_cast<uint8_t *>(MemoriaTest::CreateCode(kIncrementCode, sizeof(kIncrementCode)));
+	MEMORIA_REQUIRE(code);
+
+	auto increment = reinterpret_cast<int (*)(int)>(code);
+
+	// The accumulator is volatile and always captured.
+	MEMORIA_REQUIRE(Memoria::MidHook<Memoria::MHR_AX>(&code[kIncrementHookOffset], MidHookCallback));
+	MEMORIA_CHECK(increment(7) == 108);
+}
+
+#ifdef MEMORIA_64BIT
+MEMORIA_TEST(MidHookStubHasUnwindInfo)
+{
+	auto code = static_cast<uint8_t *>(MemoriaTest::CreateCode(kIncrementCode, sizeof(kIncrementCode)));
+	MEMORIA_REQUIRE(code);
+
+	MEMORIA_REQUIRE(Memoria::MidHook(&code[kIncrementHookOffset], MidHookCallback));
+
+	// The hooked instruction became a `jmp rel32` to the stub.
+	MEMORIA_REQUIRE(code[kIncrementHookOffset] == 0xE9);
+
+	int32_t displacement;
+	memcpy(&displacement, &code[kIncrementHookOffset + 1], sizeof(displacement));
+
+	uint8_t *stub = &code[kIncrementHookOffset + 5] + displacement;
+
+	// Stack walks from the callback must get through the stub.
+	DWORD64 image_base = 0;
+	MEMORIA_CHECK(RtlLookupFunctionEntry(reinterpret_cast<DWORD64>(stub) + 16, &image_base, nullptr) != nullptr);
+}
+#endif
\ No newline at end of file
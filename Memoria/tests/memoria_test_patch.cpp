@@ -0,0 +1,89 @@
+#include "memoria_test.hpp"
+
+#include "memoria_ext_patch.hpp"
+
+#include <string.h>
+
+static uint8_t gPatchBuffer[1024];
+
+MEMORIA_TEST(PatchRegistryIndexesPatches)
+{
+	static Memoria::CPatch *patches[600];
+
+	for (size_t i = 0; i < _countof(gPatchBuffer); ++i)
+		gPatchBuffer[i] = static_cast<uint8_t>(i);
+
+	size_t count = Memoria::GetPatchCount();
+
+	// Enough patches to span several chunks of the registry, created in reverse address order.
+	for (size_t i = _countof(patches); i-- > 0;)
+	{
+		patches[i] = Memoria::PatchU8(&gPatchBuffer[i], 0xFF, false);
+		MEMORIA_REQUIRE(patches[i]);
+	}
+
+	MEMORIA_CHECK(Memoria::GetPatchCount() == count + _countof(patches));
+
+	for (size_t i = 0; i < _countof(patches); ++i)
+	{
+		MEMORIA_CHECK(Memoria::GetPatch(patches[i]->GetId()) == patches[i]);
+		MEMORIA_CHECK(Memoria::FindPatch(&gPatchBuffer[i]) == patches[i]);
+	}
+
+	MEMORIA_CHECK(Memoria::GetPatch(static_cast<uint32_t>(count + _countof(patches))) == nullptr);
+	MEMORIA_CHECK(Memoria::FindPatch(&gPatchBuffer[_countof(patches)]) == nullptr);
+
+	// Overlap queries return patches ordered by address.
+	auto found = Memoria::FindPatches(&gPatchBuffer[10], 5);
+
+	MEMORIA_REQUIRE(found.size() == 5);
+
+	for (size_t i = 0; i < found.size(); ++i)
+		MEMORIA_CHECK(found[i] == patches[10 + i]);
+
+	MEMORIA_CHECK(Memoria::FindPatch(&gPatchBuffer[8], 4) == patches[8]);
+
+	// Nothing is written until the patches are applied.
+	MEMORIA_CHECK(gPatchBuffer[0] == 0 && !patches[0]->IsActive());
+
+	MEMORIA_REQUIRE(Memoria::ApplyPatches());
+
+	for (size_t i = 0; i < _countof(patches); ++i)
+		MEMORIA_CHECK(gPatchBuffer[i] == 0xFF && patches[i]->IsActive());
+
+	MEMORIA_REQUIRE(Memoria::RestorePatches());
+
+	for (size_t i = 0; i < _countof(patches); ++i)
+		MEMORIA_CHECK(gPatchBuffer[i] == static_cast<uint8_t>(i) && !patches[i]->IsActive());
+}
+
+MEMORIA_TEST(PatchApplyAndRestore)
+{
+	static uint32_t value = 0x11223344;
+
+	auto patch = Memoria::PatchU32(&value, 0xAABBCCDD);
+	MEMORIA_REQUIRE(patch);
+
+	// Patches are deployed on creation by default.
+	MEMORIA_CHECK(patch->IsActive());
+	MEMORIA_CHECK(value == 0xAABBCCDD);
+	MEMORIA_CHECK(patch->GetAddress() == &value);
+	MEMORIA_CHECK(patch->GetSize() == sizeof(value));
+
+	uint32_t origin, data;
+	memcpy(&origin, patch->GetDataOrigin(), sizeof(origin));
+	memcpy(&data, patch->GetDataPatch(), sizeof(data));
+
+	MEMORIA_CHECK(origin == 0x11223344);
+	MEMORIA_CHECK(data == 0xAABBCCDD);
+
+	patch->Restore();
+	MEMORIA_CHECK(!patch->IsActive());
+	MEMORIA_CHECK(value == 0x11223344);
+
+	patch->Toggle(true);
+	MEMORIA_CHECK(value == 0xAABBCCDD);
+
+	patch->Restore();
+	MEMORIA_CHECK(value == 0x11223344);
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "memoria_test.hpp"
+
+#include "memoria_ext_patch.hpp"
+
+static uint8_t gGroupBuffer[16];
+
+MEMORIA_TEST(PatchGroupAppliesMembersTogether)
+{
+	for (size_t i = 0; i < _countof(gGroupBuffer); ++i)
+		gGroupBuffer[i] = static_cast<uint8_t>(i);
+
+	auto group = Memoria::GetPatchGroup("memoria_test_patch_group");
+	MEMORIA_REQUIRE(group);
+
+	MEMORIA_CHECK(Memoria::GetPatchGroup("memoria_test_patch_group") == group);
+	MEMORIA_CHECK(Memoria::FindPatchGroup(group->GetNameHash()) == group);
+	MEMORIA_CHECK(group->GetSize() == 0 && !group->IsActive());
+
+	auto first = Memoria::PatchU8(&gGroupBuffer[0], 0xAA, false);
+	auto second = Memoria::PatchU16(&gGroupBuffer[4], 0xBBBB, false);
+
+	// Patches of the same byte are applied in the order they were added and restored in reverse.
+	auto overlapping = Memoria::PatchU8(&gGroupBuffer[0], 0xCC, false);
+
+	MEMORIA_REQUIRE(first && second && overlapping);
+
+	MEMORIA_CHECK(group->Add(first));
+	MEMORIA_CHECK(group->Add(second));
+	MEMORIA_CHECK(group->Add(overlapping));
+	MEMORIA_CHECK(group->Add(first));
+	MEMORIA_CHECK(group->GetSize() == 3);
+
+	MEMORIA_REQUIRE(group->Apply());
+
+	MEMORIA_CHECK(group->IsActive());
+	MEMORIA_CHECK(first->IsActive() && second->IsActive() && overlapping->IsActive());
+	MEMORIA_CHECK(gGroupBuffer[0] == 0xCC);
+	MEMORIA_CHECK(gGroupBuffer[4] == 0xBB && gGroupBuffer[5] == 0xBB);
+
+	MEMORIA_REQUIRE(group->Restore(true));
+
+	MEMORIA_CHECK(!group->IsActive());
+	MEMORIA_CHECK(!first->IsActive() && !second->IsActive() && !overlapping->IsActive());
+
+	for (size_t i = 0; i < _countof(gGroupBuffer); ++i)
+		MEMORIA_CHECK(gGroupBuffer[i] == static_cast<uint8_t>(i));
+
+	// Members already in the requested state are left alone.
+	second->Apply();
+
+	MEMORIA_REQUIRE(group->Apply(true));
+	MEMORIA_CHECK(gGroupBuffer[0] == 0xCC && gGroupBuffer[4] == 0xBB);
+
+	MEMORIA_REQUIRE(group->Restore());
+	MEMORIA_CHECK(gGroupBuffer[0] == 0 && gGroupBuffer[4] == 4);
+}
+
+MEMORIA_TEST(PatchGroupLookup)
+{
+	MEMORIA_CHECK(Memoria::FindPatchGroup(Memoria::FNV1a64("memoria_test_missing_group")) == nullptr);
+
+	auto group = Memoria::GetPatchGroup("memoria_test_empty_group");
+	MEMORIA_REQUIRE(group);
+
+	// An empty group toggles trivially.
+	MEMORIA_CHECK(group->Apply());
+	MEMORIA_CHECK(group->IsActive());
+	MEMORIA_CHECK(group->Restore());
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "memoria_test.hpp"
+
+#include "memoria_core_read.hpp"
+
+#include <string.h>
+
+// A readable page followed by an inaccessible one.
+static uint8_t *CreateReadPages()
+{
+	auto pages = static_cast<uint8_t *>(VirtualAlloc(nullptr, 0x2000, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+
+	if (!pages)
+		return nullptr;
+
+	for (size_t i = 0; i < 0x1000; ++i)
+		pages[i] = static_cast<uint8_t>(i);
+
+	DWORD old_protection;
+	VirtualProtect(&pages[0x1000], 0x1000, PAGE_NOACCESS, &old_protection);
+
+	return pages;
+}
+
+MEMORIA_TEST(ReadGatherSkipsInvalidElements)
+{
+	auto pages = CreateReadPages();
+	MEMORIA_REQUIRE(pages);
+
+	const void *addrs[] =
+	{
+		&pages[0x10],
+		&pages[0x1010],     // inaccessible
+		&pages[0x20],
+		nullptr,
+		&pages[0x1000 - 2], // straddles into the inaccessible page
+		&pages[0x30],
+	};
+
+	uint32_t out[_countof(addrs)];
+	bool valid[_countof(addrs)];
+
+	memset(out, 0xFF, sizeof(out));
+
+	MEMORIA_CHECK(Memoria::ReadGather(addrs, _countof(addrs), out, sizeof(uint32_t), valid) == 3);
+
+	MEMORIA_CHECK(valid[0] && !valid[1] && valid[2] && !valid[3] && !valid[4] && valid[5]);
+	MEMORIA_CHECK(out[0] == 0x13121110);
+	MEMORIA_CHECK(out[2] == 0x23222120);
+	MEMORIA_CHECK(out[5] == 0x33323130);
+
+	// Unreadable elements are zero-filled.
+	MEMORIA_CHECK(out[1] == 0 && out[3] == 0 && out[4] == 0);
+
+	uint16_t values[2];
+	MEMORIA_CHECK(Memoria::ReadMany<uint16_t>(std::span<const void *const>(addrs, 2), values) == 1);
+	MEMORIA_CHECK(values[0] == 0x1110 && values[1] == 0);
+
+	VirtualFree(pages, 0, MEM_RELEASE);
+}
+
+MEMORIA_TEST(ReadFieldsRelativeToBase)
+{
+	auto pages = CreateReadPages();
+	MEMORIA_REQUIRE(pages);
+
+	uint8_t small = 0;
+	uint32_t health = 0;
+	uint64_t position = 0;
+	uint32_t outside = 0xFFFFFFFF;
+
+	const Memoria::ReadField_t fields[] =
+	{
+		MEMORIA_READ_FIELD(0x01, small),
+		MEMORIA_READ_FIELD(0x40, health),
+		MEMORIA_READ_FIELD(0x80, position),
+		MEMORIA_READ_FIELD(0x1000, outside),
+	};
+
+	MEMORIA_CHECK(Memoria::ReadFields(pages, fields) == 3);
+
+	MEMORIA_CHECK(small == 0x01);
+	MEMORIA_CHECK(health == 0x43424140);
+	MEMORIA_CHECK(position == 0x8786858483828180ull);
+	MEMORIA_CHECK(outside == 0);
+
+	uint32_t raw = 0;
+	MEMORIA_CHECK(Memoria::ReadRaw(pages, &raw, sizeof(raw), 4));
+	MEMORIA_CHECK(raw == 0x07060504);
+	MEMORIA_CHECK(!Memoria::ReadRaw(&pages[0x1000 - 2], &raw, sizeof(raw)));
+
+	auto value = Memoria::ReadStruct<uint16_t>(pages, 0x1000);
+	MEMORIA_CHECK(!value.has_value());
+
+	VirtualFree(pages, 0, MEM_RELEASE);
+}
\ No newline at end of file
@@ -0,0 +1,263 @@
+#include "memoria_test.hpp"
+
+#include "memoria_core_source.hpp"
+#include "memoria_ext_patch.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+// Three pages in the child: read-write, read-only and inaccessible.
+static const size_t kRemoteSize = 0x3000;
+
+static uint8_t GetRemoteByte(size_t offset)
+{
+	return static_cast<uint8_t>((offset < 0x1000) ? offset : offset ^ 0x5A);
+}
+
+MEMORIA_TEST_CHILD(RemoteSourceTarget)
+{
+	auto pages = static_cast<uint8_t *>(VirtualAlloc(nullptr, kRemoteSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+
+	if (!pages)
+		return;
+
+	for (size_t i = 0; i < 0x2000; ++i)
+		pages[i] = GetRemoteByte(i);
+
+	DWORD old_protection;
+	VirtualProtect(&pages[0x1000], 0x1000, PAGE_READONLY, &old_protection);
+	VirtualProtect(&pages[0x2000], 0x1000, PAGE_NOACCESS, &old_protection);
+
+	printf("%p\n", pages);
+	fflush(stdout);
+
+	// The parent terminates the process when it is done.
+	Sleep(INFINITE);
+}
+
+// Reads the address printed by the child.
+static uint8_t *ReadRemoteAddress(HANDLE output)
+{
+	char line[64] = {};
+	size_t length = 0;
+
+	while (length < sizeof(line) - 1)
+	{
+		DWORD read = 0;
+
+		if (!ReadFile(output, &line[length], 1, &read, nullptr) || read == 0)
+			return nullptr;
+
+		if (line[length] == '\n')
+			break;
+
+		++length;
+	}
+
+	void *addr = nullptr;
+
+	if (sscanf(line, "%p", &addr) != 1)
+		return nullptr;
+
+	return static_cast<uint8_t *>(addr);
+}
+
+static bool CheckRemoteBytes(const uint8_t *data, size_t offset, size_t size)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (data[i] != GetRemoteByte(offset + i))
+			return false;
+	}
+
+	return true;
+}
+
+static void TestRemoteSource(Memoria::CRemoteMemorySource &remote, uint8_t *pages)
+{
+	uint8_t data[64];
+
+	MEMORIA_CHECK(remote.Read(&pages[0x10], data, sizeof(data)));
+	MEMORIA_CHECK(CheckRemoteBytes(data, 0x10, sizeof(data)));
+
+	MEMORIA_CHECK(!remote.Read(&pages[0x2000], data, sizeof(data)));
+	MEMORIA_CHECK(!remote.Read(&pages[0x2000 - 8], data, 16));
+
+	MEMORIA_CHECK(remote.WriteValue<uint32_t>(pages, 0xCAFEBABE, 0x100));
+	MEMORIA_CHECK(remote.ReadValue<uint32_t>(pages, 0x100) == 0xCAFEBABE);
+
+	// Read-only pages are written by changing the protection for the write.
+	MEMORIA_CHECK(remote.WriteValue<uint16_t>(&pages[0x1100], 0x1234));
+	MEMORIA_CHECK(remote.ReadValue<uint16_t>(&pages[0x1100]) == 0x1234);
+
+	MEMORY_BASIC_INFORMATION mbi;
+
+	MEMORIA_CHECK(remote.Query(&pages[0x1100], &mbi));
+	MEMORIA_CHECK(mbi.Protect == PAGE_READONLY);
+
+	MEMORIA_CHECK(remote.Query(&pages[0x2000], &mbi));
+	MEMORIA_CHECK(mbi.Protect == PAGE_NOACCESS);
+}
+
+static void TestCachedSource(Memoria::CRemoteMemorySource &remote, uint8_t *pages)
+{
+	Memoria::CCachedMemorySource cache;
+	MEMORIA_REQUIRE(cache.Create(&remote, 64));
+
+	uint8_t data[32];
+
+	MEMORIA_CHECK(cache.Read(&pages[0x200], data, sizeof(data)));
+	MEMORIA_CHECK(CheckRemoteBytes(data, 0x200, sizeof(data)));
+
+	uint64_t misses = cache.GetMisses();
+
+	// The page is cached now.
+	MEMORIA_CHECK(cache.Read(&pages[0x400], data, sizeof(data)));
+	MEMORIA_CHECK(CheckRemoteBytes(data, 0x400, sizeof(data)));
+	MEMORIA_CHECK(cache.GetMisses() == misses);
+	MEMORIA_CHECK(cache.GetHits() > 0);
+
+	// Reads across into an unreadable page fail, and keep failing from the cache.
+	MEMORIA_CHECK(cache.Read(&pages[0x1FF0], data, 16));
+	MEMORIA_CHECK(!cache.Read(&pages[0x1FF0], data, sizeof(data)));
+	MEMORIA_CHECK(!cache.Read(&pages[0x2000], data, sizeof(data)));
+
+	// Writes go through and update the cached copy.
+	MEMORIA_CHECK(cache.WriteValue<uint32_t>(&pages[0x204], 0x01020304));
+	MEMORIA_CHECK(cache.ReadValue<uint32_t>(&pages[0x204]) == 0x01020304);
+	MEMORIA_CHECK(remote.ReadValue<uint32_t>(&pages[0x204]) == 0x01020304);
+
+	// Changes made behind the cache are seen after an invalidation.
+	MEMORIA_CHECK(remote.WriteValue<uint32_t>(&pages[0x204], 0x0A0B0C0D));
+	MEMORIA_CHECK(cache.ReadValue<uint32_t>(&pages[0x204]) == 0x01020304);
+
+	cache.Invalidate();
+	MEMORIA_CHECK(cache.ReadValue<uint32_t>(&pages[0x204]) == 0x0A0B0C0D);
+
+	MEMORIA_CHECK(remote.WriteValue<uint32_t>(&pages[0x204], 0x07060504));
+
+	// A view of the whole range zero-fills the inaccessible page.
+	Memoria::CMemoryView view;
+	MEMORIA_REQUIRE(view.Map(&cache, pages, kRemoteSize));
+
+	auto local = static_cast<const uint8_t *>(view.GetBegin());
+
+	MEMORIA_CHECK(view.GetSize() == kRemoteSize);
+	MEMORIA_CHECK(CheckRemoteBytes(&local[0x200], 0x200, 0x100));
+	MEMORIA_CHECK(local[0x2000] == 0 && local[0x2FFF] == 0);
+
+	MEMORIA_CHECK(view.ToRemote(&local[0x1234]) == &pages[0x1234]);
+	MEMORIA_CHECK(view.ToLocal(&pages[0x1234]) == &local[0x1234]);
+	MEMORIA_CHECK(view.Contains(view.GetLastByte()));
+
+	MEMORIA_CHECK(!view.Map(&cache, &pages[0x2000], 0x1000));
+}
+
+static void TestSourcePatch(Memoria::CRemoteMemorySource &remote, uint8_t *pages)
+{
+	static const uint8_t bytes[] = { 0x90, 0x90, 0xEB, 0xFE };
+
+	uint8_t *target = &pages[0x1040];
+
+	Memoria::CSourcePatch patch;
+
+	MEMORIA_REQUIRE(patch.Create(&remote, target, bytes, sizeof(bytes), false));
+	MEMORIA_CHECK(!patch.IsActive());
+	MEMORIA_CHECK(patch.IsValid());
+	MEMORIA_CHECK(patch.GetAddress() == target);
+	MEMORIA_CHECK(patch.GetSize() == sizeof(bytes));
+
+	uint8_t data[sizeof(bytes)];
+
+	// Round trips of the read-only target.
+	for (int i = 0; i < 2; ++i)
+	{
+		MEMORIA_CHECK(patch.Apply());
+		MEMORIA_CHECK(patch.IsActive() && patch.IsValid());
+		MEMORIA_CHECK(remote.Read(target, data, sizeof(data)) && memcmp(data, bytes, sizeof(bytes)) == 0);
+
+		MEMORIA_CHECK(patch.Restore());
+		MEMORIA_CHECK(!patch.IsActive() && patch.IsValid());
+		MEMORIA_CHECK(remote.Read(target, data, sizeof(data)) && CheckRemoteBytes(data, 0x1040, sizeof(data)));
+	}
+
+	// Someone else changed the target.
+	MEMORIA_CHECK(patch.Apply());
+	MEMORIA_CHECK(remote.WriteValue<uint8_t>(target, 0xCC));
+	MEMORIA_CHECK(!patch.IsValid());
+
+	// Releasing an active patch restores the original bytes.
+	patch.Release();
+
+	MEMORIA_CHECK(!patch.IsActive());
+	MEMORIA_CHECK(remote.Read(target, data, sizeof(data)) && CheckRemoteBytes(data, 0x1040, sizeof(data)));
+
+	// Deployed on creation by default; the original bytes must be readable.
+	MEMORIA_CHECK(patch.Create(&remote, target, bytes, sizeof(bytes)));
+	MEMORIA_CHECK(patch.IsActive());
+	patch.Release();
+
+	MEMORIA_CHECK(!patch.Create(&remote, &pages[0x2000], bytes, sizeof(bytes)));
+}
+
+MEMORIA_TEST(RemoteMemorySourceRoundTrips)
+{
+	PROCESS_INFORMATION process;
+	HANDLE output;
+
+	MEMORIA_REQUIRE(MemoriaTest::StartChild("RemoteSourceTarget", &process, &output));
+
+	uint8_t *pages = ReadRemoteAddress(output);
+
+	if (pages)
+	{
+		Memoria::CRemoteMemorySource remote;
+
+		MEMORIA_CHECK(remote.Open(process.dwProcessId));
+
+		if (remote.GetProcess())
+		{
+			TestRemoteSource(remote, pages);
+			TestCachedSource(remote, pages);
+			TestSourcePatch(remote, pages);
+		}
+
+		remote.Close();
+		MEMORIA_CHECK(remote.GetProcess() == nullptr);
+	}
+
+	MEMORIA_CHECK(pages != nullptr);
+
+	TerminateProcess(process.hProcess, 0);
+	WaitForSingleObject(process.hProcess, INFINITE);
+
+	CloseHandle(output);
+	CloseHandle(process.hThread);
+	CloseHandle(process.hProcess);
+}
+
+MEMORIA_TEST(LocalMemorySourcePatches)
+{
+	static uint8_t buffer[16] = { 1, 2, 3, 4 };
+	static const uint8_t bytes[] = { 9, 9 };
+
+	auto source = Memoria::GetLocalMemorySource();
+
+	MEMORIA_REQUIRE(source);
+	MEMORIA_CHECK(source->IsLocal());
+
+	Memoria::CSourcePatch patch;
+
+	MEMORIA_REQUIRE(patch.Create(source, &buffer[1], bytes, sizeof(bytes)));
+	MEMORIA_CHECK(buffer[0] == 1 && buffer[1] == 9 && buffer[2] == 9 && buffer[3] == 4);
+
+	MEMORIA_CHECK(patch.Restore());
+	MEMORIA_CHECK(buffer[1] == 2 && buffer[2] == 3);
+
+	// Views of local memory point at the memory itself.
+	Memoria::CMemoryView view;
+
+	MEMORIA_REQUIRE(view.Map(source, buffer, sizeof(buffer)));
+	MEMORIA_CHECK(view.GetBegin() == buffer);
+	MEMORIA_CHECK(view.ToRemote(&buffer[3]) == &buffer[3]);
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "memoria_test.hpp"
+
+#include "memoria_core_rtti.hpp"
+
+#include <string.h>
+
+// Distinct bodies, so no two vtables are folded into one.
+class CRttiBase
+{
+public:
+	virtual ~CRttiBase() = default;
+	virtual int GetKind() { return 1; }
+};
+
+class CRttiDerived : public CRttiBase
+{
+public:
+	int GetKind() override { return 2; }
+};
+
+class CRttiSecond
+{
+public:
+	virtual ~CRttiSecond() = default;
+	virtual int GetOther() { return 3; }
+};
+
+class CRttiMulti : public CRttiBase, public CRttiSecond
+{
+public:
+	int GetKind() override { return 4; }
+	int GetOther() override { return 5; }
+};
+
+namespace MemoriaRttiTest
+{
+	struct RttiNamed
+	{
+		virtual ~RttiNamed() = default;
+		virtual int GetKind() { return 6; }
+	};
+}
+
+static void **GetVTable(void *instance)
+{
+	return *static_cast<void ***>(instance);
+}
+
+MEMORIA_TEST(RttiCatalogFindsClassesAndVTables)
+{
+	CRttiBase base;
+	CRttiDerived derived;
+	CRttiMulti multi;
+	MemoriaRttiTest::RttiNamed named;
+
+	Memoria::CRttiCatalog catalog;
+
+	MEMORIA_REQUIRE(catalog.Build(nullptr));
+	MEMORIA_CHECK(catalog.GetModule() == GetModuleHandleA(nullptr));
+
+	auto derived_class = catalog.FindClass("CRttiDerived");
+
+	MEMORIA_REQUIRE(derived_class);
+	MEMORIA_CHECK(strcmp(derived_class->Name, ".?AVCRttiDerived@@") == 0);
+	MEMORIA_CHECK(derived_class->VTable == GetVTable(&derived));
+
+	// Decorated names are looked up as they are, case-insensitively.
+	MEMORIA_CHECK(catalog.FindClass(".?AVCRttiDerived@@") == derived_class);
+	MEMORIA_CHECK(catalog.FindClass(".?avcrttiderived@@") == derived_class);
+	MEMORIA_CHECK(catalog.FindClassByDescriptor(derived_class->TypeDescriptor) == derived_class);
+
+	MEMORIA_CHECK(catalog.GetVTable("CRttiDerived") == GetVTable(&derived));
+	MEMORIA_CHECK(catalog.GetVTable("CRttiBase") == GetVTable(&base));
+	MEMORIA_CHECK(catalog.FindClassByVTable(GetVTable(&derived)) == derived_class);
+
+	auto vtable = catalog.FindVTable(GetVTable(&derived));
+
+	MEMORIA_REQUIRE(vtable);
+	MEMORIA_CHECK(vtable->Offset == 0 && &catalog.GetClasses()[vtable->Class] == derived_class);
+
+	// Structs and namespaces.
+	auto named_class = catalog.FindClass("MemoriaRttiTest::RttiNamed");
+
+	MEMORIA_REQUIRE(named_class);
+	MEMORIA_CHECK(strcmp(named_class->Name, ".?AURttiNamed@MemoriaRttiTest@@") == 0);
+	MEMORIA_CHECK(named_class->VTable == GetVTable(&named));
+
+	MEMORIA_CHECK(catalog.FindClass("CRttiMissing") == nullptr);
+	MEMORIA_CHECK(catalog.GetVTable("CRttiMissing") == nullptr);
+	MEMORIA_CHECK(catalog.FindClass("") == nullptr);
+	MEMORIA_CHECK(catalog.FindVTable(&base) == nullptr);
+}
+
+MEMORIA_TEST(RttiCatalogReadsHierarchies)
+{
+	CRttiDerived derived;
+	CRttiMulti multi;
+
+	auto catalog = Memoria::CRttiCatalog::Create(nullptr);
+	MEMORIA_REQUIRE(catalog);
+
+	auto base_class = catalog->FindClass("CRttiBase");
+	auto derived_class = catalog->FindClass("CRttiDerived");
+	auto second_class = catalog->FindClass("CRttiSecond");
+	auto multi_class = catalog->FindClass("CRttiMulti");
+
+	MEMORIA_REQUIRE(base_class && derived_class && second_class && multi_class);
+
+	MEMORIA_CHECK(derived_class->BaseCount == 1);
+	MEMORIA_CHECK(catalog->GetBase(*derived_class, 0) == base_class);
+	MEMORIA_CHECK(catalog->GetBase(*derived_class, 1) == nullptr);
+
+	MEMORIA_CHECK(catalog->IsDerivedFrom(*derived_class, *base_class));
+	MEMORIA_CHECK(!catalog->IsDerivedFrom(*base_class, *derived_class));
+	MEMORIA_CHECK(!catalog->IsDerivedFrom(*derived_class, *second_class));
+
+	MEMORIA_CHECK(multi_class->BaseCount == 2);
+	MEMORIA_CHECK(catalog->IsDerivedFrom(*multi_class, *base_class));
+	MEMORIA_CHECK(catalog->IsDerivedFrom(*multi_class, *second_class));
+
+	// The vtable of the second base belongs to the complete object as well.
+	CRttiSecond *second = &multi;
+	size_t offset = reinterpret_cast<uintptr_t>(second) - reinterpret_cast<uintptr_t>(&multi);
+
+	auto vtable = catalog->FindVTable(GetVTable(second));
+
+	MEMORIA_REQUIRE(vtable);
+	MEMORIA_CHECK(vtable->Offset == offset);
+	MEMORIA_CHECK(catalog->FindClassByVTable(GetVTable(second)) == multi_class);
+	MEMORIA_CHECK(multi_class->VTable == GetVTable(&multi));
+}
+
+MEMORIA_TEST(RttiCatalogMatchesTheScan)
+{
+	CRttiSecond second;
+
+	auto module = reinterpret_cast<const uint8_t *>(GetModuleHandleA(nullptr));
+	auto dos = reinterpret_cast<const IMAGE_DOS_HEADER *>(module);
+	auto nt = reinterpret_cast<const IMAGE_NT_HEADERS *>(module + dos->e_lfanew);
+
+	Memoria::CRttiCatalog catalog;
+	MEMORIA_REQUIRE(catalog.Build(nullptr));
+
+	// The decorated name must not appear as a literal in this module, or the scan may take it
+	// for the type descriptor.
+	void **scanned = Memoria::GetVTableForClass(module, module, module + nt->OptionalHeader.SizeOfImage, "CRttiSecond");
+
+	MEMORIA_CHECK(scanned == GetVTable(&second));
+	MEMORIA_CHECK(catalog.GetVTable("CRttiSecond") == scanned);
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include "memoria_test.hpp"
+
+#include "memoria_core_hook.hpp"
+
+class CShadowAnimal
+{
+public:
+	int _legs = 4;
+
+	virtual int GetSound() { return 1; }
+	virtual int GetLegs() { return _legs; }
+};
+
+static __declspec(noinline) int CallGetSound(CShadowAnimal *animal)
+{
+	return animal->GetSound();
+}
+
+static __declspec(noinline) int CallGetLegs(CShadowAnimal *animal)
+{
+	return animal->GetLegs();
+}
+
+static void **GetVTable(void *instance)
+{
+	return *static_cast<void ***>(instance);
+}
+
+// Virtual methods are `__thiscall` on x86; `__fastcall` receives the object in ecx as well.
+#ifdef MEMORIA_64BIT
+static int ShadowGetSound(CShadowAnimal *)
+#else
+static int __fastcall ShadowGetSound(CShadowAnimal *, void *)
+#endif
+{
+	return 2;
+}
+
+MEMORIA_TEST(ShadowVTableIsSharedPerClass)
+{
+	CShadowAnimal first, second;
+	void **original = GetVTable(&first);
+
+	MEMORIA_CHECK(Memoria::CShadowVTableRegistry::CountMethods(original) >= 2);
+
+	{
+		Memoria::CShadowVTable first_shadow(&first);
+		Memoria::CShadowVTable second_shadow(&second);
+
+		void **shadow = Memoria::CShadowVTableRegistry::FindShadow(original);
+
+		MEMORIA_REQUIRE(shadow);
+		MEMORIA_CHECK(GetVTable(&first) == shadow);
+		MEMORIA_CHECK(GetVTable(&second) == shadow);
+		MEMORIA_CHECK(Memoria::CShadowVTableRegistry::FindOriginal(shadow) == original);
+
+		// The RTTI locator in front of the vtable is copied as well.
+		MEMORIA_CHECK(shadow[-1] == original[-1]);
+
+		first_shadow.Hook(0, ShadowGetSound);
+
+		// A hook through one instance applies to every instance using the shadow.
+		MEMORIA_CHECK(CallGetSound(&first) == 2);
+		MEMORIA_CHECK(CallGetSound(&second) == 2);
+		MEMORIA_CHECK(CallGetLegs(&second) == 4);
+
+		// Instances that were never shadowed keep the original.
+		CShadowAnimal third;
+		MEMORIA_CHECK(CallGetSound(&third) == 1);
+	}
+
+	MEMORIA_CHECK(GetVTable(&first) == original);
+	MEMORIA_CHECK(GetVTable(&second) == original);
+	MEMORIA_CHECK(Memoria::CShadowVTableRegistry::FindShadow(original) == nullptr);
+	MEMORIA_CHECK(CallGetSound(&first) == 1);
+}
+
+MEMORIA_TEST(ShadowVTableCountsOwnersPerInstance)
+{
+	CShadowAnimal animal;
+	void **original = GetVTable(&animal);
+
+	auto outer = new Memoria::CShadowVTable(&animal);
+	void **shadow = GetVTable(&animal);
+
+	MEMORIA_REQUIRE(shadow != original);
+
+	{
+		// Shadowing an already shadowed instance reuses the same shadow.
+		Memoria::CShadowVTable inner(&animal);
+		MEMORIA_CHECK(GetVTable(&animal) == shadow);
+	}
+
+	// The instance keeps the shadow until its last owner is gone.
+	MEMORIA_CHECK(GetVTable(&animal) == shadow);
+
+	delete outer;
+	MEMORIA_CHECK(GetVTable(&animal) == original);
+}
\ No newline at end of file
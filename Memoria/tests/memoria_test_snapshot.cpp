@@ -0,0 +1,139 @@
+#include "memoria_test.hpp"
+
+#include "memoria_ext_snapshot.hpp"
+
+struct SnapshotRegions_t
+{
+	// Compared page by page.
+	uint8_t *Plain;
+
+	// Allocated with `MEM_WRITE_WATCH`, so only written pages are compared.
+	uint8_t *Watched;
+};
+
+static bool CreateSnapshotRegions(SnapshotRegions_t *regions)
+{
+	regions->Plain = static_cast<uint8_t *>(VirtualAlloc(nullptr, 0x4000, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+	regions->Watched = static_cast<uint8_t *>(VirtualAlloc(nullptr, 0x2000, MEM_RESERVE | MEM_COMMIT | MEM_WRITE_WATCH, PAGE_READWRITE));
+
+	if (!regions->Plain || !regions->Watched)
+		return false;
+
+	// The other pages stay zero.
+	for (size_t i = 0; i < 0x1000; ++i)
+	{
+		regions->Plain[i] = static_cast<uint8_t>(i + 1);
+		regions->Watched[i] = static_cast<uint8_t>(i * 3);
+	}
+
+	return true;
+}
+
+static void FreeSnapshotRegions(SnapshotRegions_t *regions)
+{
+	VirtualFree(regions->Plain, 0, MEM_RELEASE);
+	VirtualFree(regions->Watched, 0, MEM_RELEASE);
+}
+
+MEMORIA_TEST(SnapshotDiffsLiveMemory)
+{
+	SnapshotRegions_t regions;
+	MEMORIA_REQUIRE(CreateSnapshotRegions(&regions));
+
+	Memoria::CSnapshot snapshot;
+
+	MEMORIA_CHECK(snapshot.Add(&regions.Plain[0x10], 0x4000 - 0x10));
+	MEMORIA_CHECK(snapshot.Add(regions.Watched, 0x2000));
+	MEMORIA_CHECK(!snapshot.IsCaptured());
+
+	MEMORIA_REQUIRE(snapshot.Capture());
+
+	// Regions are extended to whole pages, and zero pages take no storage.
+	MEMORIA_CHECK(snapshot.GetPageCount() == 6);
+	MEMORIA_CHECK(snapshot.GetStoredSize() == 2 * 0x1000);
+	MEMORIA_CHECK(snapshot.Diff().empty());
+
+	regions.Plain[0x20] = 0xFF;
+	regions.Plain[0x21] = 0xFF;
+
+	// A change across two pages, one of which was zero.
+	regions.Plain[0xFFF] = 0xAA;
+	regions.Plain[0x1000] = 0xAA;
+
+	regions.Watched[0x1800] = 0x77;
+
+	auto changes = snapshot.Diff();
+
+	MEMORIA_REQUIRE(changes.size() == 3);
+
+	MEMORIA_CHECK(changes[0].Address == &regions.Plain[0x20] && changes[0].Size == 2);
+	MEMORIA_CHECK(changes[1].Address == &regions.Plain[0xFFF] && changes[1].Size == 2);
+	MEMORIA_CHECK(changes[2].Address == &regions.Watched[0x1800] && changes[2].Size == 1);
+
+	// The snapshot keeps the old contents.
+	uint8_t old_bytes[2];
+
+	MEMORIA_CHECK(snapshot.Read(&regions.Plain[0xFFF], old_bytes, sizeof(old_bytes)));
+	MEMORIA_CHECK(old_bytes[0] == static_cast<uint8_t>(0xFFF + 1) && old_bytes[1] == 0);
+
+	// Writing the same value back is no change.
+	regions.Plain[0x20] = 0x21;
+	regions.Plain[0x21] = 0x22;
+
+	auto deltas = snapshot.DiffValues<uint32_t>();
+
+	MEMORIA_REQUIRE(deltas.size() == 3);
+
+	MEMORIA_CHECK(deltas[0].Address == reinterpret_cast<uint32_t *>(&regions.Plain[0xFFC]));
+	MEMORIA_CHECK(deltas[1].Address == reinterpret_cast<uint32_t *>(&regions.Plain[0x1000]));
+	MEMORIA_CHECK(deltas[1].Old == 0 && deltas[1].New == 0xAA);
+	MEMORIA_CHECK(deltas[2].Address == reinterpret_cast<uint32_t *>(&regions.Watched[0x1800]));
+
+	// A new capture takes the current contents.
+	MEMORIA_REQUIRE(snapshot.Capture());
+	MEMORIA_CHECK(snapshot.Diff().empty());
+
+	FreeSnapshotRegions(&regions);
+}
+
+MEMORIA_TEST(SnapshotDiffsOtherSnapshots)
+{
+	SnapshotRegions_t regions;
+	MEMORIA_REQUIRE(CreateSnapshotRegions(&regions));
+
+	Memoria::CSnapshot before, after;
+
+	MEMORIA_CHECK(before.Add(regions.Plain, 0x4000));
+	MEMORIA_CHECK(before.Add(regions.Watched, 0x2000));
+	MEMORIA_CHECK(after.Add(regions.Plain, 0x4000));
+	MEMORIA_CHECK(after.Add(regions.Watched, 0x2000));
+
+	MEMORIA_REQUIRE(before.Capture());
+
+	regions.Plain[0x3000] = 1;
+	regions.Watched[0x10] ^= 0xFF;
+	regions.Watched[0x11] ^= 0xFF;
+
+	MEMORIA_REQUIRE(after.Capture());
+
+	// The live memory changes again; the snapshots are compared with each other only.
+	regions.Plain[0x2000] = 1;
+
+	auto changes = before.Diff(after);
+
+	MEMORIA_REQUIRE(changes.size() == 2);
+
+	MEMORIA_CHECK(changes[0].Address == &regions.Plain[0x3000] && changes[0].Size == 1);
+	MEMORIA_CHECK(changes[1].Address == &regions.Watched[0x10] && changes[1].Size == 2);
+
+	MEMORIA_CHECK(after.Diff(after).empty());
+
+	// Snapshots of different regions cannot be compared.
+	Memoria::CSnapshot other;
+
+	MEMORIA_CHECK(other.Add(regions.Plain, 0x1000));
+	MEMORIA_REQUIRE(other.Capture());
+	MEMORIA_CHECK(before.Diff(other).empty());
+
+	FreeSnapshotRegions(&regions);
+}
\ No newline at end of file
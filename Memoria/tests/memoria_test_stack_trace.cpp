@@ -0,0 +1,102 @@
+#include "memoria_test.hpp"
+
+#include "memoria_core_debug.hpp"
+
+#include <intrin.h>
+
+// Captures the trace of this function, and where it returns to.
+static __declspec(noinline) uint32_t CaptureWithCallSite(const void **site, size_t skip)
+{
+	uint32_t id = Memoria::CaptureStackTraceId(skip);
+	*site = _ReturnAddress();
+
+	return id;
+}
+
+MEMORIA_TEST(CaptureStackTraceIdStartsInTheCaller)
+{
+	const void *site = nullptr;
+	size_t count = 0;
+
+	uint32_t id = CaptureWithCallSite(&site, 0);
+	MEMORIA_REQUIRE(id != 0);
+
+	void *const *frames = Memoria::GetStackTrace(id, &count);
+
+	MEMORIA_REQUIRE(frames && count >= 2);
+	MEMORIA_CHECK(frames[1] == site);
+
+	// Skipped frames are left out.
+	id = CaptureWithCallSite(&site, 1);
+	MEMORIA_REQUIRE(id != 0);
+
+	frames = Memoria::GetStackTrace(id, &count);
+
+	MEMORIA_REQUIRE(frames && count >= 1);
+	MEMORIA_CHECK(frames[0] == site);
+}
+
+MEMORIA_TEST(CaptureStackTraceIdReusesTraces)
+{
+	const void *site;
+	uint32_t ids[4];
+
+	// The same call site gives the same trace every time.
+	for (auto &id : ids)
+		id = CaptureWithCallSite(&site, 0);
+
+	MEMORIA_REQUIRE(ids[0] != 0);
+	MEMORIA_CHECK(ids[1] == ids[0] && ids[2] == ids[0] && ids[3] == ids[0]);
+
+	uint32_t other = CaptureWithCallSite(&site, 0);
+
+	MEMORIA_CHECK(other != 0 && other != ids[0]);
+	MEMORIA_CHECK(Memoria::GetStackTraceCount() >= 2);
+}
+
+MEMORIA_TEST(InternStackTraceStoresCopies)
+{
+	void *frames[] = { reinterpret_cast<void *>(0x1000), reinterpret_cast<void *>(0x2000), reinterpret_cast<void *>(0x3000) };
+
+	size_t traces = Memoria::GetStackTraceCount();
+
+	uint32_t id = Memoria::InternStackTrace(frames, _countof(frames));
+	MEMORIA_REQUIRE(id != 0);
+
+	MEMORIA_CHECK(Memoria::InternStackTrace(frames, _countof(frames)) == id);
+
+	// A prefix or a different frame is another trace.
+	uint32_t prefix = Memoria::InternStackTrace(frames, 2);
+
+	frames[2] = reinterpret_cast<void *>(0x4000);
+	uint32_t changed = Memoria::InternStackTrace(frames, _countof(frames));
+
+	MEMORIA_CHECK(prefix != 0 && prefix != id);
+	MEMORIA_CHECK(changed != 0 && changed != id && changed != prefix);
+	MEMORIA_CHECK(Memoria::GetStackTraceCount() >= traces + 3);
+
+	size_t count = 0;
+	void *const *stored = Memoria::GetStackTrace(id, &count);
+
+	MEMORIA_REQUIRE(stored && count == 3);
+	MEMORIA_CHECK(stored != frames);
+	MEMORIA_CHECK(stored[0] == reinterpret_cast<void *>(0x1000) && stored[2] == reinterpret_cast<void *>(0x3000));
+
+	// The frames stay where they are while the store grows.
+	void *more[] = { reinterpret_cast<void *>(0x5000) };
+
+	for (uintptr_t i = 0; i < 1000; ++i)
+	{
+		more[0] = reinterpret_cast<void *>(0x5000 + i);
+		Memoria::InternStackTrace(more, 1);
+	}
+
+	MEMORIA_CHECK(Memoria::GetStackTrace(id, &count) == stored);
+
+	MEMORIA_CHECK(Memoria::GetStackTrace(0, &count) == nullptr && count == 0);
+	MEMORIA_CHECK(Memoria::GetStackTrace(UINT32_MAX, &count) == nullptr);
+
+	MEMORIA_CHECK(Memoria::InternStackTrace(nullptr, 1) == 0);
+	MEMORIA_CHECK(Memoria::InternStackTrace(frames, 0) == 0);
+	MEMORIA_CHECK(Memoria::InternStackTrace(frames, MEMORIA_MAX_STACK_FRAMES + 1) == 0);
+}
\ No newline at end of file
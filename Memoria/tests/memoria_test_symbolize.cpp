@@ -0,0 +1,139 @@
+#include "memoria_test.hpp"
+
+#include "memoria_core_debug.hpp"
+#include "memoria_core_misc.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+// Implemented in kernel32 itself on every version, not forwarded.
+static const uint8_t *GetKernel32Code()
+{
+	return reinterpret_cast<const uint8_t *>(GetProcAddress(GetModuleHandleA("kernel32.dll"), "BaseThreadInitThunk"));
+}
+
+MEMORIA_TEST(BeautifyPointerNamesTheModule)
+{
+	const uint8_t *code = GetKernel32Code();
+	MEMORIA_REQUIRE(code);
+
+	HMODULE kernel32 = GetModuleHandleA("kernel32.dll");
+
+	char expected[128];
+	sprintf(expected, "kernel32.%llx", static_cast<unsigned long long>(&code[2] - reinterpret_cast<const uint8_t *>(kernel32)));
+
+	char text[128];
+
+	MEMORIA_CHECK(Memoria::BeautifyPointer(&code[2], text, sizeof(text)));
+	MEMORIA_CHECK(lstrcmpiA(text, expected) == 0);
+
+	MEMORIA_CHECK(Memoria::BeautifyPointer(&code[2], kernel32, "KERNEL32.DLL", text, sizeof(text)));
+	MEMORIA_CHECK(lstrcmpiA(text, expected) == 0);
+
+	MEMORIA_CHECK(Memoria::BeautifyPointer(nullptr, text, sizeof(text)));
+	MEMORIA_CHECK(strcmp(text, "null") == 0);
+
+	// Addresses outside of modules are printed as they are.
+	int local = 0;
+
+	sprintf(expected, "%p", static_cast<void *>(&local));
+
+	MEMORIA_CHECK(Memoria::BeautifyPointer(&local, text, sizeof(text)));
+	MEMORIA_CHECK(strcmp(text, expected) == 0);
+}
+
+MEMORIA_TEST(SymbolizeAddressesKeepsTheInputOrder)
+{
+	const uint8_t *code = GetKernel32Code();
+	MEMORIA_REQUIRE(code);
+
+	HMODULE kernel32 = GetModuleHandleA("kernel32.dll");
+	int local = 0;
+
+	// Out of address order, with a repeated address and addresses outside of modules.
+	const void *addresses[] = { &code[4], &local, nullptr, &code[1], &code[4] };
+	Memoria::SymbolInfo_t infos[_countof(addresses)];
+
+	size_t found = Memoria::SymbolizeAddresses(addresses, _countof(addresses), infos);
+
+	MEMORIA_CHECK(found <= 3);
+
+	for (size_t i = 0; i < _countof(addresses); ++i)
+		MEMORIA_CHECK(infos[i].Address == addresses[i]);
+
+	for (size_t i : { 0, 3, 4 })
+	{
+		MEMORIA_CHECK(infos[i].Module == kernel32);
+		MEMORIA_CHECK(lstrcmpiA(infos[i].ModuleName, "kernel32.dll") == 0);
+
+#ifdef MEMORIA_64BIT
+		MEMORIA_CHECK(infos[i].Function == Memoria::GetFunctionBaseAddressFromItsCode(addresses[i]));
+		MEMORIA_CHECK(infos[i].Function == code);
+#endif
+
+		// The export is the nearest symbol without a PDB.
+		if (infos[i].Name[0])
+			MEMORIA_CHECK(strcmp(infos[i].Name, "BaseThreadInitThunk") == 0);
+	}
+
+	for (size_t i : { 1, 2 })
+	{
+		MEMORIA_CHECK(infos[i].Module == nullptr && infos[i].Function == nullptr);
+		MEMORIA_CHECK(infos[i].ModuleName[0] == '\0' && infos[i].Name[0] == '\0');
+	}
+
+	MEMORIA_CHECK(strcmp(infos[0].Name, infos[4].Name) == 0);
+
+	// Cached names are returned again.
+	Memoria::SymbolInfo_t again;
+
+	MEMORIA_CHECK(Memoria::SymbolizeAddresses(&addresses[0], 1, &again) == (infos[0].Name[0] ? 1u : 0u));
+	MEMORIA_CHECK(strcmp(again.Name, infos[0].Name) == 0);
+
+	MEMORIA_CHECK(Memoria::SymbolizeAddresses(nullptr, 1, infos) == 0);
+	MEMORIA_CHECK(Memoria::SymbolizeAddresses(addresses, 0, infos) == 0);
+}
+
+MEMORIA_TEST(FormatSymbolInfoMatchesGetBeautyFunctionAddress)
+{
+	const uint8_t *code = GetKernel32Code();
+	MEMORIA_REQUIRE(code);
+
+	const void *address = &code[3];
+
+	Memoria::SymbolInfo_t info;
+	Memoria::SymbolizeAddresses(&address, 1, &info);
+
+	char pointer_text[128];
+	MEMORIA_REQUIRE(Memoria::BeautifyPointer(address, pointer_text, sizeof(pointer_text)));
+
+	char formatted[512];
+	char beauty[512];
+
+	MEMORIA_CHECK(Memoria::FormatSymbolInfo(info, formatted, sizeof(formatted)));
+	MEMORIA_CHECK(Memoria::GetBeautyFunctionAddress(address, beauty, sizeof(beauty)));
+	MEMORIA_CHECK(strcmp(formatted, beauty) == 0);
+
+	if (info.Name[0])
+	{
+		// "module!name+0xOFFSET [pointer]"
+		char expected[512];
+		sprintf(expected, "%s!%s+0x%llX [%s]", info.ModuleName, info.Name,
+			static_cast<unsigned long long>(static_cast<const uint8_t *>(address) - static_cast<const uint8_t *>(info.Function)), pointer_text);
+
+		MEMORIA_CHECK(strcmp(formatted, expected) == 0);
+	}
+
+	// Unknown addresses fall back to the pointer, or fail.
+	int local = 0;
+	const void *unknown = &local;
+
+	MEMORIA_CHECK(Memoria::SymbolizeAddresses(&unknown, 1, &info) == 0);
+
+	MEMORIA_REQUIRE(Memoria::BeautifyPointer(unknown, pointer_text, sizeof(pointer_text)));
+	MEMORIA_CHECK(Memoria::FormatSymbolInfo(info, formatted, sizeof(formatted)));
+	MEMORIA_CHECK(strcmp(formatted, pointer_text) == 0);
+
+	MEMORIA_CHECK(!Memoria::FormatSymbolInfo(info, formatted, sizeof(formatted), true, false));
+	MEMORIA_CHECK(formatted[0] == '\0');
+}
\ No newline at end of file
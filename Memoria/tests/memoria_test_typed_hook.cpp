@@ -0,0 +1,98 @@
+#include "memoria_test.hpp"
+
+#include "memoria_core_hook.hpp"
+
+// Targets are left unoptimized so they are long enough to be hooked and are not inlined into the callers.
+#pragma optimize("", off)
+static __declspec(noinline) int TypedAdd(int a, int b)
+{
+	return a + b;
+}
+
+class CTypedCounter
+{
+public:
+	int _base = 10;
+
+	__declspec(noinline) int Add(int value) { return _base + value; }
+	__declspec(noinline) int Get() const { return _base; }
+};
+
+static __declspec(noinline) int CallTypedAdd(int a, int b)
+{
+	return TypedAdd(a, b);
+}
+
+static __declspec(noinline) int CallCounterAdd(CTypedCounter *counter, int value)
+{
+	return counter->Add(value);
+}
+
+static __declspec(noinline) int CallCounterGet(const CTypedCounter *counter)
+{
+	return counter->Get();
+}
+#pragma optimize("", on)
+
+static int TypedAddDetour(int a, int b)
+{
+	return Memoria::CTypedHook<&TypedAdd>::CallOriginal(a, b) * 2;
+}
+
+static int MEMORIA_MEMBER_DETOUR_CC CounterAddDetour(MEMORIA_MEMBER_DETOUR_THIS(CTypedCounter *, self), int value)
+{
+	return Memoria::CTypedHook<&CTypedCounter::Add>::CallOriginal(self, value) + 100;
+}
+
+static int MEMORIA_MEMBER_DETOUR_CC CounterGetDetour(MEMORIA_MEMBER_DETOUR_THIS(const CTypedCounter *, self))
+{
+	return Memoria::CTypedHook<&CTypedCounter::Get>::CallOriginal(self) + 1;
+}
+
+// Member functions keep their calling convention for the original and take the object pointer first.
+#ifdef MEMORIA_64BIT
+static_assert(std::is_same_v<Memoria::CTypedHook<&CTypedCounter::Add>::fn_t, int (*)(CTypedCounter *, int)>);
+static_assert(std::is_same_v<Memoria::CTypedHook<&CTypedCounter::Add>::detour_t, int (*)(CTypedCounter *, int)>);
+#else
+static_assert(std::is_same_v<Memoria::CTypedHook<&CTypedCounter::Add>::fn_t, int (__thiscall *)(CTypedCounter *, int)>);
+static_assert(std::is_same_v<Memoria::CTypedHook<&CTypedCounter::Add>::detour_t, int (__fastcall *)(CTypedCounter *, void *, int)>);
+#endif
+
+static_assert(std::is_same_v<Memoria::CTypedHook<&CTypedCounter::Get>::ret_t, int>);
+static_assert(std::is_same_v<Memoria::CTypedHook<&TypedAdd>::fn_t, int (*)(int, int)>);
+
+MEMORIA_TEST(TypedHookFreeFunction)
+{
+	MEMORIA_CHECK(CallTypedAdd(2, 3) == 5);
+
+	MEMORIA_REQUIRE(Memoria::TypedHook<&TypedAdd>(TypedAddDetour));
+	MEMORIA_CHECK(Memoria::CTypedHook<&TypedAdd>::IsInstalled());
+	MEMORIA_CHECK(Memoria::CTypedHook<&TypedAdd>::GetTarget() == reinterpret_cast<void *>(TypedAdd));
+
+	MEMORIA_CHECK(CallTypedAdd(2, 3) == 10);
+	MEMORIA_CHECK(Memoria::CTypedHook<&TypedAdd>::CallOriginal(2, 3) == 5);
+
+	// Every target is hooked once.
+	MEMORIA_CHECK(!Memoria::TypedHook<&TypedAdd>(TypedAddDetour));
+}
+
+MEMORIA_TEST(TypedHookMemberFunction)
+{
+	CTypedCounter counter;
+
+	MEMORIA_CHECK(CallCounterAdd(&counter, 5) == 15);
+	MEMORIA_CHECK(CallCounterGet(&counter) == 10);
+
+	MEMORIA_REQUIRE(Memoria::TypedHook<&CTypedCounter::Add>(CounterAddDetour));
+	MEMORIA_REQUIRE(Memoria::TypedHook<&CTypedCounter::Get>(CounterGetDetour));
+
+	// The detour receives the object and the arguments unchanged.
+	MEMORIA_CHECK(CallCounterAdd(&counter, 5) == 115);
+	MEMORIA_CHECK(CallCounterGet(&counter) == 11);
+
+	counter._base = 20;
+
+	MEMORIA_CHECK(CallCounterAdd(&counter, 1) == 121);
+	MEMORIA_CHECK(Memoria::CTypedHook<&CTypedCounter::Add>::CallOriginal(&counter, 1) == 21);
+	MEMORIA_CHECK(Memoria::CTypedHook<&CTypedCounter::Get>::CallOriginal(&counter) == 20);
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "memoria_test.hpp"
+
+#include "memoria_core_write.hpp"
+
+#include <string.h>
+
+static DWORD GetProtection(const void *addr)
+{
+	MEMORY_BASIC_INFORMATION mbi;
+
+	if (VirtualQuery(addr, &mbi, sizeof(mbi)) != sizeof(mbi))
+		return 0;
+
+	return mbi.Protect;
+}
+
+MEMORIA_TEST(WriteSessionCommitAndRollback)
+{
+	auto pages = static_cast<uint8_t *>(VirtualAlloc(nullptr, 0x3000, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+	MEMORIA_REQUIRE(pages);
+
+	for (size_t i = 0; i < 0x3000; ++i)
+		pages[i] = static_cast<uint8_t>(i);
+
+	static uint8_t original[0x3000];
+	memcpy(original, pages, sizeof(original));
+
+	DWORD old_protection;
+	MEMORIA_REQUIRE(VirtualProtect(pages, 0x3000, PAGE_READONLY, &old_protection));
+
+	Memoria::CWriteSession session;
+
+	const uint8_t data[] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88 };
+
+	// A write across a page boundary, one on the last page and two overlapping ones.
+	MEMORIA_CHECK(session.Write(&pages[0x1000 - 4], data, sizeof(data)));
+	MEMORIA_CHECK(session.WriteValue<uint32_t>(&pages[0x2800], 0xDEADBEEF));
+	MEMORIA_CHECK(session.Write(&pages[0x100], data, sizeof(data)));
+	MEMORIA_CHECK(session.Fill(&pages[0x104], 0x90, 8));
+
+	MEMORIA_CHECK(!session.Write(nullptr, data, sizeof(data)));
+	MEMORIA_CHECK(!session.Fill(pages, 0x90, 0));
+	MEMORIA_CHECK(session.GetWriteCount() == 4);
+
+	// Nothing is written before the commit.
+	MEMORIA_CHECK(memcmp(pages, original, sizeof(original)) == 0);
+
+	MEMORIA_REQUIRE(session.Commit());
+	MEMORIA_CHECK(session.IsCommitted());
+
+	MEMORIA_CHECK(memcmp(&pages[0x1000 - 4], data, sizeof(data)) == 0);
+	MEMORIA_CHECK(*reinterpret_cast<uint32_t *>(&pages[0x2800]) == 0xDEADBEEF);
+
+	// Later writes win where they overlap.
+	MEMORIA_CHECK(memcmp(&pages[0x100], data, 4) == 0);
+	MEMORIA_CHECK(pages[0x104] == 0x90 && pages[0x10B] == 0x90);
+
+	// Protections are restored.
+	MEMORIA_CHECK(GetProtection(&pages[0x0000]) == PAGE_READONLY);
+	MEMORIA_CHECK(GetProtection(&pages[0x1000]) == PAGE_READONLY);
+	MEMORIA_CHECK(GetProtection(&pages[0x2000]) == PAGE_READONLY);
+
+	// A committed session takes no more writes.
+	MEMORIA_CHECK(!session.Write(pages, data, sizeof(data)));
+
+	MEMORIA_REQUIRE(session.Rollback());
+	MEMORIA_CHECK(!session.IsCommitted());
+	MEMORIA_CHECK(memcmp(pages, original, sizeof(original)) == 0);
+	MEMORIA_CHECK(!session.Rollback());
+
+	// The staged writes are kept and can be committed again.
+	MEMORIA_CHECK(session.Commit(true));
+	MEMORIA_CHECK(*reinterpret_cast<uint32_t *>(&pages[0x2800]) == 0xDEADBEEF);
+	MEMORIA_CHECK(session.Rollback(true));
+
+	session.Clear();
+	MEMORIA_CHECK(session.GetWriteCount() == 0);
+
+	VirtualFree(pages, 0, MEM_RELEASE);
+}
+
+MEMORIA_TEST(WriteSessionPatchesCode)
+{
+	auto function = MemoriaTest::CreateConstantFunction(3);
+	MEMORIA_REQUIRE(function);
+
+	auto code = reinterpret_cast<uint8_t *>(function);
+
+	DWORD old_protection;
+	MEMORIA_REQUIRE(VirtualProtect(code, 16, PAGE_EXECUTE_READ, &old_protection));
+
+	// `mov eax, imm32` starts the function.
+	Memoria::CWriteSession session;
+	MEMORIA_CHECK(session.WriteValue<int32_t>(&code[1], 7));
+
+	MEMORIA_REQUIRE(session.Commit(true));
+	MEMORIA_CHECK(function() == 7);
+	MEMORIA_CHECK(GetProtection(code) == PAGE_EXECUTE_READ);
+
+	MEMORIA_REQUIRE(session.Rollback(true));
+	MEMORIA_CHECK(function() == 3);
+}
\ No newline at end of file